@@ -0,0 +1,34 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define ARENA_ALIGN 64
+
+struct Arena_t;
+typedef struct Arena_t Arena;
+
+// NOTE: bump allocator for the per-particle state of a System (positions,
+//       topology and ptclid2topol). Blocks are mapped with mmap and handed
+//       out 64-byte aligned; nothing is freed before deleteArena, which
+//       releases all of them at once. With huge_pages the blocks are backed
+//       by 2 MB pages, from MAP_HUGETLB when pages are reserved and from
+//       transparent huge pages (madvise) otherwise.
+Arena* newArena(const bool huge_pages);
+void deleteArena(Arena* self);
+
+// NOTE: zeroed memory, first touched by the calling thread. The state of
+//       the sweep is allocated by the thread that runs the sweep, so that
+//       it is placed on the NUMA node of that thread.
+void* allocArena(Arena* self, const size_t size);
+
+// NOTE: zeroed memory of num_chunks chunks of chunk_size bytes, owned by
+//       the threads of a "#pragma omp parallel for schedule(static)" loop
+//       over the chunks. Chunk c is first touched by the thread that runs
+//       iteration c, except with huge_pages, where the calling thread
+//       touches all of them.
+void* allocArenaChunks(Arena* self, const int32_t num_chunks, const size_t chunk_size);
+
+#endif
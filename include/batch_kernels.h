@@ -0,0 +1,84 @@
+#ifndef BATCH_KERNELS_H
+#define BATCH_KERNELS_H
+
+#include <stdint.h>
+#include <complex.h>
+
+#include "tensor3.h"
+#include "pos_store.h"
+#include "topol.h"
+
+struct Boundary_t;
+typedef struct Boundary_t Boundary;
+
+struct BondedParam_t;
+typedef struct BondedParam_t BondedParam;
+
+struct Arena_t;
+typedef struct Arena_t Arena;
+
+struct BatchBuffers_t;
+typedef struct BatchBuffers_t BatchBuffers;
+
+// NOTE: the per-chunk partial sums of the kernels below, allocated once
+//       in the arena of a System. Each chunk is first touched by the
+//       thread that runs it in the static partition of the passes (see
+//       allocArenaChunks). num_padded is that of the PosStore.
+BatchBuffers* newBatchBuffers(const int32_t num_bonds,
+                              const int32_t num_angles,
+                              const int32_t num_padded,
+                              Arena* arena);
+
+// NOTE: full-system kernels on the structure-of-arrays positions. Bonds,
+//       angles and particles are processed in blocks of POS_STORE_BLOCK
+//       lanes with one partial sum per lane; the lanes are reduced in a
+//       fixed order, so the results do not depend on the build.
+//       The minimum image is branch-free: the box length of the free
+//       boundary is zero. The geometry of a block is vectorized with
+//       AVX-512 or AVX2 when the CPU supports them (see
+//       selectBatchKernels), with the same results.
+void sumBondedEnergyOfStore(const PosStore* store,
+                            const pair* bonds,
+                            const int32_t num_bonds,
+                            const triple* angles,
+                            const int32_t num_angles,
+                            const BondedParam* bp,
+                            const Boundary* bound,
+                            BatchBuffers* buf,
+                            double* etot_bond,
+                            double* etot_angle);
+
+typedef struct BondedSums_t {
+  double e_bond;
+  double e_angle;
+  dtensor3 virial;
+} BondedSums;
+
+// NOTE: bond and angle energies and the bonded virial in one pass, the
+//       same as sumBondedEnergyOfStore for the energies.
+void sumBondedTermsOfStore(const PosStore* store,
+                           const pair* bonds,
+                           const int32_t num_bonds,
+                           const triple* angles,
+                           const int32_t num_angles,
+                           const BondedParam* bp,
+                           const Boundary* bound,
+                           BatchBuffers* buf,
+                           BondedSums* sums);
+
+// NOTE: radius of gyration around the unwrapped center of mass
+//       (distances to the center of mass use the minimum image).
+double calcRgOfStore(const PosStore* store, const Boundary* bound, BatchBuffers* buf);
+
+// NOTE: sum_i h_i exp(-i q.r_i) with h = y, q.r = qx x in 2D and
+//       h = z, q.r = qx x + qy y in 3D.
+double complex calcHeightDftOfStore(const PosStore* store, const double qx, const double qy);
+
+// NOTE: picks the kernels for the instruction sets of the CPU. It is
+//       called once at startup, before any kernel runs.
+void selectBatchKernels(void);
+
+// NOTE: "avx512", "avx2", "sse2" or "scalar", the kernels in use.
+const char* getBatchKernelIsa(void);
+
+#endif
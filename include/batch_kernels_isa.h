@@ -0,0 +1,402 @@
+// NOTE: the block kernels of batch_kernels.c for one instruction set.
+//       batch_kernels.c includes this file once per set, with
+//       BATCH_ISA_LEVEL (2 for AVX-512, 1 for AVX2, 0 for plain loops),
+//       BATCH_ISA_SUFFIX and BATCH_ISA_NAME defined, so there is no
+//       include guard. The kernels of every set do the same operations in
+//       the same order on each lane.
+
+#define ISA_NAME(name) CONCAT(name, BATCH_ISA_SUFFIX)
+
+#if BATCH_ISA_LEVEL == 2
+// NOTE: d[l] = comp[ib[l]] - comp[ia[l]] - leng * nearbyint(... * inv_leng)
+static ALWAYS_INLINE void ISA_NAME(gatherDispComponent)(const double* comp,
+                                                        const int32_t* ia,
+                                                        const int32_t* ib,
+                                                        const double leng,
+                                                        const double inv_leng,
+                                                        double* d)
+{
+  const __m512d ca = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)ia), comp, 8);
+  const __m512d cb = _mm512_i32gather_pd(_mm256_loadu_si256((const __m256i*)ib), comp, 8);
+  const __m512d dv = _mm512_sub_pd(cb, ca);
+  const __m512d img = _mm512_roundscale_pd(_mm512_mul_pd(dv, _mm512_set1_pd(inv_leng)),
+                                           _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+  _mm512_storeu_pd(d, _mm512_sub_pd(dv, _mm512_mul_pd(_mm512_set1_pd(leng), img)));
+}
+
+static ALWAYS_INLINE void ISA_NAME(dotDispBlock)(const DispBlock* d0,
+                                                 const DispBlock* d1,
+                                                 const int32_t dim,
+                                                 double* out)
+{
+  __m512d acc = _mm512_add_pd(_mm512_mul_pd(_mm512_loadu_pd(d0->x), _mm512_loadu_pd(d1->x)),
+                              _mm512_mul_pd(_mm512_loadu_pd(d0->y), _mm512_loadu_pd(d1->y)));
+  if (dim == 3) acc = _mm512_add_pd(acc, _mm512_mul_pd(_mm512_loadu_pd(d0->z), _mm512_loadu_pd(d1->z)));
+  _mm512_storeu_pd(out, acc);
+}
+
+static ALWAYS_INLINE void ISA_NAME(addOuterLane)(double* v,
+                                                 const double* f,
+                                                 const double* d,
+                                                 const double* mask)
+{
+  const __m512d fd = _mm512_mul_pd(_mm512_loadu_pd(f), _mm512_loadu_pd(d));
+  _mm512_storeu_pd(v, _mm512_add_pd(_mm512_loadu_pd(v), _mm512_mul_pd(_mm512_loadu_pd(mask), fd)));
+}
+#elif BATCH_ISA_LEVEL == 1
+static ALWAYS_INLINE void ISA_NAME(gatherDispComponent)(const double* comp,
+                                                        const int32_t* ia,
+                                                        const int32_t* ib,
+                                                        const double leng,
+                                                        const double inv_leng,
+                                                        double* d)
+{
+  const __m256d vl = _mm256_set1_pd(leng), vil = _mm256_set1_pd(inv_leng);
+  for (int32_t h = 0; h < LANES; h += 4) {
+    const __m256d ca = _mm256_i32gather_pd(comp, _mm_loadu_si128((const __m128i*)&ia[h]), 8);
+    const __m256d cb = _mm256_i32gather_pd(comp, _mm_loadu_si128((const __m128i*)&ib[h]), 8);
+    const __m256d dv = _mm256_sub_pd(cb, ca);
+    const __m256d img = _mm256_round_pd(_mm256_mul_pd(dv, vil), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    _mm256_storeu_pd(&d[h], _mm256_sub_pd(dv, _mm256_mul_pd(vl, img)));
+  }
+}
+
+static ALWAYS_INLINE void ISA_NAME(dotDispBlock)(const DispBlock* d0,
+                                                 const DispBlock* d1,
+                                                 const int32_t dim,
+                                                 double* out)
+{
+  for (int32_t h = 0; h < LANES; h += 4) {
+    __m256d acc = _mm256_add_pd(_mm256_mul_pd(_mm256_loadu_pd(&d0->x[h]), _mm256_loadu_pd(&d1->x[h])),
+                                _mm256_mul_pd(_mm256_loadu_pd(&d0->y[h]), _mm256_loadu_pd(&d1->y[h])));
+    if (dim == 3) acc = _mm256_add_pd(acc, _mm256_mul_pd(_mm256_loadu_pd(&d0->z[h]), _mm256_loadu_pd(&d1->z[h])));
+    _mm256_storeu_pd(&out[h], acc);
+  }
+}
+
+static ALWAYS_INLINE void ISA_NAME(addOuterLane)(double* v,
+                                                 const double* f,
+                                                 const double* d,
+                                                 const double* mask)
+{
+  for (int32_t h = 0; h < LANES; h += 4) {
+    const __m256d fd = _mm256_mul_pd(_mm256_loadu_pd(&f[h]), _mm256_loadu_pd(&d[h]));
+    _mm256_storeu_pd(&v[h], _mm256_add_pd(_mm256_loadu_pd(&v[h]), _mm256_mul_pd(_mm256_loadu_pd(&mask[h]), fd)));
+  }
+}
+#else
+static ALWAYS_INLINE void ISA_NAME(gatherDispComponent)(const double* comp,
+                                                        const int32_t* ia,
+                                                        const int32_t* ib,
+                                                        const double leng,
+                                                        const double inv_leng,
+                                                        double* d)
+{
+  for (int32_t l = 0; l < LANES; l++) {
+    const double dv = comp[ib[l]] - comp[ia[l]];
+    d[l] = dv - leng * nearbyint(dv * inv_leng);
+  }
+}
+
+static ALWAYS_INLINE void ISA_NAME(dotDispBlock)(const DispBlock* d0,
+                                                 const DispBlock* d1,
+                                                 const int32_t dim,
+                                                 double* out)
+{
+  for (int32_t l = 0; l < LANES; l++) out[l] = d0->x[l] * d1->x[l] + d0->y[l] * d1->y[l];
+  if (dim == 3) {
+    for (int32_t l = 0; l < LANES; l++) out[l] += d0->z[l] * d1->z[l];
+  }
+}
+
+static ALWAYS_INLINE void ISA_NAME(addOuterLane)(double* v,
+                                                 const double* f,
+                                                 const double* d,
+                                                 const double* mask)
+{
+  for (int32_t l = 0; l < LANES; l++) v[l] += mask[l] * (f[l] * d[l]);
+}
+#endif
+
+static ALWAYS_INLINE void ISA_NAME(gatherDispBlock)(const PosStore* store,
+                                                    const int32_t* ia,
+                                                    const int32_t* ib,
+                                                    const Boundary* bound,
+                                                    const int32_t dim,
+                                                    DispBlock* d)
+{
+  ISA_NAME(gatherDispComponent)(store->x, ia, ib, bound->box_leng.x, bound->inv_box_leng.x, d->x);
+  ISA_NAME(gatherDispComponent)(store->y, ia, ib, bound->box_leng.y, bound->inv_box_leng.y, d->y);
+  if (dim == 3) ISA_NAME(gatherDispComponent)(store->z, ia, ib, bound->box_leng.z, bound->inv_box_leng.z, d->z);
+}
+
+// NOTE: adds the outer product f (x) d of each unmasked lane.
+static ALWAYS_INLINE void ISA_NAME(addOuterLanes)(VirialLanes* vir,
+                                                  const DispBlock* fa,
+                                                  const DispBlock* da,
+                                                  const double* mask,
+                                                  const int32_t dim)
+{
+  const double* f[3] = {fa->x, fa->y, fa->z};
+  const double* d[3] = {da->x, da->y, da->z};
+  for (int32_t a = 0; a < dim; a++) {
+    for (int32_t b = 0; b < dim; b++) ISA_NAME(addOuterLane)(vir->v[3 * a + b], f[a], d[b], mask);
+  }
+}
+
+static ALWAYS_INLINE double ISA_NAME(sumBondEnergyChunk)(const PosStore* store,
+                                                         const pair* bonds,
+                                                         const int32_t begin,
+                                                         const int32_t num_bonds,
+                                                         const BondedParam* bp,
+                                                         const Boundary* bound,
+                                                         const int32_t dim)
+{
+  int32_t i0[LANES], i1[LANES];
+  double mask[LANES], r2[LANES], e[LANES];
+  DispBlock d01;
+  double acc[LANES] = {0.0};
+  const int32_t end = getChunkEnd(begin, num_bonds);
+  for (int32_t b0 = begin; b0 < end; b0 += LANES) {
+    gatherBondIndex(bonds, b0, num_bonds, i0, i1, mask);
+    ISA_NAME(gatherDispBlock)(store, i0, i1, bound, dim, &d01);
+    ISA_NAME(dotDispBlock)(&d01, &d01, dim, r2);
+    calcBondEnergyLanes(r2, bp, e);
+    accumulateMasked(acc, e, mask);
+  }
+  return reduceLanes(acc);
+}
+
+static ALWAYS_INLINE double ISA_NAME(sumAngleEnergyChunk)(const PosStore* store,
+                                                          const triple* angles,
+                                                          const int32_t begin,
+                                                          const int32_t num_angles,
+                                                          const BondedParam* bp,
+                                                          const Boundary* bound,
+                                                          const int32_t dim)
+{
+  int32_t i0[LANES], i1[LANES], i2[LANES];
+  double mask[LANES], e[LANES];
+  DispBlock d01, d12;
+  double acc[LANES] = {0.0};
+  const int32_t end = getChunkEnd(begin, num_angles);
+  for (int32_t a0 = begin; a0 < end; a0 += LANES) {
+    double n01[LANES], n12[LANES], cs[LANES];
+    gatherAngleIndex(angles, a0, num_angles, i0, i1, i2, mask);
+    ISA_NAME(gatherDispBlock)(store, i0, i1, bound, dim, &d01);
+    ISA_NAME(gatherDispBlock)(store, i1, i2, bound, dim, &d12);
+    ISA_NAME(dotDispBlock)(&d01, &d12, dim, cs);
+    ISA_NAME(dotDispBlock)(&d01, &d01, dim, n01);
+    ISA_NAME(dotDispBlock)(&d12, &d12, dim, n12);
+    for (int32_t l = 0; l < LANES; l++) cs[l] /= sqrt(n01[l] * n12[l]);
+    calcAngleEnergyLanes(cs, bp, e);
+    accumulateMasked(acc, e, mask);
+  }
+  return reduceLanes(acc);
+}
+
+static ALWAYS_INLINE void ISA_NAME(sumBondTermsChunk)(const PosStore* store,
+                                                      const pair* bonds,
+                                                      const int32_t begin,
+                                                      const int32_t num_bonds,
+                                                      const BondedParam* bp,
+                                                      const Boundary* bound,
+                                                      const int32_t dim,
+                                                      double* out)
+{
+  int32_t i0[LANES], i1[LANES];
+  double mask[LANES], r2[LANES], s[LANES], e[LANES];
+  DispBlock d0, f;
+  VirialLanes vir = {{{0.0}}};
+  double acc[LANES] = {0.0};
+  const int32_t end = getChunkEnd(begin, num_bonds);
+  for (int32_t b0 = begin; b0 < end; b0 += LANES) {
+    gatherBondIndex(bonds, b0, num_bonds, i0, i1, mask);
+    ISA_NAME(gatherDispBlock)(store, i0, i1, bound, dim, &d0);
+    ISA_NAME(dotDispBlock)(&d0, &d0, dim, r2);
+    calcBondEnergyLanes(r2, bp, e);
+    accumulateMasked(acc, e, mask);
+    calcBondScaleLanes(r2, bp, s);
+    for (int32_t l = 0; l < LANES; l++) {
+      f.x[l] = d0.x[l] * s[l];
+      f.y[l] = d0.y[l] * s[l];
+      f.z[l] = (dim == 3) ? d0.z[l] * s[l] : 0.0;
+    }
+    ISA_NAME(addOuterLanes)(&vir, &f, &d0, mask, dim);
+  }
+  reduceTermsChunk(acc, &vir, out);
+}
+
+// NOTE: d0 = dr10, d1 = dr12 (see calcAngleVirialOfSlope in
+//       interactions.h). The energy takes cos theta = -(dr10 * dr12) /
+//       (|dr10| |dr12|), the same bit for bit as with dr01.
+static ALWAYS_INLINE void ISA_NAME(sumAngleTermsChunk)(const PosStore* store,
+                                                       const triple* angles,
+                                                       const int32_t begin,
+                                                       const int32_t num_angles,
+                                                       const BondedParam* bp,
+                                                       const Boundary* bound,
+                                                       const int32_t dim,
+                                                       double* out)
+{
+  int32_t i0[LANES], i1[LANES], i2[LANES];
+  double mask[LANES], e[LANES];
+  DispBlock d0, d1, f;
+  VirialLanes vir = {{{0.0}}};
+  double acc[LANES] = {0.0};
+  const int32_t end = getChunkEnd(begin, num_angles);
+  for (int32_t a0 = begin; a0 < end; a0 += LANES) {
+    double n10[LANES], n12[LANES], cs[LANES], cs01[LANES];
+    double a11[LANES], a12[LANES], a22[LANES];
+    gatherAngleIndex(angles, a0, num_angles, i0, i1, i2, mask);
+    ISA_NAME(gatherDispBlock)(store, i1, i0, bound, dim, &d0);
+    ISA_NAME(gatherDispBlock)(store, i1, i2, bound, dim, &d1);
+    ISA_NAME(dotDispBlock)(&d0, &d1, dim, cs);
+    ISA_NAME(dotDispBlock)(&d0, &d0, dim, n10);
+    ISA_NAME(dotDispBlock)(&d1, &d1, dim, n12);
+    for (int32_t l = 0; l < LANES; l++) cs01[l] = -cs[l] / sqrt(n10[l] * n12[l]);
+    calcAngleEnergyLanes(cs01, bp, e);
+    accumulateMasked(acc, e, mask);
+    for (int32_t l = 0; l < LANES; l++) {
+      double c = cs[l] / sqrt(n10[l] * n12[l]);
+      if (c > 1.0) c = 1.0;
+      if (c < -1.0) c = -1.0;
+      const double k = calcAngleSlope(c, bp);
+      a11[l] = k * c / n10[l];
+      a12[l] = -k / sqrt(n10[l] * n12[l]);
+      a22[l] = k * c / n12[l];
+    }
+
+    for (int32_t l = 0; l < LANES; l++) {
+      f.x[l] = d0.x[l] * a11[l] + d1.x[l] * a12[l];
+      f.y[l] = d0.y[l] * a11[l] + d1.y[l] * a12[l];
+      f.z[l] = (dim == 3) ? d0.z[l] * a11[l] + d1.z[l] * a12[l] : 0.0;
+    }
+    ISA_NAME(addOuterLanes)(&vir, &f, &d0, mask, dim);
+
+    for (int32_t l = 0; l < LANES; l++) {
+      f.x[l] = d1.x[l] * a22[l] + d0.x[l] * a12[l];
+      f.y[l] = d1.y[l] * a22[l] + d0.y[l] * a12[l];
+      f.z[l] = (dim == 3) ? d1.z[l] * a22[l] + d0.z[l] * a12[l] : 0.0;
+    }
+    ISA_NAME(addOuterLanes)(&vir, &f, &d1, mask, dim);
+  }
+  reduceTermsChunk(acc, &vir, out);
+}
+
+
+static double ISA_NAME(sumBondEnergyOfChunk)(const PosStore* store,
+                                             const pair* bonds,
+                                             const int32_t begin,
+                                             const int32_t num_bonds,
+                                             const BondedParam* bp,
+                                             const Boundary* bound)
+{
+  if (store->dim == 3) return ISA_NAME(sumBondEnergyChunk)(store, bonds, begin, num_bonds, bp, bound, 3);
+  return ISA_NAME(sumBondEnergyChunk)(store, bonds, begin, num_bonds, bp, bound, 2);
+}
+
+static double ISA_NAME(sumAngleEnergyOfChunk)(const PosStore* store,
+                                              const triple* angles,
+                                              const int32_t begin,
+                                              const int32_t num_angles,
+                                              const BondedParam* bp,
+                                              const Boundary* bound)
+{
+  if (store->dim == 3) return ISA_NAME(sumAngleEnergyChunk)(store, angles, begin, num_angles, bp, bound, 3);
+  return ISA_NAME(sumAngleEnergyChunk)(store, angles, begin, num_angles, bp, bound, 2);
+}
+
+static void ISA_NAME(sumBondTermsOfChunk)(const PosStore* store,
+                                          const pair* bonds,
+                                          const int32_t begin,
+                                          const int32_t num_bonds,
+                                          const BondedParam* bp,
+                                          const Boundary* bound,
+                                          double* out)
+{
+  if (store->dim == 3) {
+    ISA_NAME(sumBondTermsChunk)(store, bonds, begin, num_bonds, bp, bound, 3, out);
+  } else {
+    ISA_NAME(sumBondTermsChunk)(store, bonds, begin, num_bonds, bp, bound, 2, out);
+  }
+}
+
+static void ISA_NAME(sumAngleTermsOfChunk)(const PosStore* store,
+                                           const triple* angles,
+                                           const int32_t begin,
+                                           const int32_t num_angles,
+                                           const BondedParam* bp,
+                                           const Boundary* bound,
+                                           double* out)
+{
+  if (store->dim == 3) {
+    ISA_NAME(sumAngleTermsChunk)(store, angles, begin, num_angles, bp, bound, 3, out);
+  } else {
+    ISA_NAME(sumAngleTermsChunk)(store, angles, begin, num_angles, bp, bound, 2, out);
+  }
+}
+
+static double ISA_NAME(sumComponentOfChunk)(const double* restrict comp,
+                                            const int32_t begin,
+                                            const int32_t end)
+{
+  double acc[LANES] = {0.0};
+  for (int32_t i0 = begin; i0 < end; i0 += LANES) {
+    for (int32_t l = 0; l < LANES; l++) acc[l] += comp[i0 + l];
+  }
+  return reduceLanes(acc);
+}
+
+static double ISA_NAME(sumDistance2OfChunk)(const double* restrict comp,
+                                            const int32_t num_ptcl,
+                                            const int32_t begin,
+                                            const int32_t end,
+                                            const double c0,
+                                            const double leng,
+                                            const double inv_leng)
+{
+  double acc[LANES] = {0.0};
+  for (int32_t i0 = begin; i0 < end; i0 += LANES) {
+    for (int32_t l = 0; l < LANES; l++) {
+      double d = comp[i0 + l] - c0;
+      d -= leng * nearbyint(d * inv_leng);
+      acc[l] += (i0 + l < num_ptcl) ? d * d : 0.0;
+    }
+  }
+  return reduceLanes(acc);
+}
+
+static double complex ISA_NAME(calcHeightDft)(const PosStore* store,
+                                              const double qx,
+                                              const double qy)
+{
+  const int32_t num_padded = store->num_padded;
+  const double* restrict x = store->x;
+  const double* restrict y = store->y;
+  const double* restrict h = (store->dim == 3) ? store->z : store->y;
+  const double qy_eff = (store->dim == 3) ? qy : 0.0;
+
+  double re[LANES] = {0.0}, im[LANES] = {0.0};
+  for (int32_t i0 = 0; i0 < num_padded; i0 += LANES) {
+    for (int32_t l = 0; l < LANES; l++) {
+      const double phase = qx * x[i0 + l] + qy_eff * y[i0 + l];
+      re[l] += h[i0 + l] * cos(phase);
+      im[l] -= h[i0 + l] * sin(phase);
+    }
+  }
+  return reduceLanes(re) + I * reduceLanes(im);
+}
+
+static const BatchKernels ISA_NAME(batch_kernels) = {
+  BATCH_ISA_NAME,
+  ISA_NAME(sumBondEnergyOfChunk),
+  ISA_NAME(sumAngleEnergyOfChunk),
+  ISA_NAME(sumBondTermsOfChunk),
+  ISA_NAME(sumAngleTermsOfChunk),
+  ISA_NAME(sumComponentOfChunk),
+  ISA_NAME(sumDistance2OfChunk),
+  ISA_NAME(calcHeightDft),
+};
+
+#undef ISA_NAME
@@ -0,0 +1,86 @@
+#ifndef BOND_CACHE_H
+#define BOND_CACHE_H
+
+#include <stdint.h>
+
+#include "vector3.h"
+#include "boundary.h"
+#include "potential.h"
+#include "topol.h"
+#include "pos_store.h"
+#include "utils.h"
+
+// NOTE: minimum-image vector dr = pos[i1] - pos[i0], its squared length
+//       and its energy, for each bond of the topology.
+typedef struct {
+  dvec dr;
+  double r2;
+  double energy;
+} CachedBond;
+
+// NOTE: the bonds of dr01 and dr12 of an angle, as seen from one row of
+//       ptclid2topol. slot is the index of the bond among the bonds of the
+//       particle of that row, or -1 if the particle does not belong to it.
+//       sign is -1 if exactly one of the two bonds is stored the other way
+//       round, which flips the sign of dr01 * dr12 only.
+typedef struct {
+  int32_t bond[2];
+  int32_t slot[2];
+  double sign;
+} AngleBondRef;
+
+// NOTE: bond vectors, squared lengths and energies, and angle energies,
+//       of the current positions. A move then reads its energy before the
+//       move from the cache and evaluates each new bond vector once, for
+//       the bond and the angles it belongs to (see evolver.c); the trial
+//       terms are written back only if the move is accepted. The energies
+//       are the same bit for bit as the ones computed from the positions.
+//       refs is parallel to triple_ids of ptclid2topol. The layout is
+//       public so that the kernels can be inlined.
+typedef struct BondCache_t {
+  CachedBond* bonds;
+  double* angle_energy;
+  AngleBondRef* refs;
+  CachedBond* trial_bonds;     // bonds of the moved particle
+  double* trial_angle_energy;  // angles of the moved particle
+  int32_t num_bonds;
+  int32_t num_angles;
+} BondCache;
+
+// NOTE: NULL if an angle has no bond between two of its particles.
+BondCache* newBondCache(const topol* top, const ptclid2topol* id2top,
+                        const PosStore* store, const Boundary* bound, const BondedParam* bp);
+void deleteBondCache(BondCache* self);
+
+// NOTE: the trial terms of particle id become the cached ones.
+static ALWAYS_INLINE void acceptBondCacheMove(BondCache* self,
+                                              const ptclid2topol* id2top,
+                                              const int32_t id)
+{
+  const Id2TopolRow* row = &id2top->rows[id];
+  for (int32_t k = 0; k < row->num_pair; k++) {
+    self->bonds[id2top->pair_ids[row->pair_begin + k]] = self->trial_bonds[k];
+  }
+  for (int32_t k = 0; k < row->num_triple; k++) {
+    self->angle_energy[id2top->triple_ids[row->triple_begin + k]] = self->trial_angle_energy[k];
+  }
+}
+
+// NOTE: bonded energy of particle id from the cache, summed in the order
+//       of its row as the local energy kernels do.
+static ALWAYS_INLINE double sumCachedLocEnergy(const BondCache* self,
+                                               const ptclid2topol* id2top,
+                                               const int32_t id,
+                                               double esum)
+{
+  const Id2TopolRow* row = &id2top->rows[id];
+  for (int32_t k = 0; k < row->num_pair; k++) {
+    esum += self->bonds[id2top->pair_ids[row->pair_begin + k]].energy;
+  }
+  for (int32_t k = 0; k < row->num_triple; k++) {
+    esum += self->angle_energy[id2top->triple_ids[row->triple_begin + k]];
+  }
+  return esum;
+}
+
+#endif
@@ -1,8 +1,12 @@
 #ifndef BOUNDARY_H
 #define BOUNDARY_H
 
+#include <math.h>
+#include <stdint.h>
+
 #include "vector3.h"
 #include "parameter.h"
+#include "utils.h"
 
 struct System_t;
 typedef struct System_t System;
@@ -12,22 +16,131 @@ typedef enum {
   FREE,
 } BOUNDARY_TYPE;
 
-struct Boundary_t;
+// NOTE: defined here so that the minimum image convention can be inlined.
+//       inv_box_leng is zero in a direction of zero box length (z in 2D).
+//       dim is 2 for chains in the xy plane and 3 for meshes; the z
+//       component of a position is never read or written in 2D.
+struct Boundary_t {
+  dvec box_leng;
+  dvec hbox_leng;
+  dvec inv_box_leng;
+  BOUNDARY_TYPE type;
+  int32_t dim;
+};
 typedef struct Boundary_t Boundary;
 
-Boundary* newBoundary(const string* boundary_name);
+Boundary* newBoundary(const string* boundary_name, const int32_t dim);
 void deleteBoundary(Boundary* bound);
 
 void setBoxLength(Boundary* self, const dvec length);
 void applyBoundaryCond(const Boundary* self, dvec* pos);
 void applyBoundaryCondForSystem(const Boundary* self, System* system, const Parameter* param);
-void applyMinimumImageConv(const Boundary* self, dvec* dr);
 
 BOUNDARY_TYPE getBoundaryType(const Boundary* bound);
+int32_t getBoundaryDim(const Boundary* bound);
+dvec getBoundaryBoxLength(const Boundary* bound);
 const char* getBoundaryNameFromType(BOUNDARY_TYPE type);
 BOUNDARY_TYPE getBoundaryTypeFromName(const string* boundary_name);
-double distance2(const dvec* pos0, const dvec* pos1, const Boundary* bound);
-double distance(const dvec* pos0, const dvec* pos1, const Boundary* bound);
-double cos_angle(const dvec* pos0, const dvec* pos1, const dvec* pos2, const Boundary* bound);
 
-#endif
\ No newline at end of file
+// NOTE: the *Of versions take the boundary type and the dimension as
+//       compile-time constants and are used by the specialized kernels.
+//       The periodic minimum image is branch-free.
+static ALWAYS_INLINE void applyMinimumImageOf(const Boundary* self,
+                                              dvec* dr,
+                                              const BOUNDARY_TYPE bc,
+                                              const int32_t dim)
+{
+  if (bc == FREE) return;
+  dr->x -= self->box_leng.x * nearbyint(dr->x * self->inv_box_leng.x);
+  dr->y -= self->box_leng.y * nearbyint(dr->y * self->inv_box_leng.y);
+  if (dim == 3) dr->z -= self->box_leng.z * nearbyint(dr->z * self->inv_box_leng.z);
+}
+
+static ALWAYS_INLINE void applyBoundaryCondOf(const Boundary* self,
+                                              dvec* pos,
+                                              const BOUNDARY_TYPE bc,
+                                              const int32_t dim)
+{
+  if (bc == FREE) return;
+  if (pos->x < 0.0) pos->x += self->box_leng.x;
+  if (pos->x >= self->box_leng.x) pos->x -= self->box_leng.x;
+  if (pos->y < 0.0) pos->y += self->box_leng.y;
+  if (pos->y >= self->box_leng.y) pos->y -= self->box_leng.y;
+  if (dim == 3) {
+    if (pos->z < 0.0) pos->z += self->box_leng.z;
+    if (pos->z >= self->box_leng.z) pos->z -= self->box_leng.z;
+  }
+}
+
+// NOTE: dr = pos1 - pos0 with the minimum image convention.
+static ALWAYS_INLINE dvec calcDispOf(const dvec* pos0,
+                                     const dvec* pos1,
+                                     const Boundary* self,
+                                     const BOUNDARY_TYPE bc,
+                                     const int32_t dim)
+{
+  dvec dr;
+  dr.x = pos1->x - pos0->x;
+  dr.y = pos1->y - pos0->y;
+  dr.z = (dim == 3) ? pos1->z - pos0->z : 0.0;
+  applyMinimumImageOf(self, &dr, bc, dim);
+  return dr;
+}
+
+static ALWAYS_INLINE double distance2Of(const dvec* pos0,
+                                        const dvec* pos1,
+                                        const Boundary* self,
+                                        const BOUNDARY_TYPE bc,
+                                        const int32_t dim)
+{
+  const dvec dr = calcDispOf(pos0, pos1, self, bc, dim);
+  return dvec_dot_of(&dr, &dr, dim);
+}
+
+// NOTE: return (dr01*dr12) / (|dr01|*|dr12|)
+static ALWAYS_INLINE double cosAngleOf(const dvec* pos0,
+                                       const dvec* pos1,
+                                       const dvec* pos2,
+                                       const Boundary* self,
+                                       const BOUNDARY_TYPE bc,
+                                       const int32_t dim)
+{
+  const dvec dr01 = calcDispOf(pos0, pos1, self, bc, dim);
+  const dvec dr12 = calcDispOf(pos1, pos2, self, bc, dim);
+  const double dr01_dr12 = dvec_dot_of(&dr01, &dr12, dim);
+  const double dr01_norm2 = dvec_dot_of(&dr01, &dr01, dim);
+  const double dr12_norm2 = dvec_dot_of(&dr12, &dr12, dim);
+  return dr01_dr12 / sqrt(dr01_norm2 * dr12_norm2);
+}
+
+// NOTE: generic versions for the paths that are not specialized; the
+//       boundary type and the dimension are read at run time.
+static inline void applyMinimumImageConv(const Boundary* self,
+                                         dvec* dr)
+{
+  applyMinimumImageOf(self, dr, self->type, self->dim);
+}
+
+static inline double distance2(const dvec* pos0,
+                               const dvec* pos1,
+                               const Boundary* bound)
+{
+  return distance2Of(pos0, pos1, bound, bound->type, bound->dim);
+}
+
+static inline double distance(const dvec* pos0,
+                              const dvec* pos1,
+                              const Boundary* bound)
+{
+  return sqrt(distance2(pos0, pos1, bound));
+}
+
+static inline double cos_angle(const dvec* pos0,
+                               const dvec* pos1,
+                               const dvec* pos2,
+                               const Boundary* bound)
+{
+  return cosAngleOf(pos0, pos1, pos2, bound, bound->type, bound->dim);
+}
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef CELL_LIST_H
+#define CELL_LIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vector3.h"
+#include "pos_store.h"
+
+struct Boundary_t;
+typedef struct Boundary_t Boundary;
+
+struct CellList_t;
+typedef struct CellList_t CellList;
+
+// NOTE: end of the particle list of a cell.
+#define CELL_NONE (-1)
+
+// NOTE: 3^3 in 3D; only 3^2 of them are used in 2D.
+#define MAX_NEIGHBOR_CELLS 27
+
+// NOTE: linked-cell grid covering the periodic box.
+//       The cell side is not smaller than cutoff, so that all particles
+//       within cutoff of a given particle are found in the 3^d cells
+//       around its own cell. Each cell holds a doubly linked list of
+//       particle ids, so that a single particle can be moved in O(1).
+CellList* newCellList(const Boundary* bound, const double cutoff, const int32_t num_ptcl);
+void deleteCellList(CellList* self);
+
+void buildCellList(CellList* self, const PosStore* store);
+void moveInCellList(CellList* self, const int32_t id, const dvec* new_pos);
+
+int32_t getCellIdOfPos(const CellList* self, const dvec* pos);
+int32_t getNeighborCells(const CellList* self, const int32_t cell, int32_t* neighbors);
+int32_t getCellHead(const CellList* self, const int32_t cell);
+int32_t getNextInCell(const CellList* self, const int32_t id);
+
+// NOTE: true if any particle other than id lies closer than min_dist to trial.
+bool overlapsInCellList(const CellList* self, const PosStore* store, const int32_t id,
+                        const dvec* trial, const double min_dist, const Boundary* bound);
+
+#endif
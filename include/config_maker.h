@@ -9,6 +9,8 @@ typedef struct Parameter_t Parameter;
 
 void createStraightChain(System* system, const Parameter* param);
 void createRandomChain(System* system, const Parameter* param);
+void createMeltChains(System* system, const Parameter* param);
 void createFlatMesh(System* system, const Parameter* param);
+void createTopolConfig(System* system, const Parameter* param);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,60 @@
+#ifndef DOMAIN_H
+#define DOMAIN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+struct System_t;
+typedef struct System_t System;
+
+struct Parameter_t;
+typedef struct Parameter_t Parameter;
+
+struct Boundary_t;
+typedef struct Boundary_t Boundary;
+
+struct MTstate_t;
+typedef struct MTstate_t MTstate;
+
+struct MacroSums_t;
+typedef struct MacroSums_t MacroSums;
+
+// NOTE: always true without USE_MPI.
+bool isRootRank(void);
+
+#ifdef USE_MPI
+struct Domain_t;
+typedef struct Domain_t Domain;
+
+struct Observer_t;
+typedef struct Observer_t Observer;
+
+// NOTE: the periodic box is split into slabs along x, one per rank.
+//       Each slab is further split into two halves which are updated
+//       alternately (checkerboard), so that particles moved concurrently
+//       by different ranks never interact. Slab boundaries are shifted
+//       by a random amount every sweep to keep the dynamics ergodic.
+//       Each rank stores the positions of the particles of its slab and
+//       of the ghosts within ghost_width of it, and the bonds and angles
+//       of the particles of its slab. Since a slab must be at least
+//       2 ghost_width wide, at most box_length.x / (2 ghost_width) ranks
+//       can be used (ghost_width is 4 bond_len unless specified).
+//       newDomain scatters the initial configuration and the topology of
+//       the System on the root rank; the System is not used for the
+//       positions after that, and the outputs of single particles are
+//       streamed to the root rank in blocks.
+Domain* newDomain(const System* system, const Boundary* bound, const Parameter* param);
+void deleteDomain(Domain* self);
+
+int32_t getRankOfDomain(const Domain* self);
+int32_t getNumRanksOfDomain(const Domain* self);
+void shiftDomain(Domain* self, MTstate* mtst_shared);
+double evolveMcDomain(Domain* self, const System* system, const Boundary* bound, MTstate* mtst);
+void reduceMacroSumsOfDomain(Domain* self, const System* system, const Boundary* bound, MacroSums* sums);
+// NOTE: the trajectory frame and the bond lengths; observer is NULL except
+//       on the root rank.
+void observeMicroVarsOfDomain(Domain* self, Observer* observer, const int32_t mc_steps, const Boundary* bound);
+void writeFinalConfigOfDomain(Domain* self, const Parameter* param);
+#endif
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <stdint.h>
+
+struct System_t;
+typedef struct System_t System;
+
+struct Parameter_t;
+typedef struct Parameter_t Parameter;
+
+struct Boundary_t;
+typedef struct Boundary_t Boundary;
+
+struct MTstate_t;
+typedef struct MTstate_t MTstate;
+
+struct Ensemble_t;
+typedef struct Ensemble_t Ensemble;
+
+// NOTE: num_replicas copies of the system sharing one topology.
+//       Replicas are grouped into blocks of NUM_RAND_LANES and stored
+//       lane-interleaved, i.e. pos[block][ptcl][xyz][lane].
+Ensemble* newEnsemble(const System* system, const Boundary* bound, const Parameter* param);
+void deleteEnsemble(Ensemble* self);
+
+int32_t getNumReplicasOfEnsemble(const Ensemble* self);
+double evolveEnsembleMc(Ensemble* self, const System* system, MTstate* mtst);
+void observeEnsemble(Ensemble* self, const int32_t mc_steps, const System* system);
+
+void copyReplicaToSystem(const Ensemble* self, const int32_t replica, System* system);
+void writeEnsembleFinalConfig(const Ensemble* self, const Parameter* param);
+
+#endif
@@ -17,8 +17,24 @@ typedef struct Boundary_t Boundary;
 struct MTstate_t;
 typedef struct MTstate_t MTstate;
 
+struct ptclid2topol_t;
+typedef struct ptclid2topol_t ptclid2topol;
+
+struct BondedParam_t;
+typedef struct BondedParam_t BondedParam;
+
+struct PosStore_t;
+typedef struct PosStore_t PosStore;
+
+// NOTE: upper limit of prefetch_distance (see sweepPipelined in evolver.c).
+#define MAX_PREFETCH_DIST 64
+
 double evolveMc(System *system, const Parameter *param, const Boundary *bound, MTstate *mtst);
+bool mcStepInSlab(PosStore *store, MTstate *mtst, const ptclid2topol *id2top, const Boundary *bound,
+                  const double disp, const BondedParam *bp,
+                  const int32_t id_picked, const double slab_lo, const double slab_width, const double box_x);
 double boundaryDistance(const dvec pos1, const dvec pos2, const Boundary *bound);
 bool particuleBoundary(dvec point, const Boundary *bound);
-bool checkParticleOverlap(const dvec *os, int32_t num_ptcl, const Boundary *bound);
+bool legalParticule(const PosStore *store, int32_t num_ptcl, const Boundary *bound, const double min_dist);
+bool checkParticleOverlap(const PosStore *store, int32_t num_ptcl, const Boundary *bound, const double min_dist);
 #endif
\ No newline at end of file
@@ -0,0 +1,17 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <complex.h>
+
+// NOTE: in-place radix-2 complex FFT without normalization.
+//       sign = -1 gives the forward transform sum_n f(n) exp(-2 pi i k n / N),
+//       sign = +1 the backward one. All lengths must be powers of two.
+bool isPowerOfTwo(const int32_t n);
+void fft1d(double complex* data, const int32_t n, const int32_t sign);
+
+// NOTE: data[(i0 * n1 + i1) * n2 + i2]
+void fft3d(double complex* data, const int32_t n0, const int32_t n1, const int32_t n2, const int32_t sign);
+
+#endif
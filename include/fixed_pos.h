@@ -0,0 +1,116 @@
+#ifndef FIXED_POS_H
+#define FIXED_POS_H
+
+#include <stdint.h>
+#include <math.h>
+
+#include "vector3.h"
+#include "boundary.h"
+#include "pos_store.h"
+#include "utils.h"
+
+typedef struct {
+  uint32_t x, y, z;
+} uvec;
+
+// NOTE: fixed-point positions of the periodic box (position_precision
+//       fixed). Each axis holds the position as a fraction of the box
+//       length in units of 2^-32, so that wrapping into the box is the
+//       overflow of uint32 and the minimum image of a difference is its
+//       cast to int32. A move adds an integer displacement and is exactly
+//       reversible. They are the stored positions of the run: the float64
+//       PosStore is converted from them only for an observation or the
+//       output (storeFixedPos) and released after it, so that the positions
+//       take dim * 4 bytes per particle instead of dim * 8. The round trip
+//       through float64 is exact, so restarts reproduce them.
+//       pos holds dim uint32 per particle, i.e. packed (x, y) in 2D. The
+//       layout is public so that the kernels can be inlined.
+typedef struct FixedPosStore_t {
+  uint32_t* pos;
+  dvec scale;     // box length / 2^32
+  dvec inv_scale; // 2^32 / box length
+  int32_t num_ptcl;
+  int32_t dim;
+} FixedPosStore;
+
+FixedPosStore* newFixedPosStore(const PosStore* store, const int32_t num_ptcl, const Boundary* bound);
+void deleteFixedPosStore(FixedPosStore* self);
+
+void storeFixedPos(const FixedPosStore* self, PosStore* store);
+
+// NOTE: z is 0 in 2D.
+static ALWAYS_INLINE uvec getPosOfFixed(const FixedPosStore* self,
+                                        const int32_t id,
+                                        const int32_t dim)
+{
+  const uint32_t* r = &self->pos[dim * id];
+  const uvec v = {.x = r[0], .y = r[1], .z = (dim == 3) ? r[2] : 0};
+  return v;
+}
+
+static ALWAYS_INLINE void setPosOfFixed(FixedPosStore* self,
+                                        const int32_t id,
+                                        const uvec* v,
+                                        const int32_t dim)
+{
+  uint32_t* r = &self->pos[dim * id];
+  r[0] = v->x;
+  r[1] = v->y;
+  if (dim == 3) r[2] = v->z;
+}
+
+// NOTE: the conversion to int64 and then to uint32 is modular, so that any
+//       x is mapped into the box.
+static ALWAYS_INLINE uint32_t toFixedCoord(const double x,
+                                           const double inv_scale)
+{
+  return (uint32_t)llrint(x * inv_scale);
+}
+
+// NOTE: displacement in units of 2^-32 box lengths, truncated toward zero
+//       by the cast. The truncation is odd in dx, so a trial move and its
+//       reverse are still drawn with the same probability.
+static ALWAYS_INLINE int32_t toFixedDisp(const double dx,
+                                         const double inv_scale)
+{
+  return (int32_t)(dx * inv_scale);
+}
+
+// NOTE: the int32 cast of the uint32 difference is the minimum image
+//       (modular conversion, as on every supported compiler).
+static ALWAYS_INLINE dvec calcDispFixed(const uvec* pos0,
+                                        const uvec* pos1,
+                                        const FixedPosStore* self,
+                                        const int32_t dim)
+{
+  dvec dr;
+  dr.x = (double)(int32_t)(pos1->x - pos0->x) * self->scale.x;
+  dr.y = (double)(int32_t)(pos1->y - pos0->y) * self->scale.y;
+  dr.z = (dim == 3) ? (double)(int32_t)(pos1->z - pos0->z) * self->scale.z : 0.0;
+  return dr;
+}
+
+static ALWAYS_INLINE double distance2Fixed(const uvec* pos0,
+                                           const uvec* pos1,
+                                           const FixedPosStore* self,
+                                           const int32_t dim)
+{
+  const dvec dr = calcDispFixed(pos0, pos1, self, dim);
+  return dvec_dot_of(&dr, &dr, dim);
+}
+
+static ALWAYS_INLINE double cosAngleFixed(const uvec* pos0,
+                                          const uvec* pos1,
+                                          const uvec* pos2,
+                                          const FixedPosStore* self,
+                                          const int32_t dim)
+{
+  const dvec dr01 = calcDispFixed(pos0, pos1, self, dim);
+  const dvec dr12 = calcDispFixed(pos1, pos2, self, dim);
+  const double dr01_dr12 = dvec_dot_of(&dr01, &dr12, dim);
+  const double dr01_norm2 = dvec_dot_of(&dr01, &dr01, dim);
+  const double dr12_norm2 = dvec_dot_of(&dr12, &dr12, dim);
+  return dr01_dr12 / sqrt(dr01_norm2 * dr12_norm2);
+}
+
+#endif
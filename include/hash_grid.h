@@ -0,0 +1,33 @@
+#ifndef HASH_GRID_H
+#define HASH_GRID_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vector3.h"
+#include "cell_list.h"
+
+struct HashGrid_t;
+typedef struct HashGrid_t HashGrid;
+
+// NOTE: spatial index for the free boundary.
+//       Space is divided into cubic cells of side cell_leng, and only the
+//       occupied cells are stored in an open-addressing hash table keyed
+//       by the integer cell coordinates. Memory grows with the number of
+//       occupied cells, not with the volume swept by the chain.
+//       Particle lists of the cells are terminated by CELL_NONE.
+HashGrid* newHashGrid(const double cell_leng, const int32_t num_ptcl, const int32_t dim);
+void deleteHashGrid(HashGrid* self);
+
+void buildHashGrid(HashGrid* self, const PosStore* store);
+void moveInHashGrid(HashGrid* self, const int32_t id, const dvec* new_pos);
+
+int32_t getNeighborHeadsInHashGrid(const HashGrid* self, const dvec* pos, int32_t* heads);
+int32_t getNextInHashGrid(const HashGrid* self, const int32_t id);
+int32_t getNumOccupiedCells(const HashGrid* self);
+
+// NOTE: true if any particle other than id lies closer than min_dist to trial.
+bool overlapsInHashGrid(const HashGrid* self, const PosStore* store, const int32_t id,
+                        const dvec* trial, const double min_dist);
+
+#endif
@@ -26,8 +26,7 @@ static inline dtensor3 calcBondVirial(const dvec* pos0,
   dvec dr01 = sub_dvec_new(pos1, pos0);
   applyMinimumImageConv(bound, &dr01);
   const double dr01_norm = norm(&dr01);
-  div_scalar(&dr01, dr01_norm); // normalize
-  const dvec dF01 = mul_scalar_new(&dr01, -k * (dr01_norm - l0));
+  const dvec dF01 = mul_scalar_new(&dr01, -k * (dr01_norm - l0) / dr01_norm);
   return dtensor3_dot(&dF01, &dr01);
 }
 
@@ -40,42 +39,114 @@ static inline double calcAngleEnergy(const dvec* pos0,
   return k * (1.0 - cos_angle(pos0, pos1, pos2, bound));
 }
 
-static inline dtensor3 calcAngleVirial(const dvec* pos0,
-                                       const dvec* pos1,
-                                       const dvec* pos2,
-                                       const double k,
-                                       const Boundary* bound)
+// NOTE: dr10 = r0 - r1 and dr12 = r2 - r1 (minimum image), returns
+//       cos psi with psi the angle between them (psi = pi for a straight
+//       chain).
+static ALWAYS_INLINE double calcAngleGeometry(const dvec* pos0,
+                                              const dvec* pos1,
+                                              const dvec* pos2,
+                                              const Boundary* bound,
+                                              const BOUNDARY_TYPE bc,
+                                              const int32_t dim,
+                                              dvec* dr10,
+                                              dvec* dr12)
 {
-  dvec dr10 = sub_dvec_new(pos0, pos1); // 1 -> 0
-  dvec dr12 = sub_dvec_new(pos2, pos1); // 1 -> 2
-  applyMinimumImageConv(bound, &dr10);
-  applyMinimumImageConv(bound, &dr12);
+  *dr10 = calcDispOf(pos1, pos0, bound, bc, dim); // 1 -> 0
+  *dr12 = calcDispOf(pos1, pos2, bound, bc, dim); // 1 -> 2
 
-  const double dr10_norm2 = norm2(&dr10);
-  const double dr12_norm2 = norm2(&dr12);
-
-  const double dr10_norm = sqrt(dr10_norm2);
-  const double dr12_norm = sqrt(dr12_norm2);
-
-  double cs = dvec_dot(&dr10, &dr12) / (dr10_norm * dr12_norm);
+  double cs = dvec_dot_of(dr10, dr12, dim) / sqrt(dvec_dot_of(dr10, dr10, dim) * dvec_dot_of(dr12, dr12, dim));
   if (cs > 1.0) cs = 1.0;
   if (cs < -1.0) cs = -1.0;
+  return cs;
+}
+
+// NOTE: virial of an angle term with k = dE/d(cos psi).
+static inline dtensor3 calcAngleVirialOfSlope(const dvec* dr10,
+                                              const dvec* dr12,
+                                              const double cs,
+                                              const double k)
+{
+  const double dr10_norm2 = norm2(dr10);
+  const double dr12_norm2 = norm2(dr12);
 
   const double a11 = k * cs / dr10_norm2;
-  const double a12 = -k / (dr10_norm * dr12_norm);
+  const double a12 = -k / sqrt(dr10_norm2 * dr12_norm2);
   const double a22 = k * cs / dr12_norm2;
 
-  const dvec dF0_0 = mul_scalar_new(&dr10, a11);
-  const dvec dF0_1 = mul_scalar_new(&dr12, a12);
+  const dvec dF0_0 = mul_scalar_new(dr10, a11);
+  const dvec dF0_1 = mul_scalar_new(dr12, a12);
   const dvec dF0 = add_dvec_new(&dF0_0, &dF0_1);
-  const dtensor3 dF0_dr10 = dtensor3_dot(&dF0, &dr10);
+  const dtensor3 dF0_dr10 = dtensor3_dot(&dF0, dr10);
 
-  const dvec dF1_0 = mul_scalar_new(&dr12, a22);
-  const dvec dF1_1 = mul_scalar_new(&dr10, a12);
+  const dvec dF1_0 = mul_scalar_new(dr12, a22);
+  const dvec dF1_1 = mul_scalar_new(dr10, a12);
   const dvec dF1 = add_dvec_new(&dF1_0, &dF1_1);
-  const dtensor3 dF1_dr12 = dtensor3_dot(&dF1, &dr12);
+  const dtensor3 dF1_dr12 = dtensor3_dot(&dF1, dr12);
 
   return dtensor3_add_new(&dF0_dr10, &dF1_dr12);
 }
 
+static inline dtensor3 calcAngleVirial(const dvec* pos0,
+                                       const dvec* pos1,
+                                       const dvec* pos2,
+                                       const double k,
+                                       const Boundary* bound)
+{
+  dvec dr10, dr12;
+  const double cs = calcAngleGeometry(pos0, pos1, pos2, bound, bound->type, bound->dim, &dr10, &dr12);
+  return calcAngleVirialOfSlope(&dr10, &dr12, cs, k);
+}
+
+// NOTE: truncated and shifted Lennard-Jones potential.
+//       rc = 2^(1/6) sigma gives the purely repulsive WCA potential.
+typedef struct LJParam_t {
+  double eps;
+  double sigma2;
+  double rc2;
+  double e_shift;
+} LJParam;
+
+static inline LJParam makeLJParam(const double eps,
+                                  const double sigma,
+                                  const double rc)
+{
+  LJParam lj;
+  lj.eps = eps;
+  lj.sigma2 = sigma * sigma;
+  lj.rc2 = rc * rc;
+  const double sr6 = lj.sigma2 * lj.sigma2 * lj.sigma2 / (lj.rc2 * lj.rc2 * lj.rc2);
+  lj.e_shift = 4.0 * eps * (sr6 * sr6 - sr6);
+  return lj;
+}
+
+static inline double calcLJEnergy(const dvec* pos0,
+                                  const dvec* pos1,
+                                  const LJParam* lj,
+                                  const Boundary* bound)
+{
+  const double r2 = distance2(pos0, pos1, bound);
+  if (r2 >= lj->rc2) return 0.0;
+  const double s2r2 = lj->sigma2 / r2;
+  const double sr6 = s2r2 * s2r2 * s2r2;
+  return 4.0 * lj->eps * (sr6 * sr6 - sr6) - lj->e_shift;
+}
+
+static inline dtensor3 calcLJVirial(const dvec* pos0,
+                                    const dvec* pos1,
+                                    const LJParam* lj,
+                                    const Boundary* bound)
+{
+  dvec dr01 = sub_dvec_new(pos1, pos0);
+  applyMinimumImageConv(bound, &dr01);
+  const double r2 = norm2(&dr01);
+  if (r2 >= lj->rc2) {
+    const dtensor3 zero = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+    return zero;
+  }
+  const double s2r2 = lj->sigma2 / r2;
+  const double sr6 = s2r2 * s2r2 * s2r2;
+  const dvec dF01 = mul_scalar_new(&dr01, 24.0 * lj->eps * (2.0 * sr6 * sr6 - sr6) / r2);
+  return dtensor3_dot(&dF01, &dr01);
+}
+
 #endif
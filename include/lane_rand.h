@@ -0,0 +1,21 @@
+#ifndef LANE_RAND_H
+#define LANE_RAND_H
+
+#include <stdint.h>
+
+// NOTE: number of independent streams advanced together.
+#define NUM_RAND_LANES 8
+
+// xorshift128+ generators, one per lane, stored lane-interleaved
+// so that a whole vector of random numbers is produced per call.
+typedef struct LaneRand_t {
+  uint64_t s0[NUM_RAND_LANES];
+  uint64_t s1[NUM_RAND_LANES];
+} LaneRand;
+
+void initLaneRand(LaneRand* self, const uint64_t seed, const uint64_t stream_id);
+
+/* fills out[0..NUM_RAND_LANES-1] with random numbers on [0,1) with 53-bit resolution */
+void fillLaneRandReal(LaneRand* self, double* out);
+
+#endif
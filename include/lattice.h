@@ -0,0 +1,30 @@
+#ifndef LATTICE_H
+#define LATTICE_H
+
+#include <stdint.h>
+
+struct System_t;
+typedef struct System_t System;
+
+struct Parameter_t;
+typedef struct Parameter_t Parameter;
+
+struct Boundary_t;
+typedef struct Boundary_t Boundary;
+
+struct MTstate_t;
+typedef struct MTstate_t MTstate;
+
+struct Lattice_t;
+typedef struct Lattice_t Lattice;
+
+// NOTE: bond fluctuation model.
+//       Each monomer occupies 2^d lattice sites whose lower corner is stored
+//       as int16 coordinates. The current configuration stored in System is
+//       used as the initial lattice configuration (rounded to lattice sites).
+Lattice* newLattice(System* system, const Boundary* bound, const Parameter* param);
+void deleteLattice(Lattice* self);
+
+double evolveBfm(Lattice* self, System* system, MTstate* mtst);
+
+#endif
@@ -0,0 +1,81 @@
+#ifndef MELT_H
+#define MELT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "vector3.h"
+#include "pos_store.h"
+
+struct Parameter_t;
+typedef struct Parameter_t Parameter;
+
+struct Boundary_t;
+typedef struct Boundary_t Boundary;
+
+struct topol_t;
+typedef struct topol_t topol;
+
+struct ptclid2topol_t;
+typedef struct ptclid2topol_t ptclid2topol;
+
+struct Melt_t;
+typedef struct Melt_t Melt;
+
+// NOTE: num_chains linear chains of equal length.
+//       The chain sequence is stored as seq[chain * chain_len + k],
+//       the id of the k-th particle along the chain.
+Melt* newMelt(const Parameter* param);
+void deleteMelt(Melt* self);
+
+int32_t getNumChainsOfMelt(const Melt* self);
+int32_t getChainLenOfMelt(const Melt* self);
+const int32_t* getChainSeq(const Melt* self, const int32_t chain);
+int32_t getChainIdOfPtcl(const Melt* self, const int32_t id);
+int32_t getChainIndexOfPtcl(const Melt* self, const int32_t id);
+
+// NOTE: double-bridging move between bond (A[a], A[a+1]) and
+//       bond (B[b], B[b+1]) with b = chain_len - 2 - a.
+//       New chains are A[0..a] + B[b..0] and A[N-1..a+1] + B[b+1..N-1].
+void rewireMelt(Melt* self, topol* top, ptclid2topol* id2top,
+                const int32_t chain_a, const int32_t chain_b, const int32_t a);
+
+// NOTE: particle i becomes new_of_old[i] in every chain sequence.
+void permuteMelt(Melt* self, const int32_t* new_of_old);
+
+// NOTE: the double-bridge move of bonds (A[a], A[a+1]) and
+//       (B[b], B[b+1]) with A = chain_a and B = chain_b (see rewireMelt).
+typedef struct BridgeMove_t {
+  int32_t chain_a;
+  int32_t chain_b;
+  int32_t a;
+} BridgeMove;
+
+// NOTE: the particles are indexed in a cell list of cell side cutoff
+//       (melts are periodic), which is kept up to date by moveInBridgeGrid
+//       for each accepted displacement and rebuilt by buildBridgeGrid.
+void setupBridgeGrid(Melt* self, const PosStore* store, const Boundary* bound, const double cutoff);
+void buildBridgeGrid(Melt* self, const PosStore* store);
+void moveInBridgeGrid(Melt* self, const int32_t id, const dvec* new_pos);
+bool isWithinBridgeCutoff(const Melt* self, const PosStore* store, const Boundary* bound,
+                          const int32_t i, const int32_t j);
+
+// NOTE: the partner chains of particle id, at index a of its chain A: the
+//       chains B other than A whose particle B[chain_len - 2 - a] lies
+//       within cutoff of id. With move, the chains are those after the
+//       move, which is not applied. The particle at the end of a chain has
+//       no partner.
+int32_t countBridgePartners(const Melt* self, const PosStore* store, const Boundary* bound,
+                            const int32_t id, const BridgeMove* move);
+// NOTE: the k-th partner chain of countBridgePartners without move.
+int32_t getBridgePartner(const Melt* self, const PosStore* store, const Boundary* bound,
+                         const int32_t id, const int32_t k);
+
+void recordDoubleBridge(Melt* self, const bool is_accepted);
+double getDoubleBridgeAcceptRatio(const Melt* self);
+
+// NOTE: chain positions unfolded along the bonds by the minimum image convention.
+void unwrapChain(const Melt* self, const int32_t chain, const PosStore* store,
+                 const Boundary* bound, dvec* unwrapped);
+
+#endif
@@ -2,11 +2,13 @@
 #define OBSERBER_H
 
 #include <stdint.h>
+#include <complex.h>
 
 #include "string_c.h"
 #include "system.h"
 #include "parameter.h"
 #include "boundary.h"
+#include "batch_kernels.h"
 
 struct Observer_t;
 typedef struct Observer_t Observer;
@@ -17,4 +19,28 @@ void deleteObserver(Observer* self);
 void observeMicroVars(Observer* self, const int32_t mc_steps, const System* system, const Boundary* bound, const Parameter* param);
 void observeMacroVars(Observer* self, const int32_t mc_steps, const System* system, const Boundary* bound, const Parameter* param);
 
+// NOTE: the macro observables of a configuration split over the ranks of
+//       a domain decomposition, summed over the ranks (see domain.c).
+//       height_dft holds the Fourier component of the heights for each
+//       q vector of setSpectrumQvectors.
+typedef struct MacroSums_t {
+  BondedSums bonded;
+  double rg;
+  double end2end;
+  double complex* height_dft;
+} MacroSums;
+void observeMacroSums(Observer* self, const int32_t mc_steps, const System* system, const MacroSums* sums,
+                      const Boundary* bound, const Parameter* param);
+
+// NOTE: a trajectory frame and the bond lengths written one by one, in
+//       the order of the particles and of the bonds, by the root rank of a
+//       domain decomposition as they are streamed to it (see domain.c).
+void writeMicroFrameHeader(Observer* self, const int32_t mc_steps, const int32_t num_ptcl);
+void writeTrajectPtcl(Observer* self, const dvec* r, const int32_t dim);
+void writeBondLen(Observer* self, const double bond_len);
+
+// NOTE: the q vectors of fluct_spectrum.dat, one per line.
+int32_t getNumSpectrumQvectors(const Parameter* param);
+void setSpectrumQvectors(const Parameter* param, double* qx, double* qy);
+
 #endif
\ No newline at end of file
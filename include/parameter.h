@@ -13,6 +13,7 @@ typedef struct Parameter_t Parameter;
 Parameter* newParameter(const char* path);
 void deleteParameter(Parameter* self);
 
+int32_t getDimension(const Parameter* self);
 int32_t getNumPtcl(const Parameter* self);
 double getBondLen(const Parameter* self);
 double getInitBondLen(const Parameter* self);
@@ -20,11 +21,45 @@ double getStepLen(const Parameter* self);
 int32_t getTotalSteps(const Parameter* self);
 int32_t getObserveIntervalMac(const Parameter* self);
 int32_t getObserveIntervalMic(const Parameter* self);
+int32_t getNumReplicas(const Parameter* self);
+int32_t getNumChains(const Parameter* self);
+int32_t getPrefetchDistance(const Parameter* self);
+int32_t getReorderInterval(const Parameter* self);
+int32_t getObserverThreads(const Parameter* self);
+int32_t getHugePages(const Parameter* self);
+int32_t getSweepTile(const Parameter* self);
+int32_t getBondCacheSwitch(const Parameter* self);
+double getDoubleBridgeProb(const Parameter* self);
+double getDoubleBridgeCutoff(const Parameter* self);
+double getExcludedDiameter(const Parameter* self);
+double getLJEpsilon(const Parameter* self);
+double getLJSigma(const Parameter* self);
+double getLJCutoff(const Parameter* self);
+double getVerletSkin(const Parameter* self);
+double getFeneR0(const Parameter* self);
+double getAngleTheta0(const Parameter* self);
+double getBjerrumLen(const Parameter* self);
+double getEwaldAlpha(const Parameter* self);
+double getEwaldRcut(const Parameter* self);
+int32_t getPppmMesh(const Parameter* self);
+double getGhostWidth(const Parameter* self);
+double getDriftTolerance(const Parameter* self);
 uint32_t getRandSeed(const Parameter* self);
 double getCfBond(const Parameter* self);
 double getCfAngle(const Parameter* self);
 const string* getRootDir(const Parameter* self);
 const string* getBoundaryName(const Parameter* self);
+const string* getModelName(const Parameter* self);
+const string* getBondType(const Parameter* self);
+const string* getAngleType(const Parameter* self);
+const string* getBondTable(const Parameter* self);
+const string* getAngleTable(const Parameter* self);
+const string* getChargeFile(const Parameter* self);
+const string* getPositionPrecision(const Parameter* self);
+const string* getTopologyFile(const Parameter* self);
+const string* getTopologyMode(const Parameter* self);
+const string* getReorderCurve(const Parameter* self);
+const string* getSweepOrder(const Parameter* self);
 dvec getBoxlength(const Parameter* self);
 int32_t getSideDimx(const Parameter* self);
 int32_t getSideDimy(const Parameter* self);
@@ -0,0 +1,72 @@
+#ifndef POS_STORE_H
+#define POS_STORE_H
+
+#include <stdint.h>
+
+#include "vector3.h"
+#include "utils.h"
+
+// NOTE: number of particles (or bonds) processed together by the
+//       full-system kernels (see batch_kernels.h).
+#define POS_STORE_BLOCK 8
+
+// NOTE: the positions of a System, as a structure of arrays. The sweeps
+//       read and write single particles through getPosOfStore and
+//       setPosOfStore, and the passes over the whole system (observers)
+//       stream the component arrays. Each component array is 64-byte
+//       aligned and padded with zeros to a multiple of POS_STORE_BLOCK. z is
+//       NULL in 2D. The layout is public so that the accessors can be
+//       inlined.
+typedef struct PosStore_t {
+  double* x;
+  double* y;
+  double* z;
+  int32_t num_ptcl;
+  int32_t num_padded;
+  int32_t dim;
+} PosStore;
+
+struct Arena_t;
+typedef struct Arena_t Arena;
+
+// NOTE: the store lives in the arena of the System and is released with it.
+PosStore* newPosStore(const int32_t num_ptcl, const int32_t dim, Arena* arena);
+
+// NOTE: z is 0 in 2D. The specialized sweeps pass dim as a compile-time
+//       constant, so that the 2D ones never touch z.
+static ALWAYS_INLINE dvec getPosOfStoreDim(const PosStore* self,
+                                           const int32_t id,
+                                           const int32_t dim)
+{
+  const dvec r = {
+    .x = self->x[id],
+    .y = self->y[id],
+    .z = (dim == 3) ? self->z[id] : 0.0,
+  };
+  return r;
+}
+
+static ALWAYS_INLINE void setPosOfStoreDim(PosStore* self,
+                                           const int32_t id,
+                                           const dvec* r,
+                                           const int32_t dim)
+{
+  self->x[id] = r->x;
+  self->y[id] = r->y;
+  if (dim == 3) self->z[id] = r->z;
+}
+
+static ALWAYS_INLINE dvec getPosOfStore(const PosStore* self,
+                                        const int32_t id)
+{
+  return getPosOfStoreDim(self, id, self->dim);
+}
+
+static ALWAYS_INLINE void setPosOfStore(PosStore* self,
+                                        const int32_t id,
+                                        const dvec* r)
+{
+  setPosOfStoreDim(self, id, r, self->dim);
+}
+
+#endif
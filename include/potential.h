@@ -0,0 +1,308 @@
+#ifndef POTENTIAL_H
+#define POTENTIAL_H
+
+#include <math.h>
+
+#include "vector3.h"
+#include "tensor3.h"
+#include "boundary.h"
+#include "string_c.h"
+#include "interactions.h"
+#include "spline_table.h"
+
+// NOTE: registry of the bonded potentials selected by bond_type and
+//       angle_type in input.dat. theta is the bending angle of cos_angle
+//       (theta = 0 for a straight chain).
+//         harmonic       : k/2 (r - l0)^2
+//         fene           : -k/2 R0^2 log(1 - r^2 / R0^2)
+//         tabulated bond : U(r^2) from bond_table
+//         kratky_porod   : k (1 - cos theta)
+//         cosine_squared : k/2 (cos theta - cos theta0)^2
+//         tabulated angle: U(cos theta) from angle_table
+//       Adding a type means adding its kernels below, its name, and its
+//       instantiations and entries of sweep_kernels in evolver.c.
+typedef enum {
+  BOND_HARMONIC = 0,
+  BOND_FENE,
+  BOND_TABULATED,
+  NUM_BOND_TYPES,
+} BOND_TYPE;
+
+typedef enum {
+  ANGLE_KRATKY_POROD = 0,
+  ANGLE_COSINE_SQUARED,
+  ANGLE_TABULATED,
+  NUM_ANGLE_TYPES,
+} ANGLE_TYPE;
+
+const char* getBondNameFromType(BOND_TYPE type);
+BOND_TYPE getBondTypeFromName(const string* bond_name);
+const char* getAngleNameFromType(ANGLE_TYPE type);
+ANGLE_TYPE getAngleTypeFromName(const string* angle_name);
+
+typedef struct BondedParam_t {
+  BOND_TYPE bond_type;
+  ANGLE_TYPE angle_type;
+  double cf_bond;
+  double l0;
+  double fene_r02;
+  double cf_angle;
+  double cos_theta0;
+  const SplineTable* bond_table;
+  const SplineTable* angle_table;
+} BondedParam;
+
+// NOTE: energies as functions of the squared bond length and of cos
+//       theta, shared by the kernels on every position representation.
+static ALWAYS_INLINE double calcBondEnergyOfR2_harmonic(const double r2,
+                                                        const BondedParam* bp)
+{
+  const double dr = sqrt(r2) - bp->l0;
+  return 0.5 * bp->cf_bond * dr * dr;
+}
+
+// NOTE: infinite beyond R0, so that such a move is always rejected.
+static ALWAYS_INLINE double calcBondEnergyOfR2_fene(const double r2,
+                                                    const BondedParam* bp)
+{
+  const double x = r2 / bp->fene_r02;
+  return (x < 1.0) ? -0.5 * bp->cf_bond * bp->fene_r02 * log(1.0 - x) : INFINITY;
+}
+
+static ALWAYS_INLINE double calcBondEnergyOfR2_tabulated(const double r2,
+                                                         const BondedParam* bp)
+{
+  return evalSplineTable(bp->bond_table, r2);
+}
+
+static ALWAYS_INLINE double calcAngleEnergyOfCos_kratky_porod(const double cs,
+                                                              const BondedParam* bp)
+{
+  return bp->cf_angle * (1.0 - cs);
+}
+
+static ALWAYS_INLINE double calcAngleEnergyOfCos_cosine_squared(const double cs,
+                                                                const BondedParam* bp)
+{
+  const double dc = cs - bp->cos_theta0;
+  return 0.5 * bp->cf_angle * dc * dc;
+}
+
+static ALWAYS_INLINE double calcAngleEnergyOfCos_tabulated(const double cs,
+                                                           const BondedParam* bp)
+{
+  return evalSplineTable(bp->angle_table, cs);
+}
+
+// NOTE: the kernels take the boundary type and the dimension as
+//       compile-time constants (see applyMinimumImageOf in boundary.h).
+
+// bond kernels
+static ALWAYS_INLINE double calcBondEnergy_harmonic(const dvec* pos0,
+                                                    const dvec* pos1,
+                                                    const BondedParam* bp,
+                                                    const Boundary* bound,
+                                                    const BOUNDARY_TYPE bc,
+                                                    const int32_t dim)
+{
+  return calcBondEnergyOfR2_harmonic(distance2Of(pos0, pos1, bound, bc, dim), bp);
+}
+
+static ALWAYS_INLINE dtensor3 calcBondVirial_harmonic(const dvec* pos0,
+                                                      const dvec* pos1,
+                                                      const BondedParam* bp,
+                                                      const Boundary* bound,
+                                                      const BOUNDARY_TYPE bc,
+                                                      const int32_t dim)
+{
+  const dvec dr01 = calcDispOf(pos0, pos1, bound, bc, dim);
+  const double dr01_norm = sqrt(dvec_dot_of(&dr01, &dr01, dim));
+  const dvec dF01 = mul_scalar_new(&dr01, -bp->cf_bond * (dr01_norm - bp->l0) / dr01_norm);
+  return dtensor3_dot(&dF01, &dr01);
+}
+
+static ALWAYS_INLINE double calcBondEnergy_fene(const dvec* pos0,
+                                                const dvec* pos1,
+                                                const BondedParam* bp,
+                                                const Boundary* bound,
+                                                const BOUNDARY_TYPE bc,
+                                                const int32_t dim)
+{
+  return calcBondEnergyOfR2_fene(distance2Of(pos0, pos1, bound, bc, dim), bp);
+}
+
+static ALWAYS_INLINE dtensor3 calcBondVirial_fene(const dvec* pos0,
+                                                  const dvec* pos1,
+                                                  const BondedParam* bp,
+                                                  const Boundary* bound,
+                                                  const BOUNDARY_TYPE bc,
+                                                  const int32_t dim)
+{
+  const dvec dr01 = calcDispOf(pos0, pos1, bound, bc, dim);
+  const double x = dvec_dot_of(&dr01, &dr01, dim) / bp->fene_r02;
+  const dvec dF01 = mul_scalar_new(&dr01, -bp->cf_bond / (1.0 - x));
+  return dtensor3_dot(&dF01, &dr01);
+}
+
+static ALWAYS_INLINE double calcBondEnergy_tabulated(const dvec* pos0,
+                                                     const dvec* pos1,
+                                                     const BondedParam* bp,
+                                                     const Boundary* bound,
+                                                     const BOUNDARY_TYPE bc,
+                                                     const int32_t dim)
+{
+  return calcBondEnergyOfR2_tabulated(distance2Of(pos0, pos1, bound, bc, dim), bp);
+}
+
+static ALWAYS_INLINE dtensor3 calcBondVirial_tabulated(const dvec* pos0,
+                                                       const dvec* pos1,
+                                                       const BondedParam* bp,
+                                                       const Boundary* bound,
+                                                       const BOUNDARY_TYPE bc,
+                                                       const int32_t dim)
+{
+  const dvec dr01 = calcDispOf(pos0, pos1, bound, bc, dim);
+  const double r2 = dvec_dot_of(&dr01, &dr01, dim);
+  const dvec dF01 = mul_scalar_new(&dr01, -2.0 * evalSplineTableDeriv(bp->bond_table, r2));
+  return dtensor3_dot(&dF01, &dr01);
+}
+
+// angle kernels
+static ALWAYS_INLINE double calcAngleEnergy_kratky_porod(const dvec* pos0,
+                                                         const dvec* pos1,
+                                                         const dvec* pos2,
+                                                         const BondedParam* bp,
+                                                         const Boundary* bound,
+                                                         const BOUNDARY_TYPE bc,
+                                                         const int32_t dim)
+{
+  return calcAngleEnergyOfCos_kratky_porod(cosAngleOf(pos0, pos1, pos2, bound, bc, dim), bp);
+}
+
+static ALWAYS_INLINE double calcAngleEnergy_cosine_squared(const dvec* pos0,
+                                                           const dvec* pos1,
+                                                           const dvec* pos2,
+                                                           const BondedParam* bp,
+                                                           const Boundary* bound,
+                                                           const BOUNDARY_TYPE bc,
+                                                           const int32_t dim)
+{
+  return calcAngleEnergyOfCos_cosine_squared(cosAngleOf(pos0, pos1, pos2, bound, bc, dim), bp);
+}
+
+static ALWAYS_INLINE double calcAngleEnergy_tabulated(const dvec* pos0,
+                                                      const dvec* pos1,
+                                                      const dvec* pos2,
+                                                      const BondedParam* bp,
+                                                      const Boundary* bound,
+                                                      const BOUNDARY_TYPE bc,
+                                                      const int32_t dim)
+{
+  return calcAngleEnergyOfCos_tabulated(cosAngleOf(pos0, pos1, pos2, bound, bc, dim), bp);
+}
+
+// NOTE: dE/d(cos psi) with cos psi = -cos theta (see calcAngleGeometry).
+static inline double calcAngleSlope(const double cs,
+                                    const BondedParam* bp)
+{
+  switch (bp->angle_type) {
+  case ANGLE_COSINE_SQUARED:
+    return bp->cf_angle * (cs + bp->cos_theta0);
+  case ANGLE_TABULATED:
+    return -evalSplineTableDeriv(bp->angle_table, -cs);
+  case ANGLE_KRATKY_POROD:
+  default:
+    return bp->cf_angle;
+  }
+}
+
+// NOTE: switch-based dispatch for the paths that are not per-move hot
+//       (observers, double-bridge move, slab sweep). The random-site
+//       sweep uses kernels specialized per type (see evolver.c).
+static ALWAYS_INLINE double calcBondTermEnergyOf(const dvec* pos0,
+                                                 const dvec* pos1,
+                                                 const BondedParam* bp,
+                                                 const Boundary* bound,
+                                                 const BOUNDARY_TYPE bc,
+                                                 const int32_t dim)
+{
+  switch (bp->bond_type) {
+  case BOND_FENE:
+    return calcBondEnergy_fene(pos0, pos1, bp, bound, bc, dim);
+  case BOND_TABULATED:
+    return calcBondEnergy_tabulated(pos0, pos1, bp, bound, bc, dim);
+  case BOND_HARMONIC:
+  default:
+    return calcBondEnergy_harmonic(pos0, pos1, bp, bound, bc, dim);
+  }
+}
+
+static ALWAYS_INLINE dtensor3 calcBondTermVirialOf(const dvec* pos0,
+                                                   const dvec* pos1,
+                                                   const BondedParam* bp,
+                                                   const Boundary* bound,
+                                                   const BOUNDARY_TYPE bc,
+                                                   const int32_t dim)
+{
+  switch (bp->bond_type) {
+  case BOND_FENE:
+    return calcBondVirial_fene(pos0, pos1, bp, bound, bc, dim);
+  case BOND_TABULATED:
+    return calcBondVirial_tabulated(pos0, pos1, bp, bound, bc, dim);
+  case BOND_HARMONIC:
+  default:
+    return calcBondVirial_harmonic(pos0, pos1, bp, bound, bc, dim);
+  }
+}
+
+static ALWAYS_INLINE double calcAngleTermEnergyOf(const dvec* pos0,
+                                                  const dvec* pos1,
+                                                  const dvec* pos2,
+                                                  const BondedParam* bp,
+                                                  const Boundary* bound,
+                                                  const BOUNDARY_TYPE bc,
+                                                  const int32_t dim)
+{
+  switch (bp->angle_type) {
+  case ANGLE_COSINE_SQUARED:
+    return calcAngleEnergy_cosine_squared(pos0, pos1, pos2, bp, bound, bc, dim);
+  case ANGLE_TABULATED:
+    return calcAngleEnergy_tabulated(pos0, pos1, pos2, bp, bound, bc, dim);
+  case ANGLE_KRATKY_POROD:
+  default:
+    return calcAngleEnergy_kratky_porod(pos0, pos1, pos2, bp, bound, bc, dim);
+  }
+}
+
+static ALWAYS_INLINE dtensor3 calcAngleTermVirialOf(const dvec* pos0,
+                                                    const dvec* pos1,
+                                                    const dvec* pos2,
+                                                    const BondedParam* bp,
+                                                    const Boundary* bound,
+                                                    const BOUNDARY_TYPE bc,
+                                                    const int32_t dim)
+{
+  dvec dr10, dr12;
+  const double cs = calcAngleGeometry(pos0, pos1, pos2, bound, bc, dim, &dr10, &dr12);
+  return calcAngleVirialOfSlope(&dr10, &dr12, cs, calcAngleSlope(cs, bp));
+}
+
+// NOTE: the boundary type and the dimension are read at run time.
+static inline double calcBondTermEnergy(const dvec* pos0,
+                                        const dvec* pos1,
+                                        const BondedParam* bp,
+                                        const Boundary* bound)
+{
+  return calcBondTermEnergyOf(pos0, pos1, bp, bound, bound->type, bound->dim);
+}
+
+static inline double calcAngleTermEnergy(const dvec* pos0,
+                                         const dvec* pos1,
+                                         const dvec* pos2,
+                                         const BondedParam* bp,
+                                         const Boundary* bound)
+{
+  return calcAngleTermEnergyOf(pos0, pos1, pos2, bp, bound, bound->type, bound->dim);
+}
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef POTENTIAL_SINGLE_H
+#define POTENTIAL_SINGLE_H
+
+#include <math.h>
+
+#include "potential.h"
+#include "single_pos.h"
+
+// NOTE: float32 counterparts of the bonded kernels in potential.h, used by
+//       position_precision float32. Each kernel evaluates SINGLE_LANES
+//       terms in float32 from their squared lengths or cosines (see
+//       single_pos.h); the callers accumulate the terms in float64. The
+//       harmonic, Kratky-Porod and cosine-squared loops vectorize; the fene
+//       (logf) and tabulated loops are evaluated lane by lane.
+typedef struct BondedParamSingle_t {
+  float cf_bond;
+  float l0;
+  float fene_r02;
+  float cf_angle;
+  float cos_theta0;
+  const SplineTable* bond_table;
+  const SplineTable* angle_table;
+} BondedParamSingle;
+
+static inline BondedParamSingle makeBondedParamSingle(const BondedParam* bp)
+{
+  BondedParamSingle bps;
+  bps.cf_bond = (float)bp->cf_bond;
+  bps.l0 = (float)bp->l0;
+  bps.fene_r02 = (float)bp->fene_r02;
+  bps.cf_angle = (float)bp->cf_angle;
+  bps.cos_theta0 = (float)bp->cos_theta0;
+  bps.bond_table = bp->bond_table;
+  bps.angle_table = bp->angle_table;
+  return bps;
+}
+
+// bond kernels
+static ALWAYS_INLINE void calcBondEnergyLanesSingle_harmonic(const float* r2,
+                                                             const BondedParamSingle* bps,
+                                                             float* energy)
+{
+  for (int32_t l = 0; l < SINGLE_LANES; l++) {
+    const float dr = sqrtf(r2[l]) - bps->l0;
+    energy[l] = 0.5f * bps->cf_bond * dr * dr;
+  }
+}
+
+static ALWAYS_INLINE void calcBondEnergyLanesSingle_fene(const float* r2,
+                                                         const BondedParamSingle* bps,
+                                                         float* energy)
+{
+  for (int32_t l = 0; l < SINGLE_LANES; l++) {
+    const float x = r2[l] / bps->fene_r02;
+    energy[l] = (x < 1.0f) ? -0.5f * bps->cf_bond * bps->fene_r02 * logf(1.0f - x) : INFINITY;
+  }
+}
+
+static ALWAYS_INLINE void calcBondEnergyLanesSingle_tabulated(const float* r2,
+                                                              const BondedParamSingle* bps,
+                                                              float* energy)
+{
+  for (int32_t l = 0; l < SINGLE_LANES; l++) {
+    energy[l] = (float)evalSplineTable(bps->bond_table, r2[l]);
+  }
+}
+
+// angle kernels
+static ALWAYS_INLINE void calcAngleEnergyLanesSingle_kratky_porod(const float* cs,
+                                                                  const BondedParamSingle* bps,
+                                                                  float* energy)
+{
+  for (int32_t l = 0; l < SINGLE_LANES; l++) {
+    energy[l] = bps->cf_angle * (1.0f - cs[l]);
+  }
+}
+
+static ALWAYS_INLINE void calcAngleEnergyLanesSingle_cosine_squared(const float* cs,
+                                                                    const BondedParamSingle* bps,
+                                                                    float* energy)
+{
+  for (int32_t l = 0; l < SINGLE_LANES; l++) {
+    const float dc = cs[l] - bps->cos_theta0;
+    energy[l] = 0.5f * bps->cf_angle * dc * dc;
+  }
+}
+
+static ALWAYS_INLINE void calcAngleEnergyLanesSingle_tabulated(const float* cs,
+                                                               const BondedParamSingle* bps,
+                                                               float* energy)
+{
+  for (int32_t l = 0; l < SINGLE_LANES; l++) {
+    energy[l] = (float)evalSplineTable(bps->angle_table, cs[l]);
+  }
+}
+
+#endif
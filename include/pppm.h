@@ -0,0 +1,48 @@
+#ifndef PPPM_H
+#define PPPM_H
+
+#include <stdint.h>
+
+#include "vector3.h"
+#include "tensor3.h"
+#include "pos_store.h"
+
+struct Parameter_t;
+typedef struct Parameter_t Parameter;
+
+struct Boundary_t;
+typedef struct Boundary_t Boundary;
+
+struct Pppm_t;
+typedef struct Pppm_t Pppm;
+
+// NOTE: Coulomb interaction lB q_i q_j / r in the periodic box, computed
+//       with smooth particle-mesh Ewald (order 4 B-splines). The charges
+//       are read per bead from charge_file; a net charge is neutralized
+//       by a uniform background. In 2D the particles lie in
+//       the z = 0 plane of a periodic box of height max(Lx, Ly).
+//       Single-particle moves cost one interpolation stencil of the mesh
+//       potential plus the erfc neighbours of the cell list: the mesh
+//       potential is held fixed between FFTs and each charge sees it less
+//       its own cloud. The FFT is repeated after num_charged accepted
+//       charge moves, so the reciprocal part lags by at most one sweep
+//       over the charges; the real-space part is always current. The
+//       FFTs then cost mesh^3 log(mesh) / num_charged per move, so with
+//       few charges keep pppm_mesh small and move the accuracy to the
+//       real space with a larger ewald_rcut (a smaller ewald_alpha); the
+//       mesh should resolve exp(-pi^2 m^2 / alpha^2), that is
+//       pppm_mesh >~ 2.5 alpha L.
+//       The observed totals do not change the mesh of the moves.
+Pppm* newPppm(const PosStore* store, const Boundary* bound, const Parameter* param);
+void deletePppm(Pppm* self);
+
+// NOTE: the store must still hold the old position of id.
+double calcCoulombMoveEnergy(Pppm* self, const PosStore* store, const int32_t id,
+                             const dvec* trial, const Boundary* bound);
+// NOTE: the store must already hold the new position of id.
+void acceptCoulombMove(Pppm* self, const PosStore* store, const int32_t id);
+
+double calcCoulombEnergyTotal(Pppm* self, const PosStore* store, const Boundary* bound);
+dtensor3 calcCoulombVirialTotal(Pppm* self, const PosStore* store, const Boundary* bound);
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef REORDER_H
+#define REORDER_H
+
+#include <stdint.h>
+
+#include "vector3.h"
+#include "string_c.h"
+#include "pos_store.h"
+
+struct Boundary_t;
+typedef struct Boundary_t Boundary;
+
+// NOTE: reorder_curve hilbert and morton store the particles in the order
+//       of their positions along the curve, so that particles close in
+//       space are close in memory. mesh_morton follows the Morton curve of
+//       the (x, y) indices of the 3D mesh instead.
+typedef enum {
+  NO_REORDER = 0,
+  HILBERT_CURVE,
+  MORTON_CURVE,
+  MESH_MORTON_CURVE,
+} REORDER_TYPE;
+
+const char* getReorderNameFromType(REORDER_TYPE type);
+REORDER_TYPE getReorderTypeFromName(const string* curve_name);
+
+// NOTE: new_of_old[i] is the new id of particle i. Only the particles
+//       id_lo..id_hi are reordered; the others keep their ids. orig_of is
+//       the original id of each particle, from which the mesh indices are
+//       taken (side_dim_x particles per row).
+void calcCurveOrder(const REORDER_TYPE type,
+                    const PosStore* store,
+                    const int32_t* orig_of,
+                    const int32_t num_ptcl,
+                    const int32_t id_lo,
+                    const int32_t id_hi,
+                    const int32_t side_dim_x,
+                    const Boundary* bound,
+                    int32_t* new_of_old);
+
+#endif
@@ -0,0 +1,144 @@
+#ifndef SINGLE_POS_H
+#define SINGLE_POS_H
+
+#include <stdint.h>
+#include <math.h>
+
+#include "vector3.h"
+#include "boundary.h"
+#include "pos_store.h"
+#include "utils.h"
+
+typedef struct {
+  float x, y, z;
+} fvec;
+
+// NOTE: float32 positions of position_precision float32, relative to
+//       origin: zero for the periodic boundary, so that the coordinates lie
+//       in [0, L), and the center of the initial configuration for the free
+//       boundary. They are the stored positions of the run: the float64
+//       PosStore is converted from them only for an observation or the
+//       output (storeSinglePos) and released after it, so that the positions
+//       take dim * 4 bytes per particle instead of dim * 8. The random-site
+//       sweep evaluates the local energies in float32 lanes (see
+//       potential_single.h). e_bonded is the running bonded energy,
+//       accumulated in float64 from the energy changes of accepted moves.
+//       pos holds dim floats per particle, i.e. packed (x, y) in 2D. The
+//       layout is public so that the kernels can be inlined.
+typedef struct SinglePosStore_t {
+  float* pos;
+  dvec origin;
+  fvec box_leng;
+  fvec inv_box_leng;
+  int32_t num_ptcl;
+  int32_t dim;
+  double e_bonded;
+} SinglePosStore;
+
+SinglePosStore* newSinglePosStore(const PosStore* store, const int32_t num_ptcl, const Boundary* bound);
+void deleteSinglePosStore(SinglePosStore* self);
+
+// NOTE: the position of particle i in store is origin + getPosOfSingle(i).
+void storeSinglePos(const SinglePosStore* self, PosStore* store);
+
+// NOTE: z is 0 in 2D.
+static ALWAYS_INLINE fvec getPosOfSingle(const SinglePosStore* self,
+                                         const int32_t id,
+                                         const int32_t dim)
+{
+  const float* r = &self->pos[dim * id];
+  const fvec v = {.x = r[0], .y = r[1], .z = (dim == 3) ? r[2] : 0.0f};
+  return v;
+}
+
+static ALWAYS_INLINE void setPosOfSingle(SinglePosStore* self,
+                                         const int32_t id,
+                                         const fvec* v,
+                                         const int32_t dim)
+{
+  float* r = &self->pos[dim * id];
+  r[0] = v->x;
+  r[1] = v->y;
+  if (dim == 3) r[2] = v->z;
+}
+
+static ALWAYS_INLINE void applyBoundaryCondSingle(const SinglePosStore* self,
+                                                  fvec* pos,
+                                                  const BOUNDARY_TYPE bc,
+                                                  const int32_t dim)
+{
+  if (bc == FREE) return;
+  pos->x -= self->box_leng.x * floorf(pos->x * self->inv_box_leng.x);
+  pos->y -= self->box_leng.y * floorf(pos->y * self->inv_box_leng.y);
+  if (dim == 3) pos->z -= self->box_leng.z * floorf(pos->z * self->inv_box_leng.z);
+}
+
+// NOTE: number of float32 lanes of the local energy, one AVX-512 register.
+//       The lane loops have this fixed trip count, so that the
+//       multiversioned sweeps (TARGET_CLONES) vectorize them; evolver.c is
+//       built with -fno-math-errno for sqrtf. z is not touched in 2D.
+#define SINGLE_LANES 16
+
+typedef struct {
+  float x[SINGLE_LANES];
+  float y[SINGLE_LANES];
+  float z[SINGLE_LANES];
+} FvecLanes;
+
+static ALWAYS_INLINE void setLaneOfSingle(FvecLanes* lanes,
+                                          const int32_t lane,
+                                          const fvec* v,
+                                          const int32_t dim)
+{
+  lanes->x[lane] = v->x;
+  lanes->y[lane] = v->y;
+  if (dim == 3) lanes->z[lane] = v->z;
+}
+
+// NOTE: dr = pos1 - pos0 with the minimum image of the periodic box.
+static ALWAYS_INLINE void calcDispLanesSingle(const FvecLanes* pos0,
+                                              const FvecLanes* pos1,
+                                              const SinglePosStore* self,
+                                              const BOUNDARY_TYPE bc,
+                                              const int32_t dim,
+                                              FvecLanes* dr)
+{
+  for (int32_t l = 0; l < SINGLE_LANES; l++) {
+    dr->x[l] = pos1->x[l] - pos0->x[l];
+    dr->y[l] = pos1->y[l] - pos0->y[l];
+    if (dim == 3) dr->z[l] = pos1->z[l] - pos0->z[l];
+    if (bc == PERIODIC) {
+      dr->x[l] -= self->box_leng.x * nearbyintf(dr->x[l] * self->inv_box_leng.x);
+      dr->y[l] -= self->box_leng.y * nearbyintf(dr->y[l] * self->inv_box_leng.y);
+      if (dim == 3) dr->z[l] -= self->box_leng.z * nearbyintf(dr->z[l] * self->inv_box_leng.z);
+    }
+  }
+}
+
+static ALWAYS_INLINE void dotLanesSingle(const FvecLanes* v0,
+                                         const FvecLanes* v1,
+                                         const int32_t dim,
+                                         float* dot)
+{
+  for (int32_t l = 0; l < SINGLE_LANES; l++) {
+    dot[l] = v0->x[l] * v1->x[l] + v0->y[l] * v1->y[l];
+    if (dim == 3) dot[l] += v0->z[l] * v1->z[l];
+  }
+}
+
+// NOTE: cos[l] of the angle between dr01 and dr12.
+static ALWAYS_INLINE void cosLanesSingle(const FvecLanes* dr01,
+                                         const FvecLanes* dr12,
+                                         const int32_t dim,
+                                         float* cs)
+{
+  float dr01_norm2[SINGLE_LANES], dr12_norm2[SINGLE_LANES];
+  dotLanesSingle(dr01, dr01, dim, dr01_norm2);
+  dotLanesSingle(dr12, dr12, dim, dr12_norm2);
+  dotLanesSingle(dr01, dr12, dim, cs);
+  for (int32_t l = 0; l < SINGLE_LANES; l++) {
+    cs[l] /= sqrtf(dr01_norm2[l] * dr12_norm2[l]);
+  }
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef SITE_ORDER_H
+#define SITE_ORDER_H
+
+#include <stdint.h>
+
+#include "string_c.h"
+
+struct MTstate_t;
+typedef struct MTstate_t MTstate;
+
+// NOTE: sweep_order random draws each site of a sweep uniformly and
+//       independently. The other orders visit every movable site once per
+//       sweep: sequential in increasing or decreasing id (drawn per sweep),
+//       shuffled in a new random permutation per sweep, and blocked tile by
+//       tile, the tiles in random order and each one in the direction of
+//       the sweep.
+typedef enum {
+  RANDOM_ORDER = 0,
+  SEQUENTIAL_ORDER,
+  SHUFFLED_ORDER,
+  BLOCKED_ORDER,
+} SWEEP_ORDER;
+
+const char* getSweepOrderNameFromType(SWEEP_ORDER type);
+SWEEP_ORDER getSweepOrderTypeFromName(const string* order_name);
+
+// NOTE: number of sites of a tile of the blocked order. A sweep_tile of 0
+//       gives the tiles whose particles (positions, ptclid2topol rows and
+//       terms) fit in a 32 KB L1 data cache.
+int32_t calcSweepTileSize(const int32_t sweep_tile);
+
+struct SiteOrder_t;
+typedef struct SiteOrder_t SiteOrder;
+
+// NOTE: the sites id_lo..id_hi. With side_dim_x > 0 the ids are the
+//       (x, y) indices of a mesh of side_dim_x columns, and the tiles of the
+//       blocked order are squares of about tile_size sites of the mesh;
+//       otherwise they are tile_size consecutive ids.
+SiteOrder* newSiteOrder(const SWEEP_ORDER type,
+                        const int32_t id_lo,
+                        const int32_t id_hi,
+                        const int32_t side_dim_x,
+                        const int32_t side_dim_y,
+                        const int32_t tile_size);
+void deleteSiteOrder(SiteOrder* self);
+
+int32_t getNumSitesOfSiteOrder(const SiteOrder* self);
+
+// NOTE: the sites of the next sweep, in the order in which they are moved.
+const int32_t* nextSiteOrder(SiteOrder* self, MTstate* mtst);
+
+#endif
@@ -0,0 +1,57 @@
+#ifndef SPLINE_TABLE_H
+#define SPLINE_TABLE_H
+
+#include <stdint.h>
+
+// NOTE: natural cubic spline through tabulated values on a uniform grid.
+//       coef[4 * i + p] is the p-th order coefficient of interval i in the
+//       local coordinate t = (x - x0) / dx - i. Outside the table the
+//       function is extended linearly.
+typedef struct SplineTable_t {
+  int32_t num_intervals;
+  double x0;
+  double inv_dx;
+  double* coef;
+} SplineTable;
+
+// NOTE: the file has two columns, x and f(x), with x increasing at a
+//       constant spacing. Lines starting with '#' are skipped.
+SplineTable* newSplineTableFromFile(const char* fname);
+void deleteSplineTable(SplineTable* self);
+
+static inline double evalSplineTable(const SplineTable* self,
+                                     const double x)
+{
+  const double u = (x - self->x0) * self->inv_dx;
+  const int32_t n = self->num_intervals;
+  if (u < 0.0) {
+    return self->coef[0] + self->coef[1] * u;
+  } else if (u >= n) {
+    const double* c = &self->coef[4 * (n - 1)];
+    return (c[0] + c[1] + c[2] + c[3]) + (c[1] + 2.0 * c[2] + 3.0 * c[3]) * (u - n);
+  }
+  const int32_t i = (int32_t)u;
+  const double t = u - i;
+  const double* c = &self->coef[4 * i];
+  return c[0] + t * (c[1] + t * (c[2] + t * c[3]));
+}
+
+// NOTE: df/dx.
+static inline double evalSplineTableDeriv(const SplineTable* self,
+                                          const double x)
+{
+  const double u = (x - self->x0) * self->inv_dx;
+  const int32_t n = self->num_intervals;
+  if (u < 0.0) {
+    return self->coef[1] * self->inv_dx;
+  } else if (u >= n) {
+    const double* c = &self->coef[4 * (n - 1)];
+    return (c[1] + 2.0 * c[2] + 3.0 * c[3]) * self->inv_dx;
+  }
+  const int32_t i = (int32_t)u;
+  const double t = u - i;
+  const double* c = &self->coef[4 * i];
+  return (c[1] + t * (2.0 * c[2] + t * 3.0 * c[3])) * self->inv_dx;
+}
+
+#endif
@@ -2,6 +2,7 @@
 #define SYSTEM_H
 
 #include "vector3.h"
+#include "string_c.h"
 
 struct topol_t;
 typedef struct topol_t topol;
@@ -9,6 +10,45 @@ typedef struct topol_t topol;
 struct ptclid2topol_t;
 typedef struct ptclid2topol_t ptclid2topol;
 
+struct ImplicitTopol_t;
+typedef struct ImplicitTopol_t ImplicitTopol;
+
+struct Melt_t;
+typedef struct Melt_t Melt;
+
+struct CellList_t;
+typedef struct CellList_t CellList;
+
+struct HashGrid_t;
+typedef struct HashGrid_t HashGrid;
+
+struct VerletList_t;
+typedef struct VerletList_t VerletList;
+
+struct Pppm_t;
+typedef struct Pppm_t Pppm;
+
+struct PosStore_t;
+typedef struct PosStore_t PosStore;
+
+struct BatchBuffers_t;
+typedef struct BatchBuffers_t BatchBuffers;
+
+struct SinglePosStore_t;
+typedef struct SinglePosStore_t SinglePosStore;
+
+struct FixedPosStore_t;
+typedef struct FixedPosStore_t FixedPosStore;
+
+struct BondCache_t;
+typedef struct BondCache_t BondCache;
+
+struct SiteOrder_t;
+typedef struct SiteOrder_t SiteOrder;
+
+struct BondedParam_t;
+typedef struct BondedParam_t BondedParam;
+
 struct System_t;
 typedef struct System_t System;
 
@@ -18,16 +58,66 @@ typedef struct Parameter_t Parameter;
 struct Boundary_t;
 typedef struct Boundary_t Boundary;
 
+struct Arena_t;
+typedef struct Arena_t Arena;
+
+typedef enum {
+  OFF_LATTICE = 0,
+  BOND_FLUCTUATION,
+} MODEL_TYPE;
+
+// NOTE: position_precision float32 stores the positions in float32 and
+//       evaluates the local energies in float32 lanes (see single_pos.h);
+//       fixed stores them as fixed-point fractions of the periodic box (see
+//       fixed_pos.h).
+typedef enum {
+  DOUBLE_PRECISION = 0,
+  FLOAT32,
+  FIXED_POINT,
+} PRECISION_TYPE;
+
 typedef void(*confMaker)(System* system, const Parameter* param);
-typedef topol*(*topolMaker)(const Parameter*, const Boundary* bound);
+typedef topol*(*topolMaker)(const Parameter*, const Boundary* bound, Arena* arena);
 
 System* newSystem(void);
 void deleteSystem(System* self);
 
 topol* getTopol(const System* self);
+// NOTE: NULL if topology_mode is implicit.
 ptclid2topol* getPtclId2Topol(const System* self);
-dvec* getPos(const System* self);
+// NOTE: NULL unless topology_mode is implicit.
+const ImplicitTopol* getImplicitTopol(const System* self);
+Melt* getMelt(const System* self);
+CellList* getCellList(const System* self);
+HashGrid* getHashGrid(const System* self);
+VerletList* getVerletList(const System* self);
+Pppm* getPppm(const System* self);
+const BondedParam* getBondedParam(const System* self);
+// NOTE: the positions of the particles (see pos_store.h). With
+//       position_precision fixed or float32, NULL during the sweeps and
+//       converted from the stored positions for the observers and the
+//       output.
+PosStore* getPosStore(const System* self);
+// NOTE: partial sums of the full-system kernels (see batch_kernels.h).
+BatchBuffers* getBatchBuffers(const System* self);
+// NOTE: NULL unless position_precision is float32.
+SinglePosStore* getSinglePosStore(const System* self);
+// NOTE: NULL unless position_precision is fixed.
+FixedPosStore* getFixedPosStore(const System* self);
+// NOTE: NULL unless the random-site sweep of the explicit topology in
+//       float64 keeps the bonded terms cached (see bond_cache.h).
+BondCache* getBondCache(const System* self);
+// NOTE: NULL unless sweep_order is other than random (see site_order.h).
+SiteOrder* getSiteOrder(const System* self);
 double getAcceptRatio(const System* self);
+// NOTE: index into getPosStore of the particle with the given original id; the
+//       two differ only if reorder_curve is specified.
+int32_t getStoredId(const System* self, const int32_t orig_id);
+
+const char* getModelNameFromType(MODEL_TYPE type);
+MODEL_TYPE getModelTypeFromName(const string* model_name);
+const char* getPrecisionNameFromType(PRECISION_TYPE type);
+PRECISION_TYPE getPrecisionTypeFromName(const string* precision_name);
 
 void initializeSystem(System* self, const Boundary* boundary, const Parameter* param, confMaker conf_make, topolMaker topol_make);
 void executeSimulation(System* self, const Boundary* boundary, const Parameter* param);
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include "parameter.h"
+#include "utils.h"
 
 struct Boundary_t;
 typedef struct Boundary_t Boundary;
@@ -18,29 +19,101 @@ typedef struct {
 struct topol_t;
 typedef struct topol_t topol;
 
-#ifdef SIMULATION_3D
-// for 2D mesh
-#define NUM_NEIGHBOR_PAIR 4
-#define NUM_NEIGHBOR_TRIPLE 6
-#else
-// for 1D chain
-#define NUM_NEIGHBOR_PAIR 2
-#define NUM_NEIGHBOR_TRIPLE 3
-#endif
+struct Arena_t;
+typedef struct Arena_t Arena;
 
-typedef struct ptclid2topol_t {
+// NOTE: compressed sparse rows from particles to the bonds and angles
+//       they belong to. Row id lists num_pair indices into the bond list
+//       of topol starting at pair_ids[pair_begin] (likewise for angles);
+//       its capacity extends to the begin of row id + 1, and row num_ptcl
+//       is a sentinel. Rows of melts reserve 2 bonds and 3 angles, since
+//       double-bridge moves change which particles are chain ends. The row
+//       header is packed so that a move reads it from one cache line, and
+//       the layout is public so that the accessors below can be inlined.
+typedef struct {
+  int32_t pair_begin;
   int32_t num_pair;
-  pair pair[NUM_NEIGHBOR_PAIR];
+  int32_t triple_begin;
   int32_t num_triple;
-  triple triple[NUM_NEIGHBOR_TRIPLE];
+} Id2TopolRow;
+
+typedef struct ptclid2topol_t {
+  int32_t num_ptcl;
+  Id2TopolRow* rows;
+  int32_t* pair_ids;
+  int32_t* triple_ids;
+  const pair* bond_top;
+  const triple* angle_top;
 } ptclid2topol;
 
-topol* newTopolChain(const Parameter* param, const Boundary* bound);
-topol* newTopolMesh(const Parameter* param, const Boundary* bound);
-void deleteTopol(topol* top);
+static ALWAYS_INLINE int32_t getNumPairsOfPtcl(const ptclid2topol* self,
+                                               const int32_t id)
+{
+  return self->rows[id].num_pair;
+}
+
+static ALWAYS_INLINE const pair* getPairOfPtcl(const ptclid2topol* self,
+                                               const int32_t id,
+                                               const int32_t k)
+{
+  return &self->bond_top[self->pair_ids[self->rows[id].pair_begin + k]];
+}
+
+static ALWAYS_INLINE int32_t getNumTriplesOfPtcl(const ptclid2topol* self,
+                                                 const int32_t id)
+{
+  return self->rows[id].num_triple;
+}
+
+static ALWAYS_INLINE const triple* getTripleOfPtcl(const ptclid2topol* self,
+                                                   const int32_t id,
+                                                   const int32_t k)
+{
+  return &self->angle_top[self->triple_ids[self->rows[id].triple_begin + k]];
+}
+
+// NOTE: topology_mode implicit derives the bonds and angles of a particle
+//       of a chain or a mesh from its index in the sweep kernels, instead
+//       of reading its row of ptclid2topol (see evolver.c).
+typedef enum {
+  EXPLICIT_TOPOLOGY = 0,
+  IMPLICIT_TOPOLOGY,
+} TOPOLOGY_MODE;
+
+// NOTE: shape of the chain (2D) or the side_dim_x * side_dim_y mesh (3D)
+//       of the implicit topology. The layout is public so that the
+//       kernels can be inlined.
+typedef struct ImplicitTopol_t {
+  int32_t num_ptcl;
+  int32_t side_dim_x;
+  int32_t side_dim_y;
+} ImplicitTopol;
+
+// NOTE: the topologies and ptclid2topol live in the arena of the System
+//       and are released with it.
+topol* newTopolChain(const Parameter* param, const Boundary* bound, Arena* arena);
+topol* newTopolMesh(const Parameter* param, const Boundary* bound, Arena* arena);
+topol* newTopolMelt(const Parameter* param, const Boundary* bound, Arena* arena);
+// NOTE: bonds and angles read from topology_file (see topol.c).
+topol* newTopolFromFile(const Parameter* param, const Boundary* bound, Arena* arena);
+
+ptclid2topol* newId2Topol(const topol* top, const Parameter* param, Arena* arena);
+// NOTE: rows of the permuted topology, in the arrays of id2top (the
+//       capacities of the rows are the same up to their order).
+void rebuildId2Topol(ptclid2topol* id2top, const topol* top, const Parameter* param);
+
+ImplicitTopol* newImplicitTopol(const Parameter* param);
+void deleteImplicitTopol(ImplicitTopol* implicit);
+
+const char* getTopologyModeNameFromType(TOPOLOGY_MODE type);
+TOPOLOGY_MODE getTopologyModeTypeFromName(const string* mode_name);
+
+// NOTE: particle i becomes new_of_old[i] in every bond and angle.
+void permuteTopol(topol* top, const int32_t* new_of_old);
 
-ptclid2topol* newId2Topol(const topol* top, const Parameter* param);
-void deleteId2Topol(ptclid2topol* id2top);
+void setTopolChain(topol* top, const int32_t chain, const int32_t* seq, const int32_t chain_len);
+void updateId2TopolChain(ptclid2topol* id2top, const topol* top,
+                         const int32_t chain, const int32_t* seq, const int32_t chain_len);
 
 int32_t getNumBonds(const topol* top);
 const pair* getBondTopol(const topol* top);
@@ -8,6 +8,28 @@
 #define UNUSED_PARAMETER(val) (void)(val)
 #define UNUSED_FUNCTION(func) (void)(func)
 
+#if defined(__GNUC__) || defined(__clang__)
+#define PREFETCH_READ(addr) __builtin_prefetch((addr), 0, 3)
+#define PREFETCH_WRITE(addr) __builtin_prefetch((addr), 1, 3)
+#else
+#define PREFETCH_READ(addr) do {} while (0)
+#define PREFETCH_WRITE(addr) do {} while (0)
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define ALWAYS_INLINE inline __attribute__((always_inline))
+#else
+#define ALWAYS_INLINE inline
+#endif
+
+// NOTE: the function is compiled for AVX-512, AVX2 and the baseline, and
+//       the loader picks the version for the CPU (GCC on x86-64 Linux).
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__)
+#define TARGET_CLONES __attribute__((target_clones("avx512f", "avx2", "default")))
+#else
+#define TARGET_CLONES
+#endif
+
 #ifdef DEBUG
 #define DEBUG_PRINT(...)                        \
   do {                                          \
@@ -21,6 +43,9 @@
 #include <stddef.h>
 
 void* xmalloc(const size_t size);
+// NOTE: alignment must be a power of two multiple of sizeof(void*).
+//       The memory is released with xfree.
+void* xmalloc_aligned(const size_t alignment, const size_t size);
 void xfree(void* ptr);
 
 #include "err_msgs.h"
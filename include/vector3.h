@@ -1,6 +1,8 @@
 #ifndef VECTOR3_H
 #define VECTOR3_H
 
+#include <stdint.h>
+
 #include "utils.h"
 
 typedef struct {
@@ -33,4 +35,14 @@ double norm2(const dvec* self);
 double norm(const dvec* self);
 void normalize(dvec* vec);
 
+// NOTE: dot product over the first dim components; dim is a compile-time
+//       constant in the dimension-specialized kernels.
+static ALWAYS_INLINE double dvec_dot_of(const dvec* v0,
+                                        const dvec* v1,
+                                        const int32_t dim)
+{
+  const double xy = v0->x * v1->x + v0->y * v1->y;
+  return (dim == 3) ? xy + v0->z * v1->z : xy;
+}
+
 #endif
\ No newline at end of file
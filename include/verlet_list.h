@@ -0,0 +1,38 @@
+#ifndef VERLET_LIST_H
+#define VERLET_LIST_H
+
+#include <stdint.h>
+
+#include "vector3.h"
+#include "tensor3.h"
+#include "interactions.h"
+#include "pos_store.h"
+
+struct Boundary_t;
+typedef struct Boundary_t Boundary;
+
+struct VerletList_t;
+typedef struct VerletList_t VerletList;
+
+// NOTE: Verlet neighbor lists for the nonbonded (LJ/WCA) interaction.
+//       Every particle keeps all particles within rc + skin at the last
+//       rebuild. The lists are rebuilt from a cell grid (a hash grid for
+//       the free boundary) only when a trial position would move a particle
+//       more than skin/2 away from its position at the last rebuild, so
+//       they stay exact as long as a single trial displacement is shorter
+//       than skin/2.
+VerletList* newVerletList(const Boundary* bound, const LJParam lj, const double skin, const int32_t num_ptcl);
+void deleteVerletList(VerletList* self);
+
+void buildVerletList(VerletList* self, const PosStore* store, const Boundary* bound);
+void prepareVerletMove(VerletList* self, const PosStore* store, const int32_t id,
+                       const dvec* trial, const Boundary* bound);
+
+double calcNonbondEnergyLocal(const VerletList* self, const PosStore* store, const int32_t id,
+                              const Boundary* bound);
+double calcNonbondEnergyTotal(const VerletList* self, const PosStore* store, const Boundary* bound);
+dtensor3 calcNonbondVirialTotal(const VerletList* self, const PosStore* store, const Boundary* bound);
+
+int32_t getNumVerletRebuilds(const VerletList* self);
+
+#endif
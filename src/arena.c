@@ -0,0 +1,151 @@
+// NOTE: MAP_ANONYMOUS, MAP_HUGETLB and madvise are not in POSIX.1-2001.
+#define _DEFAULT_SOURCE
+
+#include "arena.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+#include "utils.h"
+
+// NOTE: blocks are multiples of the huge page size; a request larger than
+//       ARENA_BLOCK_SIZE gets a block of its own.
+#define ARENA_BLOCK_SIZE ((size_t)32 << 20)
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+typedef struct {
+  char* base;
+  size_t size;
+  size_t used;
+} ArenaBlock;
+
+struct Arena_t {
+  ArenaBlock* blocks;
+  int32_t num_blocks;
+  int32_t capacity;
+  bool huge_pages;
+};
+
+Arena* newArena(const bool huge_pages)
+{
+  Arena* self = (Arena*)xmalloc(sizeof(Arena));
+  self->capacity = 8;
+  self->num_blocks = 0;
+  self->blocks = (ArenaBlock*)xmalloc(self->capacity * sizeof(ArenaBlock));
+  self->huge_pages = huge_pages;
+  return self;
+}
+
+#ifdef __linux__
+// NOTE: MAP_HUGETLB fails unless enough huge pages are reserved
+//       (vm.nr_hugepages); the block then falls back to transparent huge
+//       pages.
+static char* mapBlock(const size_t size,
+                      const bool huge_pages)
+{
+  const int prot = PROT_READ | PROT_WRITE;
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  void* base = MAP_FAILED;
+#ifdef MAP_HUGETLB
+  if (huge_pages) base = mmap(NULL, size, prot, flags | MAP_HUGETLB, -1, 0);
+#endif
+  if (base == MAP_FAILED) {
+    base = mmap(NULL, size, prot, flags, -1, 0);
+    if (base == MAP_FAILED) {
+      perror("mmap");
+      exit(EXIT_FAILURE);
+    }
+#ifdef MADV_HUGEPAGE
+    if (huge_pages) madvise(base, size, MADV_HUGEPAGE);
+#endif
+  }
+  return (char*)base;
+}
+
+static void unmapBlock(ArenaBlock* block)
+{
+  munmap(block->base, block->size);
+}
+#else
+static char* mapBlock(const size_t size,
+                      const bool huge_pages)
+{
+  UNUSED_PARAMETER(huge_pages);
+  return (char*)xmalloc_aligned(HUGE_PAGE_SIZE, size);
+}
+
+static void unmapBlock(ArenaBlock* block)
+{
+  xfree(block->base);
+}
+#endif
+
+void deleteArena(Arena* self)
+{
+  for (int32_t b = 0; b < self->num_blocks; b++) unmapBlock(&self->blocks[b]);
+  xfree(self->blocks);
+  xfree(self);
+}
+
+static ArenaBlock* addBlock(Arena* self,
+                            const size_t min_size)
+{
+  if (self->num_blocks == self->capacity) {
+    self->capacity *= 2;
+    ArenaBlock* blocks = (ArenaBlock*)xmalloc(self->capacity * sizeof(ArenaBlock));
+    memcpy(blocks, self->blocks, self->num_blocks * sizeof(ArenaBlock));
+    xfree(self->blocks);
+    self->blocks = blocks;
+  }
+  ArenaBlock* block = &self->blocks[self->num_blocks++];
+  block->size = (min_size > ARENA_BLOCK_SIZE) ? min_size : ARENA_BLOCK_SIZE;
+  block->size = (block->size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+  block->base = mapBlock(block->size, self->huge_pages);
+  block->used = 0;
+  return block;
+}
+
+static char* bumpArena(Arena* self,
+                       const size_t size)
+{
+  const size_t aligned_size = (size + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+  ArenaBlock* block = (self->num_blocks > 0) ? &self->blocks[self->num_blocks - 1] : NULL;
+  if (!block || block->size - block->used < aligned_size) block = addBlock(self, aligned_size);
+  char* ptr = block->base + block->used;
+  block->used += aligned_size;
+  return ptr;
+}
+
+void* allocArena(Arena* self,
+                 const size_t size)
+{
+  char* ptr = bumpArena(self, size);
+  memset(ptr, 0, size);
+  return ptr;
+}
+
+// NOTE: the same schedule(static) partition of num_chunks iterations as
+//       the loop that owns the chunks, so that each thread touches its
+//       chunks first. A 2 MB page is placed as a whole by its first touch,
+//       and spans the chunks of several threads, so huge pages are touched
+//       by the caller alone.
+void* allocArenaChunks(Arena* self,
+                       const int32_t num_chunks,
+                       const size_t chunk_size)
+{
+  const size_t size = (size_t)num_chunks * chunk_size;
+  char* ptr = bumpArena(self, size);
+  if (self->huge_pages) {
+    memset(ptr, 0, size);
+    return ptr;
+  }
+#pragma omp parallel for schedule(static)
+  for (int32_t c = 0; c < num_chunks; c++) memset(ptr + (size_t)c * chunk_size, 0, chunk_size);
+  return ptr;
+}
@@ -0,0 +1,422 @@
+#include "batch_kernels.h"
+
+#include <math.h>
+
+#include "utils.h"
+#include "boundary.h"
+#include "potential.h"
+#include "arena.h"
+
+#define LANES POS_STORE_BLOCK
+
+#if LANES != 8
+#error "the SIMD paths of batch_kernels.c assume blocks of 8 lanes"
+#endif
+
+// NOTE: displacements of one block, d = pos[ib] - pos[ia]. z is left
+//       untouched in 2D.
+typedef struct DispBlock_t {
+  double x[LANES];
+  double y[LANES];
+  double z[LANES];
+} DispBlock;
+
+// NOTE: lanes past the end of the list repeat its last entry, so that every
+//       lane holds a valid geometry; their results are masked by the caller.
+static ALWAYS_INLINE int32_t clampLane(const int32_t k,
+                                       const int32_t num)
+{
+  return (k < num) ? k : num - 1;
+}
+
+static ALWAYS_INLINE double reduceLanes(const double* acc)
+{
+  return ((acc[0] + acc[4]) + (acc[2] + acc[6])) + ((acc[1] + acc[5]) + (acc[3] + acc[7]));
+}
+
+// NOTE: one partial sum per tensor element and lane, xx, xy, ..., zz.
+typedef struct VirialLanes_t {
+  double v[9][LANES];
+} VirialLanes;
+
+static ALWAYS_INLINE void calcBondEnergyLanes(const double* r2,
+                                              const BondedParam* bp,
+                                              double* e)
+{
+  switch (bp->bond_type) {
+  case BOND_FENE:
+    for (int32_t l = 0; l < LANES; l++) e[l] = calcBondEnergyOfR2_fene(r2[l], bp);
+    break;
+  case BOND_TABULATED:
+    for (int32_t l = 0; l < LANES; l++) e[l] = calcBondEnergyOfR2_tabulated(r2[l], bp);
+    break;
+  case BOND_HARMONIC:
+  default:
+    for (int32_t l = 0; l < LANES; l++) e[l] = calcBondEnergyOfR2_harmonic(r2[l], bp);
+    break;
+  }
+}
+
+// NOTE: s with dF01 = s dr01 (see calcBondVirial_* in potential.h).
+static ALWAYS_INLINE void calcBondScaleLanes(const double* r2,
+                                             const BondedParam* bp,
+                                             double* s)
+{
+  switch (bp->bond_type) {
+  case BOND_FENE:
+    for (int32_t l = 0; l < LANES; l++) s[l] = -bp->cf_bond / (1.0 - r2[l] / bp->fene_r02);
+    break;
+  case BOND_TABULATED:
+    for (int32_t l = 0; l < LANES; l++) s[l] = -2.0 * evalSplineTableDeriv(bp->bond_table, r2[l]);
+    break;
+  case BOND_HARMONIC:
+  default:
+    for (int32_t l = 0; l < LANES; l++) {
+      const double r = sqrt(r2[l]);
+      s[l] = -bp->cf_bond * (r - bp->l0) / r;
+    }
+    break;
+  }
+}
+
+static ALWAYS_INLINE void calcAngleEnergyLanes(const double* cs,
+                                               const BondedParam* bp,
+                                               double* e)
+{
+  switch (bp->angle_type) {
+  case ANGLE_COSINE_SQUARED:
+    for (int32_t l = 0; l < LANES; l++) e[l] = calcAngleEnergyOfCos_cosine_squared(cs[l], bp);
+    break;
+  case ANGLE_TABULATED:
+    for (int32_t l = 0; l < LANES; l++) e[l] = calcAngleEnergyOfCos_tabulated(cs[l], bp);
+    break;
+  case ANGLE_KRATKY_POROD:
+  default:
+    for (int32_t l = 0; l < LANES; l++) e[l] = calcAngleEnergyOfCos_kratky_porod(cs[l], bp);
+    break;
+  }
+}
+
+static ALWAYS_INLINE void gatherBondIndex(const pair* bonds,
+                                          const int32_t b0,
+                                          const int32_t num_bonds,
+                                          int32_t* i0,
+                                          int32_t* i1,
+                                          double* mask)
+{
+  for (int32_t l = 0; l < LANES; l++) {
+    const pair* bond = &bonds[clampLane(b0 + l, num_bonds)];
+    i0[l] = bond->i0;
+    i1[l] = bond->i1;
+    mask[l] = (b0 + l < num_bonds) ? 1.0 : 0.0;
+  }
+}
+
+static ALWAYS_INLINE void gatherAngleIndex(const triple* angles,
+                                           const int32_t a0,
+                                           const int32_t num_angles,
+                                           int32_t* i0,
+                                           int32_t* i1,
+                                           int32_t* i2,
+                                           double* mask)
+{
+  for (int32_t l = 0; l < LANES; l++) {
+    const triple* angle = &angles[clampLane(a0 + l, num_angles)];
+    i0[l] = angle->i0;
+    i1[l] = angle->i1;
+    i2[l] = angle->i2;
+    mask[l] = (a0 + l < num_angles) ? 1.0 : 0.0;
+  }
+}
+
+// NOTE: masked lanes are dropped with a select rather than a product,
+//       since a FENE bond beyond R0 has infinite energy.
+static ALWAYS_INLINE void accumulateMasked(double* acc,
+                                           const double* val,
+                                           const double* mask)
+{
+  for (int32_t l = 0; l < LANES; l++) acc[l] += (mask[l] != 0.0) ? val[l] : 0.0;
+}
+
+// NOTE: bonds, angles and particles are split into chunks of a fixed
+//       size, which may run on different threads (observer_threads). The
+//       sums of the chunks are reduced by a pairwise tree in chunk order,
+//       so the results do not depend on the number of threads.
+#define CHUNK_SIZE (64 * LANES)
+
+static int32_t getNumChunks(const int32_t num)
+{
+  return (num + CHUNK_SIZE - 1) / CHUNK_SIZE;
+}
+
+static ALWAYS_INLINE int32_t getChunkEnd(const int32_t begin,
+                                         const int32_t num)
+{
+  return (begin + CHUNK_SIZE < num) ? begin + CHUNK_SIZE : num;
+}
+
+// NOTE: sum of a[0], a[stride], ..., a[(n - 1) * stride].
+static double sumPairwise(const double* a,
+                          const int32_t n,
+                          const int32_t stride)
+{
+  if (n == 0) return 0.0;
+  if (n == 1) return a[0];
+  const int32_t half = n / 2;
+  return sumPairwise(a, half, stride) + sumPairwise(a + half * stride, n - half, stride);
+}
+
+// NOTE: energy and virial of one chunk, out[0] = energy and out[1 + k] =
+//       element k of the virial (xx, xy, ..., zz).
+#define TERMS_WIDTH 10
+
+static ALWAYS_INLINE void reduceTermsChunk(const double* acc,
+                                           const VirialLanes* vir,
+                                           double* out)
+{
+  out[0] = reduceLanes(acc);
+  for (int32_t k = 0; k < 9; k++) out[1 + k] = reduceLanes(vir->v[k]);
+}
+
+struct BatchBuffers_t {
+  int32_t num_bonded_chunks;
+  int32_t num_ptcl_chunks;
+  double* bonded; // TERMS_WIDTH per chunk of bonds, then of angles
+  double* ptcl;   // one per chunk of particles
+};
+
+BatchBuffers* newBatchBuffers(const int32_t num_bonds,
+                              const int32_t num_angles,
+                              const int32_t num_padded,
+                              Arena* arena)
+{
+  BatchBuffers* self = (BatchBuffers*)allocArena(arena, sizeof(BatchBuffers));
+  self->num_bonded_chunks = getNumChunks(num_bonds) + getNumChunks(num_angles);
+  self->num_ptcl_chunks = getNumChunks(num_padded);
+  self->bonded = (double*)allocArenaChunks(arena, self->num_bonded_chunks, TERMS_WIDTH * sizeof(double));
+  self->ptcl = (double*)allocArenaChunks(arena, self->num_ptcl_chunks, sizeof(double));
+  return self;
+}
+
+// NOTE: the block kernels of one instruction set (batch_kernels_isa.h).
+typedef struct BatchKernels_t {
+  const char* name;
+  double (*sum_bond_energy)(const PosStore* store, const pair* bonds, const int32_t begin,
+                            const int32_t num_bonds, const BondedParam* bp, const Boundary* bound);
+  double (*sum_angle_energy)(const PosStore* store, const triple* angles, const int32_t begin,
+                             const int32_t num_angles, const BondedParam* bp, const Boundary* bound);
+  void (*sum_bond_terms)(const PosStore* store, const pair* bonds, const int32_t begin,
+                         const int32_t num_bonds, const BondedParam* bp, const Boundary* bound, double* out);
+  void (*sum_angle_terms)(const PosStore* store, const triple* angles, const int32_t begin,
+                          const int32_t num_angles, const BondedParam* bp, const Boundary* bound, double* out);
+  double (*sum_component)(const double* restrict comp, const int32_t begin, const int32_t end);
+  double (*sum_distance2)(const double* restrict comp, const int32_t num_ptcl, const int32_t begin,
+                          const int32_t end, const double c0, const double leng, const double inv_leng);
+  double complex (*calc_height_dft)(const PosStore* store, const double qx, const double qy);
+} BatchKernels;
+
+// NOTE: on x86-64 with GCC the kernels are compiled for AVX-512, AVX2 and
+//       the SSE2 baseline, and selectBatchKernels picks one for the CPU at
+//       startup, so that one binary runs on every node. Otherwise the
+//       kernels follow the instruction set the build targets. The results
+//       are the same bit for bit on every path (there is no FMA
+//       contraction, and rounding to nearest even is nearbyint).
+#if defined(__x86_64__) && defined(__GNUC__) && !defined(__clang__)
+#define BATCH_KERNEL_DISPATCH
+#endif
+
+#if defined(BATCH_KERNEL_DISPATCH) || defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+#ifdef BATCH_KERNEL_DISPATCH
+#pragma GCC push_options
+#pragma GCC target("avx512f")
+#define BATCH_ISA_LEVEL 2
+#define BATCH_ISA_SUFFIX _avx512
+#define BATCH_ISA_NAME "avx512"
+#include "batch_kernels_isa.h"
+#undef BATCH_ISA_LEVEL
+#undef BATCH_ISA_SUFFIX
+#undef BATCH_ISA_NAME
+#pragma GCC pop_options
+
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#define BATCH_ISA_LEVEL 1
+#define BATCH_ISA_SUFFIX _avx2
+#define BATCH_ISA_NAME "avx2"
+#include "batch_kernels_isa.h"
+#undef BATCH_ISA_LEVEL
+#undef BATCH_ISA_SUFFIX
+#undef BATCH_ISA_NAME
+#pragma GCC pop_options
+
+#define BATCH_ISA_LEVEL 0
+#define BATCH_ISA_NAME "sse2"
+#elif defined(__AVX512F__)
+#define BATCH_ISA_LEVEL 2
+#define BATCH_ISA_NAME "avx512"
+#elif defined(__AVX2__)
+#define BATCH_ISA_LEVEL 1
+#define BATCH_ISA_NAME "avx2"
+#else
+#define BATCH_ISA_LEVEL 0
+#define BATCH_ISA_NAME "scalar"
+#endif
+#define BATCH_ISA_SUFFIX _build
+#include "batch_kernels_isa.h"
+
+static const BatchKernels* kernels = &batch_kernels_build;
+
+void selectBatchKernels(void)
+{
+#ifdef BATCH_KERNEL_DISPATCH
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    kernels = &batch_kernels_avx512;
+  } else if (__builtin_cpu_supports("avx2")) {
+    kernels = &batch_kernels_avx2;
+  } else {
+    kernels = &batch_kernels_build;
+  }
+#endif
+}
+
+const char* getBatchKernelIsa(void)
+{
+  return kernels->name;
+}
+
+void sumBondedEnergyOfStore(const PosStore* store,
+                            const pair* bonds,
+                            const int32_t num_bonds,
+                            const triple* angles,
+                            const int32_t num_angles,
+                            const BondedParam* bp,
+                            const Boundary* bound,
+                            BatchBuffers* buf,
+                            double* etot_bond,
+                            double* etot_angle)
+{
+  const int32_t num_bond_chunks = getNumChunks(num_bonds);
+  const int32_t num_chunks = buf->num_bonded_chunks;
+  double* part = buf->bonded;
+#pragma omp parallel for schedule(static)
+  for (int32_t c = 0; c < num_chunks; c++) {
+    if (c < num_bond_chunks) {
+      part[c * TERMS_WIDTH] = kernels->sum_bond_energy(store, bonds, c * CHUNK_SIZE, num_bonds, bp, bound);
+    } else {
+      part[c * TERMS_WIDTH] = kernels->sum_angle_energy(store, angles, (c - num_bond_chunks) * CHUNK_SIZE,
+                                                        num_angles, bp, bound);
+    }
+  }
+  *etot_bond += sumPairwise(part, num_bond_chunks, TERMS_WIDTH);
+  *etot_angle += sumPairwise(&part[num_bond_chunks * TERMS_WIDTH], num_chunks - num_bond_chunks, TERMS_WIDTH);
+}
+
+// NOTE: energies and virials in one pass; the bond energy and the force
+//       scale share r^2.
+void sumBondedTermsOfStore(const PosStore* store,
+                           const pair* bonds,
+                           const int32_t num_bonds,
+                           const triple* angles,
+                           const int32_t num_angles,
+                           const BondedParam* bp,
+                           const Boundary* bound,
+                           BatchBuffers* buf,
+                           BondedSums* sums)
+{
+  const int32_t num_bond_chunks = getNumChunks(num_bonds);
+  const int32_t num_chunks = buf->num_bonded_chunks;
+  const int32_t num_angle_chunks = num_chunks - num_bond_chunks;
+  double* part = buf->bonded;
+#pragma omp parallel for schedule(static)
+  for (int32_t c = 0; c < num_chunks; c++) {
+    if (c < num_bond_chunks) {
+      kernels->sum_bond_terms(store, bonds, c * CHUNK_SIZE, num_bonds, bp, bound, &part[c * TERMS_WIDTH]);
+    } else {
+      kernels->sum_angle_terms(store, angles, (c - num_bond_chunks) * CHUNK_SIZE, num_angles, bp, bound,
+                               &part[c * TERMS_WIDTH]);
+    }
+  }
+
+  const double* bond_part = part;
+  const double* angle_part = &part[num_bond_chunks * TERMS_WIDTH];
+  sums->e_bond = sumPairwise(bond_part, num_bond_chunks, TERMS_WIDTH);
+  sums->e_angle = sumPairwise(angle_part, num_angle_chunks, TERMS_WIDTH);
+  double v[9];
+  for (int32_t k = 0; k < 9; k++) {
+    v[k] = sumPairwise(&bond_part[1 + k], num_bond_chunks, TERMS_WIDTH)
+      + sumPairwise(&angle_part[1 + k], num_angle_chunks, TERMS_WIDTH);
+  }
+  const dtensor3 vir_tot = {
+    v[0], v[1], v[2],
+    v[3], v[4], v[5],
+    v[6], v[7], v[8],
+  };
+  sums->virial = vir_tot;
+}
+
+// NOTE: the padding of the store is zero, so that the plain sums run over
+//       whole blocks without a mask. CHUNK_SIZE is a multiple of the
+//       padding block.
+static double sumComponent(const double* restrict comp,
+                           const int32_t num_padded,
+                           BatchBuffers* buf)
+{
+  const int32_t num_chunks = buf->num_ptcl_chunks;
+  double* part = buf->ptcl;
+#pragma omp parallel for schedule(static)
+  for (int32_t c = 0; c < num_chunks; c++) {
+    part[c] = kernels->sum_component(comp, c * CHUNK_SIZE, getChunkEnd(c * CHUNK_SIZE, num_padded));
+  }
+  return sumPairwise(part, num_chunks, 1);
+}
+
+static double sumDistance2ToPoint(const double* restrict comp,
+                                  const int32_t num_ptcl,
+                                  const int32_t num_padded,
+                                  const double c0,
+                                  const double leng,
+                                  const double inv_leng,
+                                  BatchBuffers* buf)
+{
+  const int32_t num_chunks = buf->num_ptcl_chunks;
+  double* part = buf->ptcl;
+#pragma omp parallel for schedule(static)
+  for (int32_t c = 0; c < num_chunks; c++) {
+    part[c] = kernels->sum_distance2(comp, num_ptcl, c * CHUNK_SIZE, getChunkEnd(c * CHUNK_SIZE, num_padded),
+                                     c0, leng, inv_leng);
+  }
+  return sumPairwise(part, num_chunks, 1);
+}
+
+double calcRgOfStore(const PosStore* store,
+                     const Boundary* bound,
+                     BatchBuffers* buf)
+{
+  const int32_t num_ptcl = store->num_ptcl;
+  const int32_t num_padded = store->num_padded;
+  const int32_t dim = store->dim;
+
+  const double cx = sumComponent(store->x, num_padded, buf) / num_ptcl;
+  const double cy = sumComponent(store->y, num_padded, buf) / num_ptcl;
+  double rg2 = sumDistance2ToPoint(store->x, num_ptcl, num_padded, cx,
+                                   bound->box_leng.x, bound->inv_box_leng.x, buf);
+  rg2 += sumDistance2ToPoint(store->y, num_ptcl, num_padded, cy,
+                             bound->box_leng.y, bound->inv_box_leng.y, buf);
+  if (dim == 3) {
+    const double cz = sumComponent(store->z, num_padded, buf) / num_ptcl;
+    rg2 += sumDistance2ToPoint(store->z, num_ptcl, num_padded, cz,
+                               bound->box_leng.z, bound->inv_box_leng.z, buf);
+  }
+  return sqrt(rg2 / num_ptcl);
+}
+
+double complex calcHeightDftOfStore(const PosStore* store,
+                                    const double qx,
+                                    const double qy)
+{
+  return kernels->calc_height_dft(store, qx, qy);
+}
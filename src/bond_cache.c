@@ -0,0 +1,122 @@
+#include "bond_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// NOTE: index among the bonds of particle id of the bond joining p0 and
+//       p1, or -1. *flip tells whether it is stored as (p1, p0).
+static int32_t findBondSlot(const ptclid2topol* id2top,
+                            const int32_t id,
+                            const int32_t p0,
+                            const int32_t p1,
+                            bool* flip)
+{
+  const int32_t num_bonds = getNumPairsOfPtcl(id2top, id);
+  for (int32_t k = 0; k < num_bonds; k++) {
+    const pair* b = getPairOfPtcl(id2top, id, k);
+    if (b->i0 == p0 && b->i1 == p1) {
+      *flip = false;
+      return k;
+    }
+    if (b->i0 == p1 && b->i1 == p0) {
+      *flip = true;
+      return k;
+    }
+  }
+  return -1;
+}
+
+// NOTE: the largest row capacities bound the trial terms of a move.
+static void getMaxRowCapacity(const ptclid2topol* id2top,
+                              int32_t* max_pair,
+                              int32_t* max_triple)
+{
+  const Id2TopolRow* rows = id2top->rows;
+  *max_pair = *max_triple = 0;
+  for (int32_t i = 0; i < id2top->num_ptcl; i++) {
+    const int32_t cap_pair = rows[i + 1].pair_begin - rows[i].pair_begin;
+    const int32_t cap_triple = rows[i + 1].triple_begin - rows[i].triple_begin;
+    if (cap_pair > *max_pair) *max_pair = cap_pair;
+    if (cap_triple > *max_triple) *max_triple = cap_triple;
+  }
+}
+
+// NOTE: the bond of dr01 (or dr12) is looked up in the row of the middle
+//       particle, which belongs to both bonds of the angle.
+static bool setAngleBondRefs(BondCache* self,
+                             const ptclid2topol* id2top)
+{
+  const int32_t num_ptcl = id2top->num_ptcl;
+  for (int32_t id = 0; id < num_ptcl; id++) {
+    const Id2TopolRow* row = &id2top->rows[id];
+    for (int32_t k = 0; k < row->num_triple; k++) {
+      const triple* a = getTripleOfPtcl(id2top, id, k);
+      AngleBondRef* ref = &self->refs[row->triple_begin + k];
+      bool flip01, flip12;
+      const int32_t mid01 = findBondSlot(id2top, a->i1, a->i0, a->i1, &flip01);
+      const int32_t mid12 = findBondSlot(id2top, a->i1, a->i1, a->i2, &flip12);
+      if (mid01 < 0 || mid12 < 0) return false;
+      ref->bond[0] = id2top->pair_ids[id2top->rows[a->i1].pair_begin + mid01];
+      ref->bond[1] = id2top->pair_ids[id2top->rows[a->i1].pair_begin + mid12];
+      ref->sign = (flip01 != flip12) ? -1.0 : 1.0;
+      bool unused;
+      ref->slot[0] = (id == a->i2) ? -1 : findBondSlot(id2top, id, a->i0, a->i1, &unused);
+      ref->slot[1] = (id == a->i0) ? -1 : findBondSlot(id2top, id, a->i1, a->i2, &unused);
+    }
+  }
+  return true;
+}
+
+BondCache* newBondCache(const topol* top,
+                        const ptclid2topol* id2top,
+                        const PosStore* store,
+                        const Boundary* bound,
+                        const BondedParam* bp)
+{
+  const int32_t num_ptcl = id2top->num_ptcl;
+  int32_t max_pair, max_triple;
+  getMaxRowCapacity(id2top, &max_pair, &max_triple);
+
+  BondCache* self = (BondCache*)xmalloc(sizeof(BondCache));
+  self->num_bonds = getNumBonds(top);
+  self->num_angles = getNumAngles(top);
+  self->bonds = (CachedBond*)xmalloc(self->num_bonds * sizeof(CachedBond));
+  self->angle_energy = (double*)xmalloc(self->num_angles * sizeof(double));
+  self->refs = (AngleBondRef*)xmalloc(id2top->rows[num_ptcl].triple_begin * sizeof(AngleBondRef));
+  self->trial_bonds = (CachedBond*)xmalloc(max_pair * sizeof(CachedBond));
+  self->trial_angle_energy = (double*)xmalloc(max_triple * sizeof(double));
+  if (!setAngleBondRefs(self, id2top)) {
+    deleteBondCache(self);
+    return NULL;
+  }
+
+  const pair* bond_top = getBondTopol(top);
+  const int32_t dim = getBoundaryDim(bound);
+  for (int32_t b = 0; b < self->num_bonds; b++) {
+    const dvec pos0 = getPosOfStore(store, bond_top[b].i0);
+    const dvec pos1 = getPosOfStore(store, bond_top[b].i1);
+    CachedBond* cb = &self->bonds[b];
+    cb->dr = calcDispOf(&pos0, &pos1, bound, getBoundaryType(bound), dim);
+    cb->r2 = dvec_dot_of(&cb->dr, &cb->dr, dim);
+    cb->energy = calcBondTermEnergy(&pos0, &pos1, bp, bound);
+  }
+  const triple* angle_top = getAngleTopol(top);
+  for (int32_t a = 0; a < self->num_angles; a++) {
+    const dvec pos0 = getPosOfStore(store, angle_top[a].i0);
+    const dvec pos1 = getPosOfStore(store, angle_top[a].i1);
+    const dvec pos2 = getPosOfStore(store, angle_top[a].i2);
+    self->angle_energy[a] = calcAngleTermEnergy(&pos0, &pos1, &pos2, bp, bound);
+  }
+  return self;
+}
+
+void deleteBondCache(BondCache* self)
+{
+  xfree(self->bonds);
+  xfree(self->angle_energy);
+  xfree(self->refs);
+  xfree(self->trial_bonds);
+  xfree(self->trial_angle_energy);
+  xfree(self);
+}
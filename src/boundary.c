@@ -8,18 +8,19 @@
 
 #include "utils.h"
 #include "system.h"
-
-struct Boundary_t {
-  dvec box_leng;
-  dvec hbox_leng;
-  BOUNDARY_TYPE type;
-};
+#include "pos_store.h"
+#include "domain.h"
 
 // NOTE: boundary origin is {0.0, 0.0, 0.0}
-Boundary* newBoundary(const string* type_name)
+Boundary* newBoundary(const string* type_name,
+                      const int32_t dim)
 {
   Boundary* bound = (Boundary*)xmalloc(sizeof(Boundary));
   bound->type = getBoundaryTypeFromName(type_name);
+  bound->dim = dim;
+  clear_dvec(&bound->box_leng);
+  clear_dvec(&bound->hbox_leng);
+  clear_dvec(&bound->inv_box_leng);
   return bound;
 }
 
@@ -33,6 +34,17 @@ BOUNDARY_TYPE getBoundaryType(const Boundary* bound)
   return bound->type;
 }
 
+int32_t getBoundaryDim(const Boundary* bound)
+{
+  return bound->dim;
+}
+
+// NOTE: zero for the free boundary.
+dvec getBoundaryBoxLength(const Boundary* bound)
+{
+  return bound->box_leng;
+}
+
 const char* getBoundaryNameFromType(BOUNDARY_TYPE type)
 {
   switch (type) {
@@ -71,72 +83,34 @@ void setBoxLength(Boundary* self,
   }
   self->box_leng  = length;
   self->hbox_leng = mul_scalar_new(&length, 0.5);
+  self->inv_box_leng.x = (length.x != 0.0) ? 1.0 / length.x : 0.0;
+  self->inv_box_leng.y = (length.y != 0.0) ? 1.0 / length.y : 0.0;
+  self->inv_box_leng.z = (length.z != 0.0) ? 1.0 / length.z : 0.0;
 }
 
 void applyBoundaryCond(const Boundary* self,
                        dvec* pos)
 {
-  if (self->type == FREE) return;
-  if (pos->x < 0.0) pos->x += self->box_leng.x;
-  if (pos->x >= self->box_leng.x) pos->x -= self->box_leng.x;
-  if (pos->y < 0.0) pos->y += self->box_leng.y;
-  if (pos->y >= self->box_leng.y) pos->y -= self->box_leng.y;
-  if (pos->z < 0.0) pos->z += self->box_leng.z;
-  if (pos->z >= self->box_leng.z) pos->z -= self->box_leng.z;
+  applyBoundaryCondOf(self, pos, self->type, self->dim);
 }
 
+// NOTE: a configuration read from file may lie several box lengths
+//       away; the last wrap by one box length catches the rounding of
+//       floor near the box edges. With domain decomposition the root
+//       rank alone holds the configuration (see initializeSystem).
 void applyBoundaryCondForSystem(const Boundary* self,
                                 System* system,
                                 const Parameter* param)
 {
-  if (self->type == FREE) return;
+  if (self->type == FREE || !isRootRank()) return;
   const int32_t num_ptcls = getNumPtcl(param);
-  dvec* pos = getPos(system);
+  PosStore* store = getPosStore(system);
   for (int32_t i = 0; i < num_ptcls; i++) {
-    applyBoundaryCond(self, &pos[i]);
+    dvec r = getPosOfStore(store, i);
+    r.x -= self->box_leng.x * floor(r.x * self->inv_box_leng.x);
+    r.y -= self->box_leng.y * floor(r.y * self->inv_box_leng.y);
+    if (self->dim == 3) r.z -= self->box_leng.z * floor(r.z * self->inv_box_leng.z);
+    applyBoundaryCond(self, &r);
+    setPosOfStore(store, i, &r);
   }
 }
-
-void applyMinimumImageConv(const Boundary* self,
-                           dvec* dr)
-{
-  if (self->type == FREE) return;
-  if (dr->x >  self->hbox_leng.x) dr->x -= self->box_leng.x;
-  if (dr->x < -self->hbox_leng.x) dr->x += self->box_leng.x;
-  if (dr->y >  self->hbox_leng.y) dr->y -= self->box_leng.y;
-  if (dr->y < -self->hbox_leng.y) dr->y += self->box_leng.y;
-  if (dr->z >  self->hbox_leng.z) dr->z -= self->box_leng.z;
-  if (dr->z < -self->hbox_leng.z) dr->z += self->box_leng.z;
-}
-
-double distance2(const dvec* pos0,
-                 const dvec* pos1,
-                 const Boundary* bound)
-{
-  dvec dr = sub_dvec_new(pos0, pos1);
-  applyMinimumImageConv(bound, &dr);
-  return dvec_dot(&dr, &dr);
-}
-
-double distance(const dvec* pos0,
-                const dvec* pos1,
-                const Boundary* bound)
-{
-  return sqrt(distance2(pos0, pos1, bound));
-}
-
-// NOTE: return (dr01*dr21) / (|dr01|*|dr21|)
-double cos_angle(const dvec* pos0,
-                 const dvec* pos1,
-                 const dvec* pos2,
-                 const Boundary* bound)
-{
-  dvec dr01 = sub_dvec_new(pos1, pos0); // 0 -> 1
-  dvec dr12 = sub_dvec_new(pos2, pos1); // 1 -> 2
-  applyMinimumImageConv(bound, &dr01);
-  applyMinimumImageConv(bound, &dr12);
-  const double dr01_dr12 = dvec_dot(&dr01, &dr12);
-  const double dr01_norm = norm(&dr01);
-  const double dr12_norm = norm(&dr12);
-  return dr01_dr12 / (dr01_norm * dr12_norm);
-}
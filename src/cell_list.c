@@ -0,0 +1,207 @@
+#include "cell_list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "utils.h"
+#include "boundary.h"
+
+struct CellList_t {
+  int32_t num_ptcl;
+  int32_t num_cells;
+  int32_t dim[3];
+  dvec inv_cell_leng;
+
+  int32_t* head;
+  int32_t* next;
+  int32_t* prev;
+  int32_t* cell_of;
+};
+
+static int32_t getNumCellsAlong(const double box_leng,
+                                const double cutoff)
+{
+  if (box_leng <= 0.0) return 1;
+  const int32_t n = (int32_t)floor(box_leng / cutoff);
+  return (n < 1) ? 1 : n;
+}
+
+CellList* newCellList(const Boundary* bound,
+                      const double cutoff,
+                      const int32_t num_ptcl)
+{
+  if (getBoundaryType(bound) != PERIODIC) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "cell list requires the periodic boundary.\n");
+    exit(1);
+  }
+  if (!(cutoff > 0.0)) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "cutoff of cell list should be positive (%f).\n", cutoff);
+    exit(1);
+  }
+
+  CellList* self = (CellList*)xmalloc(sizeof(CellList));
+  const dvec box = getBoundaryBoxLength(bound);
+  self->dim[0] = getNumCellsAlong(box.x, cutoff);
+  self->dim[1] = getNumCellsAlong(box.y, cutoff);
+  self->dim[2] = (getBoundaryDim(bound) == 3) ? getNumCellsAlong(box.z, cutoff) : 1;
+  self->inv_cell_leng.x = self->dim[0] / box.x;
+  self->inv_cell_leng.y = self->dim[1] / box.y;
+  self->inv_cell_leng.z = (box.z > 0.0) ? self->dim[2] / box.z : 0.0;
+  self->num_cells = self->dim[0] * self->dim[1] * self->dim[2];
+  self->num_ptcl = num_ptcl;
+
+  self->head    = (int32_t*)xmalloc(self->num_cells * sizeof(int32_t));
+  self->next    = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  self->prev    = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  self->cell_of = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  return self;
+}
+
+void deleteCellList(CellList* self)
+{
+  xfree(self->head);
+  xfree(self->next);
+  xfree(self->prev);
+  xfree(self->cell_of);
+  xfree(self);
+}
+
+static inline int32_t getCellIndexAlong(const double x,
+                                        const double inv_leng,
+                                        const int32_t n)
+{
+  int32_t c = (int32_t)floor(x * inv_leng);
+  // NOTE: positions are wrapped into [0, L) (the initial configuration by
+  //       applyBoundaryCondForSystem), but x * inv_leng may round up to n.
+  if (c >= n) c -= n;
+  if (c < 0) c += n;
+  return c;
+}
+
+int32_t getCellIdOfPos(const CellList* self,
+                       const dvec* pos)
+{
+  const int32_t cx = getCellIndexAlong(pos->x, self->inv_cell_leng.x, self->dim[0]);
+  const int32_t cy = getCellIndexAlong(pos->y, self->inv_cell_leng.y, self->dim[1]);
+  const int32_t cz = getCellIndexAlong(pos->z, self->inv_cell_leng.z, self->dim[2]);
+  return (cz * self->dim[1] + cy) * self->dim[0] + cx;
+}
+
+static void insertIntoCell(CellList* self,
+                           const int32_t id,
+                           const int32_t cell)
+{
+  const int32_t old_head = self->head[cell];
+  self->next[id] = old_head;
+  self->prev[id] = CELL_NONE;
+  if (old_head != CELL_NONE) self->prev[old_head] = id;
+  self->head[cell] = id;
+  self->cell_of[id] = cell;
+}
+
+static void removeFromCell(CellList* self,
+                           const int32_t id)
+{
+  const int32_t cell = self->cell_of[id];
+  if (self->prev[id] != CELL_NONE) {
+    self->next[self->prev[id]] = self->next[id];
+  } else {
+    self->head[cell] = self->next[id];
+  }
+  if (self->next[id] != CELL_NONE) self->prev[self->next[id]] = self->prev[id];
+}
+
+void buildCellList(CellList* self,
+                   const PosStore* store)
+{
+  for (int32_t c = 0; c < self->num_cells; c++) self->head[c] = CELL_NONE;
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    const dvec r = getPosOfStore(store, i);
+    insertIntoCell(self, i, getCellIdOfPos(self, &r));
+  }
+}
+
+void moveInCellList(CellList* self,
+                    const int32_t id,
+                    const dvec* new_pos)
+{
+  const int32_t cell = getCellIdOfPos(self, new_pos);
+  if (cell == self->cell_of[id]) return;
+  removeFromCell(self, id);
+  insertIntoCell(self, id, cell);
+}
+
+// NOTE: along a direction with fewer than 3 cells, every cell is a neighbor
+//       and listed only once.
+static int32_t getNeighborIndicesAlong(const int32_t c,
+                                       const int32_t n,
+                                       int32_t* out)
+{
+  if (n < 3) {
+    for (int32_t k = 0; k < n; k++) out[k] = k;
+    return n;
+  }
+  out[0] = (c == 0) ? n - 1 : c - 1;
+  out[1] = c;
+  out[2] = (c == n - 1) ? 0 : c + 1;
+  return 3;
+}
+
+int32_t getNeighborCells(const CellList* self,
+                         const int32_t cell,
+                         int32_t* neighbors)
+{
+  const int32_t cx = cell % self->dim[0];
+  const int32_t cy = (cell / self->dim[0]) % self->dim[1];
+  const int32_t cz = cell / (self->dim[0] * self->dim[1]);
+
+  int32_t nx[3], ny[3], nz[3];
+  const int32_t num_x = getNeighborIndicesAlong(cx, self->dim[0], nx);
+  const int32_t num_y = getNeighborIndicesAlong(cy, self->dim[1], ny);
+  const int32_t num_z = getNeighborIndicesAlong(cz, self->dim[2], nz);
+
+  int32_t num = 0;
+  for (int32_t k = 0; k < num_z; k++) {
+    for (int32_t j = 0; j < num_y; j++) {
+      for (int32_t i = 0; i < num_x; i++) {
+        neighbors[num++] = (nz[k] * self->dim[1] + ny[j]) * self->dim[0] + nx[i];
+      }
+    }
+  }
+  return num;
+}
+
+int32_t getCellHead(const CellList* self,
+                    const int32_t cell)
+{
+  return self->head[cell];
+}
+
+int32_t getNextInCell(const CellList* self,
+                      const int32_t id)
+{
+  return self->next[id];
+}
+
+bool overlapsInCellList(const CellList* self,
+                        const PosStore* store,
+                        const int32_t id,
+                        const dvec* trial,
+                        const double min_dist,
+                        const Boundary* bound)
+{
+  const double min_dist2 = min_dist * min_dist;
+  int32_t neighbors[MAX_NEIGHBOR_CELLS];
+  const int32_t num_neighbors = getNeighborCells(self, getCellIdOfPos(self, trial), neighbors);
+  for (int32_t n = 0; n < num_neighbors; n++) {
+    for (int32_t j = self->head[neighbors[n]]; j != CELL_NONE; j = self->next[j]) {
+      if (j == id) continue;
+      const dvec r = getPosOfStore(store, j);
+      if (distance2(trial, &r, bound) < min_dist2) return true;
+    }
+  }
+  return false;
+}
@@ -10,6 +10,9 @@
 #include "math_utils.h"
 #include "parameter.h"
 #include "system.h"
+#include "topol.h"
+#include "boundary.h"
+#include "pos_store.h"
 
 static double uniform(void);
 
@@ -18,13 +21,15 @@ void createStraightChain(System* system,
 {
   const int32_t num_ptcl = getNumPtcl(param);
   const double len = getInitBondLen(param);
-  dvec* pos = getPos(system);
+  PosStore* store = getPosStore(system);
   dvec dr = { 0.0, 0.0, 0.0 };
   dr.x = len;
-  clear_dvec(&pos[0]);
-  pos[0].x += 0.5 * dr.x;
+  dvec r = { 0.0, 0.0, 0.0 };
+  r.x += 0.5 * dr.x;
+  setPosOfStore(store, 0, &r);
   for (int32_t i = 1; i < num_ptcl; i++) {
-    pos[i] = add_dvec_new(&pos[i - 1], &dr);
+    r = add_dvec_new(&r, &dr);
+    setPosOfStore(store, i, &r);
   }
 }
 
@@ -38,13 +43,46 @@ void createRandomChain(System* system,
 {
   const int32_t num_ptcl = getNumPtcl(param);
   const double len = getInitBondLen(param);
-  dvec* pos = getPos(system);
+  PosStore* store = getPosStore(system);
   dvec dr = { 0.0, 0.0, 0.0 };
-  clear_dvec(&pos[0]);
+  dvec r = { 0.0, 0.0, 0.0 };
+  setPosOfStore(store, 0, &r);
   for (int32_t i = 1; i < num_ptcl; i++) {
     dr.x = len * (2.0 * uniform() - 1.0);
     dr.y = len * (2.0 * uniform() - 1.0);
-    pos[i] = add_dvec_new(&pos[i - 1], &dr);
+    r = add_dvec_new(&r, &dr);
+    setPosOfStore(store, i, &r);
+  }
+}
+
+// NOTE: chains start at random points in the box and grow as random walks.
+void createMeltChains(System* system,
+                      const Parameter* param)
+{
+  const int32_t num_ptcl = getNumPtcl(param);
+  const int32_t num_chains = getNumChains(param);
+  const int32_t chain_len = num_ptcl / num_chains;
+  const double len = getInitBondLen(param);
+  const dvec box = getBoxlength(param);
+  const bool is_3d = (getDimension(param) == 3);
+  PosStore* store = getPosStore(system);
+  for (int32_t c = 0; c < num_chains; c++) {
+    dvec r = { 0.0, 0.0, 0.0 };
+    r.x = box.x * uniform();
+    r.y = box.y * uniform();
+    if (is_3d) r.z = box.z * uniform();
+    for (int32_t k = 0; k < chain_len; k++) {
+      if (k > 0) {
+        r.x += len * (2.0 * uniform() - 1.0);
+        r.y += len * (2.0 * uniform() - 1.0);
+        if (is_3d) r.z += len * (2.0 * uniform() - 1.0);
+      }
+      dvec r_in = r;
+      r_in.x -= box.x * floor(r_in.x / box.x);
+      r_in.y -= box.y * floor(r_in.y / box.y);
+      if (is_3d) r_in.z -= box.z * floor(r_in.z / box.z);
+      setPosOfStore(store, c * chain_len + k, &r_in);
+    }
   }
 }
 
@@ -59,7 +97,7 @@ void createFlatMesh(System* system,
     exit(1);
   }
 
-  dvec* pos = getPos(system);
+  PosStore* store = getPosStore(system);
   const double len = getInitBondLen(param);
   const int32_t side_dim = (int32_t)sqrt(num_ptcl);
 
@@ -70,7 +108,94 @@ void createFlatMesh(System* system,
     r.y = (y + 0.5) * len;
     for (int32_t x = 0; x < side_dim; x++) {
       r.x = (x + 0.5) * len;
-      pos[cnt++] = r;
+      setPosOfStore(store, cnt++, &r);
+    }
+  }
+}
+
+static dvec randomBondVector(const double len,
+                             const bool is_3d)
+{
+  dvec dr = { 0.0, 0.0, 0.0 };
+  double norm2 = 0.0;
+  do {
+    dr.x = 2.0 * uniform() - 1.0;
+    dr.y = 2.0 * uniform() - 1.0;
+    dr.z = is_3d ? 2.0 * uniform() - 1.0 : 0.0;
+    norm2 = dr.x * dr.x + dr.y * dr.y + dr.z * dr.z;
+  } while (norm2 > 1.0 || norm2 < 1.0e-4);
+  const double scale = len / sqrt(norm2);
+  dr.x *= scale;
+  dr.y *= scale;
+  dr.z *= scale;
+  return dr;
+}
+
+// NOTE: for topologies read from file. Each connected component starts at
+//       a random point and grows breadth first along its bonds, every
+//       particle being placed at init_blen in a random direction from the
+//       particle it is reached from. Bonds closing a cycle may therefore
+//       start stretched; init_config.bin can be supplied instead.
+void createTopolConfig(System* system,
+                       const Parameter* param)
+{
+  const int32_t num_ptcl = getNumPtcl(param);
+  const double len = getInitBondLen(param);
+  const bool is_3d = (getDimension(param) == 3);
+  const bool is_periodic = (getBoundaryTypeFromName(getBoundaryName(param)) == PERIODIC);
+  const dvec box = getBoxlength(param);
+  const ptclid2topol* id2top = getPtclId2Topol(system);
+  PosStore* store = getPosStore(system);
+
+  // NOTE: without a box, components start in a region of the size of a
+  //       fully stretched component of num_ptcl^(1/dim) particles per side.
+  dvec region = box;
+  if (!is_periodic) {
+    const double side = len * pow((double)num_ptcl, is_3d ? 1.0 / 3.0 : 0.5);
+    region.x = region.y = side;
+    region.z = is_3d ? side : 0.0;
+  }
+
+  bool* placed = (bool*)xmalloc(num_ptcl * sizeof(bool));
+  int32_t* queue = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  for (int32_t i = 0; i < num_ptcl; i++) placed[i] = false;
+
+  for (int32_t root = 0; root < num_ptcl; root++) {
+    if (placed[root]) continue;
+    dvec r = { 0.0, 0.0, 0.0 };
+    r.x = region.x * uniform();
+    r.y = region.y * uniform();
+    if (is_3d) r.z = region.z * uniform();
+    setPosOfStore(store, root, &r);
+    placed[root] = true;
+
+    int32_t head = 0, tail = 0;
+    queue[tail++] = root;
+    while (head < tail) {
+      const int32_t i = queue[head++];
+      for (int32_t b = 0; b < getNumPairsOfPtcl(id2top, i); b++) {
+        const pair* bond = getPairOfPtcl(id2top, i, b);
+        const int32_t j = (bond->i0 == i) ? bond->i1 : bond->i0;
+        if (placed[j]) continue;
+        const dvec dr = randomBondVector(len, is_3d);
+        const dvec ri = getPosOfStore(store, i);
+        const dvec rj = add_dvec_new(&ri, &dr);
+        setPosOfStore(store, j, &rj);
+        placed[j] = true;
+        queue[tail++] = j;
+      }
+    }
+  }
+
+  if (is_periodic) {
+    for (int32_t i = 0; i < num_ptcl; i++) {
+      dvec r = getPosOfStore(store, i);
+      r.x -= box.x * floor(r.x / box.x);
+      r.y -= box.y * floor(r.y / box.y);
+      if (is_3d) r.z -= box.z * floor(r.z / box.z);
+      setPosOfStore(store, i, &r);
     }
   }
+  xfree(placed);
+  xfree(queue);
 }
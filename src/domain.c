@@ -0,0 +1,1208 @@
+#include "domain.h"
+
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#include "utils.h"
+#include "file_utils.h"
+#include "mt_rand.h"
+#include "parameter.h"
+#include "system.h"
+#include "topol.h"
+#include "boundary.h"
+#include "evolver.h"
+#include "melt.h"
+#include "vector3.h"
+#include "pos_store.h"
+#include "potential.h"
+#include "arena.h"
+#include "observer.h"
+
+bool isRootRank(void)
+{
+#ifdef USE_MPI
+  int rank = 0;
+  MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+  return rank == 0;
+#else
+  return true;
+#endif
+}
+
+#ifdef USE_MPI
+
+// NOTE: side of a particle seen from this rank.
+//       Ghosts received from the left neighbor are frozen during phase 0,
+//       those from the right neighbor during phase 1.
+enum {
+  GHOST_FROM_LEFT = 0,
+  GHOST_FROM_RIGHT = 1,
+  OWNED_HERE = 2,
+};
+
+typedef struct PtclMsg_t {
+  int32_t id;
+  int32_t side;
+  int32_t image[3];
+  dvec pos;
+} PtclMsg;
+
+// NOTE: per chain of a melt, the sum of the unwrapped positions, the sum
+//       of their squares and the end-to-end vector.
+#define CHAIN_SUMS 7
+
+// NOTE: e_bond, e_angle, the virial, the squared distances to the
+//       center (Rg) and the positions of the first and last particles
+//       (end-to-end distance); see reduceMacroSumsOfDomain.
+#define SCALAR_SUMS 18
+
+// NOTE: particles (or bonds) per block of the configuration streamed from
+//       and to the root rank (see scatterInitialConfig and streamToRoot).
+#define IO_BLOCK_SIZE 65536
+
+// NOTE: a bond of an owned particle and its index in the topology, in
+//       whose order the bond lengths are written.
+typedef struct OwnedBond_t {
+  int32_t i0, i1;
+  int32_t index;
+} OwnedBond;
+
+// NOTE: the terms of a slot start with the numbers of its bonds and angles.
+#define TERMS_HEADER 2
+
+struct Domain_t {
+  int rank, num_ranks;
+  int32_t num_ptcl, dim;
+  int32_t id_lo, id_hi;
+  int32_t num_bonds;
+  double box_x, slab_width, ghost_width, shift;
+  double step_len;
+
+  // NOTE: the particles of this rank, in slots of a local store: the
+  //       owned ones in [0, num_owned) and the ghosts in
+  //       [num_owned, num_local). gid is the id of a slot in the System,
+  //       and image counts the box lengths by which an owned particle
+  //       has been wrapped, so that chains of a melt can be unwrapped.
+  Arena* arena;
+  PosStore* store;
+  int32_t capacity;
+  int32_t num_owned, num_local;
+  int32_t* gid;
+  uint8_t* side;
+  int32_t* image;
+  int32_t* active;
+
+  // NOTE: the bonds and angles of the owned particles, in gids, which
+  //       migrate with them: terms_len int32 per slot, i.e. TERMS_HEADER,
+  //       max_bonds bonds and max_angles angles (see getTermsOfSlot). The
+  //       terms of the ghosts are not set.
+  int32_t max_bonds, max_angles, terms_len;
+  int32_t* terms;
+
+  // NOTE: open addressing from gid to slot, rebuilt with the ghosts.
+  int32_t* hash_gid;
+  int32_t* hash_slot;
+  int32_t hash_mask;
+
+  // NOTE: the bonds and angles of the particles moved in a phase, in
+  //       slots. The rows of the other particles are empty.
+  ptclid2topol local_top;
+  pair* bonds;
+  triple* angles;
+  int32_t bond_cap, angle_cap;
+
+  int32_t num_q;
+  double *qx, *qy;
+  int32_t num_chains, chain_len;
+  int32_t num_sums;
+  double* sums;
+
+  PtclMsg* send_buf;
+  PtclMsg* recv_buf;
+  int32_t send_cap, recv_cap;
+  int32_t* send_terms;
+  int32_t* recv_terms;
+  int32_t send_terms_cap, recv_terms_cap;
+  int* send_counts;
+  int* recv_counts;
+  int* send_displs;
+  int* recv_displs;
+  MPI_Datatype msg_type;
+  MPI_Datatype terms_type;
+};
+
+static inline double wrapX(const Domain* self,
+                           double x)
+{
+  return x - self->box_x * floor(x / self->box_x);
+}
+
+static inline double getSlabLo(const Domain* self)
+{
+  return wrapX(self, self->shift + self->rank * self->slab_width);
+}
+
+static inline int getOwnerRank(const Domain* self,
+                               const double x)
+{
+  const int owner = (int)(wrapX(self, x - self->shift) / self->slab_width);
+  return (owner >= self->num_ranks) ? self->num_ranks - 1 : owner;
+}
+
+static void reserveMsgBuffer(PtclMsg** buf,
+                             int32_t* cap,
+                             const int32_t size)
+{
+  if (size <= *cap) return;
+  xfree(*buf);
+  *cap = 2 * size;
+  *buf = (PtclMsg*)xmalloc(*cap * sizeof(PtclMsg));
+}
+
+// NOTE: size is in messages of terms_len int32.
+static void reserveTermsBuffer(int32_t** buf,
+                               int32_t* cap,
+                               const int32_t size,
+                               const int32_t terms_len)
+{
+  if (size <= *cap) return;
+  xfree(*buf);
+  *cap = 2 * size;
+  *buf = (int32_t*)xmalloc((size_t)*cap * terms_len * sizeof(int32_t));
+}
+
+static inline int32_t* getTermsOfSlot(const Domain* self,
+                                      const int32_t slot)
+{
+  return &self->terms[(size_t)slot * self->terms_len];
+}
+
+static inline OwnedBond* getBondsOfTerms(int32_t* terms)
+{
+  return (OwnedBond*)&terms[TERMS_HEADER];
+}
+
+static inline triple* getAnglesOfTerms(const Domain* self,
+                                       int32_t* terms)
+{
+  return (triple*)&terms[TERMS_HEADER + 3 * self->max_bonds];
+}
+
+static void* growArray(void* array,
+                       const size_t used,
+                       const size_t size)
+{
+  void* grown = xmalloc(size);
+  if (used > 0) memcpy(grown, array, used);
+  xfree(array);
+  return grown;
+}
+
+static inline uint32_t hashGid(const Domain* self,
+                               const int32_t gid)
+{
+  return ((uint32_t)gid * 2654435761u) & (uint32_t)self->hash_mask;
+}
+
+static void insertSlot(Domain* self,
+                       const int32_t slot)
+{
+  uint32_t h = hashGid(self, self->gid[slot]);
+  while (self->hash_gid[h] >= 0) h = (h + 1) & (uint32_t)self->hash_mask;
+  self->hash_gid[h] = self->gid[slot];
+  self->hash_slot[h] = slot;
+}
+
+// NOTE: -1 if the particle is neither owned nor a ghost.
+static int32_t findSlot(const Domain* self,
+                        const int32_t gid)
+{
+  for (uint32_t h = hashGid(self, gid); self->hash_gid[h] >= 0; h = (h + 1) & (uint32_t)self->hash_mask) {
+    if (self->hash_gid[h] == gid) return self->hash_slot[h];
+  }
+  return -1;
+}
+
+static void rebuildHash(Domain* self)
+{
+  for (int32_t h = 0; h <= self->hash_mask; h++) self->hash_gid[h] = -1;
+  for (int32_t s = 0; s < self->num_local; s++) insertSlot(self, s);
+}
+
+// NOTE: the slots [0, num_local) are kept. The positions move to a new
+//       arena since an arena frees nothing before it is deleted.
+static void reserveLocal(Domain* self,
+                         const int32_t size)
+{
+  if (size <= self->capacity) return;
+  const int32_t cap = 2 * size;
+  const int32_t used = self->num_local;
+
+  Arena* arena = newArena(false);
+  PosStore* store = newPosStore(cap, self->dim, arena);
+  for (int32_t s = 0; s < used; s++) {
+    const dvec pos = getPosOfStore(self->store, s);
+    setPosOfStore(store, s, &pos);
+  }
+  if (self->arena) deleteArena(self->arena);
+  self->arena = arena;
+  self->store = store;
+
+  self->gid    = (int32_t*)growArray(self->gid, used * sizeof(int32_t), cap * sizeof(int32_t));
+  self->side   = (uint8_t*)growArray(self->side, used * sizeof(uint8_t), cap * sizeof(uint8_t));
+  self->image  = (int32_t*)growArray(self->image, 3 * used * sizeof(int32_t), 3 * cap * sizeof(int32_t));
+  self->terms  = (int32_t*)growArray(self->terms, (size_t)used * self->terms_len * sizeof(int32_t),
+                                     (size_t)cap * self->terms_len * sizeof(int32_t));
+  self->active = (int32_t*)growArray(self->active, 0, cap * sizeof(int32_t));
+  self->local_top.rows = (Id2TopolRow*)growArray(self->local_top.rows, 0, (cap + 1) * sizeof(Id2TopolRow));
+  self->local_top.num_ptcl = cap;
+  self->capacity = cap;
+
+  int32_t hash_size = 1;
+  while (hash_size < 2 * cap) hash_size *= 2;
+  xfree(self->hash_gid);
+  xfree(self->hash_slot);
+  self->hash_gid  = (int32_t*)xmalloc(hash_size * sizeof(int32_t));
+  self->hash_slot = (int32_t*)xmalloc(hash_size * sizeof(int32_t));
+  self->hash_mask = hash_size - 1;
+  rebuildHash(self);
+}
+
+// NOTE: pair_ids and triple_ids are the identity, since the terms of a
+//       phase are listed row by row.
+static void reserveLocalTerms(Domain* self,
+                              const int32_t num_bonds,
+                              const int32_t num_angles)
+{
+  if (num_bonds > self->bond_cap) {
+    const int32_t cap = 2 * num_bonds;
+    self->bonds = (pair*)growArray(self->bonds, self->bond_cap * sizeof(pair), cap * sizeof(pair));
+    self->local_top.pair_ids = (int32_t*)growArray(self->local_top.pair_ids, 0, cap * sizeof(int32_t));
+    for (int32_t k = 0; k < cap; k++) self->local_top.pair_ids[k] = k;
+    self->local_top.bond_top = self->bonds;
+    self->bond_cap = cap;
+  }
+  if (num_angles > self->angle_cap) {
+    const int32_t cap = 2 * num_angles;
+    self->angles = (triple*)growArray(self->angles, self->angle_cap * sizeof(triple), cap * sizeof(triple));
+    self->local_top.triple_ids = (int32_t*)growArray(self->local_top.triple_ids, 0, cap * sizeof(int32_t));
+    for (int32_t k = 0; k < cap; k++) self->local_top.triple_ids[k] = k;
+    self->local_top.angle_top = self->angles;
+    self->angle_cap = cap;
+  }
+}
+
+static void clearSendCounts(Domain* self)
+{
+  for (int r = 0; r < self->num_ranks; r++) self->send_counts[r] = 0;
+}
+
+// NOTE: send_counts must be filled. Messages are packed into send_buf
+//       by destination using the displacements set up here; the terms of
+//       a message, if any, go to the same index of send_terms.
+static void setSendDispls(Domain* self,
+                          const bool with_terms)
+{
+  int32_t total = 0;
+  for (int r = 0; r < self->num_ranks; r++) {
+    self->send_displs[r] = total;
+    total += self->send_counts[r];
+  }
+  reserveMsgBuffer(&self->send_buf, &self->send_cap, total);
+  if (with_terms) reserveTermsBuffer(&self->send_terms, &self->send_terms_cap, total, self->terms_len);
+}
+
+static int32_t exchangeMessages(Domain* self)
+{
+  MPI_Alltoall(self->send_counts, 1, MPI_INT,
+               self->recv_counts, 1, MPI_INT, MPI_COMM_WORLD);
+  int32_t num_recv = 0;
+  for (int r = 0; r < self->num_ranks; r++) {
+    self->recv_displs[r] = num_recv;
+    num_recv += self->recv_counts[r];
+  }
+  reserveMsgBuffer(&self->recv_buf, &self->recv_cap, num_recv);
+  MPI_Alltoallv(self->send_buf, self->send_counts, self->send_displs, self->msg_type,
+                self->recv_buf, self->recv_counts, self->recv_displs, self->msg_type,
+                MPI_COMM_WORLD);
+  return num_recv;
+}
+
+// NOTE: the terms of the messages of the last exchangeMessages.
+static void exchangeTerms(Domain* self,
+                          const int32_t num_recv)
+{
+  reserveTermsBuffer(&self->recv_terms, &self->recv_terms_cap, num_recv, self->terms_len);
+  MPI_Alltoallv(self->send_terms, self->send_counts, self->send_displs, self->terms_type,
+                self->recv_terms, self->recv_counts, self->recv_displs, self->terms_type,
+                MPI_COMM_WORLD);
+}
+
+static void packMsg(const Domain* self,
+                    PtclMsg* msg,
+                    const int32_t slot,
+                    const int32_t side)
+{
+  msg->id = self->gid[slot];
+  msg->side = side;
+  for (int32_t a = 0; a < 3; a++) msg->image[a] = self->image[3 * slot + a];
+  msg->pos = getPosOfStore(self->store, slot);
+}
+
+// NOTE: the received particles and their terms become owned here.
+static void appendOwned(Domain* self,
+                        const int32_t num_recv)
+{
+  reserveLocal(self, self->num_owned + num_recv);
+  for (int32_t k = 0; k < num_recv; k++) {
+    const PtclMsg* msg = &self->recv_buf[k];
+    const int32_t slot = self->num_owned++;
+    setPosOfStore(self->store, slot, &msg->pos);
+    self->gid[slot] = msg->id;
+    self->side[slot] = OWNED_HERE;
+    for (int32_t a = 0; a < 3; a++) self->image[3 * slot + a] = msg->image[a];
+    memcpy(getTermsOfSlot(self, slot), &self->recv_terms[(size_t)k * self->terms_len],
+           self->terms_len * sizeof(int32_t));
+  }
+  self->num_local = self->num_owned;
+}
+
+// NOTE: the wraps of the initial configuration are those of the chains
+//       unfolded along their bonds (see unwrapChain); NULL unless melt.
+static int32_t* newInitialImages(const Domain* self,
+                                 const System* system,
+                                 const Boundary* bound)
+{
+  const Melt* melt = getMelt(system);
+  if (!melt) return NULL;
+
+  int32_t* image = (int32_t*)xmalloc(3 * (size_t)self->num_ptcl * sizeof(int32_t));
+  const PosStore* store = getPosStore(system);
+  dvec* chain_buf = (dvec*)xmalloc(self->chain_len * sizeof(dvec));
+  for (int32_t c = 0; c < self->num_chains; c++) {
+    unwrapChain(melt, c, store, bound, chain_buf);
+    const int32_t* seq = getChainSeq(melt, c);
+    for (int32_t k = 0; k < self->chain_len; k++) {
+      const dvec pos = getPosOfStore(store, seq[k]);
+      int32_t* im = &image[3 * seq[k]];
+      im[0] = (int32_t)nearbyint((chain_buf[k].x - pos.x) * bound->inv_box_leng.x);
+      im[1] = (int32_t)nearbyint((chain_buf[k].y - pos.y) * bound->inv_box_leng.y);
+      im[2] = (self->dim == 3) ? (int32_t)nearbyint((chain_buf[k].z - pos.z) * bound->inv_box_leng.z) : 0;
+    }
+  }
+  xfree(chain_buf);
+  return image;
+}
+
+static void setTermsOfPtcl(const Domain* self,
+                           int32_t* terms,
+                           const topol* top,
+                           const ptclid2topol* id2top,
+                           const int32_t id)
+{
+  const pair* bond_top = getBondTopol(top);
+  terms[0] = getNumPairsOfPtcl(id2top, id);
+  terms[1] = getNumTriplesOfPtcl(id2top, id);
+  OwnedBond* bonds = getBondsOfTerms(terms);
+  for (int32_t b = 0; b < terms[0]; b++) {
+    const pair* bond = getPairOfPtcl(id2top, id, b);
+    bonds[b] = (OwnedBond){.i0 = bond->i0, .i1 = bond->i1, .index = (int32_t)(bond - bond_top)};
+  }
+  triple* angles = getAnglesOfTerms(self, terms);
+  for (int32_t a = 0; a < terms[1]; a++) angles[a] = *getTripleOfPtcl(id2top, id, a);
+}
+
+// NOTE: only the root rank holds the initial configuration and the
+//       topology (see initializeSystem). It sends each particle with its
+//       wraps and its bonds and angles to the owner, in blocks of
+//       IO_BLOCK_SIZE particles, so that no other rank holds more than
+//       the particles of its slab.
+static void scatterInitialConfig(Domain* self,
+                                 const System* system,
+                                 const Boundary* bound)
+{
+  const PosStore* store = NULL;
+  const topol* top = NULL;
+  const ptclid2topol* id2top = NULL;
+  int32_t* image = NULL;
+  int32_t sizes[3] = {0, 0, 0}; // max. bonds and angles per particle, bonds
+  if (self->rank == 0) {
+    store = getPosStore(system);
+    top = getTopol(system);
+    id2top = getPtclId2Topol(system);
+    image = newInitialImages(self, system, bound);
+    for (int32_t i = 0; i < self->num_ptcl; i++) {
+      if (getNumPairsOfPtcl(id2top, i) > sizes[0]) sizes[0] = getNumPairsOfPtcl(id2top, i);
+      if (getNumTriplesOfPtcl(id2top, i) > sizes[1]) sizes[1] = getNumTriplesOfPtcl(id2top, i);
+    }
+    sizes[2] = getNumBonds(top);
+  }
+  MPI_Bcast(sizes, 3, MPI_INT32_T, 0, MPI_COMM_WORLD);
+  self->max_bonds = sizes[0];
+  self->max_angles = sizes[1];
+  self->num_bonds = sizes[2];
+  self->terms_len = TERMS_HEADER + 3 * (self->max_bonds + self->max_angles);
+  MPI_Type_contiguous(self->terms_len, MPI_INT32_T, &self->terms_type);
+  MPI_Type_commit(&self->terms_type);
+  reserveLocal(self, 1);
+
+  for (int32_t lo = 0; lo < self->num_ptcl; lo += IO_BLOCK_SIZE) {
+    const int32_t hi = (lo + IO_BLOCK_SIZE < self->num_ptcl) ? lo + IO_BLOCK_SIZE : self->num_ptcl;
+    if (self->rank == 0) {
+      clearSendCounts(self);
+      for (int32_t i = lo; i < hi; i++) self->send_counts[getOwnerRank(self, store->x[i])]++;
+      setSendDispls(self, true);
+      clearSendCounts(self);
+      for (int32_t i = lo; i < hi; i++) {
+        const int owner = getOwnerRank(self, store->x[i]);
+        const int32_t k = self->send_displs[owner] + self->send_counts[owner]++;
+        PtclMsg* msg = &self->send_buf[k];
+        msg->id = i;
+        msg->side = OWNED_HERE;
+        for (int32_t a = 0; a < 3; a++) msg->image[a] = image ? image[3 * i + a] : 0;
+        msg->pos = getPosOfStore(store, i);
+        setTermsOfPtcl(self, &self->send_terms[(size_t)k * self->terms_len], top, id2top, i);
+      }
+    }
+    int num_recv = 0;
+    MPI_Scatter(self->send_counts, 1, MPI_INT, &num_recv, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    reserveMsgBuffer(&self->recv_buf, &self->recv_cap, num_recv);
+    reserveTermsBuffer(&self->recv_terms, &self->recv_terms_cap, num_recv, self->terms_len);
+    MPI_Scatterv(self->send_buf, self->send_counts, self->send_displs, self->msg_type,
+                 self->recv_buf, num_recv, self->msg_type, 0, MPI_COMM_WORLD);
+    MPI_Scatterv(self->send_terms, self->send_counts, self->send_displs, self->terms_type,
+                 self->recv_terms, num_recv, self->terms_type, 0, MPI_COMM_WORLD);
+    appendOwned(self, num_recv);
+  }
+  rebuildHash(self);
+  if (image) xfree(image);
+}
+
+Domain* newDomain(const System* system,
+                  const Boundary* bound,
+                  const Parameter* param)
+{
+  if (getBoundaryType(bound) != PERIODIC) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "%s cannot be specified for domain decomposition.\n",
+            getBoundaryNameFromType(getBoundaryType(bound)));
+    exit(1);
+  }
+  const bool is_melt = getNumChains(param) > 1;
+  if (is_melt && getDoubleBridgeProb(param) > 0.0) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "double-bridging moves are not supported with domain decomposition.\n");
+    exit(1);
+  }
+
+  Domain* self = (Domain*)xmalloc(sizeof(Domain));
+  MPI_Comm_rank(MPI_COMM_WORLD, &self->rank);
+  MPI_Comm_size(MPI_COMM_WORLD, &self->num_ranks);
+  MPI_Type_contiguous((int)sizeof(PtclMsg), MPI_BYTE, &self->msg_type);
+  MPI_Type_commit(&self->msg_type);
+
+  self->num_ptcl = getNumPtcl(param);
+  self->dim = getDimension(param);
+  self->id_lo = 0;
+  self->id_hi = self->num_ptcl - 1;
+  if (!is_melt && !getTopologyFile(param)) {
+    // same as evolveMc: chain ends are not moved under the periodic boundary
+    self->id_lo++;
+    self->id_hi--;
+  }
+  self->step_len = getStepLen(param);
+  self->box_x    = getBoxlength(param).x;
+  self->slab_width = self->box_x / self->num_ranks;
+  self->ghost_width = isnan(getGhostWidth(param)) ? 4.0 * getBondLen(param) : getGhostWidth(param);
+  self->shift = 0.0;
+  if (self->ghost_width > 0.5 * self->slab_width) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "ghost_width (%f) should not exceed half of the slab width (%f).\n",
+            self->ghost_width, self->slab_width);
+    fprintf(stderr, "At most box_length.x / (2 ghost_width) = %d ranks can be used.\n",
+            (int32_t)floor(self->box_x / (2.0 * self->ghost_width)));
+    exit(1);
+  }
+
+  self->arena = NULL;
+  self->store = NULL;
+  self->capacity = self->num_owned = self->num_local = 0;
+  self->gid = self->image = self->active = NULL;
+  self->side = NULL;
+  self->hash_gid = self->hash_slot = NULL;
+  self->local_top.num_ptcl = 0;
+  self->local_top.rows = NULL;
+  self->local_top.pair_ids = self->local_top.triple_ids = NULL;
+  self->local_top.bond_top = NULL;
+  self->local_top.angle_top = NULL;
+  self->bonds = NULL;
+  self->angles = NULL;
+  self->bond_cap = self->angle_cap = 0;
+  self->terms = NULL;
+  self->num_chains = is_melt ? getNumChains(param) : 0;
+  self->chain_len = is_melt ? self->num_ptcl / self->num_chains : 0;
+
+  self->send_buf = self->recv_buf = NULL;
+  self->send_cap = self->recv_cap = 0;
+  self->send_terms = self->recv_terms = NULL;
+  self->send_terms_cap = self->recv_terms_cap = 0;
+  self->send_counts = (int*)xmalloc(self->num_ranks * sizeof(int));
+  self->recv_counts = (int*)xmalloc(self->num_ranks * sizeof(int));
+  self->send_displs = (int*)xmalloc(self->num_ranks * sizeof(int));
+  self->recv_displs = (int*)xmalloc(self->num_ranks * sizeof(int));
+
+  scatterInitialConfig(self, system, bound);
+
+  self->num_q = getNumSpectrumQvectors(param);
+  self->qx = (double*)xmalloc(self->num_q * sizeof(double));
+  self->qy = (double*)xmalloc(self->num_q * sizeof(double));
+  setSpectrumQvectors(param, self->qx, self->qy);
+  self->num_sums = SCALAR_SUMS + CHAIN_SUMS * self->num_chains + 2 * self->num_q;
+  self->sums = (double*)xmalloc(self->num_sums * sizeof(double));
+
+  return self;
+}
+
+void deleteDomain(Domain* self)
+{
+  MPI_Type_free(&self->msg_type);
+  MPI_Type_free(&self->terms_type);
+  deleteArena(self->arena);
+  xfree(self->gid);
+  xfree(self->terms);
+  xfree(self->side);
+  xfree(self->image);
+  xfree(self->active);
+  xfree(self->hash_gid);
+  xfree(self->hash_slot);
+  xfree(self->local_top.rows);
+  xfree(self->local_top.pair_ids);
+  xfree(self->local_top.triple_ids);
+  xfree(self->bonds);
+  xfree(self->angles);
+  xfree(self->qx);
+  xfree(self->qy);
+  xfree(self->sums);
+  xfree(self->send_buf);
+  xfree(self->recv_buf);
+  xfree(self->send_terms);
+  xfree(self->recv_terms);
+  xfree(self->send_counts);
+  xfree(self->recv_counts);
+  xfree(self->send_displs);
+  xfree(self->recv_displs);
+  xfree(self);
+}
+
+int32_t getRankOfDomain(const Domain* self)
+{
+  return self->rank;
+}
+
+int32_t getNumRanksOfDomain(const Domain* self)
+{
+  return self->num_ranks;
+}
+
+// NOTE: slab boundaries move by a random fraction of the slab width.
+//       Particles which are no longer in the slab of this rank migrate
+//       to their new owner together with their positions and terms. The
+//       ghosts are dropped until the next exchange.
+void shiftDomain(Domain* self,
+                 MTstate* mtst_shared)
+{
+  self->shift = wrapX(self, self->shift + self->slab_width * genrand_res53(mtst_shared));
+  self->num_local = self->num_owned;
+  if (self->num_ranks == 1) return;
+
+  clearSendCounts(self);
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    const int owner = getOwnerRank(self, self->store->x[s]);
+    if (owner != self->rank) self->send_counts[owner]++;
+  }
+  setSendDispls(self, true);
+
+  int32_t num_stay = 0;
+  clearSendCounts(self);
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    const int owner = getOwnerRank(self, self->store->x[s]);
+    if (owner == self->rank) {
+      const dvec pos = getPosOfStore(self->store, s);
+      setPosOfStore(self->store, num_stay, &pos);
+      self->gid[num_stay] = self->gid[s];
+      for (int32_t a = 0; a < 3; a++) self->image[3 * num_stay + a] = self->image[3 * s + a];
+      memmove(getTermsOfSlot(self, num_stay), getTermsOfSlot(self, s), self->terms_len * sizeof(int32_t));
+      num_stay++;
+    } else {
+      const int32_t k = self->send_displs[owner] + self->send_counts[owner]++;
+      packMsg(self, &self->send_buf[k], s, OWNED_HERE);
+      memcpy(&self->send_terms[(size_t)k * self->terms_len], getTermsOfSlot(self, s),
+             self->terms_len * sizeof(int32_t));
+    }
+  }
+  self->num_owned = self->num_local = num_stay;
+  for (int32_t s = 0; s < self->num_owned; s++) self->side[s] = OWNED_HERE;
+
+  const int32_t num_recv = exchangeMessages(self);
+  exchangeTerms(self, num_recv);
+  appendOwned(self, num_recv);
+}
+
+// NOTE: owned particles within ghost_width of the slab edges are sent to
+//       the neighboring ranks, and the ghosts of the last exchange are
+//       replaced with those received.
+static void exchangeGhosts(Domain* self)
+{
+  self->num_local = self->num_owned;
+  if (self->num_ranks == 1) {
+    rebuildHash(self);
+    return;
+  }
+
+  const int left  = (self->rank - 1 + self->num_ranks) % self->num_ranks;
+  const int right = (self->rank + 1) % self->num_ranks;
+  const double slab_lo = getSlabLo(self);
+  const double g = self->ghost_width, w = self->slab_width;
+
+  clearSendCounts(self);
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    const double u = wrapX(self, self->store->x[s] - slab_lo);
+    if (u < g) self->send_counts[left]++;
+    if (u >= w - g) self->send_counts[right]++;
+  }
+  setSendDispls(self, false);
+
+  clearSendCounts(self);
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    const double u = wrapX(self, self->store->x[s] - slab_lo);
+    if (u < g) {
+      packMsg(self, &self->send_buf[self->send_displs[left] + self->send_counts[left]++], s, GHOST_FROM_RIGHT);
+    }
+    if (u >= w - g) {
+      packMsg(self, &self->send_buf[self->send_displs[right] + self->send_counts[right]++], s, GHOST_FROM_LEFT);
+    }
+  }
+
+  const int32_t num_recv = exchangeMessages(self);
+  reserveLocal(self, self->num_owned + num_recv);
+  rebuildHash(self);
+  // NOTE: with two ranks a particle may arrive from both sides; the last
+  //       message decides its side.
+  for (int32_t k = 0; k < num_recv; k++) {
+    const PtclMsg* msg = &self->recv_buf[k];
+    int32_t slot = findSlot(self, msg->id);
+    if (slot < 0) {
+      slot = self->num_local++;
+      self->gid[slot] = msg->id;
+      insertSlot(self, slot);
+    }
+    setPosOfStore(self->store, slot, &msg->pos);
+    self->side[slot] = (uint8_t)msg->side;
+  }
+}
+
+// NOTE: a particle is moved only if all particles sharing a bond or an
+//       angle with it are here and not moved by another rank. Its terms
+//       are then appended to the local topology in slots.
+static bool appendLocalTerms(Domain* self,
+                             const int32_t slot,
+                             const int32_t phase,
+                             int32_t* num_bonds,
+                             int32_t* num_angles)
+{
+  int32_t* terms = getTermsOfSlot(self, slot);
+  const int32_t nb = terms[0];
+  const int32_t na = terms[1];
+  reserveLocalTerms(self, *num_bonds + nb, *num_angles + na);
+
+  int32_t members[3];
+  const OwnedBond* bonds = getBondsOfTerms(terms);
+  for (int32_t b = 0; b < nb; b++) {
+    const OwnedBond* bond = &bonds[b];
+    members[0] = findSlot(self, bond->i0);
+    members[1] = findSlot(self, bond->i1);
+    for (int32_t m = 0; m < 2; m++) {
+      if (members[m] < 0) return false;
+      if (self->side[members[m]] != OWNED_HERE && self->side[members[m]] != phase) return false;
+    }
+    self->bonds[*num_bonds + b] = (pair){.i0 = members[0], .i1 = members[1]};
+  }
+  const triple* angles = getAnglesOfTerms(self, terms);
+  for (int32_t a = 0; a < na; a++) {
+    const triple* angle = &angles[a];
+    members[0] = findSlot(self, angle->i0);
+    members[1] = findSlot(self, angle->i1);
+    members[2] = findSlot(self, angle->i2);
+    for (int32_t m = 0; m < 3; m++) {
+      if (members[m] < 0) return false;
+      if (self->side[members[m]] != OWNED_HERE && self->side[members[m]] != phase) return false;
+    }
+    self->angles[*num_angles + a] = (triple){.i0 = members[0], .i1 = members[1], .i2 = members[2]};
+  }
+
+  self->local_top.rows[slot] = (Id2TopolRow){.pair_begin = *num_bonds, .num_pair = nb,
+                                             .triple_begin = *num_angles, .num_triple = na};
+  *num_bonds += nb;
+  *num_angles += na;
+  return true;
+}
+
+static inline int32_t countWraps(const double d,
+                                 const double leng)
+{
+  return (d > 0.5 * leng) ? -1 : ((d < -0.5 * leng) ? 1 : 0);
+}
+
+// NOTE: a move is shorter than half the box, so a longer displacement
+//       means that the particle was wrapped.
+static void updateImage(Domain* self,
+                        const int32_t slot,
+                        const dvec* pos_old,
+                        const Boundary* bound)
+{
+  const dvec pos_new = getPosOfStore(self->store, slot);
+  int32_t* image = &self->image[3 * slot];
+  image[0] += countWraps(pos_new.x - pos_old->x, bound->box_leng.x);
+  image[1] += countWraps(pos_new.y - pos_old->y, bound->box_leng.y);
+  if (self->dim == 3) image[2] += countWraps(pos_new.z - pos_old->z, bound->box_leng.z);
+}
+
+double evolveMcDomain(Domain* self,
+                      const System* system,
+                      const Boundary* bound,
+                      MTstate* mtst)
+{
+  const BondedParam* bp = getBondedParam(system);
+  const double half_width = 0.5 * self->slab_width;
+
+  int64_t counts[2] = {0, 0}; // accepted, trials
+  for (int32_t phase = 0; phase < 2; phase++) {
+    exchangeGhosts(self);
+
+    const double half_lo = wrapX(self, getSlabLo(self) + phase * half_width);
+    int32_t num_active = 0;
+    for (int32_t s = 0; s < self->num_owned; s++) {
+      const int32_t id = self->gid[s];
+      if (id < self->id_lo || id > self->id_hi) continue;
+      if (wrapX(self, self->store->x[s] - half_lo) < half_width) self->active[num_active++] = s;
+    }
+
+    int32_t num_bonds = 0, num_angles = 0;
+    memset(self->local_top.rows, 0, (self->num_local + 1) * sizeof(Id2TopolRow));
+    for (int32_t p = 0; p < num_active; p++) {
+      const int32_t slot = self->active[p];
+      // NOTE: -1 marks a particle whose terms are not all available
+      if (!appendLocalTerms(self, slot, phase, &num_bonds, &num_angles)) {
+        self->local_top.rows[slot].num_pair = -1;
+      }
+    }
+
+    for (int32_t p = 0; p < num_active; p++) {
+      const int32_t slot = self->active[genrand_int31_range(mtst, 0, num_active - 1)];
+      counts[1]++;
+      if (self->local_top.rows[slot].num_pair < 0) continue;
+      const dvec pos_old = getPosOfStore(self->store, slot);
+      if (mcStepInSlab(self->store, mtst, &self->local_top, bound,
+                       self->step_len, bp,
+                       slot, half_lo, half_width, self->box_x)) {
+        counts[0]++;
+        updateImage(self, slot, &pos_old, bound);
+      }
+    }
+  }
+
+  MPI_Allreduce(MPI_IN_PLACE, counts, 2, MPI_INT64_T, MPI_SUM, MPI_COMM_WORLD);
+  return (counts[1] > 0) ? (double)counts[0] / (double)counts[1] : 0.0;
+}
+
+static void requireSlot(Domain* self,
+                        const int32_t id)
+{
+  if (findSlot(self, id) >= 0) return;
+  reserveLocal(self, self->num_local + 1);
+  const int32_t slot = self->num_local++;
+  self->gid[slot] = id;
+  self->side[slot] = OWNED_HERE;
+  insertSlot(self, slot);
+}
+
+// NOTE: a stretched bond may reach beyond the ghosts of a slab edge. The
+//       particles missing from the terms summed by this rank are requested
+//       from all ranks and sent back by their owners.
+//       requireSlot may move the terms, so they are copied first.
+static void fetchTermPtcls(Domain* self)
+{
+  const int32_t num_known = self->num_local;
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    const int32_t id = self->gid[s];
+    const int32_t nb = getTermsOfSlot(self, s)[0];
+    for (int32_t b = 0; b < nb; b++) {
+      const OwnedBond bond = getBondsOfTerms(getTermsOfSlot(self, s))[b];
+      if (bond.i0 == id) requireSlot(self, bond.i1);
+    }
+    const int32_t na = getTermsOfSlot(self, s)[1];
+    for (int32_t a = 0; a < na; a++) {
+      const triple angle = getAnglesOfTerms(self, getTermsOfSlot(self, s))[a];
+      if (angle.i1 != id) continue;
+      requireSlot(self, angle.i0);
+      requireSlot(self, angle.i2);
+    }
+  }
+
+  int num_missing = self->num_local - num_known;
+  MPI_Allgather(&num_missing, 1, MPI_INT, self->recv_counts, 1, MPI_INT, MPI_COMM_WORLD);
+  int32_t num_requests = 0;
+  for (int r = 0; r < self->num_ranks; r++) {
+    self->recv_displs[r] = num_requests;
+    num_requests += self->recv_counts[r];
+  }
+  if (num_requests == 0) return;
+  int32_t* requests = (int32_t*)xmalloc(num_requests * sizeof(int32_t));
+  MPI_Allgatherv(&self->gid[num_known], num_missing, MPI_INT32_T,
+                 requests, self->recv_counts, self->recv_displs, MPI_INT32_T, MPI_COMM_WORLD);
+
+  for (int32_t pass = 0; pass < 2; pass++) {
+    clearSendCounts(self);
+    for (int r = 0; r < self->num_ranks; r++) {
+      for (int32_t k = 0; k < self->recv_counts[r]; k++) {
+        const int32_t slot = findSlot(self, requests[self->recv_displs[r] + k]);
+        if (slot < 0 || slot >= self->num_owned) continue;
+        if (pass == 0) {
+          self->send_counts[r]++;
+        } else {
+          packMsg(self, &self->send_buf[self->send_displs[r] + self->send_counts[r]++], slot, OWNED_HERE);
+        }
+      }
+    }
+    if (pass == 0) setSendDispls(self, false);
+  }
+  xfree(requests);
+
+  const int32_t num_recv = exchangeMessages(self);
+  for (int32_t k = 0; k < num_recv; k++) {
+    const PtclMsg* msg = &self->recv_buf[k];
+    setPosOfStore(self->store, findSlot(self, msg->id), &msg->pos);
+  }
+}
+
+// NOTE: a bond is summed by the owner of its first particle, and an angle
+//       by the owner of its center.
+static void sumOwnedBondedTerms(const Domain* self,
+                                const System* system,
+                                const Boundary* bound,
+                                double* sums)
+{
+  const BondedParam* bp = getBondedParam(system);
+  dtensor3 virial;
+  dtensor3_clear(&virial);
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    const int32_t id = self->gid[s];
+    const dvec pos = getPosOfStore(self->store, s);
+    int32_t* terms = getTermsOfSlot(self, s);
+    const OwnedBond* bonds = getBondsOfTerms(terms);
+    for (int32_t b = 0; b < terms[0]; b++) {
+      const OwnedBond* bond = &bonds[b];
+      if (bond->i0 != id) continue;
+      const dvec pos1 = getPosOfStore(self->store, findSlot(self, bond->i1));
+      sums[0] += calcBondTermEnergyOf(&pos, &pos1, bp, bound, bound->type, self->dim);
+      const dtensor3 vir = calcBondTermVirialOf(&pos, &pos1, bp, bound, bound->type, self->dim);
+      dtensor3_add(&virial, &vir);
+    }
+    const triple* angles = getAnglesOfTerms(self, terms);
+    for (int32_t a = 0; a < terms[1]; a++) {
+      const triple* angle = &angles[a];
+      if (angle->i1 != id) continue;
+      const dvec pos0 = getPosOfStore(self->store, findSlot(self, angle->i0));
+      const dvec pos2 = getPosOfStore(self->store, findSlot(self, angle->i2));
+      sums[1] += calcAngleTermEnergyOf(&pos0, &pos, &pos2, bp, bound, bound->type, self->dim);
+      const dtensor3 vir = calcAngleTermVirialOf(&pos0, &pos, &pos2, bp, bound, bound->type, self->dim);
+      dtensor3_add(&virial, &vir);
+    }
+  }
+  memcpy(&sums[2], &virial, sizeof(dtensor3));
+}
+
+// NOTE: the same as calcRgOfStore; the center is the mean of the wrapped
+//       positions over all ranks, and the distances to it use the minimum
+//       image.
+static void sumOwnedRg2(const Domain* self,
+                        const Boundary* bound,
+                        double* rg2)
+{
+  double center[3] = {0.0, 0.0, 0.0};
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    const dvec pos = getPosOfStore(self->store, s);
+    center[0] += pos.x;
+    center[1] += pos.y;
+    center[2] += pos.z;
+  }
+  MPI_Allreduce(MPI_IN_PLACE, center, 3, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+  for (int32_t a = 0; a < 3; a++) center[a] /= self->num_ptcl;
+
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    const dvec pos = getPosOfStore(self->store, s);
+    const double d[3] = {pos.x - center[0], pos.y - center[1], pos.z - center[2]};
+    const double leng[3] = {bound->box_leng.x, bound->box_leng.y, bound->box_leng.z};
+    const double inv_leng[3] = {bound->inv_box_leng.x, bound->inv_box_leng.y, bound->inv_box_leng.z};
+    for (int32_t a = 0; a < self->dim; a++) {
+      const double da = d[a] - leng[a] * nearbyint(d[a] * inv_leng[a]);
+      *rg2 += da * da;
+    }
+  }
+}
+
+// NOTE: the unwrapped positions of the owned particles of each chain.
+//       Without double-bridging moves, particle id is the monomer
+//       id % chain_len of chain id / chain_len (see newMelt).
+static void sumOwnedChains(const Domain* self,
+                           const Boundary* bound,
+                           double* chain_sums)
+{
+  const int32_t chain_len = self->chain_len;
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    const int32_t id = self->gid[s];
+    const dvec pos = getPosOfStore(self->store, s);
+    const int32_t* image = &self->image[3 * s];
+    const double u[3] = {pos.x + image[0] * bound->box_leng.x,
+                         pos.y + image[1] * bound->box_leng.y,
+                         pos.z + image[2] * bound->box_leng.z};
+    double* sums = &chain_sums[CHAIN_SUMS * (id / chain_len)];
+    const int32_t k = id % chain_len;
+    const double end_sign = (k == chain_len - 1) ? 1.0 : ((k == 0) ? -1.0 : 0.0);
+    for (int32_t a = 0; a < 3; a++) {
+      sums[a] += u[a];
+      sums[3] += u[a] * u[a];
+      sums[4 + a] += end_sign * u[a];
+    }
+  }
+}
+
+// NOTE: the terms of calcHeightDftOfStore of the owned particles.
+static void sumOwnedHeightDft(const Domain* self,
+                              double* dft)
+{
+  const double* x = self->store->x;
+  const double* y = self->store->y;
+  const double* h = (self->dim == 3) ? self->store->z : self->store->y;
+#pragma omp parallel for schedule(dynamic)
+  for (int32_t q = 0; q < self->num_q; q++) {
+    double re = 0.0, im = 0.0;
+    for (int32_t s = 0; s < self->num_owned; s++) {
+      const double phase = self->qx[q] * x[s] + self->qy[q] * y[s];
+      re += h[s] * cos(phase);
+      im -= h[s] * sin(phase);
+    }
+    dft[2 * q] = re;
+    dft[2 * q + 1] = im;
+  }
+}
+
+// NOTE: each rank sums the observables over its owned particles, and the
+//       partial sums are reduced on the root rank, which alone fills sums.
+//       Ghosts are exchanged first so that the bonded terms across the
+//       slab edges see the current positions.
+void reduceMacroSumsOfDomain(Domain* self,
+                             const System* system,
+                             const Boundary* bound,
+                             MacroSums* sums)
+{
+  exchangeGhosts(self);
+  fetchTermPtcls(self);
+  memset(self->sums, 0, self->num_sums * sizeof(double));
+  double* chain_sums = &self->sums[SCALAR_SUMS];
+  double* dft = &chain_sums[CHAIN_SUMS * self->num_chains];
+
+  sumOwnedBondedTerms(self, system, bound, self->sums);
+  if (self->num_chains > 0) {
+    sumOwnedChains(self, bound, chain_sums);
+  } else {
+    sumOwnedRg2(self, bound, &self->sums[11]);
+    const int32_t first = findSlot(self, getStoredId(system, 0));
+    const int32_t last = findSlot(self, getStoredId(system, self->num_ptcl - 1));
+    if (first >= 0 && first < self->num_owned) {
+      const dvec pos = getPosOfStore(self->store, first);
+      memcpy(&self->sums[12], &pos, sizeof(dvec));
+    }
+    if (last >= 0 && last < self->num_owned) {
+      const dvec pos = getPosOfStore(self->store, last);
+      memcpy(&self->sums[15], &pos, sizeof(dvec));
+    }
+  }
+  sumOwnedHeightDft(self, dft);
+
+  MPI_Reduce((self->rank == 0) ? MPI_IN_PLACE : self->sums, self->sums, self->num_sums,
+             MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+  if (self->rank != 0) return;
+
+  sums->bonded.e_bond = self->sums[0];
+  sums->bonded.e_angle = self->sums[1];
+  memcpy(&sums->bonded.virial, &self->sums[2], sizeof(dtensor3));
+  if (self->num_chains > 0) {
+    const int32_t chain_len = self->chain_len;
+    double rg_sum = 0.0, e2e_sum = 0.0;
+    for (int32_t c = 0; c < self->num_chains; c++) {
+      const double* cs = &chain_sums[CHAIN_SUMS * c];
+      const double cm2 = (cs[0] * cs[0] + cs[1] * cs[1] + cs[2] * cs[2]) / ((double)chain_len * chain_len);
+      rg_sum += sqrt(fmax(cs[3] / chain_len - cm2, 0.0));
+      e2e_sum += sqrt(cs[4] * cs[4] + cs[5] * cs[5] + cs[6] * cs[6]);
+    }
+    sums->rg = rg_sum / self->num_chains;
+    sums->end2end = e2e_sum / self->num_chains;
+  } else {
+    dvec pos_first, pos_last;
+    memcpy(&pos_first, &self->sums[12], sizeof(dvec));
+    memcpy(&pos_last, &self->sums[15], sizeof(dvec));
+    sums->rg = sqrt(self->sums[11] / self->num_ptcl);
+    sums->end2end = distance(&pos_first, &pos_last, bound);
+  }
+  sums->height_dft = (double complex*)dft;
+}
+
+static int comparePtclMsgId(const void* lhs,
+                            const void* rhs)
+{
+  const int32_t a = ((const PtclMsg*)lhs)->id;
+  const int32_t b = ((const PtclMsg*)rhs)->id;
+  return (a > b) - (a < b);
+}
+
+typedef void (*itemWriter)(void* ctx, const dvec* val);
+
+// NOTE: the values pos of the messages [0, num_items) of send_buf, with
+//       ids in [0, num_ids), are sent to the root rank in blocks of
+//       IO_BLOCK_SIZE ids, where write is called for each id in order. Each
+//       id is sent by one rank, so the root rank holds one block at a time.
+static void streamToRoot(Domain* self,
+                         const int32_t num_items,
+                         const int32_t num_ids,
+                         itemWriter write,
+                         void* ctx)
+{
+  qsort(self->send_buf, num_items, sizeof(PtclMsg), comparePtclMsgId);
+  dvec* block = (self->rank == 0) ? (dvec*)xmalloc(IO_BLOCK_SIZE * sizeof(dvec)) : NULL;
+  int32_t next = 0;
+  for (int32_t lo = 0; lo < num_ids; lo += IO_BLOCK_SIZE) {
+    const int32_t hi = (lo + IO_BLOCK_SIZE < num_ids) ? lo + IO_BLOCK_SIZE : num_ids;
+    int num_send = 0;
+    while (next + num_send < num_items && self->send_buf[next + num_send].id < hi) num_send++;
+    MPI_Gather(&num_send, 1, MPI_INT, self->recv_counts, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    int32_t num_recv = 0;
+    if (self->rank == 0) {
+      for (int r = 0; r < self->num_ranks; r++) {
+        self->recv_displs[r] = num_recv;
+        num_recv += self->recv_counts[r];
+      }
+      reserveMsgBuffer(&self->recv_buf, &self->recv_cap, num_recv);
+    }
+    MPI_Gatherv(&self->send_buf[next], num_send, self->msg_type,
+                self->recv_buf, self->recv_counts, self->recv_displs, self->msg_type,
+                0, MPI_COMM_WORLD);
+    next += num_send;
+    if (self->rank != 0) continue;
+
+    if (num_recv != hi - lo) {
+      fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+      fprintf(stderr, "%d values are received for the %d ids from %d.\n", num_recv, hi - lo, lo);
+      exit(1);
+    }
+    for (int32_t k = 0; k < num_recv; k++) block[self->recv_buf[k].id - lo] = self->recv_buf[k].pos;
+    for (int32_t i = 0; i < hi - lo; i++) write(ctx, &block[i]);
+  }
+  if (block) xfree(block);
+}
+
+static void packOwnedPositions(Domain* self)
+{
+  reserveMsgBuffer(&self->send_buf, &self->send_cap, self->num_owned);
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    packMsg(self, &self->send_buf[s], s, OWNED_HERE);
+  }
+}
+
+typedef struct OutputCtx_t {
+  Observer* observer;
+  FILE* fp;
+  int32_t dim;
+} OutputCtx;
+
+static void writeTrajectItem(void* ctx,
+                             const dvec* val)
+{
+  const OutputCtx* out = (const OutputCtx*)ctx;
+  writeTrajectPtcl(out->observer, val, out->dim);
+}
+
+static void writeBondLenItem(void* ctx,
+                             const dvec* val)
+{
+  const OutputCtx* out = (const OutputCtx*)ctx;
+  writeBondLen(out->observer, val->x);
+}
+
+static void writeConfigItem(void* ctx,
+                            const dvec* val)
+{
+  const OutputCtx* out = (const OutputCtx*)ctx;
+  const double r3[3] = {val->x, val->y, val->z};
+  fwrite((const void*)r3, sizeof(double), out->dim, out->fp);
+}
+
+// NOTE: a bond length is computed by the owner of the first particle of
+//       the bond, as its energy (see sumOwnedBondedTerms).
+void observeMicroVarsOfDomain(Domain* self,
+                              Observer* observer,
+                              const int32_t mc_steps,
+                              const Boundary* bound)
+{
+  OutputCtx ctx = {.observer = observer, .fp = NULL, .dim = self->dim};
+  if (observer) writeMicroFrameHeader(observer, mc_steps, self->num_ptcl);
+  packOwnedPositions(self);
+  streamToRoot(self, self->num_owned, self->num_ptcl, writeTrajectItem, &ctx);
+
+  exchangeGhosts(self);
+  fetchTermPtcls(self);
+  int32_t num_items = 0;
+  for (int32_t s = 0; s < self->num_owned; s++) num_items += getTermsOfSlot(self, s)[0];
+  reserveMsgBuffer(&self->send_buf, &self->send_cap, num_items);
+  num_items = 0;
+  for (int32_t s = 0; s < self->num_owned; s++) {
+    const int32_t id = self->gid[s];
+    const dvec pos = getPosOfStore(self->store, s);
+    int32_t* terms = getTermsOfSlot(self, s);
+    const OwnedBond* bonds = getBondsOfTerms(terms);
+    for (int32_t b = 0; b < terms[0]; b++) {
+      if (bonds[b].i0 != id) continue;
+      const dvec pos1 = getPosOfStore(self->store, findSlot(self, bonds[b].i1));
+      PtclMsg* msg = &self->send_buf[num_items++];
+      msg->id = bonds[b].index;
+      msg->pos = (dvec){.x = distance(&pos, &pos1, bound), .y = 0.0, .z = 0.0};
+    }
+  }
+  streamToRoot(self, num_items, self->num_bonds, writeBondLenItem, &ctx);
+}
+
+// NOTE: the format is that of writeFinalConfig.
+void writeFinalConfigOfDomain(Domain* self,
+                              const Parameter* param)
+{
+  OutputCtx ctx = {.observer = NULL, .fp = NULL, .dim = self->dim};
+  string* fname = new_string_from_string(getRootDir(param));
+  append_char(fname, "/fin_config.bin");
+  if (self->rank == 0) {
+    ctx.fp = xfopen(string_to_char(fname), "w");
+    fwrite((const void*)&self->num_ptcl, sizeof(int32_t), 1, ctx.fp);
+  }
+  packOwnedPositions(self);
+  streamToRoot(self, self->num_owned, self->num_ptcl, writeConfigItem, &ctx);
+  if (ctx.fp) xfclose(ctx.fp);
+  delete_string(fname);
+}
+
+#endif
@@ -0,0 +1,470 @@
+#include "ensemble.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils.h"
+#include "file_utils.h"
+#include "lane_rand.h"
+#include "mt_rand.h"
+#include "parameter.h"
+#include "system.h"
+#include "topol.h"
+#include "boundary.h"
+#include "vector3.h"
+#include "pos_store.h"
+
+#define LANES NUM_RAND_LANES
+
+// NOTE: box length is zero for the free boundary so that the
+//       branch-free wrapping below reduces to the identity.
+typedef struct LaneBox_t {
+  double leng[3];
+  double inv_leng[3];
+} LaneBox;
+
+typedef struct LaneBlock_t {
+  double* pos; // [ptcl][dim][lane], packed (x, y) in 2D
+  LaneRand rand;
+  int32_t num_accepted[LANES];
+} LaneBlock;
+
+struct Ensemble_t {
+  int32_t num_blocks;
+  int32_t num_ptcl;
+  int32_t dim;
+  int32_t id_lo, id_hi;
+  double step_len, cf_bond, cf_angle, l0;
+  LaneBox box;
+  LaneBlock* blocks;
+  FILE* fp;
+};
+
+#define LANE_AT(pos, dim, i, c) (&(pos)[((dim) * (i) + (c)) * LANES])
+
+// NOTE: 1.5 * 2^52. (x + ROUND_SHIFTER) - ROUND_SHIFTER is x rounded to
+//       the nearest integer, ties to even as nearbyint, for |x| < 2^51, and
+//       the low bits of x + ROUND_SHIFTER hold that integer. Unlike the libm
+//       calls, this plain arithmetic vectorizes on every instruction set.
+#define ROUND_SHIFTER 6755399441055744.0
+#define LN2_HI 6.93147180369123816490e-01
+#define LN2_LO 1.90821492927058770002e-10
+#define LOG2_E 1.44269504088896340736
+// NOTE: exp(x) is below the smallest normal double for x < EXP_ARG_MIN.
+#define EXP_ARG_MIN -708.0
+
+static void setLaneBox(LaneBox* box,
+                       const Boundary* bound,
+                       const Parameter* param)
+{
+  const dvec box_length = getBoxlength(param);
+  const double leng[3] = {box_length.x, box_length.y, box_length.z};
+  for (int32_t c = 0; c < 3; c++) {
+    const bool is_wrapped = (getBoundaryType(bound) == PERIODIC) && (leng[c] > 0.0);
+    box->leng[c]     = is_wrapped ? leng[c] : 0.0;
+    box->inv_leng[c] = is_wrapped ? 1.0 / leng[c] : 0.0;
+  }
+}
+
+static ALWAYS_INLINE double roundLane(const double x)
+{
+  return (x + ROUND_SHIFTER) - ROUND_SHIFTER;
+}
+
+static ALWAYS_INLINE double floorLane(const double x)
+{
+  const double r = roundLane(x);
+  return r - ((r > x) ? 1.0 : 0.0);
+}
+
+// NOTE: exp(min(x, 0)) within one ulp, and 0 below EXP_ARG_MIN, for the
+//       acceptance test. x = n ln2 + r with |r| <= ln2 / 2, exp(r) is its
+//       Taylor polynomial of degree 13 and 2^n is built in the exponent
+//       bits. A NaN x gives NaN, i.e. the move is rejected.
+static ALWAYS_INLINE double expLane(const double x)
+{
+  const double x_neg = (x > 0.0) ? 0.0 : x;
+  const double xc = (x < EXP_ARG_MIN) ? EXP_ARG_MIN : x_neg;
+  const double is_normal = (x < EXP_ARG_MIN) ? 0.0 : 1.0;
+  const double t = xc * LOG2_E + ROUND_SHIFTER;
+  const double n = t - ROUND_SHIFTER;
+  const double r = (xc - n * LN2_HI) - n * LN2_LO;
+  double p = 1.0 / 6227020800.0;
+  p = p * r + 1.0 / 479001600.0;
+  p = p * r + 1.0 / 39916800.0;
+  p = p * r + 1.0 / 3628800.0;
+  p = p * r + 1.0 / 362880.0;
+  p = p * r + 1.0 / 40320.0;
+  p = p * r + 1.0 / 5040.0;
+  p = p * r + 1.0 / 720.0;
+  p = p * r + 1.0 / 120.0;
+  p = p * r + 1.0 / 24.0;
+  p = p * r + 1.0 / 6.0;
+  p = p * r + 0.5;
+  p = p * r + 1.0;
+  p = p * r + 1.0;
+  uint64_t bits;
+  memcpy(&bits, &t, sizeof(bits));
+  bits = (bits + 1023) << 52;
+  double scale;
+  memcpy(&scale, &bits, sizeof(scale));
+  return is_normal * p * scale;
+}
+
+// NOTE: d[lane] <- x1[lane] - x0[lane] with minimum image convention.
+static ALWAYS_INLINE void calcLaneDisp(const double* x0,
+                                       const double* x1,
+                                       const double leng,
+                                       const double inv_leng,
+                                       double* d)
+{
+  for (int32_t l = 0; l < LANES; l++) {
+    const double dx = x1[l] - x0[l];
+    d[l] = dx - leng * roundLane(dx * inv_leng);
+  }
+}
+
+// NOTE: dr[c][lane] <- pos[i1] - pos[i0] with minimum image convention.
+//       The components are unrolled, so that only the lane loops are
+//       vectorized.
+static ALWAYS_INLINE void calcLaneBondVec(const double* pos,
+                                          const int32_t dim,
+                                          const int32_t i0,
+                                          const int32_t i1,
+                                          const LaneBox* box,
+                                          double dr[3][LANES])
+{
+  calcLaneDisp(LANE_AT(pos, dim, i0, 0), LANE_AT(pos, dim, i1, 0), box->leng[0], box->inv_leng[0], dr[0]);
+  calcLaneDisp(LANE_AT(pos, dim, i0, 1), LANE_AT(pos, dim, i1, 1), box->leng[1], box->inv_leng[1], dr[1]);
+  if (dim == 3) {
+    calcLaneDisp(LANE_AT(pos, dim, i0, 2), LANE_AT(pos, dim, i1, 2), box->leng[2], box->inv_leng[2], dr[2]);
+  } else {
+    for (int32_t l = 0; l < LANES; l++) dr[2][l] = 0.0;
+  }
+}
+
+// NOTE: sum over the first dim components of a[c][lane] * b[c][lane].
+static ALWAYS_INLINE void calcLaneDot(const int32_t dim,
+                                      const double a[3][LANES],
+                                      const double b[3][LANES],
+                                      double* dot)
+{
+  for (int32_t l = 0; l < LANES; l++) dot[l] = a[0][l] * b[0][l] + a[1][l] * b[1][l];
+  if (dim == 3) {
+    for (int32_t l = 0; l < LANES; l++) dot[l] += a[2][l] * b[2][l];
+  }
+}
+
+static ALWAYS_INLINE void addLaneBondEnergy(const double* pos,
+                                            const int32_t dim,
+                                            const pair* bond,
+                                            const LaneBox* box,
+                                            const double k,
+                                            const double l0,
+                                            double* e)
+{
+  double dr[3][LANES], r2[LANES];
+  calcLaneBondVec(pos, dim, bond->i0, bond->i1, box, dr);
+  calcLaneDot(dim, dr, dr, r2);
+  for (int32_t l = 0; l < LANES; l++) {
+    const double r = sqrt(r2[l]);
+    e[l] += 0.5 * k * (r - l0) * (r - l0);
+  }
+}
+
+static ALWAYS_INLINE void addLaneAngleEnergy(const double* pos,
+                                             const int32_t dim,
+                                             const triple* angle,
+                                             const LaneBox* box,
+                                             const double k,
+                                             double* e)
+{
+  double dr01[3][LANES], dr12[3][LANES];
+  double dot[LANES], n01[LANES], n12[LANES];
+  calcLaneBondVec(pos, dim, angle->i0, angle->i1, box, dr01);
+  calcLaneBondVec(pos, dim, angle->i1, angle->i2, box, dr12);
+  calcLaneDot(dim, dr01, dr12, dot);
+  calcLaneDot(dim, dr01, dr01, n01);
+  calcLaneDot(dim, dr12, dr12, n12);
+  for (int32_t l = 0; l < LANES; l++) {
+    e[l] += k * (1.0 - dot[l] / sqrt(n01[l] * n12[l]));
+  }
+}
+
+static ALWAYS_INLINE void calcLaneLocEnergy(const Ensemble* self,
+                                             const double* pos,
+                                             const ptclid2topol* id2top,
+                                             const int32_t id,
+                                             const int32_t dim,
+                                             double* e)
+{
+  for (int32_t l = 0; l < LANES; l++) e[l] = 0.0;
+  for (int32_t b = 0; b < getNumPairsOfPtcl(id2top, id); b++) {
+    addLaneBondEnergy(pos, dim, getPairOfPtcl(id2top, id, b), &self->box, self->cf_bond, self->l0, e);
+  }
+  for (int32_t a = 0; a < getNumTriplesOfPtcl(id2top, id); a++) {
+    addLaneAngleEnergy(pos, dim, getTripleOfPtcl(id2top, id, a), &self->box, self->cf_angle, e);
+  }
+}
+
+// NOTE: the picked site is shared by all lanes of a block;
+//       displacements and acceptance are drawn independently per lane.
+static ALWAYS_INLINE void laneMcStep(const Ensemble* self,
+                                     LaneBlock* block,
+                                     const ptclid2topol* id2top,
+                                     const int32_t id_picked,
+                                     const int32_t dim)
+{
+  double* pos = block->pos;
+  double pos_old[3][LANES];
+  for (int32_t c = 0; c < dim; c++) {
+    const double* x = LANE_AT(pos, dim, id_picked, c);
+    for (int32_t l = 0; l < LANES; l++) pos_old[c][l] = x[l];
+  }
+
+  double e_bef[LANES], e_aft[LANES], rnd[LANES];
+  calcLaneLocEnergy(self, pos, id2top, id_picked, dim, e_bef);
+
+  for (int32_t c = 0; c < dim; c++) {
+    double* x = LANE_AT(pos, dim, id_picked, c);
+    const double leng = self->box.leng[c], inv_leng = self->box.inv_leng[c];
+    fillLaneRandReal(&block->rand, rnd);
+    for (int32_t l = 0; l < LANES; l++) {
+      const double x_new = x[l] + self->step_len * (2.0 * rnd[l] - 1.0);
+      x[l] = x_new - leng * floorLane(x_new * inv_leng);
+    }
+  }
+
+  calcLaneLocEnergy(self, pos, id2top, id_picked, dim, e_aft);
+
+  // masked accept / reject
+  fillLaneRandReal(&block->rand, rnd);
+  int32_t is_accepted[LANES];
+  for (int32_t l = 0; l < LANES; l++) {
+    is_accepted[l] = rnd[l] < expLane(e_bef[l] - e_aft[l]);
+    block->num_accepted[l] += is_accepted[l];
+  }
+  for (int32_t c = 0; c < dim; c++) {
+    double* x = LANE_AT(pos, dim, id_picked, c);
+    for (int32_t l = 0; l < LANES; l++) {
+      x[l] = is_accepted[l] ? x[l] : pos_old[c][l];
+    }
+  }
+}
+
+// NOTE: the lane kernels are inlined into the sweep of a block and the
+//       energy sums of the observer, which are compiled for each
+//       instruction set (TARGET_CLONES), with dim a compile-time constant.
+//       ensemble.c is built without errno and FP traps, so that the sqrt
+//       and the selects of the lane loops vectorize too, and with a low
+//       limit of complete peeling, so that GCC vectorizes the lane loops
+//       as loops; fully peeled, the basic-block vectorizer leaves most of the
+//       sqrt and div scalar.
+TARGET_CLONES static void sweepLaneBlock(const Ensemble* self,
+                                         LaneBlock* block,
+                                         const ptclid2topol* id2top,
+                                         MTstate* mtst)
+{
+  for (int32_t l = 0; l < LANES; l++) block->num_accepted[l] = 0;
+  for (int32_t p = 0; p < self->num_ptcl; p++) {
+    const int32_t id_picked = genrand_int31_range(mtst, self->id_lo, self->id_hi);
+    if (self->dim == 3) {
+      laneMcStep(self, block, id2top, id_picked, 3);
+    } else {
+      laneMcStep(self, block, id2top, id_picked, 2);
+    }
+  }
+}
+
+static ALWAYS_INLINE void addLaneBondedEnergy(const Ensemble* self,
+                                              const double* pos,
+                                              const topol* top,
+                                              const int32_t dim,
+                                              double* ebond,
+                                              double* eangle)
+{
+  const int32_t num_bonds = getNumBonds(top);
+  const int32_t num_angles = getNumAngles(top);
+  const pair* bond_top = getBondTopol(top);
+  const triple* angle_top = getAngleTopol(top);
+  for (int32_t i = 0; i < num_bonds; i++) {
+    addLaneBondEnergy(pos, dim, &bond_top[i], &self->box, self->cf_bond, self->l0, ebond);
+  }
+  for (int32_t i = 0; i < num_angles; i++) {
+    addLaneAngleEnergy(pos, dim, &angle_top[i], &self->box, self->cf_angle, eangle);
+  }
+}
+
+TARGET_CLONES static void sumLaneBondedEnergy(const Ensemble* self,
+                                              const LaneBlock* block,
+                                              const topol* top,
+                                              double* ebond,
+                                              double* eangle)
+{
+  for (int32_t l = 0; l < LANES; l++) {
+    ebond[l] = 0.0;
+    eangle[l] = 0.0;
+  }
+  if (self->dim == 3) {
+    addLaneBondedEnergy(self, block->pos, top, 3, ebond, eangle);
+  } else {
+    addLaneBondedEnergy(self, block->pos, top, 2, ebond, eangle);
+  }
+}
+
+Ensemble* newEnsemble(const System* system,
+                      const Boundary* bound,
+                      const Parameter* param)
+{
+  const int32_t num_replicas = getNumReplicas(param);
+  if (num_replicas % LANES != 0) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "num_replicas should be a multiple of %d.\n", LANES);
+    fprintf(stderr, "num_replicas = %d.\n", num_replicas);
+    exit(1);
+  }
+
+  Ensemble* self = (Ensemble*)xmalloc(sizeof(Ensemble));
+  self->num_blocks = num_replicas / LANES;
+  self->num_ptcl   = getNumPtcl(param);
+  self->dim        = getBoundaryDim(bound);
+  self->step_len   = getStepLen(param);
+  self->cf_bond    = getCfBond(param);
+  self->cf_angle   = getCfAngle(param);
+  self->l0         = getBondLen(param);
+  self->id_lo = 0;
+  self->id_hi = self->num_ptcl - 1;
+  if (getBoundaryType(bound) == PERIODIC && !getTopologyFile(param)) {
+    self->id_lo++;
+    self->id_hi--;
+  }
+  setLaneBox(&self->box, bound, param);
+
+  // every replica starts from the current configuration of system
+  const PosStore* store = getPosStore(system);
+  self->blocks = (LaneBlock*)xmalloc(self->num_blocks * sizeof(LaneBlock));
+  for (int32_t b = 0; b < self->num_blocks; b++) {
+    LaneBlock* block = &self->blocks[b];
+    block->pos = (double*)xmalloc(self->dim * LANES * self->num_ptcl * sizeof(double));
+    for (int32_t i = 0; i < self->num_ptcl; i++) {
+      const dvec ri = getPosOfStore(store, i);
+      const double r[3] = {ri.x, ri.y, ri.z};
+      for (int32_t c = 0; c < self->dim; c++) {
+        double* x = LANE_AT(block->pos, self->dim, i, c);
+        for (int32_t l = 0; l < LANES; l++) x[l] = r[c];
+      }
+    }
+    initLaneRand(&block->rand, getRandSeed(param), (uint64_t)b);
+    for (int32_t l = 0; l < LANES; l++) block->num_accepted[l] = 0;
+  }
+
+  string* fname = new_string_from_string(getRootDir(param));
+  append_char(fname, "/ensemble.dat");
+  self->fp = xfopen(string_to_char(fname), "w");
+  fprintf(self->fp, "# mcsteps bond angle total accept_ratio (averaged over %d replicas)\n", num_replicas);
+  delete_string(fname);
+
+  return self;
+}
+
+void deleteEnsemble(Ensemble* self)
+{
+  for (int32_t b = 0; b < self->num_blocks; b++) {
+    xfree(self->blocks[b].pos);
+  }
+  xfree(self->blocks);
+  xfclose(self->fp);
+  xfree(self);
+}
+
+int32_t getNumReplicasOfEnsemble(const Ensemble* self)
+{
+  return self->num_blocks * LANES;
+}
+
+double evolveEnsembleMc(Ensemble* self,
+                        const System* system,
+                        MTstate* mtst)
+{
+  const ptclid2topol* id2top = getPtclId2Topol(system);
+  int64_t num_accepted = 0;
+  for (int32_t b = 0; b < self->num_blocks; b++) {
+    LaneBlock* block = &self->blocks[b];
+    sweepLaneBlock(self, block, id2top, mtst);
+    for (int32_t l = 0; l < LANES; l++) num_accepted += block->num_accepted[l];
+  }
+  return (double)num_accepted / ((double)self->num_ptcl * getNumReplicasOfEnsemble(self));
+}
+
+void observeEnsemble(Ensemble* self,
+                     const int32_t mc_steps,
+                     const System* system)
+{
+  const topol* top = getTopol(system);
+  double ebond_sum = 0.0, eangle_sum = 0.0;
+  int64_t num_accepted = 0;
+  for (int32_t b = 0; b < self->num_blocks; b++) {
+    const LaneBlock* block = &self->blocks[b];
+    double ebond[LANES], eangle[LANES];
+    sumLaneBondedEnergy(self, block, top, ebond, eangle);
+    for (int32_t l = 0; l < LANES; l++) {
+      ebond_sum  += ebond[l];
+      eangle_sum += eangle[l];
+      num_accepted += block->num_accepted[l];
+    }
+  }
+
+  const int32_t num_replicas = getNumReplicasOfEnsemble(self);
+  ebond_sum  /= num_replicas;
+  eangle_sum /= num_replicas;
+  fprintf(self->fp, "%d %f %f %f %f\n", mc_steps,
+          ebond_sum, eangle_sum, ebond_sum + eangle_sum,
+          (double)num_accepted / ((double)self->num_ptcl * num_replicas));
+}
+
+void copyReplicaToSystem(const Ensemble* self,
+                         const int32_t replica,
+                         System* system)
+{
+  const double* pos_lane = self->blocks[replica / LANES].pos;
+  const int32_t l = replica % LANES;
+  const int32_t dim = self->dim;
+  PosStore* store = getPosStore(system);
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    const dvec r = {
+      .x = LANE_AT(pos_lane, dim, i, 0)[l],
+      .y = LANE_AT(pos_lane, dim, i, 1)[l],
+      .z = (dim == 3) ? LANE_AT(pos_lane, dim, i, 2)[l] : 0.0,
+    };
+    setPosOfStore(store, i, &r);
+  }
+}
+
+// NOTE: format is num_replicas, num_ptcl, then the positions of each
+//       replica in the same layout as fin_config.bin.
+void writeEnsembleFinalConfig(const Ensemble* self,
+                              const Parameter* param)
+{
+  const int32_t num_replicas = getNumReplicasOfEnsemble(self);
+  const int32_t num_ptcl = self->num_ptcl;
+
+  string* fname = new_string_from_string(getRootDir(param));
+  append_char(fname, "/fin_config_ensemble.bin");
+  FILE* fp = xfopen(string_to_char(fname), "w");
+  fwrite((void *)&num_replicas, sizeof(int32_t), 1, fp);
+  fwrite((void *)&num_ptcl, sizeof(int32_t), 1, fp);
+  for (int32_t r = 0; r < num_replicas; r++) {
+    const double* pos_lane = self->blocks[r / LANES].pos;
+    const int32_t l = r % LANES;
+    for (int32_t i = 0; i < num_ptcl; i++) {
+      for (int32_t c = 0; c < self->dim; c++) {
+        fwrite((void *)&LANE_AT(pos_lane, self->dim, i, c)[l], sizeof(double), 1, fp);
+      }
+    }
+  }
+  xfclose(fp);
+  delete_string(fname);
+}
@@ -4,31 +4,79 @@
 #define _USE_MATH_DEFINES
 #endif
 #include <math.h>
+#include <stdlib.h>
 
 #include "mt_rand.h"
 #include "parameter.h"
 #include "system.h"
 #include "topol.h"
 #include "utils.h"
-#include "interactions.h"
+#include "potential.h"
 #include "boundary.h"
 #include "vector3.h"
+#include "math_utils.h"
+#include "melt.h"
+#include "cell_list.h"
+#include "hash_grid.h"
+#include "verlet_list.h"
+#include "pppm.h"
+#include "single_pos.h"
+#include "potential_single.h"
+#include "fixed_pos.h"
+#include "bond_cache.h"
+#include "site_order.h"
 
-static dvec kickParticle(const dvec *pos0,
-                         const double disp,
-                         MTstate *mtst,
-                         const Boundary *bound)
-{
-  dvec disp_vec;
-  disp_vec.x = disp * (2.0 * genrand_res53(mtst) - 1.0);
-  disp_vec.y = disp * (2.0 * genrand_res53(mtst) - 1.0);
-#ifdef SIMULATION_3D
-  disp_vec.z = disp * (2.0 * genrand_res53(mtst) - 1.0);
-#else
-  disp_vec.z = 0.0;
-#endif
-  dvec new_pos = add_dvec_new(pos0, &disp_vec);
-  applyBoundaryCond(bound, &new_pos);
+// NOTE: z is neither drawn nor wrapped in 2D.
+static ALWAYS_INLINE dvec kickParticle(const dvec *pos0,
+                                      const double disp,
+                                      MTstate *mtst,
+                                      const Boundary *bound,
+                                      const BOUNDARY_TYPE bc,
+                                      const int32_t dim)
+{
+  dvec new_pos = *pos0;
+  new_pos.x += disp * (2.0 * genrand_res53(mtst) - 1.0);
+  new_pos.y += disp * (2.0 * genrand_res53(mtst) - 1.0);
+  if (dim == 3)
+  {
+    new_pos.z += disp * (2.0 * genrand_res53(mtst) - 1.0);
+  }
+  applyBoundaryCondOf(bound, &new_pos, bc, dim);
+  return new_pos;
+}
+
+static ALWAYS_INLINE fvec kickParticleSingle(const fvec *pos0,
+                                            const double disp,
+                                            MTstate *mtst,
+                                            const SinglePosStore *sp,
+                                            const BOUNDARY_TYPE bc,
+                                            const int32_t dim)
+{
+  fvec new_pos = *pos0;
+  new_pos.x += (float)(disp * (2.0 * genrand_res53(mtst) - 1.0));
+  new_pos.y += (float)(disp * (2.0 * genrand_res53(mtst) - 1.0));
+  if (dim == 3)
+  {
+    new_pos.z += (float)(disp * (2.0 * genrand_res53(mtst) - 1.0));
+  }
+  applyBoundaryCondSingle(sp, &new_pos, bc, dim);
+  return new_pos;
+}
+
+// NOTE: no wrapping: the box is the range of uint32.
+static ALWAYS_INLINE uvec kickParticleFixed(const uvec *pos0,
+                                           const double disp,
+                                           MTstate *mtst,
+                                           const FixedPosStore *fp,
+                                           const int32_t dim)
+{
+  uvec new_pos = *pos0;
+  new_pos.x += (uint32_t)toFixedDisp(disp * (2.0 * genrand_res53(mtst) - 1.0), fp->inv_scale.x);
+  new_pos.y += (uint32_t)toFixedDisp(disp * (2.0 * genrand_res53(mtst) - 1.0), fp->inv_scale.y);
+  if (dim == 3)
+  {
+    new_pos.z += (uint32_t)toFixedDisp(disp * (2.0 * genrand_res53(mtst) - 1.0), fp->inv_scale.z);
+  }
   return new_pos;
 }
 
@@ -47,163 +95,1096 @@ static bool newStateIsAccepted(const double deltaE,
   }
 }
 
-static double calcBondEnergyLocalSum(dvec *pos,
+static double calcBondEnergyLocalSum(const PosStore *store,
                                      const int32_t id_picked,
                                      const ptclid2topol *id2top,
                                      const Boundary *bound,
-                                     const double cf_bond,
-                                     const double l0)
+                                     const BondedParam *bp)
 {
   double esum = 0.0;
-  const int32_t num_bonds = id2top[id_picked].num_pair;
+  const int32_t num_bonds = getNumPairsOfPtcl(id2top, id_picked);
   for (int32_t bond = 0; bond < num_bonds; bond++)
   {
-    const int32_t i = id2top[id_picked].pair[bond].i0;
-    const int32_t j = id2top[id_picked].pair[bond].i1;
-    esum += calcBondEnergy(&pos[i], &pos[j], cf_bond, l0, bound);
+    const pair *b = getPairOfPtcl(id2top, id_picked, bond);
+    const dvec ri = getPosOfStore(store, b->i0);
+    const dvec rj = getPosOfStore(store, b->i1);
+    esum += calcBondTermEnergy(&ri, &rj, bp, bound);
   }
   return esum;
 }
 
-static double calcAngleEnergyLocalSum(dvec *pos,
+static double calcAngleEnergyLocalSum(const PosStore *store,
                                       const int32_t id_picked,
                                       const ptclid2topol *id2top,
                                       const Boundary *bound,
-                                      const double cf_angle)
+                                      const BondedParam *bp)
 {
   double esum = 0.0;
-  const int32_t num_angles = id2top[id_picked].num_triple;
+  const int32_t num_angles = getNumTriplesOfPtcl(id2top, id_picked);
   for (int32_t angle = 0; angle < num_angles; angle++)
   {
-    const int32_t i = id2top[id_picked].triple[angle].i0;
-    const int32_t j = id2top[id_picked].triple[angle].i1;
-    const int32_t k = id2top[id_picked].triple[angle].i2;
-    esum += calcAngleEnergy(&pos[i], &pos[j], &pos[k], cf_angle, bound);
+    const triple *a = getTripleOfPtcl(id2top, id_picked, angle);
+    const dvec ri = getPosOfStore(store, a->i0);
+    const dvec rj = getPosOfStore(store, a->i1);
+    const dvec rk = getPosOfStore(store, a->i2);
+    esum += calcAngleTermEnergy(&ri, &rj, &rk, bp, bound);
   }
   return esum;
 }
 
-static double calcLocEnergy(dvec *pos,
+static double calcLocEnergy(const PosStore *store,
                             const int32_t id_picked,
                             const ptclid2topol *id2top,
                             const Boundary *bound,
-                            const double cf_bond,
-                            const double cf_angle,
-                            const double l0)
+                            const BondedParam *bp,
+                            const VerletList *verlet)
 {
-  return calcBondEnergyLocalSum(pos, id_picked, id2top, bound, cf_bond, l0) + calcAngleEnergyLocalSum(pos, id_picked, id2top, bound, cf_angle);
+  const double e_nonbond = verlet ? calcNonbondEnergyLocal(verlet, store, id_picked, bound) : 0.0;
+  return calcBondEnergyLocalSum(store, id_picked, id2top, bound, bp) + calcAngleEnergyLocalSum(store, id_picked, id2top, bound, bp) + e_nonbond;
 }
 
-static void mcStep(dvec *pos,
-                   MTstate *mtst,
-                   int32_t *num_accepted,
-                   const ptclid2topol *id2top,
-                   const Boundary *bound,
-                   const double disp,
-                   const double cf_bond,
-                   const double cf_angle,
-                   const double l0,
-                   const int32_t id_lo,
-                   const int32_t id_hi)
+// NOTE: everything a sweep needs, so that the specialized sweeps share
+//       one signature.
+typedef struct SweepContext_t
 {
-  const int32_t id_picked = genrand_int31_range(mtst, id_lo, id_hi);
-  const dvec pos_tmp = pos[id_picked];
+  System *system;
+  PosStore *store;
+  MTstate *mtst;
+  const ptclid2topol *id2top;
+  const ImplicitTopol *implicit;
+  const Boundary *bound;
+  double disp;
+  const BondedParam *bp;
+  CellList *cells;
+  HashGrid *hgrid;
+  double excl_diam;
+  VerletList *verlet;
+  Pppm *pppm;
+  Melt *melt;
+  double double_bridge_prob;
+  int32_t id_lo, id_hi;
+  int32_t num_steps;
+  int32_t prefetch_dist;
+  const int32_t *order;
+  SinglePosStore *single;
+  BondedParamSingle bps;
+  FixedPosStore *fixed;
+  BondCache *bcache;
+} SweepContext;
 
-  const double e_locsum_bef = calcLocEnergy(pos, id_picked, id2top, bound, cf_bond, cf_angle, l0);
-  pos[id_picked] = kickParticle(&pos_tmp, disp, mtst, bound);
-  const double e_locsum_aft = calcLocEnergy(pos, id_picked, id2top, bound, cf_bond, cf_angle, l0);
-  const double dE = e_locsum_aft - e_locsum_bef;
+typedef double (*locEnergyFunc)(const PosStore *store, const int32_t id_picked, const ptclid2topol *id2top,
+                                const ImplicitTopol *implicit, const Boundary *bound, const BondedParam *bp,
+                                const VerletList *verlet);
+typedef double (*locEnergySingleFunc)(const SinglePosStore *sp, const int32_t id_picked, const fvec *pos_new,
+                                      const ptclid2topol *id2top, const BondedParamSingle *bps);
+typedef void (*lanesSingleFunc)(const float *val, const BondedParamSingle *bps, float *energy);
+typedef double (*locEnergyFixedFunc)(const FixedPosStore *fp, const int32_t id_picked,
+                                     const ptclid2topol *id2top, const BondedParam *bp);
+typedef double (*trialEnergyFunc)(const PosStore *store, const int32_t id_picked, const ptclid2topol *id2top,
+                                  BondCache *bcache, const Boundary *bound, const BondedParam *bp,
+                                  const VerletList *verlet);
+typedef double (*sweepFunc)(const SweepContext *ctx);
 
-  if (newStateIsAccepted(dE, mtst))
+// NOTE: inlined into every specialized sweep, where calc_loc_energy,
+//       calc_trial_energy, bc and dim are compile-time constants. With the
+//       bond cache (calc_trial_energy not NULL), the energy before the move
+//       is read from the cache and the one after it is evaluated into its
+//       trial terms (see bond_cache.h).
+static ALWAYS_INLINE void mcStep(const SweepContext *ctx,
+                                 const locEnergyFunc calc_loc_energy,
+                                 const trialEnergyFunc calc_trial_energy,
+                                 const BOUNDARY_TYPE bc,
+                                 const int32_t dim,
+                                 int32_t *num_accepted,
+                                 const int32_t id_picked)
+{
+  PosStore *store = ctx->store;
+  const Boundary *bound = ctx->bound;
+  const dvec pos_tmp = getPosOfStoreDim(store, id_picked, dim);
+  const dvec pos_new = kickParticle(&pos_tmp, ctx->disp, ctx->mtst, bound, bc, dim);
+  if (ctx->cells && overlapsInCellList(ctx->cells, store, id_picked, &pos_new, ctx->excl_diam, bound))
+  {
+    return;
+  }
+  if (ctx->hgrid && overlapsInHashGrid(ctx->hgrid, store, id_picked, &pos_new, ctx->excl_diam))
+  {
+    return;
+  }
+  if (ctx->verlet)
+  {
+    prepareVerletMove(ctx->verlet, store, id_picked, &pos_new, bound);
+  }
+
+  const double de_coulomb = ctx->pppm ? calcCoulombMoveEnergy(ctx->pppm, store, id_picked, &pos_new, bound) : 0.0;
+  double e_locsum_bef, e_locsum_aft;
+  if (calc_trial_energy)
+  {
+    const double e_nonbond_bef = ctx->verlet ? calcNonbondEnergyLocal(ctx->verlet, store, id_picked, bound) : 0.0;
+    e_locsum_bef = sumCachedLocEnergy(ctx->bcache, ctx->id2top, id_picked, e_nonbond_bef);
+    setPosOfStoreDim(store, id_picked, &pos_new, dim);
+    e_locsum_aft = calc_trial_energy(store, id_picked, ctx->id2top, ctx->bcache, bound, ctx->bp, ctx->verlet);
+  }
+  else
+  {
+    e_locsum_bef = calc_loc_energy(store, id_picked, ctx->id2top, ctx->implicit, bound, ctx->bp, ctx->verlet);
+    setPosOfStoreDim(store, id_picked, &pos_new, dim);
+    e_locsum_aft = calc_loc_energy(store, id_picked, ctx->id2top, ctx->implicit, bound, ctx->bp, ctx->verlet);
+  }
+  const double dE = e_locsum_aft - e_locsum_bef + de_coulomb;
+
+  if (newStateIsAccepted(dE, ctx->mtst))
   {
     (*num_accepted)++;
+    if (calc_trial_energy)
+    {
+      acceptBondCacheMove(ctx->bcache, ctx->id2top, id_picked);
+    }
+    if (ctx->cells)
+    {
+      moveInCellList(ctx->cells, id_picked, &pos_new);
+    }
+    if (ctx->hgrid)
+    {
+      moveInHashGrid(ctx->hgrid, id_picked, &pos_new);
+    }
+    if (ctx->double_bridge_prob > 0.0)
+    {
+      moveInBridgeGrid(ctx->melt, id_picked, &pos_new);
+    }
+    if (ctx->pppm)
+    {
+      acceptCoulombMove(ctx->pppm, store, id_picked);
+    }
   }
   else
   {
-    pos[id_picked] = pos_tmp;
+    setPosOfStoreDim(store, id_picked, &pos_tmp, dim);
   }
 }
 
-double evolveMc(System *system,
-                const Parameter *param,
-                const Boundary *bound,
-                MTstate *mtst)
+// NOTE: position of particle id before (trial 0) or after (trial 1) the
+//       move of id_picked to pos_new.
+static ALWAYS_INLINE fvec getTrialPosOfSingle(const SinglePosStore *sp,
+                                              const int32_t id,
+                                              const int32_t id_picked,
+                                              const fvec *pos_new,
+                                              const int32_t trial,
+                                              const int32_t dim)
 {
-  const int32_t num_ptcl = getNumPtcl(param);
-  const double step_len = getStepLen(param);
-  const double cf_bond = getCfBond(param);
-  const double cf_angle = getCfAngle(param);
-  const double l0 = getBondLen(param);
+  return (trial == 1 && id == id_picked) ? *pos_new : getPosOfSingle(sp, id, dim);
+}
+
+// NOTE: the change of the local energy when id_picked moves to pos_new.
+//       Each bonded term takes two float32 lanes, one before and one after
+//       the move, so that both are evaluated in the same vector operations;
+//       a row of more than SINGLE_LANES / 2 terms is evaluated in several
+//       passes. The terms before and after the move are summed in float64
+//       in the order of the row.
+static ALWAYS_INLINE double calcLocEnergyChangeSingle(const SinglePosStore *sp,
+                                                      const int32_t id_picked,
+                                                      const fvec *pos_new,
+                                                      const ptclid2topol *id2top,
+                                                      const BondedParamSingle *bps,
+                                                      const lanesSingleFunc calc_bond_lanes,
+                                                      const lanesSingleFunc calc_angle_lanes,
+                                                      const BOUNDARY_TYPE bc,
+                                                      const int32_t dim)
+{
+  // NOTE: the unused lanes hold zeros.
+  FvecLanes r0 = {.x = {0.0f}}, r1 = {.x = {0.0f}}, r2 = {.x = {0.0f}};
+  FvecLanes dr01, dr12;
+  float val[SINGLE_LANES], energy[SINGLE_LANES];
+  double e_locsum_bef = 0.0, e_locsum_aft = 0.0;
 
-  for (int32_t p = 0; p < num_ptcl; p++)
+  const int32_t num_bonds = getNumPairsOfPtcl(id2top, id_picked);
+  for (int32_t begin = 0; begin < num_bonds; begin += SINGLE_LANES / 2)
   {
-    const double PIVOT_MOVE_PROBABILITY = 0.1; // let's roll with 10% for now
-    double rand_val = genrand_real1(mtst);
-    if (rand_val < PIVOT_MOVE_PROBABILITY)
+    const int32_t num_terms = (num_bonds - begin < SINGLE_LANES / 2) ? num_bonds - begin : SINGLE_LANES / 2;
+    for (int32_t k = 0; k < num_terms; k++)
     {
-      continue;
+      const pair *b = getPairOfPtcl(id2top, id_picked, begin + k);
+      for (int32_t trial = 0; trial < 2; trial++)
+      {
+        const fvec p0 = getTrialPosOfSingle(sp, b->i0, id_picked, pos_new, trial, dim);
+        const fvec p1 = getTrialPosOfSingle(sp, b->i1, id_picked, pos_new, trial, dim);
+        setLaneOfSingle(&r0, 2 * k + trial, &p0, dim);
+        setLaneOfSingle(&r1, 2 * k + trial, &p1, dim);
+      }
     }
-
-    while (1)
+    calcDispLanesSingle(&r0, &r1, sp, bc, dim, &dr01);
+    dotLanesSingle(&dr01, &dr01, dim, val);
+    calc_bond_lanes(val, bps, energy);
+    for (int32_t k = 0; k < num_terms; k++)
     {
-      int32_t pivot = 1 + genrand_int31(mtst) % (num_ptcl - 2);
-      // hm. lol.
-      double axis[3] = {genrand_real1(mtst), genrand_real1(mtst), genrand_real1(mtst)};
-      double angle = 2 * M_PI * genrand_real1(mtst); // Full rotation range
+      e_locsum_bef += energy[2 * k];
+      e_locsum_aft += energy[2 * k + 1];
+    }
+  }
 
-      for (int32_t i = pivot + 1; i < num_ptcl; i++)
+  const int32_t num_angles = getNumTriplesOfPtcl(id2top, id_picked);
+  for (int32_t begin = 0; begin < num_angles; begin += SINGLE_LANES / 2)
+  {
+    const int32_t num_terms = (num_angles - begin < SINGLE_LANES / 2) ? num_angles - begin : SINGLE_LANES / 2;
+    for (int32_t k = 0; k < num_terms; k++)
+    {
+      const triple *a = getTripleOfPtcl(id2top, id_picked, begin + k);
+      for (int32_t trial = 0; trial < 2; trial++)
       {
-        printf("rotate the particle %d around the axis (%f, %f, %f) by %f\n", i, axis[0], axis[1], axis[2], angle);
+        const fvec p0 = getTrialPosOfSingle(sp, a->i0, id_picked, pos_new, trial, dim);
+        const fvec p1 = getTrialPosOfSingle(sp, a->i1, id_picked, pos_new, trial, dim);
+        const fvec p2 = getTrialPosOfSingle(sp, a->i2, id_picked, pos_new, trial, dim);
+        setLaneOfSingle(&r0, 2 * k + trial, &p0, dim);
+        setLaneOfSingle(&r1, 2 * k + trial, &p1, dim);
+        setLaneOfSingle(&r2, 2 * k + trial, &p2, dim);
       }
     }
+    calcDispLanesSingle(&r0, &r1, sp, bc, dim, &dr01);
+    calcDispLanesSingle(&r1, &r2, sp, bc, dim, &dr12);
+    cosLanesSingle(&dr01, &dr12, dim, val);
+    calc_angle_lanes(val, bps, energy);
+    for (int32_t k = 0; k < num_terms; k++)
+    {
+      e_locsum_bef += energy[2 * k];
+      e_locsum_aft += energy[2 * k + 1];
+    }
+  }
+  return e_locsum_aft - e_locsum_bef;
+}
+
+// NOTE: mcStep on the float32 positions. The particle is moved only if the
+//       move is accepted; the energy changes of the accepted moves are
+//       summed in float64.
+static ALWAYS_INLINE void mcStepSingle(const SweepContext *ctx,
+                                       const locEnergySingleFunc calc_loc_energy,
+                                       const BOUNDARY_TYPE bc,
+                                       const int32_t dim,
+                                       int32_t *num_accepted,
+                                       double *de_accepted,
+                                       const int32_t id_picked)
+{
+  SinglePosStore *sp = ctx->single;
+  const fvec pos_tmp = getPosOfSingle(sp, id_picked, dim);
+  const fvec pos_new = kickParticleSingle(&pos_tmp, ctx->disp, ctx->mtst, sp, bc, dim);
+  const double dE = calc_loc_energy(sp, id_picked, &pos_new, ctx->id2top, &ctx->bps);
 
-    /*     mcStep(getPos(system), mtst, NULL, getPtclId2Topol(system), bound,
-              step_len, cf_bond, cf_angle, l0,
-               0, num_ptcl - 1); */
+  if (newStateIsAccepted(dE, ctx->mtst))
+  {
+    (*num_accepted)++;
+    *de_accepted += dE;
+    setPosOfSingle(sp, id_picked, &pos_new, dim);
   }
+}
 
-  int32_t id_movable_lo = 0, id_movable_hi = num_ptcl - 1;
-  if (getBoundaryType(bound) == PERIODIC)
+// NOTE: mcStep on the fixed-point positions of the periodic box.
+static ALWAYS_INLINE void mcStepFixed(const SweepContext *ctx,
+                                      const locEnergyFixedFunc calc_loc_energy,
+                                      const int32_t dim,
+                                      int32_t *num_accepted,
+                                      const int32_t id_picked)
+{
+  FixedPosStore *fp = ctx->fixed;
+  const uvec pos_tmp = getPosOfFixed(fp, id_picked, dim);
+  const uvec pos_new = kickParticleFixed(&pos_tmp, ctx->disp, ctx->mtst, fp, dim);
+
+  const double e_locsum_bef = calc_loc_energy(fp, id_picked, ctx->id2top, ctx->bp);
+  setPosOfFixed(fp, id_picked, &pos_new, dim);
+  const double e_locsum_aft = calc_loc_energy(fp, id_picked, ctx->id2top, ctx->bp);
+
+  if (newStateIsAccepted(e_locsum_aft - e_locsum_bef, ctx->mtst))
+  {
+    (*num_accepted)++;
+  }
+  else
+  {
+    setPosOfFixed(fp, id_picked, &pos_tmp, dim);
+  }
+}
+
+// NOTE: same as mcStep for a given particle, but a trial position whose x
+//       leaves [slab_lo, slab_lo + slab_width) (periodic) is rejected.
+bool mcStepInSlab(PosStore *store,
+                  MTstate *mtst,
+                  const ptclid2topol *id2top,
+                  const Boundary *bound,
+                  const double disp,
+                  const BondedParam *bp,
+                  const int32_t id_picked,
+                  const double slab_lo,
+                  const double slab_width,
+                  const double box_x)
+{
+  const dvec pos_tmp = getPosOfStore(store, id_picked);
+  const dvec pos_new = kickParticle(&pos_tmp, disp, mtst, bound, bound->type, bound->dim);
+  double u = pos_new.x - slab_lo;
+  u -= box_x * floor(u / box_x);
+  if (u >= slab_width)
+  {
+    return false;
+  }
+
+  const double e_locsum_bef = calcLocEnergy(store, id_picked, id2top, bound, bp, NULL);
+  setPosOfStore(store, id_picked, &pos_new);
+  const double e_locsum_aft = calcLocEnergy(store, id_picked, id2top, bound, bp, NULL);
+
+  if (newStateIsAccepted(e_locsum_aft - e_locsum_bef, mtst))
+  {
+    return true;
+  }
+  setPosOfStore(store, id_picked, &pos_tmp);
+  return false;
+}
+
+static double calcAngleEnergyIfValid(const PosStore *store,
+                                     const int32_t i0,
+                                     const int32_t i1,
+                                     const int32_t i2,
+                                     const BondedParam *bp,
+                                     const Boundary *bound)
+{
+  if (i0 < 0 || i2 < 0)
+  {
+    return 0.0;
+  }
+  const dvec r0 = getPosOfStore(store, i0);
+  const dvec r1 = getPosOfStore(store, i1);
+  const dvec r2 = getPosOfStore(store, i2);
+  return calcAngleTermEnergy(&r0, &r1, &r2, bp, bound);
+}
+
+// NOTE: connectivity-altering move for melts. The bonds (i, i1) and (j, j1)
+//       are replaced by (i, j) and (i1, j1); only the two bonds and the
+//       angles centered at the four end particles change, so the energy
+//       difference does not depend on the chain length.
+//       i is drawn uniformly and the chain of j among the n_i partner
+//       chains of i within double_bridge_cutoff (see countBridgePartners).
+//       The same move is drawn from j with probability 1 / n_j, and the
+//       reverse move from i or i1 with 1 / n'_i or 1 / n'_i1 (the partners
+//       after the move), so that it is accepted with
+//       min(1, exp(-dE) (1 / n'_i + 1 / n'_i1) / (1 / n_i + 1 / n_j)).
+//       The reverse move needs i1 within the cutoff of i.
+static void doubleBridgeStep(System *system,
+                             Melt *melt,
+                             MTstate *mtst,
+                             const Boundary *bound,
+                             const BondedParam *bp)
+{
+  const int32_t num_chains = getNumChainsOfMelt(melt);
+  const int32_t n = getChainLenOfMelt(melt);
+  const int32_t i = genrand_int31_range(mtst, 0, num_chains * n - 1);
+  const PosStore *store = getPosStore(system);
+  const int32_t num_fwd_i = countBridgePartners(melt, store, bound, i, NULL);
+  if (num_fwd_i == 0)
+  {
+    recordDoubleBridge(melt, false);
+    return;
+  }
+
+  const int32_t chain_a = getChainIdOfPtcl(melt, i);
+  const int32_t a = getChainIndexOfPtcl(melt, i);
+  const int32_t chain_b = getBridgePartner(melt, store, bound, i, genrand_int31_range(mtst, 0, num_fwd_i - 1));
+  const int32_t b = n - 2 - a;
+  const int32_t *seq_a = getChainSeq(melt, chain_a);
+  const int32_t *seq_b = getChainSeq(melt, chain_b);
+  const int32_t i1 = seq_a[a + 1];
+  const int32_t j = seq_b[b];
+  const int32_t j1 = seq_b[b + 1];
+  if (!isWithinBridgeCutoff(melt, store, bound, i, i1))
+  {
+    recordDoubleBridge(melt, false);
+    return;
+  }
+  const int32_t i_prev = (a >= 1) ? seq_a[a - 1] : -1;
+  const int32_t i1_next = (a + 2 <= n - 1) ? seq_a[a + 2] : -1;
+  const int32_t j_prev = (b >= 1) ? seq_b[b - 1] : -1;
+  const int32_t j1_next = (b + 2 <= n - 1) ? seq_b[b + 2] : -1;
+
+  const dvec ri = getPosOfStore(store, i);
+  const dvec ri1 = getPosOfStore(store, i1);
+  const dvec rj = getPosOfStore(store, j);
+  const dvec rj1 = getPosOfStore(store, j1);
+  const double e_bef = calcBondTermEnergy(&ri, &ri1, bp, bound)
+    + calcBondTermEnergy(&rj, &rj1, bp, bound)
+    + calcAngleEnergyIfValid(store, i_prev, i, i1, bp, bound)
+    + calcAngleEnergyIfValid(store, i, i1, i1_next, bp, bound)
+    + calcAngleEnergyIfValid(store, j_prev, j, j1, bp, bound)
+    + calcAngleEnergyIfValid(store, j, j1, j1_next, bp, bound);
+  const double e_aft = calcBondTermEnergy(&ri, &rj, bp, bound)
+    + calcBondTermEnergy(&ri1, &rj1, bp, bound)
+    + calcAngleEnergyIfValid(store, i_prev, i, j, bp, bound)
+    + calcAngleEnergyIfValid(store, i, j, j_prev, bp, bound)
+    + calcAngleEnergyIfValid(store, i1_next, i1, j1, bp, bound)
+    + calcAngleEnergyIfValid(store, i1, j1, j1_next, bp, bound);
+
+  // NOTE: the partner counts other than n_i are needed only if the move
+  //       can pass with the largest ratio, 2 n_i.
+  const double threshold = genrand_res53(mtst) * exp(e_aft - e_bef);
+  bool is_accepted = false;
+  if (threshold < 2.0 * num_fwd_i)
+  {
+    const BridgeMove move = {chain_a, chain_b, a};
+    const int32_t num_fwd_j = countBridgePartners(melt, store, bound, j, NULL);
+    const int32_t num_rev_i = countBridgePartners(melt, store, bound, i, &move);
+    const int32_t num_rev_i1 = countBridgePartners(melt, store, bound, i1, &move);
+    const double prob_fwd = 1.0 / num_fwd_i + 1.0 / num_fwd_j;
+    const double prob_rev = 1.0 / num_rev_i + 1.0 / num_rev_i1;
+    is_accepted = threshold < prob_rev / prob_fwd;
+  }
+  if (is_accepted)
+  {
+    rewireMelt(melt, getTopol(system), getPtclId2Topol(system), chain_a, chain_b, a);
+  }
+  recordDoubleBridge(melt, is_accepted);
+}
+
+// NOTE: the particle (and its topology record) is prefetched when its id
+//       is drawn, and its bonded partners half a pipeline later, once the
+//       topology record is expected to be in cache.
+static void prefetchSite(const PosStore *store,
+                         const ptclid2topol *id2top,
+                         const int32_t id)
+{
+  PREFETCH_WRITE(&store->x[id]);
+  PREFETCH_WRITE(&store->y[id]);
+  if (store->z)
+  {
+    PREFETCH_WRITE(&store->z[id]);
+  }
+  PREFETCH_READ(&id2top->rows[id]);
+}
+
+static void prefetchPartners(const PosStore *store,
+                             const ptclid2topol *id2top,
+                             const int32_t id)
+{
+  const int32_t num_bonds = getNumPairsOfPtcl(id2top, id);
+  for (int32_t bond = 0; bond < num_bonds; bond++)
+  {
+    const pair *b = getPairOfPtcl(id2top, id, bond);
+    PREFETCH_READ(&store->x[b->i0]);
+    PREFETCH_READ(&store->x[b->i1]);
+  }
+  const int32_t num_angles = getNumTriplesOfPtcl(id2top, id);
+  for (int32_t angle = 0; angle < num_angles; angle++)
   {
-    id_movable_lo++;
-    id_movable_hi--;
+    const triple *a = getTripleOfPtcl(id2top, id, angle);
+    PREFETCH_READ(&store->x[a->i0]);
+    PREFETCH_READ(&store->x[a->i2]);
   }
+}
 
-  dvec *pos = getPos(system);
-  ptclid2topol *id2top = getPtclId2Topol(system);
+// NOTE: random-site sweep in which the site ids are drawn prefetch_dist
+//       steps ahead of their use. The sites are still chosen uniformly and
+//       independently, but the random number stream is consumed in a
+//       different order from the plain sweep.
+static ALWAYS_INLINE double sweepPipelined(const SweepContext *ctx,
+                                           const locEnergyFunc calc_loc_energy,
+                                           const trialEnergyFunc calc_trial_energy,
+                                           const BOUNDARY_TYPE bc,
+                                           const int32_t dim)
+{
+  const PosStore *store = ctx->store;
+  const ptclid2topol *id2top = ctx->id2top;
+  const int32_t prefetch_dist = ctx->prefetch_dist;
+  int32_t ring[MAX_PREFETCH_DIST];
+  const int32_t half_dist = prefetch_dist / 2;
+  for (int32_t k = 0; k < prefetch_dist; k++)
+  {
+    ring[k] = genrand_int31_range(ctx->mtst, ctx->id_lo, ctx->id_hi);
+    prefetchSite(store, id2top, ring[k]);
+  }
 
   int32_t num_accepted = 0;
-  for (int32_t p = 0; p < num_ptcl; p++)
+  int32_t head = 0;
+  for (int32_t p = 0; p < ctx->num_steps; p++)
+  {
+    const int32_t id_picked = ring[head];
+    ring[head] = genrand_int31_range(ctx->mtst, ctx->id_lo, ctx->id_hi);
+    prefetchSite(store, id2top, ring[head]);
+    head = (head + 1 == prefetch_dist) ? 0 : head + 1;
+
+    int32_t mid = head + half_dist;
+    if (mid >= prefetch_dist)
+    {
+      mid -= prefetch_dist;
+    }
+    prefetchPartners(store, id2top, ring[mid]);
+
+    mcStep(ctx, calc_loc_energy, calc_trial_energy, bc, dim, &num_accepted, id_picked);
+  }
+  return (double)num_accepted / (double)ctx->num_steps;
+}
+
+// NOTE: the site of step p of the sweep, drawn uniformly unless the sweep
+//       follows an order (see site_order.h).
+static ALWAYS_INLINE int32_t pickSite(const SweepContext *ctx,
+                                      const int32_t p)
+{
+  if (ctx->order)
+  {
+    return ctx->order[p];
+  }
+  return genrand_int31_range(ctx->mtst, ctx->id_lo, ctx->id_hi);
+}
+
+// NOTE: the sites of an ordered sweep are known in advance, and are
+//       prefetched prefetch_dist steps before they are moved. A step of such
+//       a sweep may be a double-bridge move instead, whose site is then
+//       skipped in this sweep.
+static ALWAYS_INLINE double sweepRandom(const SweepContext *ctx,
+                                        const locEnergyFunc calc_loc_energy,
+                                        const trialEnergyFunc calc_trial_energy,
+                                        const BOUNDARY_TYPE bc,
+                                        const int32_t dim)
+{
+  int32_t num_accepted = 0, num_trials = 0;
+  for (int32_t p = 0; p < ctx->num_steps; p++)
   {
-    mcStep(pos, mtst, &num_accepted, id2top, bound,
-           step_len, cf_bond, cf_angle, l0,
-           id_movable_lo, id_movable_hi);
+    if (ctx->double_bridge_prob > 0.0 && genrand_res53(ctx->mtst) < ctx->double_bridge_prob)
+    {
+      doubleBridgeStep(ctx->system, ctx->melt, ctx->mtst, ctx->bound, ctx->bp);
+      continue;
+    }
+    if (ctx->order && ctx->prefetch_dist > 0 && p + ctx->prefetch_dist < ctx->num_steps)
+    {
+      prefetchSite(ctx->store, ctx->id2top, ctx->order[p + ctx->prefetch_dist]);
+    }
+    const int32_t id_picked = pickSite(ctx, p);
+    mcStep(ctx, calc_loc_energy, calc_trial_energy, bc, dim, &num_accepted, id_picked);
+    num_trials++;
   }
 
-  return (double)num_accepted / (double)num_ptcl;
+  return (num_trials > 0) ? (double)num_accepted / (double)num_trials : 0.0;
 }
 
-// TODO(erwan): this seems directionally correct, but prob not quite right
-bool legalParticule(const dvec *pos, int32_t num_ptcl, const Boundary *bound)
+static ALWAYS_INLINE double sweepRandomSingle(const SweepContext *ctx,
+                                              const locEnergySingleFunc calc_loc_energy,
+                                              const BOUNDARY_TYPE bc,
+                                              const int32_t dim)
 {
-  const double MIN_DISTANCE_MONOMER = 1.0; // really a placeholder for now
+  int32_t num_accepted = 0;
+  double de_accepted = 0.0;
+  for (int32_t p = 0; p < ctx->num_steps; p++)
+  {
+    const int32_t id_picked = pickSite(ctx, p);
+    mcStepSingle(ctx, calc_loc_energy, bc, dim, &num_accepted, &de_accepted, id_picked);
+  }
+  ctx->single->e_bonded += de_accepted;
+  return (double)num_accepted / (double)ctx->num_steps;
+}
 
-  for (int32_t i = 0; i < num_ptcl - 1; i++)
+static ALWAYS_INLINE double sweepRandomFixed(const SweepContext *ctx,
+                                             const locEnergyFixedFunc calc_loc_energy,
+                                             const int32_t dim)
+{
+  int32_t num_accepted = 0;
+  for (int32_t p = 0; p < ctx->num_steps; p++)
   {
-    for (int32_t j = i + 1; j < num_ptcl; j++)
+    const int32_t id_picked = pickSite(ctx, p);
+    mcStepFixed(ctx, calc_loc_energy, dim, &num_accepted, id_picked);
+  }
+  return (double)num_accepted / (double)ctx->num_steps;
+}
+
+#define KERNEL_SUFFIX(BOND, ANGLE, BC, DIM) CONCAT(CONCAT(CONCAT(CONCAT(CONCAT(CONCAT(BOND, _), ANGLE), _), BC), _), DIM)
+#define LOC_ENERGY_NAME(BOND, ANGLE, BC, DIM) CONCAT(calcLocEnergy_, KERNEL_SUFFIX(BOND, ANGLE, BC, DIM))
+#define SWEEP_NAME(BOND, ANGLE, BC, DIM) CONCAT(sweep_, KERNEL_SUFFIX(BOND, ANGLE, BC, DIM))
+#define LOC_ENERGY_TRIAL_NAME(BOND, ANGLE, BC, DIM) CONCAT(calcLocEnergyTrial_, KERNEL_SUFFIX(BOND, ANGLE, BC, DIM))
+#define SWEEP_CACHED_NAME(BOND, ANGLE, BC, DIM) CONCAT(sweepCached_, KERNEL_SUFFIX(BOND, ANGLE, BC, DIM))
+#define LOC_ENERGY_SINGLE_NAME(BOND, ANGLE, BC, DIM) CONCAT(calcLocEnergySingle_, KERNEL_SUFFIX(BOND, ANGLE, BC, DIM))
+#define SWEEP_SINGLE_NAME(BOND, ANGLE, BC, DIM) CONCAT(sweepSingle_, KERNEL_SUFFIX(BOND, ANGLE, BC, DIM))
+#define LOC_ENERGY_FIXED_NAME(BOND, ANGLE, DIM) CONCAT(calcLocEnergyFixed_, KERNEL_SUFFIX(BOND, ANGLE, PERIODIC, DIM))
+#define SWEEP_FIXED_NAME(BOND, ANGLE, DIM) CONCAT(sweepFixed_, KERNEL_SUFFIX(BOND, ANGLE, PERIODIC, DIM))
+
+// NOTE: one local energy and one sweep per bond/angle potential pair,
+//       boundary type and dimension. The potential kernels are called
+//       directly from the inner loop, with the minimum image of the
+//       boundary inlined; the 2D kernels never touch z.
+#define DEFINE_BONDED_KERNELS(BOND, ANGLE, BC, DIM)                                         \
+  static double LOC_ENERGY_NAME(BOND, ANGLE, BC, DIM)(const PosStore *store,                \
+                                                      const int32_t id_picked,              \
+                                                      const ptclid2topol *id2top,           \
+                                                      const ImplicitTopol *implicit,        \
+                                                      const Boundary *bound,                \
+                                                      const BondedParam *bp,                \
+                                                      const VerletList *verlet)             \
+  {                                                                                         \
+    (void)implicit;                                                                         \
+    double esum = verlet ? calcNonbondEnergyLocal(verlet, store, id_picked, bound) : 0.0;   \
+    const int32_t num_bonds = getNumPairsOfPtcl(id2top, id_picked);                         \
+    for (int32_t bond = 0; bond < num_bonds; bond++)                                        \
+    {                                                                                       \
+      const pair *b = getPairOfPtcl(id2top, id_picked, bond);                               \
+      const dvec r0 = getPosOfStoreDim(store, b->i0, DIM);                                  \
+      const dvec r1 = getPosOfStoreDim(store, b->i1, DIM);                                  \
+      esum += CONCAT(calcBondEnergy_, BOND)(&r0, &r1, bp, bound, BC, DIM);                  \
+    }                                                                                       \
+    const int32_t num_angles = getNumTriplesOfPtcl(id2top, id_picked);                      \
+    for (int32_t angle = 0; angle < num_angles; angle++)                                    \
+    {                                                                                       \
+      const triple *a = getTripleOfPtcl(id2top, id_picked, angle);                          \
+      const dvec r0 = getPosOfStoreDim(store, a->i0, DIM);                                  \
+      const dvec r1 = getPosOfStoreDim(store, a->i1, DIM);                                  \
+      const dvec r2 = getPosOfStoreDim(store, a->i2, DIM);                                  \
+      esum += CONCAT(calcAngleEnergy_, ANGLE)(&r0, &r1, &r2, bp, bound, BC, DIM);           \
+    }                                                                                       \
+    return esum;                                                                            \
+  }                                                                                         \
+                                                                                            \
+  TARGET_CLONES                                                                             \
+  static double SWEEP_NAME(BOND, ANGLE, BC, DIM)(const SweepContext *ctx)                   \
+  {                                                                                         \
+    if (ctx->prefetch_dist > 0 && ctx->double_bridge_prob == 0.0 && !ctx->order)            \
+    {                                                                                       \
+      return sweepPipelined(ctx, LOC_ENERGY_NAME(BOND, ANGLE, BC, DIM), NULL, BC, DIM);     \
+    }                                                                                       \
+    return sweepRandom(ctx, LOC_ENERGY_NAME(BOND, ANGLE, BC, DIM), NULL, BC, DIM);          \
+  }                                                                                         \
+                                                                                            \
+  static double LOC_ENERGY_TRIAL_NAME(BOND, ANGLE, BC, DIM)(const PosStore *store,          \
+                                                            const int32_t id_picked,        \
+                                                            const ptclid2topol *id2top,     \
+                                                            BondCache *bcache,              \
+                                                            const Boundary *bound,          \
+                                                            const BondedParam *bp,          \
+                                                            const VerletList *verlet)       \
+  {                                                                                         \
+    double esum = verlet ? calcNonbondEnergyLocal(verlet, store, id_picked, bound) : 0.0;   \
+    const Id2TopolRow *row = &id2top->rows[id_picked];                                      \
+    CachedBond *trial = bcache->trial_bonds;                                                \
+    for (int32_t bond = 0; bond < row->num_pair; bond++)                                    \
+    {                                                                                       \
+      const pair *b = getPairOfPtcl(id2top, id_picked, bond);                               \
+      const dvec r0 = getPosOfStoreDim(store, b->i0, DIM);                                  \
+      const dvec r1 = getPosOfStoreDim(store, b->i1, DIM);                                  \
+      trial[bond].dr = calcDispOf(&r0, &r1, bound, BC, DIM);                                \
+      trial[bond].r2 = dvec_dot_of(&trial[bond].dr, &trial[bond].dr, DIM);                  \
+      trial[bond].energy = CONCAT(calcBondEnergyOfR2_, BOND)(trial[bond].r2, bp);           \
+      esum += trial[bond].energy;                                                           \
+    }                                                                                       \
+    const AngleBondRef *refs = &bcache->refs[row->triple_begin];                            \
+    for (int32_t angle = 0; angle < row->num_triple; angle++)                               \
+    {                                                                                       \
+      const AngleBondRef *ref = &refs[angle];                                               \
+      const CachedBond *b01 = (ref->slot[0] >= 0) ? &trial[ref->slot[0]] : &bcache->bonds[ref->bond[0]]; \
+      const CachedBond *b12 = (ref->slot[1] >= 0) ? &trial[ref->slot[1]] : &bcache->bonds[ref->bond[1]]; \
+      const double cs = ref->sign * dvec_dot_of(&b01->dr, &b12->dr, DIM) / sqrt(b01->r2 * b12->r2); \
+      bcache->trial_angle_energy[angle] = CONCAT(calcAngleEnergyOfCos_, ANGLE)(cs, bp);     \
+      esum += bcache->trial_angle_energy[angle];                                            \
+    }                                                                                       \
+    return esum;                                                                            \
+  }                                                                                         \
+                                                                                            \
+  TARGET_CLONES                                                                             \
+  static double SWEEP_CACHED_NAME(BOND, ANGLE, BC, DIM)(const SweepContext *ctx)            \
+  {                                                                                         \
+    if (ctx->prefetch_dist > 0 && !ctx->order)                                              \
+    {                                                                                       \
+      return sweepPipelined(ctx, NULL, LOC_ENERGY_TRIAL_NAME(BOND, ANGLE, BC, DIM), BC, DIM); \
+    }                                                                                       \
+    return sweepRandom(ctx, NULL, LOC_ENERGY_TRIAL_NAME(BOND, ANGLE, BC, DIM), BC, DIM);    \
+  }                                                                                         \
+                                                                                            \
+  static ALWAYS_INLINE double LOC_ENERGY_SINGLE_NAME(BOND, ANGLE, BC, DIM)(const SinglePosStore *sp, \
+                                                                           const int32_t id_picked, \
+                                                                           const fvec *pos_new, \
+                                                                           const ptclid2topol *id2top, \
+                                                                           const BondedParamSingle *bps) \
+  {                                                                                         \
+    return calcLocEnergyChangeSingle(sp, id_picked, pos_new, id2top, bps,                   \
+                                     CONCAT(calcBondEnergyLanesSingle_, BOND),              \
+                                     CONCAT(calcAngleEnergyLanesSingle_, ANGLE), BC, DIM);  \
+  }                                                                                         \
+                                                                                            \
+  TARGET_CLONES                                                                             \
+  static double SWEEP_SINGLE_NAME(BOND, ANGLE, BC, DIM)(const SweepContext *ctx)            \
+  {                                                                                         \
+    return sweepRandomSingle(ctx, LOC_ENERGY_SINGLE_NAME(BOND, ANGLE, BC, DIM), BC, DIM);   \
+  }
+
+#define DEFINE_BONDED_KERNELS_FOR_BOND(BOND, BC, DIM)  \
+  DEFINE_BONDED_KERNELS(BOND, kratky_porod, BC, DIM)   \
+  DEFINE_BONDED_KERNELS(BOND, cosine_squared, BC, DIM) \
+  DEFINE_BONDED_KERNELS(BOND, tabulated, BC, DIM)
+
+#define DEFINE_BONDED_KERNELS_FOR_SPACE(BC, DIM)       \
+  DEFINE_BONDED_KERNELS_FOR_BOND(harmonic, BC, DIM)    \
+  DEFINE_BONDED_KERNELS_FOR_BOND(fene, BC, DIM)        \
+  DEFINE_BONDED_KERNELS_FOR_BOND(tabulated, BC, DIM)
+
+DEFINE_BONDED_KERNELS_FOR_SPACE(PERIODIC, 2)
+DEFINE_BONDED_KERNELS_FOR_SPACE(PERIODIC, 3)
+DEFINE_BONDED_KERNELS_FOR_SPACE(FREE, 2)
+DEFINE_BONDED_KERNELS_FOR_SPACE(FREE, 3)
+
+// NOTE: the fixed-point kernels exist only for the periodic boundary; the
+//       energies are evaluated in float64 from the minimum-image
+//       displacements (see fixed_pos.h).
+#define DEFINE_FIXED_KERNELS(BOND, ANGLE, DIM)                                              \
+  static double LOC_ENERGY_FIXED_NAME(BOND, ANGLE, DIM)(const FixedPosStore *fp,            \
+                                                        const int32_t id_picked,            \
+                                                        const ptclid2topol *id2top,         \
+                                                        const BondedParam *bp)              \
+  {                                                                                         \
+    double esum = 0.0;                                                                      \
+    const int32_t num_bonds = getNumPairsOfPtcl(id2top, id_picked);                         \
+    for (int32_t bond = 0; bond < num_bonds; bond++)                                        \
+    {                                                                                       \
+      const pair *b = getPairOfPtcl(id2top, id_picked, bond);                               \
+      const uvec r0 = getPosOfFixed(fp, b->i0, DIM);                                        \
+      const uvec r1 = getPosOfFixed(fp, b->i1, DIM);                                        \
+      esum += CONCAT(calcBondEnergyOfR2_, BOND)(distance2Fixed(&r0, &r1, fp, DIM), bp);     \
+    }                                                                                       \
+    const int32_t num_angles = getNumTriplesOfPtcl(id2top, id_picked);                      \
+    for (int32_t angle = 0; angle < num_angles; angle++)                                    \
+    {                                                                                       \
+      const triple *a = getTripleOfPtcl(id2top, id_picked, angle);                          \
+      const uvec r0 = getPosOfFixed(fp, a->i0, DIM);                                        \
+      const uvec r1 = getPosOfFixed(fp, a->i1, DIM);                                        \
+      const uvec r2 = getPosOfFixed(fp, a->i2, DIM);                                        \
+      esum += CONCAT(calcAngleEnergyOfCos_, ANGLE)(cosAngleFixed(&r0, &r1, &r2, fp, DIM), bp); \
+    }                                                                                       \
+    return esum;                                                                            \
+  }                                                                                         \
+                                                                                            \
+  TARGET_CLONES                                                                             \
+  static double SWEEP_FIXED_NAME(BOND, ANGLE, DIM)(const SweepContext *ctx)                 \
+  {                                                                                         \
+    return sweepRandomFixed(ctx, LOC_ENERGY_FIXED_NAME(BOND, ANGLE, DIM), DIM);             \
+  }
+
+#define DEFINE_FIXED_KERNELS_FOR_BOND(BOND, DIM)  \
+  DEFINE_FIXED_KERNELS(BOND, kratky_porod, DIM)   \
+  DEFINE_FIXED_KERNELS(BOND, cosine_squared, DIM) \
+  DEFINE_FIXED_KERNELS(BOND, tabulated, DIM)
+
+#define DEFINE_FIXED_KERNELS_FOR_DIM(DIM)       \
+  DEFINE_FIXED_KERNELS_FOR_BOND(harmonic, DIM)  \
+  DEFINE_FIXED_KERNELS_FOR_BOND(fene, DIM)      \
+  DEFINE_FIXED_KERNELS_FOR_BOND(tabulated, DIM)
+
+DEFINE_FIXED_KERNELS_FOR_DIM(2)
+DEFINE_FIXED_KERNELS_FOR_DIM(3)
+
+// NOTE: bond k of a chain of n particles joins k and k + 1, and angle k
+//       spans k to k + 2, modulo n on a ring. Writes the k of the terms of
+//       the given width (1 for bonds, 2 for angles) that contain id, in
+//       increasing order as in the explicit rows: the wrapped k of a ring
+//       come last. The sum of the terms is then the same bit for bit.
+static ALWAYS_INLINE int32_t calcChainTermStarts(const int32_t id,
+                                                 const int32_t width,
+                                                 const int32_t n,
+                                                 const bool is_ring,
+                                                 int32_t *ks)
+{
+  int32_t num_terms = 0;
+  for (int32_t k = id - width; k <= id; k++)
+  {
+    if (k >= 0 && (is_ring || k + width < n))
     {
-      if (checkParticleOverlap(pos, num_ptcl, bound))
-      {
-        return false;
-      }
+      ks[num_terms++] = k;
+    }
+  }
+  if (is_ring)
+  {
+    for (int32_t k = id - width; k < 0; k++)
+    {
+      ks[num_terms++] = k + n;
+    }
+  }
+  return num_terms;
+}
+
+static ALWAYS_INLINE int32_t wrapChainIndex(const int32_t k,
+                                            const int32_t n)
+{
+  return (k < n) ? k : k - n;
+}
+
+#define LOC_ENERGY_CHAIN_NAME(BOND, ANGLE, BC) CONCAT(calcLocEnergyChain_, KERNEL_SUFFIX(BOND, ANGLE, BC, 2))
+#define SWEEP_CHAIN_NAME(BOND, ANGLE, BC) CONCAT(sweepChain_, KERNEL_SUFFIX(BOND, ANGLE, BC, 2))
+#define LOC_ENERGY_MESH_NAME(BOND, ANGLE) CONCAT(calcLocEnergyMesh_, KERNEL_SUFFIX(BOND, ANGLE, PERIODIC, 3))
+#define SWEEP_MESH_NAME(BOND, ANGLE) CONCAT(sweepMesh_, KERNEL_SUFFIX(BOND, ANGLE, PERIODIC, 3))
+
+// NOTE: the implicit-topology kernels of the 2D chain (a ring under the
+//       periodic boundary, see newTopolChain) and the periodic 3D mesh (see
+//       newTopolMesh, where the x bonds precede the y bonds, and likewise
+//       for the angles).
+#define DEFINE_IMPLICIT_KERNELS(BOND, ANGLE, BC)                                            \
+  static double LOC_ENERGY_CHAIN_NAME(BOND, ANGLE, BC)(const PosStore *store,               \
+                                                       const int32_t id_picked,             \
+                                                       const ptclid2topol *id2top,          \
+                                                       const ImplicitTopol *implicit,       \
+                                                       const Boundary *bound,               \
+                                                       const BondedParam *bp,               \
+                                                       const VerletList *verlet)            \
+  {                                                                                         \
+    (void)id2top;                                                                           \
+    double esum = verlet ? calcNonbondEnergyLocal(verlet, store, id_picked, bound) : 0.0;   \
+    const int32_t n = implicit->num_ptcl;                                                   \
+    int32_t ks[3];                                                                          \
+    const int32_t num_bonds = calcChainTermStarts(id_picked, 1, n, BC == PERIODIC, ks);     \
+    for (int32_t bond = 0; bond < num_bonds; bond++)                                        \
+    {                                                                                       \
+      const int32_t k = ks[bond];                                                           \
+      const dvec r0 = getPosOfStoreDim(store, k, 2);                                        \
+      const dvec r1 = getPosOfStoreDim(store, wrapChainIndex(k + 1, n), 2);                 \
+      esum += CONCAT(calcBondEnergy_, BOND)(&r0, &r1, bp, bound, BC, 2);                    \
+    }                                                                                       \
+    const int32_t num_angles = calcChainTermStarts(id_picked, 2, n, BC == PERIODIC, ks);    \
+    for (int32_t angle = 0; angle < num_angles; angle++)                                    \
+    {                                                                                       \
+      const int32_t k = ks[angle];                                                          \
+      const dvec r0 = getPosOfStoreDim(store, k, 2);                                        \
+      const dvec r1 = getPosOfStoreDim(store, wrapChainIndex(k + 1, n), 2);                 \
+      const dvec r2 = getPosOfStoreDim(store, wrapChainIndex(k + 2, n), 2);                 \
+      esum += CONCAT(calcAngleEnergy_, ANGLE)(&r0, &r1, &r2, bp, bound, BC, 2);             \
+    }                                                                                       \
+    return esum;                                                                            \
+  }                                                                                         \
+                                                                                            \
+  TARGET_CLONES                                                                             \
+  static double SWEEP_CHAIN_NAME(BOND, ANGLE, BC)(const SweepContext *ctx)                  \
+  {                                                                                         \
+    return sweepRandom(ctx, LOC_ENERGY_CHAIN_NAME(BOND, ANGLE, BC), NULL, BC, 2);           \
+  }
+
+#define DEFINE_MESH_KERNELS(BOND, ANGLE)                                                    \
+  static double LOC_ENERGY_MESH_NAME(BOND, ANGLE)(const PosStore *store,                    \
+                                                  const int32_t id_picked,                  \
+                                                  const ptclid2topol *id2top,               \
+                                                  const ImplicitTopol *implicit,            \
+                                                  const Boundary *bound,                    \
+                                                  const BondedParam *bp,                    \
+                                                  const VerletList *verlet)                 \
+  {                                                                                         \
+    (void)id2top;                                                                           \
+    double esum = verlet ? calcNonbondEnergyLocal(verlet, store, id_picked, bound) : 0.0;   \
+    const int32_t sx = implicit->side_dim_x;                                                \
+    const int32_t sy = implicit->side_dim_y;                                                \
+    const int32_t x = id_picked % sx;                                                       \
+    const int32_t row = id_picked - x;                                                      \
+    const int32_t y = row / sx;                                                             \
+    int32_t ks[3];                                                                          \
+    int32_t num_terms = calcChainTermStarts(x, 1, sx, true, ks);                            \
+    for (int32_t t = 0; t < num_terms; t++)                                                 \
+    {                                                                                       \
+      const int32_t k = ks[t];                                                              \
+      const dvec r0 = getPosOfStoreDim(store, row + k, 3);                                  \
+      const dvec r1 = getPosOfStoreDim(store, row + wrapChainIndex(k + 1, sx), 3);          \
+      esum += CONCAT(calcBondEnergy_, BOND)(&r0, &r1, bp, bound, PERIODIC, 3);              \
+    }                                                                                       \
+    num_terms = calcChainTermStarts(y, 1, sy, true, ks);                                    \
+    for (int32_t t = 0; t < num_terms; t++)                                                 \
+    {                                                                                       \
+      const int32_t k = ks[t];                                                              \
+      const dvec r0 = getPosOfStoreDim(store, x + k * sx, 3);                               \
+      const dvec r1 = getPosOfStoreDim(store, x + wrapChainIndex(k + 1, sy) * sx, 3);       \
+      esum += CONCAT(calcBondEnergy_, BOND)(&r0, &r1, bp, bound, PERIODIC, 3);              \
+    }                                                                                       \
+    num_terms = calcChainTermStarts(x, 2, sx, true, ks);                                    \
+    for (int32_t t = 0; t < num_terms; t++)                                                 \
+    {                                                                                       \
+      const int32_t k = ks[t];                                                              \
+      const dvec r0 = getPosOfStoreDim(store, row + k, 3);                                  \
+      const dvec r1 = getPosOfStoreDim(store, row + wrapChainIndex(k + 1, sx), 3);          \
+      const dvec r2 = getPosOfStoreDim(store, row + wrapChainIndex(k + 2, sx), 3);          \
+      esum += CONCAT(calcAngleEnergy_, ANGLE)(&r0, &r1, &r2, bp, bound, PERIODIC, 3);       \
+    }                                                                                       \
+    num_terms = calcChainTermStarts(y, 2, sy, true, ks);                                    \
+    for (int32_t t = 0; t < num_terms; t++)                                                 \
+    {                                                                                       \
+      const int32_t k = ks[t];                                                              \
+      const dvec r0 = getPosOfStoreDim(store, x + k * sx, 3);                               \
+      const dvec r1 = getPosOfStoreDim(store, x + wrapChainIndex(k + 1, sy) * sx, 3);       \
+      const dvec r2 = getPosOfStoreDim(store, x + wrapChainIndex(k + 2, sy) * sx, 3);       \
+      esum += CONCAT(calcAngleEnergy_, ANGLE)(&r0, &r1, &r2, bp, bound, PERIODIC, 3);       \
+    }                                                                                       \
+    return esum;                                                                            \
+  }                                                                                         \
+                                                                                            \
+  TARGET_CLONES                                                                             \
+  static double SWEEP_MESH_NAME(BOND, ANGLE)(const SweepContext *ctx)                       \
+  {                                                                                         \
+    return sweepRandom(ctx, LOC_ENERGY_MESH_NAME(BOND, ANGLE), NULL, PERIODIC, 3);          \
+  }
+
+#define DEFINE_IMPLICIT_KERNELS_FOR_BOND(BOND, BC)  \
+  DEFINE_IMPLICIT_KERNELS(BOND, kratky_porod, BC)   \
+  DEFINE_IMPLICIT_KERNELS(BOND, cosine_squared, BC) \
+  DEFINE_IMPLICIT_KERNELS(BOND, tabulated, BC)
+
+#define DEFINE_IMPLICIT_KERNELS_FOR_BC(BC)       \
+  DEFINE_IMPLICIT_KERNELS_FOR_BOND(harmonic, BC) \
+  DEFINE_IMPLICIT_KERNELS_FOR_BOND(fene, BC)     \
+  DEFINE_IMPLICIT_KERNELS_FOR_BOND(tabulated, BC)
+
+DEFINE_IMPLICIT_KERNELS_FOR_BC(PERIODIC)
+DEFINE_IMPLICIT_KERNELS_FOR_BC(FREE)
+
+#define DEFINE_MESH_KERNELS_FOR_BOND(BOND)  \
+  DEFINE_MESH_KERNELS(BOND, kratky_porod)   \
+  DEFINE_MESH_KERNELS(BOND, cosine_squared) \
+  DEFINE_MESH_KERNELS(BOND, tabulated)
+
+DEFINE_MESH_KERNELS_FOR_BOND(harmonic)
+DEFINE_MESH_KERNELS_FOR_BOND(fene)
+DEFINE_MESH_KERNELS_FOR_BOND(tabulated)
+
+#define SWEEP_ROW(BOND, BC, DIM) \
+  { SWEEP_NAME(BOND, kratky_porod, BC, DIM), SWEEP_NAME(BOND, cosine_squared, BC, DIM), SWEEP_NAME(BOND, tabulated, BC, DIM) }
+#define SWEEP_TABLE(BC, DIM) \
+  { SWEEP_ROW(harmonic, BC, DIM), SWEEP_ROW(fene, BC, DIM), SWEEP_ROW(tabulated, BC, DIM) }
+#define SWEEP_CACHED_ROW(BOND, BC, DIM) \
+  { SWEEP_CACHED_NAME(BOND, kratky_porod, BC, DIM), SWEEP_CACHED_NAME(BOND, cosine_squared, BC, DIM), SWEEP_CACHED_NAME(BOND, tabulated, BC, DIM) }
+#define SWEEP_CACHED_TABLE(BC, DIM) \
+  { SWEEP_CACHED_ROW(harmonic, BC, DIM), SWEEP_CACHED_ROW(fene, BC, DIM), SWEEP_CACHED_ROW(tabulated, BC, DIM) }
+#define SWEEP_SINGLE_ROW(BOND, BC, DIM) \
+  { SWEEP_SINGLE_NAME(BOND, kratky_porod, BC, DIM), SWEEP_SINGLE_NAME(BOND, cosine_squared, BC, DIM), SWEEP_SINGLE_NAME(BOND, tabulated, BC, DIM) }
+#define SWEEP_SINGLE_TABLE(BC, DIM) \
+  { SWEEP_SINGLE_ROW(harmonic, BC, DIM), SWEEP_SINGLE_ROW(fene, BC, DIM), SWEEP_SINGLE_ROW(tabulated, BC, DIM) }
+#define SWEEP_FIXED_ROW(BOND, DIM) \
+  { SWEEP_FIXED_NAME(BOND, kratky_porod, DIM), SWEEP_FIXED_NAME(BOND, cosine_squared, DIM), SWEEP_FIXED_NAME(BOND, tabulated, DIM) }
+#define SWEEP_FIXED_TABLE(DIM) \
+  { SWEEP_FIXED_ROW(harmonic, DIM), SWEEP_FIXED_ROW(fene, DIM), SWEEP_FIXED_ROW(tabulated, DIM) }
+
+#define SWEEP_CHAIN_ROW(BOND, BC) \
+  { SWEEP_CHAIN_NAME(BOND, kratky_porod, BC), SWEEP_CHAIN_NAME(BOND, cosine_squared, BC), SWEEP_CHAIN_NAME(BOND, tabulated, BC) }
+#define SWEEP_CHAIN_TABLE(BC) \
+  { SWEEP_CHAIN_ROW(harmonic, BC), SWEEP_CHAIN_ROW(fene, BC), SWEEP_CHAIN_ROW(tabulated, BC) }
+#define SWEEP_MESH_ROW(BOND) \
+  { SWEEP_MESH_NAME(BOND, kratky_porod), SWEEP_MESH_NAME(BOND, cosine_squared), SWEEP_MESH_NAME(BOND, tabulated) }
+
+// NOTE: indexed by [BOUNDARY_TYPE][dim - 2][BOND_TYPE][ANGLE_TYPE] (see
+//       boundary.h and potential.h for the order).
+static const sweepFunc sweep_kernels[2][2][NUM_BOND_TYPES][NUM_ANGLE_TYPES] = {
+  { SWEEP_TABLE(PERIODIC, 2), SWEEP_TABLE(PERIODIC, 3) },
+  { SWEEP_TABLE(FREE, 2), SWEEP_TABLE(FREE, 3) },
+};
+
+static const sweepFunc sweep_kernels_cached[2][2][NUM_BOND_TYPES][NUM_ANGLE_TYPES] = {
+  { SWEEP_CACHED_TABLE(PERIODIC, 2), SWEEP_CACHED_TABLE(PERIODIC, 3) },
+  { SWEEP_CACHED_TABLE(FREE, 2), SWEEP_CACHED_TABLE(FREE, 3) },
+};
+
+static const sweepFunc sweep_kernels_single[2][2][NUM_BOND_TYPES][NUM_ANGLE_TYPES] = {
+  { SWEEP_SINGLE_TABLE(PERIODIC, 2), SWEEP_SINGLE_TABLE(PERIODIC, 3) },
+  { SWEEP_SINGLE_TABLE(FREE, 2), SWEEP_SINGLE_TABLE(FREE, 3) },
+};
+
+// NOTE: indexed by [dim - 2][BOND_TYPE][ANGLE_TYPE].
+static const sweepFunc sweep_kernels_fixed[2][NUM_BOND_TYPES][NUM_ANGLE_TYPES] = {
+  SWEEP_FIXED_TABLE(2),
+  SWEEP_FIXED_TABLE(3),
+};
+
+// NOTE: implicit topology; the chain kernels are indexed by
+//       [BOUNDARY_TYPE][BOND_TYPE][ANGLE_TYPE], the mesh kernels (periodic
+//       only) by [BOND_TYPE][ANGLE_TYPE].
+static const sweepFunc sweep_kernels_chain[2][NUM_BOND_TYPES][NUM_ANGLE_TYPES] = {
+  SWEEP_CHAIN_TABLE(PERIODIC),
+  SWEEP_CHAIN_TABLE(FREE),
+};
+
+static const sweepFunc sweep_kernels_mesh[NUM_BOND_TYPES][NUM_ANGLE_TYPES] = {
+  SWEEP_MESH_ROW(harmonic),
+  SWEEP_MESH_ROW(fene),
+  SWEEP_MESH_ROW(tabulated),
+};
+
+double evolveMc(System *system,
+                const Parameter *param,
+                const Boundary *bound,
+                MTstate *mtst)
+{
+  const int32_t num_ptcl = getNumPtcl(param);
+  Melt *melt = getMelt(system);
+
+  SweepContext ctx;
+  ctx.system = system;
+  ctx.store = getPosStore(system);
+  ctx.mtst = mtst;
+  ctx.id2top = getPtclId2Topol(system);
+  ctx.implicit = getImplicitTopol(system);
+  ctx.bound = bound;
+  ctx.disp = getStepLen(param);
+  ctx.bp = getBondedParam(system);
+  ctx.cells = getCellList(system);
+  ctx.hgrid = getHashGrid(system);
+  ctx.excl_diam = getExcludedDiameter(param);
+  ctx.verlet = getVerletList(system);
+  ctx.pppm = getPppm(system);
+  ctx.melt = melt;
+  ctx.double_bridge_prob = melt ? getDoubleBridgeProb(param) : 0.0;
+  ctx.num_steps = num_ptcl;
+
+  ctx.id_lo = 0;
+  ctx.id_hi = num_ptcl - 1;
+  // NOTE: all particles of a topology read from file are moved.
+  if (getBoundaryType(bound) == PERIODIC && !melt && !getTopologyFile(param))
+  {
+    ctx.id_lo++;
+    ctx.id_hi--;
+  }
+
+  ctx.prefetch_dist = getPrefetchDistance(param);
+  if (ctx.prefetch_dist < 0 || ctx.prefetch_dist > MAX_PREFETCH_DIST)
+  {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "prefetch_distance should be in [0, %d].\n", MAX_PREFETCH_DIST);
+    exit(1);
+  }
+
+  // NOTE: an ordered sweep moves each site once.
+  ctx.order = NULL;
+  SiteOrder *sorder = getSiteOrder(system);
+  if (sorder)
+  {
+    ctx.order = nextSiteOrder(sorder, mtst);
+    ctx.num_steps = getNumSitesOfSiteOrder(sorder);
+  }
+
+  // NOTE: the fixed-point and float32 positions are the stored ones; there
+  //       is no float64 PosStore during their sweeps (see loadPosStore in
+  //       system.c).
+  ctx.fixed = getFixedPosStore(system);
+  if (ctx.fixed)
+  {
+    return sweep_kernels_fixed[getBoundaryDim(bound) - 2][ctx.bp->bond_type][ctx.bp->angle_type](&ctx);
+  }
+  ctx.single = getSinglePosStore(system);
+  if (ctx.single)
+  {
+    ctx.bps = makeBondedParamSingle(ctx.bp);
+    return sweep_kernels_single[getBoundaryType(bound)][getBoundaryDim(bound) - 2][ctx.bp->bond_type][ctx.bp->angle_type](&ctx);
+  }
+  if (ctx.implicit)
+  {
+    if (getBoundaryDim(bound) == 3)
+    {
+      return sweep_kernels_mesh[ctx.bp->bond_type][ctx.bp->angle_type](&ctx);
     }
+    return sweep_kernels_chain[getBoundaryType(bound)][ctx.bp->bond_type][ctx.bp->angle_type](&ctx);
   }
+  ctx.bcache = getBondCache(system);
+  if (ctx.bcache && ctx.double_bridge_prob == 0.0)
+  {
+    return sweep_kernels_cached[getBoundaryType(bound)][getBoundaryDim(bound) - 2][ctx.bp->bond_type][ctx.bp->angle_type](&ctx);
+  }
+  return sweep_kernels[getBoundaryType(bound)][getBoundaryDim(bound) - 2][ctx.bp->bond_type][ctx.bp->angle_type](&ctx);
+}
 
-  if (bound == PERIODIC)
+bool legalParticule(const PosStore *store, int32_t num_ptcl, const Boundary *bound, const double min_dist)
+{
+  if (checkParticleOverlap(store, num_ptcl, bound, min_dist))
+  {
+    return false;
+  }
+
+  if (getBoundaryType(bound) == PERIODIC)
   {
     for (int32_t i = 0; i < num_ptcl; i++)
     {
-      if (!particuleBoundary(pos[i], bound))
+      if (!particuleBoundary(getPosOfStore(store, i), bound))
       {
         return false;
       }
@@ -212,6 +1193,7 @@ bool legalParticule(const dvec *pos, int32_t num_ptcl, const Boundary *bound)
 
   return true;
 }
+
 bool particuleBoundary(dvec point, const Boundary *bound)
 {
   if (getBoundaryType(bound) == FREE)
@@ -220,7 +1202,7 @@ bool particuleBoundary(dvec point, const Boundary *bound)
   }
   else if (getBoundaryType(bound) == PERIODIC)
   {
-    dvec boxLength;
+    const dvec boxLength = getBoundaryBoxLength(bound);
 
     return (point.x >= 0 && point.x <= boxLength.x &&
             point.y >= 0 && point.y <= boxLength.y &&
@@ -229,24 +1211,37 @@ bool particuleBoundary(dvec point, const Boundary *bound)
 
   return false;
 }
+
 double boundaryDistance(const dvec pos1, const dvec pos2, const Boundary *bound)
 {
-  return distance(&pos1, &pos2, bound); 
+  return distance(&pos1, &pos2, bound);
 }
 
-bool checkParticleOverlap(const dvec *pos, int32_t num_ptcl, const Boundary *bound)
+// NOTE: O(N) with a temporary cell list (periodic) or hash grid (free).
+bool checkParticleOverlap(const PosStore *store, int32_t num_ptcl, const Boundary *bound, const double min_dist)
 {
-  const double MIN_DISTANCE = 1.0; // this is a placeholder for now
-
-  for (int32_t i = 0; i < num_ptcl - 1; i++)
+  if (getBoundaryType(bound) == PERIODIC)
   {
-    for (int32_t j = i + 1; j < num_ptcl; j++)
+    CellList *cells = newCellList(bound, min_dist, num_ptcl);
+    buildCellList(cells, store);
+    bool overlaps = false;
+    for (int32_t i = 0; i < num_ptcl && !overlaps; i++)
     {
-      if (boundaryDistance(pos[i], pos[j], bound) < MIN_DISTANCE)
-      {
-        return true;
-      }
+      const dvec r = getPosOfStore(store, i);
+      overlaps = overlapsInCellList(cells, store, i, &r, min_dist, bound);
     }
+    deleteCellList(cells);
+    return overlaps;
   }
-  return false;
+
+  HashGrid *hgrid = newHashGrid(min_dist, num_ptcl, getBoundaryDim(bound));
+  buildHashGrid(hgrid, store);
+  bool overlaps = false;
+  for (int32_t i = 0; i < num_ptcl && !overlaps; i++)
+  {
+    const dvec r = getPosOfStore(store, i);
+    overlaps = overlapsInHashGrid(hgrid, store, i, &r, min_dist);
+  }
+  deleteHashGrid(hgrid);
+  return overlaps;
 }
@@ -0,0 +1,87 @@
+#include "fft.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "utils.h"
+#include "math_utils.h"
+
+bool isPowerOfTwo(const int32_t n)
+{
+  return (n > 0) && ((n & (n - 1)) == 0);
+}
+
+void fft1d(double complex* data,
+           const int32_t n,
+           const int32_t sign)
+{
+  // bit reversal permutation
+  for (int32_t i = 1, j = 0; i < n; i++) {
+    int32_t bit = n >> 1;
+    for (; j & bit; bit >>= 1) j ^= bit;
+    j ^= bit;
+    if (i < j) {
+      const double complex tmp = data[i];
+      data[i] = data[j];
+      data[j] = tmp;
+    }
+  }
+
+  for (int32_t len = 2; len <= n; len <<= 1) {
+    const double ang = sign * 2.0 * M_PI / len;
+    const double complex wlen = cos(ang) + I * sin(ang);
+    for (int32_t i = 0; i < n; i += len) {
+      double complex w = 1.0;
+      for (int32_t k = 0; k < len / 2; k++) {
+        const double complex u = data[i + k];
+        const double complex v = data[i + k + len / 2] * w;
+        data[i + k] = u + v;
+        data[i + k + len / 2] = u - v;
+        w *= wlen;
+      }
+    }
+  }
+}
+
+// NOTE: lines along one axis are gathered into a contiguous buffer.
+static void fftAlongAxis(double complex* data,
+                         double complex* line,
+                         const int32_t n_line,
+                         const int32_t stride,
+                         const int32_t num_lines,
+                         const int32_t line_block,
+                         const int32_t sign)
+{
+  for (int32_t l = 0; l < num_lines; l++) {
+    // lines are grouped in blocks of line_block consecutive starting points
+    const int32_t start = (l / line_block) * line_block * n_line + (l % line_block);
+    for (int32_t k = 0; k < n_line; k++) line[k] = data[start + k * stride];
+    fft1d(line, n_line, sign);
+    for (int32_t k = 0; k < n_line; k++) data[start + k * stride] = line[k];
+  }
+}
+
+void fft3d(double complex* data,
+           const int32_t n0,
+           const int32_t n1,
+           const int32_t n2,
+           const int32_t sign)
+{
+  if (!isPowerOfTwo(n0) || !isPowerOfTwo(n1) || !isPowerOfTwo(n2)) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "FFT size should be a power of two (%d %d %d).\n", n0, n1, n2);
+    exit(1);
+  }
+
+  int32_t n_max = n0;
+  if (n1 > n_max) n_max = n1;
+  if (n2 > n_max) n_max = n2;
+  double complex* line = (double complex*)xmalloc(n_max * sizeof(double complex));
+
+  fftAlongAxis(data, line, n2, 1, n0 * n1, 1, sign);
+  fftAlongAxis(data, line, n1, n2, n0 * n2, n2, sign);
+  fftAlongAxis(data, line, n0, n1 * n2, n1 * n2, n1 * n2, sign);
+
+  xfree(line);
+}
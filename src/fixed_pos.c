@@ -0,0 +1,63 @@
+#include "fixed_pos.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// NOTE: 2^32
+#define FIXED_ONE 4294967296.0
+
+FixedPosStore* newFixedPosStore(const PosStore* store,
+                                const int32_t num_ptcl,
+                                const Boundary* bound)
+{
+  if (getBoundaryType(bound) != PERIODIC) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "position_precision fixed is supported only for the periodic boundary.\n");
+    exit(1);
+  }
+
+  FixedPosStore* self = (FixedPosStore*)xmalloc(sizeof(FixedPosStore));
+  self->num_ptcl = num_ptcl;
+  self->dim = getBoundaryDim(bound);
+  self->pos = (uint32_t*)xmalloc(self->dim * num_ptcl * sizeof(uint32_t));
+
+  const dvec box = getBoundaryBoxLength(bound);
+  self->scale.x = box.x / FIXED_ONE;
+  self->scale.y = box.y / FIXED_ONE;
+  self->scale.z = box.z / FIXED_ONE;
+  self->inv_scale.x = FIXED_ONE / box.x;
+  self->inv_scale.y = FIXED_ONE / box.y;
+  self->inv_scale.z = (self->dim == 3) ? FIXED_ONE / box.z : 0.0;
+
+  for (int32_t i = 0; i < num_ptcl; i++) {
+    const dvec r = getPosOfStore(store, i);
+    const uvec u = {
+      .x = toFixedCoord(r.x, self->inv_scale.x),
+      .y = toFixedCoord(r.y, self->inv_scale.y),
+      .z = (self->dim == 3) ? toFixedCoord(r.z, self->inv_scale.z) : 0,
+    };
+    setPosOfFixed(self, i, &u, self->dim);
+  }
+  return self;
+}
+
+void deleteFixedPosStore(FixedPosStore* self)
+{
+  xfree(self->pos);
+  xfree(self);
+}
+
+void storeFixedPos(const FixedPosStore* self,
+                   PosStore* store)
+{
+  const int32_t num_ptcl = self->num_ptcl;
+  for (int32_t i = 0; i < num_ptcl; i++) {
+    const uvec u = getPosOfFixed(self, i, self->dim);
+    const dvec r = {
+      .x = (double)u.x * self->scale.x,
+      .y = (double)u.y * self->scale.y,
+      .z = (double)u.z * self->scale.z,
+    };
+    setPosOfStore(store, i, &r);
+  }
+}
@@ -0,0 +1,272 @@
+#include "hash_grid.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "utils.h"
+
+typedef enum {
+  SLOT_EMPTY = 0,
+  SLOT_USED,
+  SLOT_REMOVED,
+} SLOT_STATE;
+
+typedef struct HashSlot_t {
+  int32_t key[3];
+  int32_t head;
+  int32_t count;
+  SLOT_STATE state;
+} HashSlot;
+
+struct HashGrid_t {
+  double inv_cell_leng;
+  int32_t num_ptcl;
+  int32_t dz_max; // 0 in 2D, where all particles lie in one layer of cells
+
+  HashSlot* slots;
+  uint32_t capacity; // power of two
+  int32_t num_used;
+  int32_t num_removed;
+
+  int32_t* next;
+  int32_t* prev;
+  int32_t* slot_of;
+};
+
+#define MIN_HASH_CAPACITY 16
+
+static inline uint32_t hashCellKey(const int32_t* key)
+{
+  uint64_t h = (uint64_t)(uint32_t)key[0];
+  h = h * 0x9E3779B97F4A7C15ULL ^ (uint64_t)(uint32_t)key[1];
+  h = h * 0x9E3779B97F4A7C15ULL ^ (uint64_t)(uint32_t)key[2];
+  h *= 0x9E3779B97F4A7C15ULL;
+  return (uint32_t)(h >> 32);
+}
+
+static inline void getCellKey(const HashGrid* self,
+                              const dvec* pos,
+                              int32_t* key)
+{
+  key[0] = (int32_t)floor(pos->x * self->inv_cell_leng);
+  key[1] = (int32_t)floor(pos->y * self->inv_cell_leng);
+  key[2] = (int32_t)floor(pos->z * self->inv_cell_leng);
+}
+
+static inline bool isSameKey(const int32_t* k0,
+                             const int32_t* k1)
+{
+  return k0[0] == k1[0] && k0[1] == k1[1] && k0[2] == k1[2];
+}
+
+static HashSlot* allocSlots(const uint32_t capacity)
+{
+  HashSlot* slots = (HashSlot*)xmalloc(capacity * sizeof(HashSlot));
+  for (uint32_t s = 0; s < capacity; s++) slots[s].state = SLOT_EMPTY;
+  return slots;
+}
+
+HashGrid* newHashGrid(const double cell_leng,
+                      const int32_t num_ptcl,
+                      const int32_t dim)
+{
+  if (!(cell_leng > 0.0)) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "cell length of hash grid should be positive (%f).\n", cell_leng);
+    exit(1);
+  }
+
+  HashGrid* self = (HashGrid*)xmalloc(sizeof(HashGrid));
+  self->inv_cell_leng = 1.0 / cell_leng;
+  self->num_ptcl = num_ptcl;
+  self->dz_max = (dim == 3) ? 1 : 0;
+  self->capacity = MIN_HASH_CAPACITY;
+  self->slots = allocSlots(self->capacity);
+  self->num_used = self->num_removed = 0;
+  self->next    = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  self->prev    = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  self->slot_of = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  return self;
+}
+
+void deleteHashGrid(HashGrid* self)
+{
+  xfree(self->slots);
+  xfree(self->next);
+  xfree(self->prev);
+  xfree(self->slot_of);
+  xfree(self);
+}
+
+// NOTE: returns -1 if the cell is not occupied.
+static int32_t findSlot(const HashGrid* self,
+                        const int32_t* key)
+{
+  const uint32_t mask = self->capacity - 1;
+  for (uint32_t s = hashCellKey(key) & mask; ; s = (s + 1) & mask) {
+    const HashSlot* slot = &self->slots[s];
+    if (slot->state == SLOT_EMPTY) return -1;
+    if (slot->state == SLOT_USED && isSameKey(slot->key, key)) return (int32_t)s;
+  }
+}
+
+// NOTE: the table is rebuilt from the occupied cells only, which also
+//       drops all removed slots.
+static void rehashGrid(HashGrid* self,
+                       const uint32_t capacity)
+{
+  HashSlot* old_slots = self->slots;
+  const uint32_t old_capacity = self->capacity;
+  self->slots = allocSlots(capacity);
+  self->capacity = capacity;
+  self->num_removed = 0;
+
+  const uint32_t mask = capacity - 1;
+  for (uint32_t o = 0; o < old_capacity; o++) {
+    if (old_slots[o].state != SLOT_USED) continue;
+    uint32_t s = hashCellKey(old_slots[o].key) & mask;
+    while (self->slots[s].state != SLOT_EMPTY) s = (s + 1) & mask;
+    self->slots[s] = old_slots[o];
+    for (int32_t i = old_slots[o].head; i != CELL_NONE; i = self->next[i]) {
+      self->slot_of[i] = (int32_t)s;
+    }
+  }
+  xfree(old_slots);
+}
+
+static int32_t findOrInsertSlot(HashGrid* self,
+                                const int32_t* key)
+{
+  const int32_t found = findSlot(self, key);
+  if (found >= 0) return found;
+
+  // keep the load factor (including removed slots) below 1/2
+  if (2 * (uint32_t)(self->num_used + self->num_removed + 1) > self->capacity) {
+    uint32_t capacity = MIN_HASH_CAPACITY;
+    while (capacity < 4 * (uint32_t)(self->num_used + 1)) capacity *= 2;
+    rehashGrid(self, capacity);
+  }
+
+  const uint32_t mask = self->capacity - 1;
+  uint32_t s = hashCellKey(key) & mask;
+  while (self->slots[s].state == SLOT_USED) s = (s + 1) & mask;
+  if (self->slots[s].state == SLOT_REMOVED) self->num_removed--;
+  HashSlot* slot = &self->slots[s];
+  slot->key[0] = key[0];
+  slot->key[1] = key[1];
+  slot->key[2] = key[2];
+  slot->head = CELL_NONE;
+  slot->count = 0;
+  slot->state = SLOT_USED;
+  self->num_used++;
+  return (int32_t)s;
+}
+
+static void insertIntoSlot(HashGrid* self,
+                           const int32_t id,
+                           const int32_t s)
+{
+  HashSlot* slot = &self->slots[s];
+  self->next[id] = slot->head;
+  self->prev[id] = CELL_NONE;
+  if (slot->head != CELL_NONE) self->prev[slot->head] = id;
+  slot->head = id;
+  slot->count++;
+  self->slot_of[id] = s;
+}
+
+static void removeFromSlot(HashGrid* self,
+                           const int32_t id)
+{
+  HashSlot* slot = &self->slots[self->slot_of[id]];
+  if (self->prev[id] != CELL_NONE) {
+    self->next[self->prev[id]] = self->next[id];
+  } else {
+    slot->head = self->next[id];
+  }
+  if (self->next[id] != CELL_NONE) self->prev[self->next[id]] = self->prev[id];
+  if (--slot->count == 0) {
+    slot->state = SLOT_REMOVED;
+    self->num_used--;
+    self->num_removed++;
+  }
+}
+
+void buildHashGrid(HashGrid* self,
+                   const PosStore* store)
+{
+  for (uint32_t s = 0; s < self->capacity; s++) self->slots[s].state = SLOT_EMPTY;
+  self->num_used = self->num_removed = 0;
+  int32_t key[3];
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    const dvec r = getPosOfStore(store, i);
+    getCellKey(self, &r, key);
+    insertIntoSlot(self, i, findOrInsertSlot(self, key));
+  }
+}
+
+void moveInHashGrid(HashGrid* self,
+                    const int32_t id,
+                    const dvec* new_pos)
+{
+  int32_t key[3];
+  getCellKey(self, new_pos, key);
+  if (isSameKey(self->slots[self->slot_of[id]].key, key)) return;
+  removeFromSlot(self, id);
+  insertIntoSlot(self, id, findOrInsertSlot(self, key));
+}
+
+int32_t getNeighborHeadsInHashGrid(const HashGrid* self,
+                                   const dvec* pos,
+                                   int32_t* heads)
+{
+  int32_t center[3], key[3];
+  getCellKey(self, pos, center);
+  const int32_t dz_max = self->dz_max;
+
+  int32_t num = 0;
+  for (int32_t dz = -dz_max; dz <= dz_max; dz++) {
+    for (int32_t dy = -1; dy <= 1; dy++) {
+      for (int32_t dx = -1; dx <= 1; dx++) {
+        key[0] = center[0] + dx;
+        key[1] = center[1] + dy;
+        key[2] = center[2] + dz;
+        const int32_t s = findSlot(self, key);
+        if (s >= 0) heads[num++] = self->slots[s].head;
+      }
+    }
+  }
+  return num;
+}
+
+int32_t getNextInHashGrid(const HashGrid* self,
+                          const int32_t id)
+{
+  return self->next[id];
+}
+
+int32_t getNumOccupiedCells(const HashGrid* self)
+{
+  return self->num_used;
+}
+
+bool overlapsInHashGrid(const HashGrid* self,
+                        const PosStore* store,
+                        const int32_t id,
+                        const dvec* trial,
+                        const double min_dist)
+{
+  const double min_dist2 = min_dist * min_dist;
+  int32_t heads[MAX_NEIGHBOR_CELLS];
+  const int32_t num_heads = getNeighborHeadsInHashGrid(self, trial, heads);
+  for (int32_t n = 0; n < num_heads; n++) {
+    for (int32_t j = heads[n]; j != CELL_NONE; j = self->next[j]) {
+      if (j == id) continue;
+      const dvec r = getPosOfStore(store, j);
+      const dvec dr = sub_dvec_new(trial, &r);
+      if (norm2(&dr) < min_dist2) return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,37 @@
+#include "lane_rand.h"
+
+#include "utils.h"
+
+static uint64_t splitmix64(uint64_t* state)
+{
+  uint64_t z = (*state += UINT64_C(0x9e3779b97f4a7c15));
+  z = (z ^ (z >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+  z = (z ^ (z >> 27)) * UINT64_C(0x94d049bb133111eb);
+  return z ^ (z >> 31);
+}
+
+void initLaneRand(LaneRand* self,
+                  const uint64_t seed,
+                  const uint64_t stream_id)
+{
+  uint64_t state = seed ^ (stream_id * UINT64_C(0xd1b54a32d192ed03));
+  for (int32_t l = 0; l < NUM_RAND_LANES; l++) {
+    self->s0[l] = splitmix64(&state);
+    self->s1[l] = splitmix64(&state);
+    if (!(self->s0[l] | self->s1[l])) self->s1[l] = 1; // all-zero state is forbidden
+  }
+}
+
+TARGET_CLONES void fillLaneRandReal(LaneRand* self,
+                                    double* out)
+{
+  for (int32_t l = 0; l < NUM_RAND_LANES; l++) {
+    uint64_t s1 = self->s0[l];
+    const uint64_t s0 = self->s1[l];
+    const uint64_t result = s0 + s1;
+    self->s0[l] = s0;
+    s1 ^= s1 << 23;
+    self->s1[l] = s1 ^ s0 ^ (s1 >> 18) ^ (s0 >> 5);
+    out[l] = (double)(result >> 11) * (1.0 / 9007199254740992.0);
+  }
+}
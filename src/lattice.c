@@ -0,0 +1,355 @@
+#include "lattice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+
+#include "utils.h"
+#include "mt_rand.h"
+#include "parameter.h"
+#include "system.h"
+#include "topol.h"
+#include "boundary.h"
+#include "vector3.h"
+#include "pos_store.h"
+
+#define MAX_FACE_SITES 4
+#define BOND_COMP_MAX 3
+#define BOND_TABLE_SIDE (2 * BOND_COMP_MAX + 1)
+#define BOND_TABLE_SIZE (BOND_TABLE_SIDE * BOND_TABLE_SIDE * BOND_TABLE_SIDE)
+
+struct Lattice_t {
+  int16_t* pos;        // lower corner of each monomer (dim components)
+  uint64_t* occupancy; // one bit per lattice site
+  int32_t dim;
+  int32_t num_hops;    // 2 dim
+  int32_t num_corners; // 2^dim
+  int32_t side[3];
+  int32_t num_ptcl;
+  const ptclid2topol* id2top;
+  uint8_t bond_allowed[BOND_TABLE_SIZE];
+};
+
+// NOTE: the first 2 dim hops are used.
+static const int32_t hop_table[6][3] = {
+  { 1,  0,  0}, {-1,  0,  0},
+  { 0,  1,  0}, { 0, -1,  0},
+  { 0,  0,  1}, { 0,  0, -1},
+};
+
+// NOTE: bond vector classes (sorted absolute components).
+//       (2, 2, 0) is allowed only in 2D; in 3D it would let bonds cross.
+#define NUM_BOND_CLASSES_2D 5
+#define NUM_BOND_CLASSES_3D 6
+static const int32_t bond_classes_2d[NUM_BOND_CLASSES_2D][3] = {
+  {2, 0, 0}, {2, 1, 0}, {3, 0, 0}, {3, 1, 0},
+  {2, 2, 0},
+};
+static const int32_t bond_classes_3d[NUM_BOND_CLASSES_3D][3] = {
+  {2, 0, 0}, {2, 1, 0}, {3, 0, 0}, {3, 1, 0},
+  {2, 1, 1}, {2, 2, 1},
+};
+
+static inline int32_t wrapCoord(int32_t x, const int32_t side)
+{
+  if (x < 0) x += side;
+  if (x >= side) x -= side;
+  return x;
+}
+
+static inline int32_t minImageCoord(int32_t dx, const int32_t side)
+{
+  if (dx >  side / 2) dx -= side;
+  if (dx < -side / 2) dx += side;
+  return dx;
+}
+
+static inline int64_t siteIndex(const Lattice* self,
+                                const int32_t* r)
+{
+  const int64_t x = wrapCoord(r[0], self->side[0]);
+  const int64_t y = wrapCoord(r[1], self->side[1]);
+  const int64_t z = wrapCoord(r[2], self->side[2]);
+  return x + self->side[0] * (y + self->side[1] * z);
+}
+
+static inline bool isOccupied(const Lattice* self,
+                              const int64_t site)
+{
+  return (self->occupancy[site >> 6] >> (site & 63)) & 1;
+}
+
+static inline void setOccupied(Lattice* self,
+                               const int64_t site)
+{
+  self->occupancy[site >> 6] |= (UINT64_C(1) << (site & 63));
+}
+
+static inline void clearOccupied(Lattice* self,
+                                 const int64_t site)
+{
+  self->occupancy[site >> 6] &= ~(UINT64_C(1) << (site & 63));
+}
+
+static inline void loadPos(const Lattice* self,
+                           const int32_t id,
+                           int32_t* r)
+{
+  r[0] = r[1] = r[2] = 0;
+  for (int32_t a = 0; a < self->dim; a++) {
+    r[a] = self->pos[self->dim * id + a];
+  }
+}
+
+static inline int32_t bondTableIndex(const int32_t* dr)
+{
+  return (dr[0] + BOND_COMP_MAX)
+    + BOND_TABLE_SIDE * ((dr[1] + BOND_COMP_MAX) + BOND_TABLE_SIDE * (dr[2] + BOND_COMP_MAX));
+}
+
+static void sortDescending(int32_t* a)
+{
+  for (int32_t i = 0; i < 3; i++) {
+    for (int32_t j = i + 1; j < 3; j++) {
+      if (a[j] > a[i]) {
+        const int32_t tmp = a[i];
+        a[i] = a[j];
+        a[j] = tmp;
+      }
+    }
+  }
+}
+
+static void createBondTable(Lattice* self)
+{
+  memset(self->bond_allowed, 0, sizeof(self->bond_allowed));
+  const int32_t (*bond_classes)[3] = (self->dim == 3) ? bond_classes_3d : bond_classes_2d;
+  const int32_t num_classes = (self->dim == 3) ? NUM_BOND_CLASSES_3D : NUM_BOND_CLASSES_2D;
+  const int32_t zmax = (self->dim == 3) ? BOND_COMP_MAX : 0;
+  for (int32_t dz = -zmax; dz <= zmax; dz++) {
+    for (int32_t dy = -BOND_COMP_MAX; dy <= BOND_COMP_MAX; dy++) {
+      for (int32_t dx = -BOND_COMP_MAX; dx <= BOND_COMP_MAX; dx++) {
+        const int32_t dr[3] = {dx, dy, dz};
+        int32_t comp[3] = {abs(dx), abs(dy), abs(dz)};
+        sortDescending(comp);
+        for (int32_t c = 0; c < num_classes; c++) {
+          if (comp[0] == bond_classes[c][0] &&
+              comp[1] == bond_classes[c][1] &&
+              comp[2] == bond_classes[c][2]) {
+            self->bond_allowed[bondTableIndex(dr)] = 1;
+          }
+        }
+      }
+    }
+  }
+}
+
+static bool isBondAllowed(const Lattice* self,
+                          const int32_t* r0,
+                          const int32_t* r1)
+{
+  int32_t dr[3];
+  for (int32_t a = 0; a < 3; a++) {
+    dr[a] = minImageCoord(r1[a] - r0[a], self->side[a]);
+    if (dr[a] > BOND_COMP_MAX || dr[a] < -BOND_COMP_MAX) return false;
+  }
+  return self->bond_allowed[bondTableIndex(dr)];
+}
+
+static bool bondsAreAllowed(const Lattice* self,
+                            const int32_t id,
+                            const int32_t* r_new)
+{
+  for (int32_t b = 0; b < getNumPairsOfPtcl(self->id2top, id); b++) {
+    const pair* bond = getPairOfPtcl(self->id2top, id, b);
+    const int32_t partner = (bond->i0 == id) ? bond->i1 : bond->i0;
+    int32_t r_partner[3];
+    loadPos(self, partner, r_partner);
+    if (!isBondAllowed(self, r_new, r_partner)) return false;
+  }
+  return true;
+}
+
+// NOTE: collect the sites of the monomer face perpendicular to axis,
+//       located at r[axis] + offset.
+static void collectFaceSites(const Lattice* self,
+                             const int32_t* r,
+                             const int32_t axis,
+                             const int32_t offset,
+                             int64_t* sites)
+{
+  for (int32_t k = 0; k < self->num_corners / 2; k++) {
+    int32_t c[3] = {r[0], r[1], r[2]};
+    int32_t bit = 0;
+    for (int32_t a = 0; a < self->dim; a++) {
+      if (a == axis) {
+        c[a] += offset;
+      } else {
+        c[a] += (k >> bit) & 1;
+        bit++;
+      }
+    }
+    sites[k] = siteIndex(self, c);
+  }
+}
+
+static void occupyMonomer(Lattice* self,
+                          const int32_t id)
+{
+  int32_t r[3];
+  loadPos(self, id, r);
+  for (int32_t k = 0; k < self->num_corners; k++) {
+    int32_t c[3] = {r[0], r[1], r[2]};
+    for (int32_t a = 0; a < self->dim; a++) {
+      c[a] += (k >> a) & 1;
+    }
+    const int64_t site = siteIndex(self, c);
+    if (isOccupied(self, site)) {
+      fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+      fprintf(stderr, "Monomer %d overlaps with another monomer on the lattice.\n", id);
+      exit(1);
+    }
+    setOccupied(self, site);
+  }
+}
+
+static void checkInitialBonds(const Lattice* self,
+                              const topol* top)
+{
+  const int32_t num_bonds = getNumBonds(top);
+  const pair* bond_top = getBondTopol(top);
+  for (int32_t b = 0; b < num_bonds; b++) {
+    int32_t r0[3], r1[3];
+    loadPos(self, bond_top[b].i0, r0);
+    loadPos(self, bond_top[b].i1, r1);
+    if (!isBondAllowed(self, r0, r1)) {
+      fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+      fprintf(stderr, "Bond (%d, %d) is not an allowed bond vector of the bond fluctuation model.\n",
+              bond_top[b].i0, bond_top[b].i1);
+      exit(1);
+    }
+  }
+}
+
+static int32_t getLatticeSide(const double length)
+{
+  const int32_t side = (int32_t)lround(length);
+  if (fabs(length - side) > 1.0e-10 || side <= 2 * BOND_COMP_MAX || side > INT16_MAX) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "Box length %f cannot be used as a lattice side length.\n", length);
+    exit(1);
+  }
+  return side;
+}
+
+Lattice* newLattice(System* system,
+                    const Boundary* bound,
+                    const Parameter* param)
+{
+  if (getBoundaryType(bound) != PERIODIC) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "%s cannot be specified for the bond fluctuation model.\n",
+            getBoundaryNameFromType(getBoundaryType(bound)));
+    exit(1);
+  }
+
+  Lattice* self = (Lattice*)xmalloc(sizeof(Lattice));
+  const dvec box_length = getBoxlength(param);
+  self->side[0] = getLatticeSide(box_length.x);
+  self->side[1] = getLatticeSide(box_length.y);
+  self->dim = getBoundaryDim(bound);
+  self->side[2] = (self->dim == 3) ? getLatticeSide(box_length.z) : 1;
+  self->num_hops = 2 * self->dim;
+  self->num_corners = 1 << self->dim;
+  self->num_ptcl = getNumPtcl(param);
+  self->id2top = getPtclId2Topol(system);
+  createBondTable(self);
+
+  const int64_t num_sites = (int64_t)self->side[0] * self->side[1] * self->side[2];
+  const size_t num_words = (size_t)((num_sites + 63) / 64);
+  self->occupancy = (uint64_t*)xmalloc(num_words * sizeof(uint64_t));
+  memset(self->occupancy, 0, num_words * sizeof(uint64_t));
+
+  // snap the current configuration to the lattice
+  self->pos = (int16_t*)xmalloc(self->dim * self->num_ptcl * sizeof(int16_t));
+  PosStore* store = getPosStore(system);
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    const dvec ri = getPosOfStore(store, i);
+    const double r[3] = {ri.x, ri.y, ri.z};
+    for (int32_t a = 0; a < self->dim; a++) {
+      self->pos[self->dim * i + a]
+        = (int16_t)wrapCoord((int32_t)lround(r[a]) % self->side[a], self->side[a]);
+    }
+    occupyMonomer(self, i);
+    const dvec r_snap = {
+      .x = self->pos[self->dim * i + 0],
+      .y = self->pos[self->dim * i + 1],
+      .z = (self->dim == 3) ? self->pos[self->dim * i + 2] : 0.0,
+    };
+    setPosOfStore(store, i, &r_snap);
+  }
+  checkInitialBonds(self, getTopol(system));
+
+  return self;
+}
+
+void deleteLattice(Lattice* self)
+{
+  xfree(self->pos);
+  xfree(self->occupancy);
+  xfree(self);
+}
+
+// NOTE: athermal BFM; a hop is accepted when the bond vectors stay in the
+//       allowed set and the sites entered by the monomer are empty.
+double evolveBfm(Lattice* self,
+                 System* system,
+                 MTstate* mtst)
+{
+  const int32_t num_ptcl = self->num_ptcl;
+  PosStore* store = getPosStore(system);
+
+  int32_t num_accepted = 0;
+  for (int32_t p = 0; p < num_ptcl; p++) {
+    const int32_t id = genrand_int31_range(mtst, 0, num_ptcl - 1);
+    const int32_t hop = genrand_int32(mtst) % self->num_hops;
+    const int32_t axis = hop / 2;
+    const int32_t dir = hop_table[hop][axis];
+
+    int32_t r_old[3], r_new[3];
+    loadPos(self, id, r_old);
+    loadPos(self, id, r_new);
+    r_new[axis] = wrapCoord(r_new[axis] + dir, self->side[axis]);
+
+    if (!bondsAreAllowed(self, id, r_new)) continue;
+
+    const int32_t num_face_sites = self->num_corners / 2;
+    int64_t face_enter[MAX_FACE_SITES];
+    collectFaceSites(self, r_old, axis, (dir > 0) ? 2 : -1, face_enter);
+    bool is_free = true;
+    for (int32_t k = 0; k < num_face_sites; k++) {
+      is_free &= !isOccupied(self, face_enter[k]);
+    }
+    if (!is_free) continue;
+
+    int64_t face_leave[MAX_FACE_SITES];
+    collectFaceSites(self, r_old, axis, (dir > 0) ? 0 : 1, face_leave);
+    for (int32_t k = 0; k < num_face_sites; k++) {
+      clearOccupied(self, face_leave[k]);
+      setOccupied(self, face_enter[k]);
+    }
+
+    self->pos[self->dim * id + axis] = (int16_t)r_new[axis];
+    const dvec r_moved = {
+      .x = r_new[0],
+      .y = r_new[1],
+      .z = (self->dim == 3) ? r_new[2] : 0.0,
+    };
+    setPosOfStore(store, id, &r_moved);
+    num_accepted++;
+  }
+
+  return (double)num_accepted / (double)num_ptcl;
+}
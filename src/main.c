@@ -2,11 +2,16 @@
 #include <stdbool.h>
 #include <stdlib.h>
 
+#ifdef USE_MPI
+#include <mpi.h>
+#endif
+
 #include "system.h"
 #include "topol.h"
 #include "parameter.h"
 #include "config_maker.h"
 #include "boundary.h"
+#include "batch_kernels.h"
 
 static void check_args(const int argc,
                        const char* argv[])
@@ -20,29 +25,42 @@ static void check_args(const int argc,
 int main(const int argc, const char* argv[])
 {
   check_args(argc, argv);
+#ifdef USE_MPI
+  MPI_Init(NULL, NULL);
+#endif
+  selectBatchKernels();
 
   System* system   = newSystem();
   Parameter* param = newParameter(argv[1]);
   readParameterFromFile(param);
-  Boundary* boundary = newBoundary(getBoundaryName(param));
+  Boundary* boundary = newBoundary(getBoundaryName(param), getDimension(param));
   if (getBoundaryType(boundary) == PERIODIC) setBoxLength(boundary, getBoxlength(param));
 
-#ifdef SIMULATION_3D
-  initializeSystem(system, boundary, param, createFlatMesh, newTopolMesh);
-#else
-  if (getBoundaryType(boundary) == PERIODIC) {
+  if (getTopologyFile(param)) {
+    initializeSystem(system, boundary, param, createTopolConfig, newTopolFromFile);
+  } else if (getNumChains(param) > 1) {
+    initializeSystem(system, boundary, param, createMeltChains, newTopolMelt);
+  } else if (getDimension(param) == 3) {
+    initializeSystem(system, boundary, param, createFlatMesh, newTopolMesh);
+  } else if (getBoundaryType(boundary) == PERIODIC) {
     initializeSystem(system, boundary, param, createStraightChain, newTopolChain);
   } else if (getBoundaryType(boundary) == FREE) {
     initializeSystem(system, boundary, param, createRandomChain, newTopolChain);
   }
-#endif
 
   readRestartConfig(system, param);
+  applyBoundaryCondForSystem(boundary, system, param);
   executeSimulation(system, boundary, param);
+#ifndef USE_MPI
+  // NOTE: the ranks of the domain decomposition write it together.
   writeFinalConfig(system, param);
+#endif
 
   deleteSystem(system);
   deleteParameter(param);
   deleteBoundary(boundary);
+#ifdef USE_MPI
+  MPI_Finalize();
+#endif
   return 0;
 }
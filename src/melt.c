@@ -0,0 +1,275 @@
+#include "melt.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "utils.h"
+#include "parameter.h"
+#include "boundary.h"
+#include "topol.h"
+#include "cell_list.h"
+
+struct Melt_t {
+  int32_t num_chains;
+  int32_t chain_len;
+  int32_t* seq;
+  int32_t* chain_of;
+  int32_t* index_of;
+  int32_t* buffer; // 2 * chain_len, used while rewiring
+  CellList* cells; // of the double-bridge partners
+  double bridge_cutoff2;
+  int64_t num_db_trials;
+  int64_t num_db_accepted;
+};
+
+static void registerChain(Melt* self,
+                          const int32_t chain)
+{
+  const int32_t* seq = &self->seq[chain * self->chain_len];
+  for (int32_t k = 0; k < self->chain_len; k++) {
+    self->chain_of[seq[k]] = chain;
+    self->index_of[seq[k]] = k;
+  }
+}
+
+Melt* newMelt(const Parameter* param)
+{
+  const int32_t num_ptcl = getNumPtcl(param);
+  const int32_t num_chains = getNumChains(param);
+  if (num_chains <= 0 || num_ptcl % num_chains != 0) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "Number of particles should be a multiple of num_chains.\n");
+    fprintf(stderr, "num_ptcl = %d, num_chains = %d.\n", num_ptcl, num_chains);
+    exit(1);
+  }
+
+  Melt* self = (Melt*)xmalloc(sizeof(Melt));
+  self->num_chains = num_chains;
+  self->chain_len  = num_ptcl / num_chains;
+  self->seq        = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  self->chain_of   = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  self->index_of   = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  self->buffer     = (int32_t*)xmalloc(2 * self->chain_len * sizeof(int32_t));
+  for (int32_t i = 0; i < num_ptcl; i++) self->seq[i] = i;
+  for (int32_t c = 0; c < num_chains; c++) registerChain(self, c);
+  self->cells = NULL;
+  self->bridge_cutoff2 = 0.0;
+  self->num_db_trials = self->num_db_accepted = 0;
+  return self;
+}
+
+void deleteMelt(Melt* self)
+{
+  xfree(self->seq);
+  xfree(self->chain_of);
+  xfree(self->index_of);
+  xfree(self->buffer);
+  if (self->cells) deleteCellList(self->cells);
+  xfree(self);
+}
+
+int32_t getNumChainsOfMelt(const Melt* self)
+{
+  return self->num_chains;
+}
+
+int32_t getChainLenOfMelt(const Melt* self)
+{
+  return self->chain_len;
+}
+
+const int32_t* getChainSeq(const Melt* self,
+                           const int32_t chain)
+{
+  return &self->seq[chain * self->chain_len];
+}
+
+int32_t getChainIdOfPtcl(const Melt* self,
+                         const int32_t id)
+{
+  return self->chain_of[id];
+}
+
+int32_t getChainIndexOfPtcl(const Melt* self,
+                            const int32_t id)
+{
+  return self->index_of[id];
+}
+
+void rewireMelt(Melt* self,
+                topol* top,
+                ptclid2topol* id2top,
+                const int32_t chain_a,
+                const int32_t chain_b,
+                const int32_t a)
+{
+  const int32_t n = self->chain_len;
+  const int32_t b = n - 2 - a;
+  int32_t* seq_a = &self->seq[chain_a * n];
+  int32_t* seq_b = &self->seq[chain_b * n];
+  int32_t* new_a = self->buffer;
+  int32_t* new_b = self->buffer + n;
+
+  int32_t cnt = 0;
+  for (int32_t k = 0; k <= a; k++) new_a[cnt++] = seq_a[k];
+  for (int32_t k = b; k >= 0; k--) new_a[cnt++] = seq_b[k];
+  cnt = 0;
+  for (int32_t k = n - 1; k > a; k--) new_b[cnt++] = seq_a[k];
+  for (int32_t k = b + 1; k < n; k++) new_b[cnt++] = seq_b[k];
+
+  for (int32_t k = 0; k < n; k++) {
+    seq_a[k] = new_a[k];
+    seq_b[k] = new_b[k];
+  }
+  registerChain(self, chain_a);
+  registerChain(self, chain_b);
+
+  setTopolChain(top, chain_a, seq_a, n);
+  setTopolChain(top, chain_b, seq_b, n);
+  updateId2TopolChain(id2top, top, chain_a, seq_a, n);
+  updateId2TopolChain(id2top, top, chain_b, seq_b, n);
+}
+
+void permuteMelt(Melt* self,
+                 const int32_t* new_of_old)
+{
+  const int32_t num_ptcl = self->num_chains * self->chain_len;
+  for (int32_t k = 0; k < num_ptcl; k++) self->seq[k] = new_of_old[self->seq[k]];
+  for (int32_t c = 0; c < self->num_chains; c++) registerChain(self, c);
+}
+
+void setupBridgeGrid(Melt* self,
+                     const PosStore* store,
+                     const Boundary* bound,
+                     const double cutoff)
+{
+  self->cells = newCellList(bound, cutoff, self->num_chains * self->chain_len);
+  self->bridge_cutoff2 = cutoff * cutoff;
+  buildBridgeGrid(self, store);
+}
+
+void buildBridgeGrid(Melt* self,
+                     const PosStore* store)
+{
+  if (self->cells) buildCellList(self->cells, store);
+}
+
+void moveInBridgeGrid(Melt* self,
+                      const int32_t id,
+                      const dvec* new_pos)
+{
+  moveInCellList(self->cells, id, new_pos);
+}
+
+bool isWithinBridgeCutoff(const Melt* self,
+                          const PosStore* store,
+                          const Boundary* bound,
+                          const int32_t i,
+                          const int32_t j)
+{
+  const dvec ri = getPosOfStore(store, i);
+  const dvec rj = getPosOfStore(store, j);
+  return distance2(&ri, &rj, bound) < self->bridge_cutoff2;
+}
+
+// NOTE: after the move, A[0..a] + B[b..0] is chain_a and
+//       A[N-1..a+1] + B[b+1..N-1] is chain_b (see rewireMelt).
+static void getChainIndexAfterMove(const Melt* self,
+                                   const int32_t id,
+                                   const BridgeMove* move,
+                                   int32_t* chain,
+                                   int32_t* index)
+{
+  *chain = self->chain_of[id];
+  *index = self->index_of[id];
+  if (!move) return;
+  const int32_t n = self->chain_len;
+  if (*chain == move->chain_a && *index > move->a) {
+    *chain = move->chain_b;
+    *index = n - 1 - *index;
+  } else if (*chain == move->chain_b && *index <= n - 2 - move->a) {
+    *chain = move->chain_a;
+    *index = n - 1 - *index;
+  }
+}
+
+// NOTE: a chain holds one particle at each index, so that each partner
+//       chain is found once. Returns the number of partners, or the
+//       pick-th partner chain if pick >= 0.
+static int32_t scanBridgePartners(const Melt* self,
+                                  const PosStore* store,
+                                  const Boundary* bound,
+                                  const int32_t id,
+                                  const BridgeMove* move,
+                                  const int32_t pick)
+{
+  int32_t chain_id, index_id;
+  getChainIndexAfterMove(self, id, move, &chain_id, &index_id);
+  const int32_t target = self->chain_len - 2 - index_id;
+  if (target < 0) return 0;
+
+  const dvec r = getPosOfStore(store, id);
+  int32_t cells[MAX_NEIGHBOR_CELLS];
+  const int32_t num_cells = getNeighborCells(self->cells, getCellIdOfPos(self->cells, &r), cells);
+  int32_t num = 0;
+  for (int32_t c = 0; c < num_cells; c++) {
+    for (int32_t k = getCellHead(self->cells, cells[c]); k != CELL_NONE; k = getNextInCell(self->cells, k)) {
+      int32_t chain_k, index_k;
+      getChainIndexAfterMove(self, k, move, &chain_k, &index_k);
+      if (index_k != target || chain_k == chain_id) continue;
+      const dvec rk = getPosOfStore(store, k);
+      if (distance2(&r, &rk, bound) >= self->bridge_cutoff2) continue;
+      if (num == pick) return chain_k;
+      num++;
+    }
+  }
+  return num;
+}
+
+int32_t countBridgePartners(const Melt* self,
+                            const PosStore* store,
+                            const Boundary* bound,
+                            const int32_t id,
+                            const BridgeMove* move)
+{
+  return scanBridgePartners(self, store, bound, id, move, -1);
+}
+
+int32_t getBridgePartner(const Melt* self,
+                         const PosStore* store,
+                         const Boundary* bound,
+                         const int32_t id,
+                         const int32_t k)
+{
+  return scanBridgePartners(self, store, bound, id, NULL, k);
+}
+
+void recordDoubleBridge(Melt* self,
+                        const bool is_accepted)
+{
+  self->num_db_trials++;
+  if (is_accepted) self->num_db_accepted++;
+}
+
+double getDoubleBridgeAcceptRatio(const Melt* self)
+{
+  if (self->num_db_trials == 0) return 0.0;
+  return (double)self->num_db_accepted / (double)self->num_db_trials;
+}
+
+void unwrapChain(const Melt* self,
+                 const int32_t chain,
+                 const PosStore* store,
+                 const Boundary* bound,
+                 dvec* unwrapped)
+{
+  const int32_t* seq = getChainSeq(self, chain);
+  unwrapped[0] = getPosOfStore(store, seq[0]);
+  for (int32_t k = 1; k < self->chain_len; k++) {
+    const dvec r0 = getPosOfStore(store, seq[k - 1]);
+    const dvec r1 = getPosOfStore(store, seq[k]);
+    dvec dr = sub_dvec_new(&r1, &r0);
+    applyMinimumImageConv(bound, &dr);
+    unwrapped[k] = add_dvec_new(&unwrapped[k - 1], &dr);
+  }
+}
@@ -8,10 +8,15 @@
 
 #include "utils.h"
 #include "file_utils.h"
-#include "interactions.h"
+#include "potential.h"
 #include "evolver.h"
 #include "topol.h"
 #include "math_utils.h"
+#include "melt.h"
+#include "verlet_list.h"
+#include "pppm.h"
+#include "pos_store.h"
+#include "batch_kernels.h"
 
 typedef enum {
   ENERGY = 0,
@@ -37,15 +42,18 @@ struct Observer_t {
 
 static const char* getFileNameFromObserverType(ObserverType type);
 
-static void initializeEnergyObserver(Observer* self);
+static void sumBondedTerms(const System* system, const Boundary* bound, BondedSums* bonded);
+static void initializeEnergyObserver(Observer* self, const bool has_nonbond, const bool has_coulomb);
 static void finalizeEnergyObserver(Observer* self);
-static void observeEnergy(Observer* self, const int32_t mc_steps, const System* system, const Boundary* bound, const Parameter* param);
+static void observeEnergy(Observer* self, const int32_t mc_steps, const System* system, const BondedSums* bonded, const Boundary* bound, const Parameter* param);
 
 static void initializePressureObserver(Observer* self);
 static void finalizePressureObserver(Observer* self);
-static void observePressure(Observer* self, const int32_t mc_steps, const System* system, const Boundary* bound, const Parameter* param);
+static void observePressure(Observer* self, const int32_t mc_steps, const System* system, const BondedSums* bonded, const Boundary* bound, const Parameter* param);
 
+static void writeRg(Observer* self, const int32_t mcsteps, const double rg);
 static void observeRg(Observer* self, const int32_t mcsteps, const System* system, const Boundary* bound, const Parameter* param);
+static void writeEnd2End(Observer* self, const int32_t mcsteps, const double e2e);
 static void observeEnd2End(Observer* self, const int32_t mcsteps, const System* system, const Boundary* bound, const Parameter* param);
 static void observeAcceptRatio(Observer* self, const int32_t mcsteps, const System* system, const Parameter* param);
 static void writeXYZHeader(FILE* fp, const int32_t num_ptcl, const int32_t mcsteps);
@@ -54,19 +62,18 @@ static void observeBondLenDist(Observer* self, const System* system, const Bound
 
 struct SpectrumBuffer_t;
 typedef struct SpectrumBuffer_t SpectrumBuffer;
-static double complex calcftilde1D(const dvec* pos, const int32_t n_ptcl, const double qx_at);
-static double complex calcftilde2D(const dvec* pos, const int32_t n_ptcl,
-                                   const double qx_at, const double qy_at);
-static void doFourierTransform1D(const dvec* pos, const int32_t n_ptcl, SpectrumBuffer* sbuffer);
-static void doFourierTransform2D(const dvec* pos, const int32_t n_ptcl, SpectrumBuffer* sbuffer);
+static void doFourierTransform1D(const PosStore* store, SpectrumBuffer* sbuffer);
+static void doFourierTransform2D(const PosStore* store, SpectrumBuffer* sbuffer);
 static void setQvector1D(double* qx, const double q_low, const double q_up, const int32_t ndiv);
 static void setQvector2D(double* qx, double* qy,
                        const double qx_low, const double qx_up,
                        const double qy_low, const double qy_up,
                        const int32_t nx_div, const int32_t ny_div);
+static void setSpectrumGrid(SpectrumBuffer* sbuffer, const Parameter* param);
 static void initializeFluctSpetrumObserver(Observer* self, const Parameter* param);
 static void finalizeFluctSpetrumObserver(Observer* self);
 static void observeFluctSpectrum(Observer* self, const System* system, const Parameter* param);
+static void addFluctSpectrum(Observer* self, const double complex* height_dft, const Parameter* param);
 
 static const char* getFileNameFromObserverType(ObserverType type)
 {
@@ -145,8 +152,11 @@ void observeMacroVars(Observer* self,
                       const Boundary* bound,
                       const Parameter* param)
 {
-  observeEnergy(self, mc_steps, system, bound, param);
-  observePressure(self, mc_steps, system, bound, param);
+  BondedSums bonded;
+  sumBondedTerms(system, bound, &bonded);
+
+  observeEnergy(self, mc_steps, system, &bonded, bound, param);
+  observePressure(self, mc_steps, system, &bonded, bound, param);
   observeRg(self, mc_steps, system, bound, param);
   observeEnd2End(self, mc_steps, system, bound, param);
   observeAcceptRatio(self, mc_steps, system, param);
@@ -155,80 +165,138 @@ void observeMacroVars(Observer* self,
   }
 }
 
-#define GET_TOPOLOGY(system, param)             \
+// NOTE: the energies and the pressure of the nonbonded and Coulomb
+//       interactions are those of the System, which has none in a domain
+//       decomposition.
+void observeMacroSums(Observer* self,
+                      const int32_t mc_steps,
+                      const System* system,
+                      const MacroSums* sums,
+                      const Boundary* bound,
+                      const Parameter* param)
+{
+  observeEnergy(self, mc_steps, system, &sums->bonded, bound, param);
+  observePressure(self, mc_steps, system, &sums->bonded, bound, param);
+  writeRg(self, mc_steps, sums->rg);
+  writeEnd2End(self, mc_steps, sums->end2end);
+  observeAcceptRatio(self, mc_steps, system, param);
+  if (getBoundaryType(bound) == PERIODIC) {
+    addFluctSpectrum(self, sums->height_dft, param);
+  }
+}
+
+#define GET_TOPOLOGY(system)                    \
   const topol* top = getTopol(system);          \
   const int32_t num_bonds = getNumBonds(top);   \
   const int32_t num_angles = getNumAngles(top); \
   const pair* bond_top = getBondTopol(top);     \
   const triple* angle_top = getAngleTopol(top); \
-  const double cf_b = getCfBond(param);         \
-  const double cf_a = getCfAngle(param);        \
-  const double l0  = getBondLen(param)
+  const BondedParam* bp = getBondedParam(system)
+
+// NOTE: bonded energies and virial in one pass over the structure-of-arrays
+//       positions (see batch_kernels.h), shared by the energy and pressure
+//       observers.
+static void sumBondedTerms(const System* system,
+                           const Boundary* bound,
+                           BondedSums* bonded)
+{
+  GET_TOPOLOGY(system);
+  sumBondedTermsOfStore(getPosStore(system), bond_top, num_bonds, angle_top, num_angles,
+                        bp, bound, getBatchBuffers(system), bonded);
+}
 
 typedef struct EnergyBuffer_t {
   double bond;
   double angle;
+  double nonbond;
+  double coulomb;
   double total;
+  bool has_nonbond;
+  bool has_coulomb;
 } EnergyBuffer;
 
-static void initializeEnergyObserver(Observer* self)
+// NOTE: the nonbond column is written only when lj_epsilon is specified,
+//       the coulomb column only when charge_file is specified.
+static void initializeEnergyObserver(Observer* self,
+                                     const bool has_nonbond,
+                                     const bool has_coulomb)
 {
-  fprintf(self->fps[ENERGY], "# mcsteps bond angle total \n");
+  fprintf(self->fps[ENERGY], "# mcsteps bond angle %s%stotal \n",
+          has_nonbond ? "nonbond " : "", has_coulomb ? "coulomb " : "");
   self->buffer[ENERGY] = (EnergyBuffer*) xmalloc(sizeof(EnergyBuffer));
   EnergyBuffer* ebuffer = (EnergyBuffer*) self->buffer[ENERGY];
-  ebuffer->bond = ebuffer->angle = ebuffer->total = 0.0;
+  ebuffer->bond = ebuffer->angle = ebuffer->nonbond = ebuffer->coulomb = ebuffer->total = 0.0;
+  ebuffer->has_nonbond = has_nonbond;
+  ebuffer->has_coulomb = has_coulomb;
   self->finalizer[ENERGY] = finalizeEnergyObserver;
 }
 
+static void printEnergyColumns(FILE* fp,
+                               const EnergyBuffer* ebuffer,
+                               const double bond,
+                               const double angle,
+                               const double nonbond,
+                               const double coulomb,
+                               const double total)
+{
+  fprintf(fp, "%f %f", bond, angle);
+  if (ebuffer->has_nonbond) fprintf(fp, " %f", nonbond);
+  if (ebuffer->has_coulomb) fprintf(fp, " %f", coulomb);
+  fprintf(fp, " %f\n", total);
+}
+
 static void finalizeEnergyObserver(Observer* self)
 {
   EnergyBuffer* ebuffer = (EnergyBuffer*) self->buffer[ENERGY];
-  ebuffer->bond  /= self->num_frames[ENERGY];
-  ebuffer->angle /= self->num_frames[ENERGY];
-  ebuffer->total /= self->num_frames[ENERGY];
-  fprintf(self->fps[ENERGY], "# mean = %f %f %f\n",
-          ebuffer->bond, ebuffer->angle, ebuffer->total);
+  ebuffer->bond    /= self->num_frames[ENERGY];
+  ebuffer->angle   /= self->num_frames[ENERGY];
+  ebuffer->nonbond /= self->num_frames[ENERGY];
+  ebuffer->coulomb /= self->num_frames[ENERGY];
+  ebuffer->total   /= self->num_frames[ENERGY];
+  fprintf(self->fps[ENERGY], "# mean = ");
+  printEnergyColumns(self->fps[ENERGY], ebuffer,
+                     ebuffer->bond, ebuffer->angle, ebuffer->nonbond, ebuffer->coulomb, ebuffer->total);
 }
 
 static void observeEnergy(Observer* self,
                           const int32_t mc_steps,
                           const System* system,
+                          const BondedSums* bonded,
                           const Boundary* bound,
                           const Parameter* param)
 {
+  const VerletList* verlet = getVerletList(system);
+  Pppm* pppm = getPppm(system);
   static bool is_first_call = true;
   if (is_first_call) {
-    initializeEnergyObserver(self);
+    initializeEnergyObserver(self, verlet != NULL, pppm != NULL);
     is_first_call = false;
   }
 
-  GET_TOPOLOGY(system, param);
-  const dvec* pos = getPos(system);
+  UNUSED_PARAMETER(param);
+  const PosStore* store = getPosStore(system);
+
+  // bonded and angle energy
+  const double etot_bond = bonded->e_bond, etot_angle = bonded->e_angle;
 
-  // sum bonded energy
-  double etot_bond = 0.0;
-  for (int32_t b = 0; b < num_bonds; b++) {
-    etot_bond += calcBondEnergy(&pos[bond_top[b].i0], &pos[bond_top[b].i1], cf_b, l0, bound);
-  }
+  // sum nonbonded energy
+  const double etot_nonbond = verlet ? calcNonbondEnergyTotal(verlet, store, bound) : 0.0;
 
-  // sum angle energy
-  double etot_angle = 0.0;
-  for (int32_t a = 0; a < num_angles; a++) {
-    etot_angle += calcAngleEnergy(&pos[angle_top[a].i0],
-                                  &pos[angle_top[a].i1],
-                                  &pos[angle_top[a].i2],
-                                  cf_a,
-                                  bound);
-  }
+  // sum electrostatic energy
+  const double etot_coulomb = pppm ? calcCoulombEnergyTotal(pppm, store, bound) : 0.0;
 
   // print out energy
-  const double etot = etot_bond + etot_angle;
-  fprintf(self->fps[ENERGY], "%d %f %f %f\n", mc_steps, etot_bond, etot_angle, etot);
+  EnergyBuffer* ebuffer = (EnergyBuffer*) self->buffer[ENERGY];
+  const double etot = etot_bond + etot_angle + etot_nonbond + etot_coulomb;
+  fprintf(self->fps[ENERGY], "%d ", mc_steps);
+  printEnergyColumns(self->fps[ENERGY], ebuffer,
+                     etot_bond, etot_angle, etot_nonbond, etot_coulomb, etot);
 
   // accumulate result
-  EnergyBuffer* ebuffer = (EnergyBuffer*) self->buffer[ENERGY];
   ebuffer->bond += etot_bond;
   ebuffer->angle += etot_angle;
+  ebuffer->nonbond += etot_nonbond;
+  ebuffer->coulomb += etot_coulomb;
   ebuffer->total += etot;
   self->num_frames[ENERGY]++;
 }
@@ -259,6 +327,7 @@ static void finalizePressureObserver(Observer* self)
 static void observePressure(Observer* self,
                             const int32_t mcsteps,
                             const System* system,
+                            const BondedSums* bonded,
                             const Boundary* bound,
                             const Parameter* param)
 {
@@ -270,24 +339,18 @@ static void observePressure(Observer* self,
     is_first_call = false;
   }
 
-  GET_TOPOLOGY(system, param);
-  const dvec* pos = getPos(system);
+  UNUSED_PARAMETER(param);
+  const PosStore* store = getPosStore(system);
 
-  dtensor3 vir_tot = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
-  for (int32_t b = 0; b < num_bonds; b++) {
-    const dtensor3 dvir = calcBondVirial(&pos[bond_top[b].i0],
-                                         &pos[bond_top[b].i1],
-                                         cf_b,
-                                         l0,
-                                         bound);
+  dtensor3 vir_tot = bonded->virial;
+  const VerletList* verlet = getVerletList(system);
+  if (verlet) {
+    const dtensor3 dvir = calcNonbondVirialTotal(verlet, store, bound);
     dtensor3_add(&vir_tot, &dvir);
   }
-  for (int32_t a = 0; a < num_angles; a++) {
-    const dtensor3 dvir = calcAngleVirial(&pos[angle_top[a].i0],
-                                          &pos[angle_top[a].i1],
-                                          &pos[angle_top[a].i2],
-                                          cf_a,
-                                          bound);
+  Pppm* pppm = getPppm(system);
+  if (pppm) {
+    const dtensor3 dvir = calcCoulombVirialTotal(pppm, store, bound);
     dtensor3_add(&vir_tot, &dvir);
   }
   fprintf(self->fps[PRESSURE],
@@ -303,30 +366,65 @@ static void observePressure(Observer* self,
   self->num_frames[PRESSURE]++;
 }
 
+// NOTE: for melts, Rg is averaged over the unwrapped chains.
+static double calcMeltRg(const Melt* melt,
+                         const PosStore* store,
+                         const Boundary* bound,
+                         dvec* chain_buf)
+{
+  const int32_t num_chains = getNumChainsOfMelt(melt);
+  const int32_t chain_len = getChainLenOfMelt(melt);
+  double rg_sum = 0.0;
+  for (int32_t c = 0; c < num_chains; c++) {
+    unwrapChain(melt, c, store, bound, chain_buf);
+    dvec cmpos = {.x = 0.0, .y = 0.0, .z = 0.0};
+    for (int32_t k = 0; k < chain_len; k++) {
+      add_dvec(&cmpos, &chain_buf[k]);
+    }
+    div_scalar(&cmpos, (double)chain_len);
+    double rg2 = 0.0;
+    for (int32_t k = 0; k < chain_len; k++) {
+      const dvec dr = sub_dvec_new(&chain_buf[k], &cmpos);
+      rg2 += norm2(&dr);
+    }
+    rg_sum += sqrt(rg2 / chain_len);
+  }
+  return rg_sum / num_chains;
+}
+
+static void writeRg(Observer* self,
+                    const int32_t mcsteps,
+                    const double rg)
+{
+  fprintf(self->fps[RG], "%d %f\n", mcsteps, rg);
+  self->num_frames[RG]++;
+}
+
 static void observeRg(Observer* self,
                       const int32_t mcsteps,
                       const System* system,
                       const Boundary* bound,
                       const Parameter* param)
 {
-  const dvec* pos = getPos(system);
-  const int32_t num_ptcl = getNumPtcl(param);
+  UNUSED_PARAMETER(param);
+  const Melt* melt = getMelt(system);
 
-  dvec cmpos = {.x = 0.0, .y = 0.0, .z = 0.0};
-  for (int32_t i = 0; i < num_ptcl; i++) {
-    add_dvec(&cmpos, &pos[i]);
+  if (melt) {
+    dvec* chain_buf = (dvec*)xmalloc(getChainLenOfMelt(melt) * sizeof(dvec));
+    writeRg(self, mcsteps, calcMeltRg(melt, getPosStore(system), bound, chain_buf));
+    xfree(chain_buf);
+    return;
   }
-  div_scalar(&cmpos, (double)num_ptcl);
 
-  double rg = 0.0;
-  for (int32_t i = 0; i < num_ptcl; i++) {
-    rg += distance2(&cmpos, &pos[i], bound);
-  }
-  rg /= num_ptcl;
-  rg = sqrt(rg);
+  writeRg(self, mcsteps, calcRgOfStore(getPosStore(system), bound, getBatchBuffers(system)));
+}
 
-  fprintf(self->fps[RG], "%d %f\n", mcsteps, rg);
-  self->num_frames[RG]++;
+static void writeEnd2End(Observer* self,
+                         const int32_t mcsteps,
+                         const double e2e)
+{
+  fprintf(self->fps[END_TO_END], "%d %f\n", mcsteps, e2e);
+  self->num_frames[END_TO_END]++;
 }
 
 static void observeEnd2End(Observer* self,
@@ -335,11 +433,28 @@ static void observeEnd2End(Observer* self,
                            const Boundary* bound,
                            const Parameter* param)
 {
-  const dvec* pos = getPos(system);
+  const PosStore* store = getPosStore(system);
   const int32_t num_ptcl = getNumPtcl(param);
-  const double e2e = distance(&pos[0], &pos[num_ptcl - 1], bound);
-  fprintf(self->fps[END_TO_END], "%d %f\n", mcsteps, e2e);
-  self->num_frames[END_TO_END]++;
+  const Melt* melt = getMelt(system);
+  double e2e = 0.0;
+  if (melt) {
+    // NOTE: averaged over chains, using unwrapped chain conformations
+    const int32_t num_chains = getNumChainsOfMelt(melt);
+    const int32_t chain_len = getChainLenOfMelt(melt);
+    dvec* chain_buf = (dvec*)xmalloc(chain_len * sizeof(dvec));
+    for (int32_t c = 0; c < num_chains; c++) {
+      unwrapChain(melt, c, store, bound, chain_buf);
+      const dvec dr = sub_dvec_new(&chain_buf[chain_len - 1], &chain_buf[0]);
+      e2e += norm(&dr);
+    }
+    e2e /= num_chains;
+    xfree(chain_buf);
+  } else {
+    const dvec pos_first = getPosOfStore(store, getStoredId(system, 0));
+    const dvec pos_last = getPosOfStore(store, getStoredId(system, num_ptcl - 1));
+    e2e = distance(&pos_first, &pos_last, bound);
+  }
+  writeEnd2End(self, mcsteps, e2e);
 }
 
 static void observeAcceptRatio(Observer* self,
@@ -348,7 +463,14 @@ static void observeAcceptRatio(Observer* self,
                                const Parameter* param)
 {
   UNUSED_PARAMETER(param);
-  fprintf(self->fps[ACCEPT_RATIO], "%d %f\n", mcsteps, getAcceptRatio(system));
+  const Melt* melt = getMelt(system);
+  if (melt) {
+    // NOTE: the last column is the cumulative acceptance ratio of double-bridging moves
+    fprintf(self->fps[ACCEPT_RATIO], "%d %f %f\n", mcsteps, getAcceptRatio(system),
+            getDoubleBridgeAcceptRatio(melt));
+  } else {
+    fprintf(self->fps[ACCEPT_RATIO], "%d %f\n", mcsteps, getAcceptRatio(system));
+  }
   self->num_frames[ACCEPT_RATIO]++;
 }
 
@@ -365,14 +487,45 @@ static void observeTraject(Observer* self,
                            const System* system,
                            const Parameter* param)
 {
-  const dvec* pos = getPos(system);
+  const PosStore* store = getPosStore(system);
   const int32_t num_ptcl = getNumPtcl(param);
+  const int32_t dim = getDimension(param);
   writeXYZHeader(self->fps[TRAJECT], num_ptcl, mcsteps);
   for (int32_t i = 0; i < num_ptcl; i++) {
+    const dvec r = getPosOfStore(store, getStoredId(system, i));
+    writeTrajectPtcl(self, &r, dim);
+  }
+  self->num_frames[TRAJECT]++;
+}
+
+void writeTrajectPtcl(Observer* self,
+                      const dvec* r,
+                      const int32_t dim)
+{
+  UNUSED_PARAMETER(self);
+  if (dim == 3) {
     printf(
-            "C %.15g %.15g %.15g\n", pos[i].x, pos[i].y, pos[i].z);
+            "C %.15g %.15g %.15g\n", r->x, r->y, r->z);
+  } else {
+    // NOTE: z is written as a literal 0 to keep the xyz format.
+    printf(
+            "C %.15g %.15g 0\n", r->x, r->y);
   }
+}
+
+void writeBondLen(Observer* self,
+                  const double bond_len)
+{
+  fprintf(self->fps[BOND_LEN_DIST], "%.15g\n", bond_len);
+}
+
+void writeMicroFrameHeader(Observer* self,
+                           const int32_t mc_steps,
+                           const int32_t num_ptcl)
+{
+  writeXYZHeader(self->fps[TRAJECT], num_ptcl, mc_steps);
   self->num_frames[TRAJECT]++;
+  self->num_frames[BOND_LEN_DIST]++;
 }
 
 static void observeBondLenDist(Observer* self,
@@ -380,68 +533,56 @@ static void observeBondLenDist(Observer* self,
                                const Boundary* bound,
                                const Parameter* param)
 {
-  const dvec* pos = getPos(system);
-  const int32_t num_ptcl = getNumPtcl(param);
-  for (int32_t i = 1; i < num_ptcl; i++) {
-    fprintf(self->fps[BOND_LEN_DIST],
-            "%.15g\n", distance(&pos[i], &pos[i-1], bound));
+  UNUSED_PARAMETER(param);
+  const PosStore* store = getPosStore(system);
+  const topol* top = getTopol(system);
+  const int32_t num_bonds = getNumBonds(top);
+  const pair* bond_top = getBondTopol(top);
+  for (int32_t b = 0; b < num_bonds; b++) {
+    const dvec r0 = getPosOfStore(store, bond_top[b].i0);
+    const dvec r1 = getPosOfStore(store, bond_top[b].i1);
+    writeBondLen(self, distance(&r0, &r1, bound));
   }
   self->num_frames[BOND_LEN_DIST]++;
 }
 
+// NOTE: height fluctuation spectrum, y(x) of a 2D chain (nx_div q values)
+//       or z(x, y) of a 3D mesh (nx_div * ny_div q vectors).
+#define SPECTRUM_NDIV_2D 100
+#define SPECTRUM_NDIV_3D 50
+
 typedef struct SpectrumBuffer_t {
   double *qx, *qy;
+  int32_t dim;
   int32_t nx_div, ny_div;
   double complex* spect_sum;
   double factor; // normalize factor
 } SpectrumBuffer;
 
-static double complex calcftilde1D(const dvec* pos,
-                                   const int32_t n_ptcl,
-                                   const double qx_at)
-{
-  double complex sum = 0.0 + 0.0 * I;
-  for (int32_t i = 0; i < n_ptcl; i++) {
-    sum += pos[i].y * cexp(-I * qx_at * pos[i].x);
-  }
-  return sum;
-}
-
-static double complex calcftilde2D(const dvec* pos,
-                                   const int32_t n_ptcl,
-                                   const double qx_at,
-                                   const double qy_at)
-{
-  double complex sum = 0.0 + 0.0 * I;
-  for (int32_t i = 0; i < n_ptcl; i++) {
-    sum += pos[i].z * cexp(-I * (qx_at * pos[i].x + qy_at * pos[i].y));
-  }
-  return sum;
-}
-
-static void doFourierTransform1D(const dvec* pos,
-                                 const int32_t n_ptcl,
+// NOTE: each q-vector is summed on its own, so the q-vectors may be
+//       distributed over the observer threads without changing the result.
+static void doFourierTransform1D(const PosStore* store,
                                  SpectrumBuffer* sbuffer)
 {
   const int32_t nx_div = sbuffer->nx_div;
+#pragma omp parallel for schedule(dynamic)
   for (int32_t i = 0; i < nx_div; i++) {
-    sbuffer->spect_sum[i] += calcftilde1D(pos, n_ptcl, sbuffer->qx[i]);
+    sbuffer->spect_sum[i] += calcHeightDftOfStore(store, sbuffer->qx[i], 0.0);
   }
 }
 
-static void doFourierTransform2D(const dvec* pos,
-                                 const int32_t n_ptcl,
+static void doFourierTransform2D(const PosStore* store,
                                  SpectrumBuffer* sbuffer)
 {
   const int32_t nx_div = sbuffer->nx_div;
-  const int32_t ny_div = sbuffer->ny_div;
-  int32_t cnt = 0;
-  for (int32_t iy = 0; iy < ny_div; iy++) {
-    for (int32_t ix = 0; ix < nx_div; ix++) {
-      sbuffer->spect_sum[cnt++] += calcftilde2D(pos, n_ptcl,
-                                                sbuffer->qx[ix],
-                                                sbuffer->qy[iy]);
-    }
+  const int32_t num_q = nx_div * sbuffer->ny_div;
+#pragma omp parallel for schedule(dynamic)
+  for (int32_t cnt = 0; cnt < num_q; cnt++) {
+    const int32_t ix = cnt % nx_div;
+    const int32_t iy = cnt / nx_div;
+    sbuffer->spect_sum[cnt] += calcHeightDftOfStore(store,
+                                                    sbuffer->qx[ix],
+                                                    sbuffer->qy[iy]);
   }
 }
 
@@ -471,48 +612,52 @@ static void setQvector2D(double* qx, double* qy,
   }
 }
 
+static void setSpectrumGrid(SpectrumBuffer* sbuffer,
+                            const Parameter* param)
+{
+  const dvec box_length = getBoxlength(param);
+  const double b_len = getBondLen(param);
+  sbuffer->dim = getDimension(param);
+  if (sbuffer->dim == 3) {
+    sbuffer->nx_div = SPECTRUM_NDIV_3D;
+    sbuffer->ny_div = SPECTRUM_NDIV_3D;
+    sbuffer->factor = 1.0 / sqrt(box_length.x * box_length.y);
+    sbuffer->qx = (double*) xmalloc(sbuffer->nx_div * sizeof(double));
+    sbuffer->qy = (double*) xmalloc(sbuffer->ny_div * sizeof(double));
+  } else {
+    sbuffer->nx_div = SPECTRUM_NDIV_2D;
+    sbuffer->ny_div = 1;
+    sbuffer->factor = 1.0 / sqrt(box_length.x);
+    sbuffer->qx = (double*) xmalloc(sbuffer->nx_div * sizeof(double));
+    sbuffer->qy = NULL;
+  }
+
+  if (sbuffer->dim == 3) {
+    const double qx_low = 1.0 / (M_PI * box_length.x);
+    const double qy_low = 1.0 / (M_PI * box_length.y);
+    const double qx_up  = 1.0 / (M_PI * b_len), qy_up  = 1.0 / (M_PI * b_len);
+    setQvector2D(sbuffer->qx, sbuffer->qy,
+                 qx_low, qx_up,
+                 qy_low, qy_up,
+                 sbuffer->nx_div, sbuffer->ny_div);
+  } else {
+    const double qx_low = 1.0 / (M_PI * box_length.x);
+    const double qx_up  = 1.0 / (M_PI * b_len);
+    setQvector1D(sbuffer->qx,
+                 qx_low, qx_up,
+                 sbuffer->nx_div);
+  }
+}
+
 static void initializeFluctSpetrumObserver(Observer* self,
                                            const Parameter* param)
 {
   self->buffer[FLUCT_SPECTRUM] = (SpectrumBuffer*) xmalloc(sizeof(SpectrumBuffer));
   SpectrumBuffer* sbuffer      = (SpectrumBuffer*) self->buffer[FLUCT_SPECTRUM];
-  const dvec box_length        = getBoxlength(param);
-  const double b_len = getBondLen(param);
-#ifdef SIMULATION_3D
-  sbuffer->nx_div = 50;
-  sbuffer->ny_div = 50;
-  sbuffer->factor = 1.0 / sqrt(box_length.x * box_length.y);
-  sbuffer->qx = (double*) xmalloc(sbuffer->nx_div * sizeof(double));
-  sbuffer->qy = (double*) xmalloc(sbuffer->ny_div * sizeof(double));
-#else
-  sbuffer->nx_div = 100;
-  sbuffer->ny_div = 1;
-  sbuffer->factor = 1.0 / sqrt(box_length.x);
-  sbuffer->qx = (double*) xmalloc(sbuffer->nx_div * sizeof(double));
-  sbuffer->qy = NULL;
-#endif
+  setSpectrumGrid(sbuffer, param);
   const int32_t ndiv = sbuffer->nx_div * sbuffer->ny_div;
   sbuffer->spect_sum
     = (double complex*) xmalloc(ndiv * sizeof(double complex));
-
-#ifdef SIMULATION_3D
-  const double qx_low = 1.0 / (M_PI * box_length.x);
-  const double qy_low = 1.0 / (M_PI * box_length.y);
-  const double qx_up  = 1.0 / (M_PI * b_len), qy_up  = 1.0 / (M_PI * b_len);
-  setQvector2D(sbuffer->qx, sbuffer->qy,
-               qx_low, qx_up,
-               qy_low, qy_up,
-               sbuffer->nx_div, sbuffer->ny_div);
-  UNUSED_FUNCTION(setQvector1D);
-#else
-  const double qx_low = 1.0 / (M_PI * box_length.x);
-  const double qx_up  = 1.0 / (M_PI * b_len);
-  setQvector1D(sbuffer->qx,
-               qx_low, qx_up,
-               sbuffer->nx_div);
-  UNUSED_FUNCTION(setQvector2D);
-#endif
-
   for (int32_t i = 0; i < ndiv; i++) {
     sbuffer->spect_sum[i] = 0.0 + 0.0 * I;
   }
@@ -523,31 +668,31 @@ static void finalizeFluctSpetrumObserver(Observer* self)
 {
   SpectrumBuffer* sbuffer = (SpectrumBuffer*) self->buffer[FLUCT_SPECTRUM];
   const double cf = sbuffer->factor / self->num_frames[FLUCT_SPECTRUM];
-#ifdef SIMULATION_3D
-  int32_t cnt = 0;
-  for (int32_t iy = 0; iy < sbuffer->ny_div; iy++) {
-    for (int32_t ix = 0; ix < sbuffer->nx_div; ix++) {
-      const double q_norm = sqrt(sbuffer->qx[i] * sbuffer->qx[i]
-                                 + sbuffer->qy[i] * sbuffer->qy[i]);
-      sbuffer->spect_sum[cnt] *= cf;
+  if (sbuffer->dim == 3) {
+    int32_t cnt = 0;
+    for (int32_t iy = 0; iy < sbuffer->ny_div; iy++) {
+      for (int32_t ix = 0; ix < sbuffer->nx_div; ix++) {
+        const double q_norm = sqrt(sbuffer->qx[ix] * sbuffer->qx[ix]
+                                   + sbuffer->qy[iy] * sbuffer->qy[iy]);
+        sbuffer->spect_sum[cnt] *= cf;
+        const double spect_norm
+          = creal(sbuffer->spect_sum[cnt] * conj(sbuffer->spect_sum[cnt]));
+        fprintf(self->fps[FLUCT_SPECTRUM],
+                "%.10g %.10g\n",
+                q_norm, spect_norm);
+        cnt++;
+      }
+    }
+  } else {
+    for (int32_t i = 0; i < sbuffer->nx_div; i++) {
+      sbuffer->spect_sum[i] *= cf;
       const double spect_norm
-        = creal(sbuffer->spect_sum[cnt] * conj(sbuffer->spect_sum[cnt]));
+        = creal(sbuffer->spect_sum[i] * conj(sbuffer->spect_sum[i]));
       fprintf(self->fps[FLUCT_SPECTRUM],
               "%.10g %.10g\n",
-              q_norm, spect_norm);
-      cnt++;
+              sbuffer->qx[i], spect_norm);
     }
   }
-#else
-  for (int32_t i = 0; i < sbuffer->nx_div; i++) {
-    sbuffer->spect_sum[i] *= cf;
-    const double spect_norm
-      = creal(sbuffer->spect_sum[i] * conj(sbuffer->spect_sum[i]));
-    fprintf(self->fps[FLUCT_SPECTRUM],
-            "%.10g %.10g\n",
-            sbuffer->qx[i], spect_norm);
-  }
-#endif
   xfree(sbuffer->qx);
   xfree(sbuffer->qy);
   xfree(sbuffer->spect_sum);
@@ -557,23 +702,55 @@ static void observeFluctSpectrum(Observer* self,
                                  const System* system,
                                  const Parameter* param)
 {
-  static bool is_first_call = true;
-  if (is_first_call) {
+  if (!self->buffer[FLUCT_SPECTRUM]) {
     initializeFluctSpetrumObserver(self, param);
-    is_first_call = false;
   }
 
-  const dvec* pos = getPos(system);
-  const int32_t num_ptcl = getNumPtcl(param);
+  const PosStore* store = getPosStore(system);
   SpectrumBuffer* sbuffer = (SpectrumBuffer*) self->buffer[FLUCT_SPECTRUM];
 
-#ifdef SIMULATION_3D
-  doFourierTransform2D(pos, num_ptcl, sbuffer);
-  UNUSED_FUNCTION(doFourierTransform1D);
-#else
-  doFourierTransform1D(pos, num_ptcl, sbuffer);
-  UNUSED_FUNCTION(doFourierTransform2D);
-#endif
+  if (sbuffer->dim == 3) {
+    doFourierTransform2D(store, sbuffer);
+  } else {
+    doFourierTransform1D(store, sbuffer);
+  }
 
   self->num_frames[FLUCT_SPECTRUM]++;
 }
+
+static void addFluctSpectrum(Observer* self,
+                             const double complex* height_dft,
+                             const Parameter* param)
+{
+  if (!self->buffer[FLUCT_SPECTRUM]) {
+    initializeFluctSpetrumObserver(self, param);
+  }
+
+  SpectrumBuffer* sbuffer = (SpectrumBuffer*) self->buffer[FLUCT_SPECTRUM];
+  const int32_t num_q = sbuffer->nx_div * sbuffer->ny_div;
+  for (int32_t cnt = 0; cnt < num_q; cnt++) {
+    sbuffer->spect_sum[cnt] += height_dft[cnt];
+  }
+
+  self->num_frames[FLUCT_SPECTRUM]++;
+}
+
+int32_t getNumSpectrumQvectors(const Parameter* param)
+{
+  return (getDimension(param) == 3) ? SPECTRUM_NDIV_3D * SPECTRUM_NDIV_3D : SPECTRUM_NDIV_2D;
+}
+
+// NOTE: qy is 0 in 2D.
+void setSpectrumQvectors(const Parameter* param,
+                         double* qx,
+                         double* qy)
+{
+  SpectrumBuffer sbuffer;
+  setSpectrumGrid(&sbuffer, param);
+  for (int32_t cnt = 0; cnt < sbuffer.nx_div * sbuffer.ny_div; cnt++) {
+    qx[cnt] = sbuffer.qx[cnt % sbuffer.nx_div];
+    qy[cnt] = (sbuffer.dim == 3) ? sbuffer.qy[cnt / sbuffer.nx_div] : 0.0;
+  }
+  xfree(sbuffer.qx);
+  xfree(sbuffer.qy);
+}
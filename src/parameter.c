@@ -8,22 +8,63 @@
 #include "file_utils.h"
 #include "utils.h"
 #include "boundary.h"
+#include "system.h"
+#include "topol.h"
+#include "reorder.h"
+#include "site_order.h"
+#include "domain.h"
+#include "batch_kernels.h"
 
 struct Parameter_t {
   string* root_dir;
+  int32_t dimension;
   int32_t num_ptcl;
   int32_t side_dim_x;
   int32_t side_dim_y;
   int32_t total_steps;
   int32_t observe_interval_mic;
   int32_t observe_interval_mac;
+  int32_t num_replicas;
+  int32_t num_chains;
+  int32_t prefetch_distance;
+  int32_t reorder_interval;
+  int32_t observer_threads;
+  int32_t huge_pages;
+  int32_t sweep_tile;
+  int32_t bond_cache;
+  int32_t pppm_mesh;
   double bond_len;
   double init_blen;
   double step_len;
   double cf_bond;
   double cf_angle;
+  double double_bridge_prob;
+  double double_bridge_cutoff;
+  double excluded_diameter;
+  double lj_epsilon;
+  double lj_sigma;
+  double lj_cutoff;
+  double verlet_skin;
+  double fene_r0;
+  double angle_theta0;
+  double bjerrum_len;
+  double ewald_alpha;
+  double ewald_rcut;
+  double ghost_width;
+  double drift_tolerance;
   dvec box_length;
   string* boundary_name;
+  string* model_name;
+  string* bond_type;
+  string* angle_type;
+  string* bond_table;
+  string* angle_table;
+  string* charge_file;
+  string* position_precision;
+  string* topology_file;
+  string* topology_mode;
+  string* reorder_curve;
+  string* sweep_order;
   uint32_t rand_seed;
 };
 
@@ -40,30 +81,76 @@ Parameter* newParameter(const char* path)
 
 void deleteParameter(Parameter* self)
 {
-  dumpAllParameter(self);
+  if (isRootRank()) dumpAllParameter(self);
   delete_string(self->root_dir);
   delete_string(self->boundary_name);
+  if (self->model_name) delete_string(self->model_name);
+  if (self->bond_type) delete_string(self->bond_type);
+  if (self->angle_type) delete_string(self->angle_type);
+  if (self->bond_table) delete_string(self->bond_table);
+  if (self->angle_table) delete_string(self->angle_table);
+  if (self->charge_file) delete_string(self->charge_file);
+  if (self->position_precision) delete_string(self->position_precision);
+  if (self->topology_file) delete_string(self->topology_file);
+  if (self->topology_mode) delete_string(self->topology_mode);
+  if (self->reorder_curve) delete_string(self->reorder_curve);
+  if (self->sweep_order) delete_string(self->sweep_order);
   xfree(self);
 }
 
 static void initializeParameter(Parameter* self)
 {
   self->root_dir = NULL;
+  self->dimension = 2;
   self->num_ptcl = -1;
   self->side_dim_x = -1;
   self->side_dim_y = -1;
   self->total_steps = -1;
   self->observe_interval_mic = -1;
   self->observe_interval_mac = -1;
+  self->num_replicas = 1;
+  self->num_chains = 1;
+  self->prefetch_distance = 0;
+  self->reorder_interval = 0;
+  self->observer_threads = 1;
+  self->huge_pages = 0;
+  self->sweep_tile = 0;
+  self->bond_cache = 1;
+  self->pppm_mesh = 32;
   self->bond_len = nan("");
   self->step_len = nan("");
   self->cf_bond = nan("");
   self->cf_angle = nan("");
+  self->double_bridge_prob = 0.0;
+  self->double_bridge_cutoff = nan("");
+  self->excluded_diameter = 0.0;
+  self->lj_epsilon = 0.0;
+  self->lj_sigma = nan("");
+  self->lj_cutoff = nan("");
+  self->verlet_skin = nan("");
+  self->fene_r0 = nan("");
+  self->angle_theta0 = 0.0;
+  self->bjerrum_len = 1.0;
+  self->ewald_alpha = nan("");
+  self->ewald_rcut = nan("");
+  self->ghost_width = nan("");
+  self->drift_tolerance = 1.0e-4;
   self->box_length.x = nan("");
   self->box_length.y = nan("");
   self->box_length.z = 0.0;
   self->rand_seed = 0xffffffff;
   self->boundary_name = NULL;
+  self->model_name = NULL;
+  self->bond_type = NULL;
+  self->angle_type = NULL;
+  self->bond_table = NULL;
+  self->angle_table = NULL;
+  self->charge_file = NULL;
+  self->position_precision = NULL;
+  self->topology_file = NULL;
+  self->topology_mode = NULL;
+  self->reorder_curve = NULL;
+  self->sweep_order = NULL;
 }
 
 #define DUMP_WITH_TAG(fmt, value)               \
@@ -75,25 +162,70 @@ static void dumpAllParameter(Parameter* self)
   append_char(fname, "/all_param.dat");
   FILE* fp = xfopen(string_to_char(fname), "w");
   fprintf(fp, "%s = %s\n", "root_dir", string_to_char(self->root_dir));
+  DUMP_WITH_TAG("%s = %d\n", dimension);
   DUMP_WITH_TAG("%s = %d\n", num_ptcl);
   DUMP_WITH_TAG("%s = %d\n", side_dim_x);
   DUMP_WITH_TAG("%s = %d\n", side_dim_y);
   DUMP_WITH_TAG("%s = %d\n", total_steps);
   DUMP_WITH_TAG("%s = %d\n", observe_interval_mac);
   DUMP_WITH_TAG("%s = %d\n", observe_interval_mic);
+  DUMP_WITH_TAG("%s = %d\n", num_replicas);
+  DUMP_WITH_TAG("%s = %d\n", num_chains);
+  DUMP_WITH_TAG("%s = %d\n", prefetch_distance);
+  DUMP_WITH_TAG("%s = %d\n", reorder_interval);
+  DUMP_WITH_TAG("%s = %d\n", observer_threads);
+  DUMP_WITH_TAG("%s = %d\n", huge_pages);
+  fprintf(fp, "%s = %d\n", "sweep_tile", calcSweepTileSize(self->sweep_tile));
+  DUMP_WITH_TAG("%s = %d\n", bond_cache);
+  DUMP_WITH_TAG("%s = %d\n", pppm_mesh);
   DUMP_WITH_TAG("%s = %lf\n", bond_len);
   DUMP_WITH_TAG("%s = %lf\n", step_len);
   DUMP_WITH_TAG("%s = %lf\n", cf_bond);
   DUMP_WITH_TAG("%s = %lf\n", cf_angle);
+  DUMP_WITH_TAG("%s = %lf\n", double_bridge_prob);
+  DUMP_WITH_TAG("%s = %lf\n", double_bridge_cutoff);
+  DUMP_WITH_TAG("%s = %lf\n", excluded_diameter);
+  DUMP_WITH_TAG("%s = %lf\n", lj_epsilon);
+  DUMP_WITH_TAG("%s = %lf\n", lj_sigma);
+  DUMP_WITH_TAG("%s = %lf\n", lj_cutoff);
+  DUMP_WITH_TAG("%s = %lf\n", verlet_skin);
+  DUMP_WITH_TAG("%s = %lf\n", fene_r0);
+  DUMP_WITH_TAG("%s = %lf\n", angle_theta0);
+  DUMP_WITH_TAG("%s = %lf\n", bjerrum_len);
+  DUMP_WITH_TAG("%s = %lf\n", ewald_alpha);
+  DUMP_WITH_TAG("%s = %lf\n", ewald_rcut);
+  DUMP_WITH_TAG("%s = %lf\n", ghost_width);
+  DUMP_WITH_TAG("%s = %lf\n", drift_tolerance);
   DUMP_WITH_TAG("%s = %lf\n", box_length.x);
   DUMP_WITH_TAG("%s = %lf\n", box_length.y);
   DUMP_WITH_TAG("%s = %lf\n", box_length.z);
   DUMP_WITH_TAG("%s = %u\n", rand_seed);
   fprintf(fp, "%s = %s\n", "boundary_name", string_to_char(self->boundary_name));
+  fprintf(fp, "%s = %s\n", "model_name", getModelNameFromType(getModelTypeFromName(self->model_name)));
+  fprintf(fp, "%s = %s\n", "position_precision",
+          getPrecisionNameFromType(getPrecisionTypeFromName(self->position_precision)));
+  fprintf(fp, "%s = %s\n", "topology_mode",
+          getTopologyModeNameFromType(getTopologyModeTypeFromName(self->topology_mode)));
+  fprintf(fp, "%s = %s\n", "reorder_curve",
+          getReorderNameFromType(getReorderTypeFromName(self->reorder_curve)));
+  fprintf(fp, "%s = %s\n", "sweep_order",
+          getSweepOrderNameFromType(getSweepOrderTypeFromName(self->sweep_order)));
+  fprintf(fp, "%s = %s\n", "kernel_isa", getBatchKernelIsa());
+  if (self->bond_type) fprintf(fp, "%s = %s\n", "bond_type", string_to_char(self->bond_type));
+  if (self->angle_type) fprintf(fp, "%s = %s\n", "angle_type", string_to_char(self->angle_type));
+  if (self->bond_table) fprintf(fp, "%s = %s\n", "bond_table", string_to_char(self->bond_table));
+  if (self->angle_table) fprintf(fp, "%s = %s\n", "angle_table", string_to_char(self->angle_table));
+  if (self->charge_file) fprintf(fp, "%s = %s\n", "charge_file", string_to_char(self->charge_file));
+  if (self->topology_file) fprintf(fp, "%s = %s\n", "topology_file", string_to_char(self->topology_file));
   delete_string(fname);
   xfclose(fp);
 }
 
+int32_t getDimension(const Parameter* self)
+{
+  return self->dimension;
+}
+
 int32_t getNumPtcl(const Parameter* self)
 {
   return self->num_ptcl;
@@ -129,6 +261,121 @@ int32_t getObserveIntervalMic(const Parameter* self)
   return self->observe_interval_mic;
 }
 
+int32_t getNumReplicas(const Parameter* self)
+{
+  return self->num_replicas;
+}
+
+int32_t getNumChains(const Parameter* self)
+{
+  return self->num_chains;
+}
+
+int32_t getPrefetchDistance(const Parameter* self)
+{
+  return self->prefetch_distance;
+}
+
+int32_t getReorderInterval(const Parameter* self)
+{
+  return self->reorder_interval;
+}
+
+int32_t getObserverThreads(const Parameter* self)
+{
+  return self->observer_threads;
+}
+
+int32_t getHugePages(const Parameter* self)
+{
+  return self->huge_pages;
+}
+
+int32_t getBondCacheSwitch(const Parameter* self)
+{
+  return self->bond_cache;
+}
+
+int32_t getSweepTile(const Parameter* self)
+{
+  return self->sweep_tile;
+}
+
+double getDoubleBridgeProb(const Parameter* self)
+{
+  return self->double_bridge_prob;
+}
+
+double getDoubleBridgeCutoff(const Parameter* self)
+{
+  return self->double_bridge_cutoff;
+}
+
+double getExcludedDiameter(const Parameter* self)
+{
+  return self->excluded_diameter;
+}
+
+double getLJEpsilon(const Parameter* self)
+{
+  return self->lj_epsilon;
+}
+
+double getLJSigma(const Parameter* self)
+{
+  return self->lj_sigma;
+}
+
+double getLJCutoff(const Parameter* self)
+{
+  return self->lj_cutoff;
+}
+
+double getVerletSkin(const Parameter* self)
+{
+  return self->verlet_skin;
+}
+
+double getFeneR0(const Parameter* self)
+{
+  return self->fene_r0;
+}
+
+double getAngleTheta0(const Parameter* self)
+{
+  return self->angle_theta0;
+}
+
+double getBjerrumLen(const Parameter* self)
+{
+  return self->bjerrum_len;
+}
+
+double getEwaldAlpha(const Parameter* self)
+{
+  return self->ewald_alpha;
+}
+
+double getEwaldRcut(const Parameter* self)
+{
+  return self->ewald_rcut;
+}
+
+int32_t getPppmMesh(const Parameter* self)
+{
+  return self->pppm_mesh;
+}
+
+double getGhostWidth(const Parameter* self)
+{
+  return self->ghost_width;
+}
+
+double getDriftTolerance(const Parameter* self)
+{
+  return self->drift_tolerance;
+}
+
 uint32_t getRandSeed(const Parameter* self)
 {
   return self->rand_seed;
@@ -154,6 +401,61 @@ const string* getBoundaryName(const Parameter* self)
   return self->boundary_name;
 }
 
+const string* getModelName(const Parameter* self)
+{
+  return self->model_name;
+}
+
+const string* getBondType(const Parameter* self)
+{
+  return self->bond_type;
+}
+
+const string* getAngleType(const Parameter* self)
+{
+  return self->angle_type;
+}
+
+const string* getBondTable(const Parameter* self)
+{
+  return self->bond_table;
+}
+
+const string* getAngleTable(const Parameter* self)
+{
+  return self->angle_table;
+}
+
+const string* getChargeFile(const Parameter* self)
+{
+  return self->charge_file;
+}
+
+const string* getPositionPrecision(const Parameter* self)
+{
+  return self->position_precision;
+}
+
+const string* getTopologyFile(const Parameter* self)
+{
+  return self->topology_file;
+}
+
+const string* getTopologyMode(const Parameter* self)
+{
+  return self->topology_mode;
+}
+
+const string* getReorderCurve(const Parameter* self)
+{
+  return self->reorder_curve;
+}
+
+const string* getSweepOrder(const Parameter* self)
+{
+  return self->sweep_order;
+}
+
 dvec getBoxlength(const Parameter* self)
 {
   return self->box_length;
@@ -192,6 +494,36 @@ static void getKeysAndValues(const vector_ptr_string* key_values,
     delete_string(value_name);                                          \
   } while (0)
 
+// NOTE: 2D runs hold chains in the xy plane (num_ptcl), 3D runs hold
+//       side_dim_x * side_dim_y meshes.
+static void checkDimension(Parameter* self)
+{
+  if (self->dimension != 2 && self->dimension != 3) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "dimension should be 2 or 3 (%d).\n", self->dimension);
+    exit(1);
+  }
+  if (self->dimension == 3) {
+    // NOTE: num_ptcl of a topology read from file is given explicitly.
+    if (!self->topology_file) self->num_ptcl = self->side_dim_x * self->side_dim_y;
+  } else if (self->box_length.z != 0.0) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "box_length.z cannot be specified for dimension 2.\n");
+    exit(1);
+  }
+}
+
+// NOTE: the fixed-point positions are fractions of the periodic box.
+static void checkPrecision(Parameter* self)
+{
+  if (getPrecisionTypeFromName(self->position_precision) != FIXED_POINT) return;
+  if (!self->boundary_name || getBoundaryTypeFromName(self->boundary_name) != PERIODIC) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "position_precision fixed requires boundary_name periodic.\n");
+    exit(1);
+  }
+}
+
 void readParameterFromFile(Parameter* self)
 {
   string* input_fname = new_string_from_string(self->root_dir);
@@ -212,13 +544,10 @@ void readParameterFromFile(Parameter* self)
       continue;
     }
 
-#ifdef SIMULATION_3D
+    MATCH(dimension, int32_t);
+    MATCH(num_ptcl, int32_t);
     MATCH(side_dim_x, int32_t);
     MATCH(side_dim_y, int32_t);
-    self->num_ptcl = self->side_dim_x * self->side_dim_y;
-#else
-    MATCH(num_ptcl, int32_t);
-#endif
     MATCH(bond_len, double);
     MATCH(init_blen, double);
     MATCH(step_len, double);
@@ -227,14 +556,46 @@ void readParameterFromFile(Parameter* self)
     MATCH(total_steps, int32_t);
     MATCH(observe_interval_mic, int32_t);
     MATCH(observe_interval_mac, int32_t);
+    MATCH(num_replicas, int32_t);
+    MATCH(num_chains, int32_t);
+    MATCH(prefetch_distance, int32_t);
+    MATCH(reorder_interval, int32_t);
+    MATCH(observer_threads, int32_t);
+    MATCH(huge_pages, int32_t);
+    MATCH(sweep_tile, int32_t);
+    MATCH(bond_cache, int32_t);
+    MATCH(double_bridge_prob, double);
+    MATCH(double_bridge_cutoff, double);
+    MATCH(excluded_diameter, double);
+    MATCH(lj_epsilon, double);
+    MATCH(lj_sigma, double);
+    MATCH(lj_cutoff, double);
+    MATCH(verlet_skin, double);
+    MATCH(fene_r0, double);
+    MATCH(angle_theta0, double);
+    MATCH(bjerrum_len, double);
+    MATCH(ewald_alpha, double);
+    MATCH(ewald_rcut, double);
+    MATCH(pppm_mesh, int32_t);
+    MATCH(ghost_width, double);
+    MATCH(drift_tolerance, double);
     MATCH(boundary_name, string);
+    MATCH(model_name, string);
+    MATCH(bond_type, string);
+    MATCH(angle_type, string);
+    MATCH(bond_table, string);
+    MATCH(angle_table, string);
+    MATCH(charge_file, string);
+    MATCH(position_precision, string);
+    MATCH(topology_file, string);
+    MATCH(topology_mode, string);
+    MATCH(reorder_curve, string);
+    MATCH(sweep_order, string);
     if (self->boundary_name) { /// boundary name is already set.
       if (getBoundaryTypeFromName(self->boundary_name) == PERIODIC) {
         MATCH(box_length.x, double);
         MATCH(box_length.y, double);
-#ifdef SIMULATION_3D
         MATCH(box_length.z, double);
-#endif
       }
     }
     MATCH(rand_seed, uint32_t);
@@ -245,4 +606,7 @@ void readParameterFromFile(Parameter* self)
   delete_splitted_strings(keys);
   delete_splitted_strings(values);
   xfclose(fp);
+
+  checkDimension(self);
+  checkPrecision(self);
 }
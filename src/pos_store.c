@@ -0,0 +1,24 @@
+#include "pos_store.h"
+
+#include "arena.h"
+
+// NOTE: the arena returns zeroed memory aligned to ARENA_ALIGN.
+static double* newComponent(const int32_t num_padded,
+                            Arena* arena)
+{
+  return (double*)allocArena(arena, num_padded * sizeof(double));
+}
+
+PosStore* newPosStore(const int32_t num_ptcl,
+                      const int32_t dim,
+                      Arena* arena)
+{
+  PosStore* self = (PosStore*)allocArena(arena, sizeof(PosStore));
+  self->num_ptcl = num_ptcl;
+  self->num_padded = (num_ptcl + POS_STORE_BLOCK - 1) / POS_STORE_BLOCK * POS_STORE_BLOCK;
+  self->dim = dim;
+  self->x = newComponent(self->num_padded, arena);
+  self->y = newComponent(self->num_padded, arena);
+  self->z = (dim == 3) ? newComponent(self->num_padded, arena) : NULL;
+  return self;
+}
@@ -0,0 +1,59 @@
+#include "potential.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+const char* getBondNameFromType(BOND_TYPE type)
+{
+  switch (type) {
+  case BOND_HARMONIC:
+    return "harmonic";
+  case BOND_FENE:
+    return "fene";
+  case BOND_TABULATED:
+    return "tabulated";
+  default:
+    fprintf(stderr, "Unknown type\n");
+    return NULL;
+  }
+}
+
+// NOTE: harmonic bond is used when bond_type is not specified.
+BOND_TYPE getBondTypeFromName(const string* bond_name)
+{
+  if (!bond_name) return BOND_HARMONIC;
+  for (int32_t type = BOND_HARMONIC; type < NUM_BOND_TYPES; type++) {
+    if (0 == strcmp(string_to_char(bond_name), getBondNameFromType(type))) return type;
+  }
+  fprintf(stderr, "Error occurs in getBondTypeFromName at %s:%d\n", __FILE__, (int32_t)__LINE__);
+  fprintf(stderr, "Unknown bond type %s\n", string_to_char(bond_name));
+  exit(1);
+}
+
+const char* getAngleNameFromType(ANGLE_TYPE type)
+{
+  switch (type) {
+  case ANGLE_KRATKY_POROD:
+    return "kratky_porod";
+  case ANGLE_COSINE_SQUARED:
+    return "cosine_squared";
+  case ANGLE_TABULATED:
+    return "tabulated";
+  default:
+    fprintf(stderr, "Unknown type\n");
+    return NULL;
+  }
+}
+
+// NOTE: Kratky-Porod (cosine) angle is used when angle_type is not specified.
+ANGLE_TYPE getAngleTypeFromName(const string* angle_name)
+{
+  if (!angle_name) return ANGLE_KRATKY_POROD;
+  for (int32_t type = ANGLE_KRATKY_POROD; type < NUM_ANGLE_TYPES; type++) {
+    if (0 == strcmp(string_to_char(angle_name), getAngleNameFromType(type))) return type;
+  }
+  fprintf(stderr, "Error occurs in getAngleTypeFromName at %s:%d\n", __FILE__, (int32_t)__LINE__);
+  fprintf(stderr, "Unknown angle type %s\n", string_to_char(angle_name));
+  exit(1);
+}
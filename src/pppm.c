@@ -0,0 +1,525 @@
+#include "pppm.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <complex.h>
+
+#include "utils.h"
+#include "math_utils.h"
+#include "fft.h"
+#include "parameter.h"
+#include "boundary.h"
+#include "cell_list.h"
+#include "file_utils.h"
+#include "string_c.h"
+
+#define PPPM_ORDER 4
+
+struct Pppm_t {
+  int32_t num_ptcl;
+  int32_t num_charged;
+  double* charge;
+  double lb;
+  double alpha;
+  dvec image_hess;     // diagonal Hessian of the potential of the images
+  double rcut;
+  double e_self;
+  double e_background; // of the uniform background of a net charge
+
+  int32_t mesh;
+  int32_t mesh3;
+  dvec box;
+  dvec inv_h;
+
+  double* influence;   // G(k)
+  double* q_mesh;      // scratch of the FFTs
+  double* phi_mesh;
+  double complex* work;
+
+  CellList* cells;
+
+  dvec* ref_pos;       // positions at the last FFT
+  int32_t num_moves;   // accepted charge moves since the last FFT
+  int32_t trial_id;
+};
+
+static inline int32_t wrapMesh(const int32_t i,
+                               const int32_t mesh)
+{
+  return i & (mesh - 1);
+}
+
+static inline int32_t getMeshIndex(const Pppm* self,
+                                   const int32_t ix,
+                                   const int32_t iy,
+                                   const int32_t iz)
+{
+  return (ix * self->mesh + iy) * self->mesh + iz;
+}
+
+// NOTE: weights M_4(f + j) of the mesh points base - j (j = 0, .., 3).
+static void calcStencil1D(const double u,
+                          int32_t* base,
+                          double* w)
+{
+  const double fl = floor(u);
+  const double f = u - fl;
+  const double f2 = f * f, f3 = f2 * f;
+  *base = (int32_t)fl;
+  w[0] = f3 / 6.0;
+  w[1] = (-3.0 * f3 + 3.0 * f2 + 3.0 * f + 1.0) / 6.0;
+  w[2] = (3.0 * f3 - 6.0 * f2 + 4.0) / 6.0;
+  w[3] = (1.0 - f) * (1.0 - f) * (1.0 - f) / 6.0;
+}
+
+typedef struct Stencil_t {
+  int32_t base[3];
+  double w[3][PPPM_ORDER];
+} Stencil;
+
+static Stencil calcStencil(const Pppm* self,
+                           const dvec* r)
+{
+  Stencil st;
+  calcStencil1D(r->x * self->inv_h.x, &st.base[0], st.w[0]);
+  calcStencil1D(r->y * self->inv_h.y, &st.base[1], st.w[1]);
+  calcStencil1D(r->z * self->inv_h.z, &st.base[2], st.w[2]);
+  return st;
+}
+
+// NOTE: the mesh potential at r, interpolated with the weights of r.
+static double interpolatePotential(const Pppm* self,
+                                   const dvec* r)
+{
+  const Stencil st = calcStencil(self, r);
+  double phi = 0.0;
+  for (int32_t a = 0; a < PPPM_ORDER; a++) {
+    const int32_t ix = wrapMesh(st.base[0] - a, self->mesh);
+    for (int32_t b = 0; b < PPPM_ORDER; b++) {
+      const int32_t iy = wrapMesh(st.base[1] - b, self->mesh);
+      const double* phi_row = &self->phi_mesh[getMeshIndex(self, ix, iy, 0)];
+      double sum = 0.0;
+      for (int32_t c = 0; c < PPPM_ORDER; c++) {
+        sum += st.w[2][c] * phi_row[wrapMesh(st.base[2] - c, self->mesh)];
+      }
+      phi += st.w[0][a] * st.w[1][b] * sum;
+    }
+  }
+  return phi;
+}
+
+// NOTE: reciprocal-space potential of a unit charge at dr, erf(alpha r) / r
+//       plus the quadratic term of its periodic images (-2 pi r^2 / 3V in
+//       a cube).
+static double calcOwnCloudPotential(const Pppm* self,
+                                    const dvec* dr)
+{
+  const double r = sqrt(norm2(dr));
+  const double phi = (r > 0.0) ? erf(self->alpha * r) / r : 2.0 * self->alpha / sqrt(M_PI);
+  return phi + 0.5 * (self->image_hess.x * dr->x * dr->x + self->image_hess.y * dr->y * dr->y
+                      + self->image_hess.z * dr->z * dr->z);
+}
+
+static inline double getWaveNumber(const int32_t k,
+                                   const int32_t mesh,
+                                   const double leng)
+{
+  return ((k <= mesh / 2) ? k : k - mesh) / leng;
+}
+
+// NOTE: |b(k)|^2 of the Euler exponential spline, order 4.
+static double calcBsplineModulus(const int32_t k,
+                                 const int32_t mesh)
+{
+  const double m4[PPPM_ORDER - 1] = { 1.0 / 6.0, 4.0 / 6.0, 1.0 / 6.0 };
+  double complex den = 0.0;
+  for (int32_t j = 0; j < PPPM_ORDER - 1; j++) {
+    const double arg = 2.0 * M_PI * k * j / mesh;
+    den += m4[j] * (cos(arg) + I * sin(arg));
+  }
+  const double den2 = creal(den * conj(den));
+  return 1.0 / den2;
+}
+
+// NOTE: also the Hessian at r = 0 of the images of a unit charge, that is
+//       -sum_k (4 pi / V) (m_a^2 / m^2) exp(-pi^2 m^2 / alpha^2) less that
+//       of erf(alpha r) / r, -4 alpha^3 / (3 sqrt(pi)).
+static void setupInfluence(Pppm* self)
+{
+  const int32_t mesh = self->mesh;
+  const double vol = self->box.x * self->box.y * self->box.z;
+  const double pi2_a2 = M_PI * M_PI / (self->alpha * self->alpha);
+  const double hess0 = 4.0 * pow(self->alpha, 3) / (3.0 * sqrt(M_PI));
+  self->image_hess.x = self->image_hess.y = self->image_hess.z = hess0;
+  for (int32_t kx = 0; kx < mesh; kx++) {
+    const double mx = getWaveNumber(kx, mesh, self->box.x);
+    const double bx = calcBsplineModulus(kx, mesh);
+    for (int32_t ky = 0; ky < mesh; ky++) {
+      const double my = getWaveNumber(ky, mesh, self->box.y);
+      const double by = calcBsplineModulus(ky, mesh);
+      for (int32_t kz = 0; kz < mesh; kz++) {
+        const double mz = getWaveNumber(kz, mesh, self->box.z);
+        const double bz = calcBsplineModulus(kz, mesh);
+        const double m2 = mx * mx + my * my + mz * mz;
+        const int32_t idx = getMeshIndex(self, kx, ky, kz);
+        self->influence[idx] = (m2 == 0.0) ? 0.0
+          : exp(-pi2_a2 * m2) / (M_PI * vol * m2) * bx * by * bz;
+        if (m2 == 0.0) continue;
+        const double h = -4.0 * M_PI / vol * exp(-pi2_a2 * m2) / m2;
+        self->image_hess.x += h * mx * mx;
+        self->image_hess.y += h * my * my;
+        self->image_hess.z += h * mz * mz;
+      }
+    }
+  }
+}
+
+// NOTE: the mesh charge Q and its transform S(k) in work.
+static void assignCharges(Pppm* self,
+                          const PosStore* store)
+{
+  memset(self->q_mesh, 0, self->mesh3 * sizeof(double));
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    const double q = self->charge[i];
+    if (q == 0.0) continue;
+    const dvec r = getPosOfStore(store, i);
+    const Stencil st = calcStencil(self, &r);
+    for (int32_t a = 0; a < PPPM_ORDER; a++) {
+      const int32_t ix = wrapMesh(st.base[0] - a, self->mesh);
+      for (int32_t b = 0; b < PPPM_ORDER; b++) {
+        const int32_t iy = wrapMesh(st.base[1] - b, self->mesh);
+        const double wxy = q * st.w[0][a] * st.w[1][b];
+        for (int32_t c = 0; c < PPPM_ORDER; c++) {
+          const int32_t iz = wrapMesh(st.base[2] - c, self->mesh);
+          self->q_mesh[getMeshIndex(self, ix, iy, iz)] += wxy * st.w[2][c];
+        }
+      }
+    }
+  }
+
+  for (int32_t i = 0; i < self->mesh3; i++) self->work[i] = self->q_mesh[i];
+  fft3d(self->work, self->mesh, self->mesh, self->mesh, -1);
+}
+
+// NOTE: sum_k E(k) with E(k) = G(k) |S(k)|^2 / 2, S(k) being in work.
+static double calcRecipEnergy(const Pppm* self)
+{
+  double e_recip = 0.0;
+  for (int32_t i = 0; i < self->mesh3; i++) {
+    e_recip += 0.5 * self->influence[i] * creal(self->work[i] * conj(self->work[i]));
+  }
+  return e_recip;
+}
+
+// NOTE: sum_k E(k) (delta_ab - 2 (1 + pi^2 m^2 / alpha^2) m_a m_b / m^2)
+//       with E(k) = G(k) |S(k)|^2 / 2, S(k) being in work.
+static dtensor3 calcRecipVirial(const Pppm* self)
+{
+  const int32_t mesh = self->mesh;
+  const double pi2_a2 = M_PI * M_PI / (self->alpha * self->alpha);
+  dtensor3 vir = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+  for (int32_t kx = 0; kx < mesh; kx++) {
+    const double mx = getWaveNumber(kx, mesh, self->box.x);
+    for (int32_t ky = 0; ky < mesh; ky++) {
+      const double my = getWaveNumber(ky, mesh, self->box.y);
+      for (int32_t kz = 0; kz < mesh; kz++) {
+        const int32_t idx = getMeshIndex(self, kx, ky, kz);
+        if (self->influence[idx] == 0.0) continue;
+        const double mz = getWaveNumber(kz, mesh, self->box.z);
+        const double m2 = mx * mx + my * my + mz * mz;
+        const double s2 = creal(self->work[idx] * conj(self->work[idx]));
+        const double e_k = 0.5 * self->influence[idx] * s2;
+        const double c = 2.0 * (1.0 + pi2_a2 * m2) / m2;
+        vir.xx += e_k * (1.0 - c * mx * mx);
+        vir.yy += e_k * (1.0 - c * my * my);
+        vir.zz += e_k * (1.0 - c * mz * mz);
+        vir.xy -= e_k * c * mx * my;
+        vir.xz -= e_k * c * mx * mz;
+        vir.yz -= e_k * c * my * mz;
+      }
+    }
+  }
+  vir.yx = vir.xy;
+  vir.zx = vir.xz;
+  vir.zy = vir.yz;
+  return vir;
+}
+
+// NOTE: recomputes the mesh potential G Q with FFT and takes the current
+//       positions as the reference positions of the charges.
+static void refreshMesh(Pppm* self,
+                        const PosStore* store)
+{
+  assignCharges(self, store);
+  for (int32_t i = 0; i < self->mesh3; i++) self->work[i] *= self->influence[i];
+  fft3d(self->work, self->mesh, self->mesh, self->mesh, +1);
+  for (int32_t i = 0; i < self->mesh3; i++) self->phi_mesh[i] = creal(self->work[i]);
+
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    if (self->charge[i] != 0.0) self->ref_pos[i] = getPosOfStore(store, i);
+  }
+  self->num_moves = 0;
+}
+
+// NOTE: sum_j q_j erfc(alpha r) / r over charged particles other than id.
+static double calcRealSpacePotential(const Pppm* self,
+                                     const PosStore* store,
+                                     const int32_t id,
+                                     const dvec* at,
+                                     const Boundary* bound)
+{
+  const double rcut2 = self->rcut * self->rcut;
+  int32_t neighbors[MAX_NEIGHBOR_CELLS];
+  const int32_t num_neighbors = getNeighborCells(self->cells, getCellIdOfPos(self->cells, at), neighbors);
+  double phi = 0.0;
+  for (int32_t n = 0; n < num_neighbors; n++) {
+    for (int32_t j = getCellHead(self->cells, neighbors[n]); j != CELL_NONE; j = getNextInCell(self->cells, j)) {
+      if (j == id || self->charge[j] == 0.0) continue;
+      const dvec rj = getPosOfStore(store, j);
+      const double r2 = distance2(at, &rj, bound);
+      if (r2 >= rcut2) continue;
+      const double r = sqrt(r2);
+      phi += self->charge[j] * erfc(self->alpha * r) / r;
+    }
+  }
+  return phi;
+}
+
+// NOTE: the charge file in the input directory lists "id charge" per
+//       line; lines starting with # are skipped and the beads not listed
+//       are neutral.
+static void readCharges(Pppm* self,
+                        const Parameter* param)
+{
+  string* fname = new_string_from_string(getRootDir(param));
+  append_char(fname, "/");
+  append_char(fname, string_to_char(getChargeFile(param)));
+  FILE* fp = xfopen(string_to_char(fname), "r");
+
+  char line[256];
+  int32_t line_no = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    line_no++;
+    if (line[0] == '#') continue;
+    int32_t id;
+    double q;
+    if (sscanf(line, "%d %lf", &id, &q) != 2) continue;
+    if (id < 0 || id >= self->num_ptcl) {
+      fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+      fprintf(stderr, "%s: bead id %d out of range [0, %d) (line %d).\n",
+              string_to_char(fname), id, self->num_ptcl, line_no);
+      exit(1);
+    }
+    self->charge[id] = q;
+  }
+  xfclose(fp);
+  delete_string(fname);
+}
+
+static void setupCharges(Pppm* self,
+                         const Parameter* param)
+{
+  self->charge = (double*)xmalloc(self->num_ptcl * sizeof(double));
+  for (int32_t i = 0; i < self->num_ptcl; i++) self->charge[i] = 0.0;
+  readCharges(self, param);
+
+  double q_sum = 0.0, q2_sum = 0.0;
+  self->num_charged = 0;
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    q_sum += self->charge[i];
+    q2_sum += self->charge[i] * self->charge[i];
+    if (self->charge[i] != 0.0) self->num_charged++;
+  }
+  self->e_self = -self->lb * self->alpha / sqrt(M_PI) * q2_sum;
+  // NOTE: the k = 0 term left out of the mesh sum; without it the total
+  //       of a charged system would depend on alpha.
+  const double vol = self->box.x * self->box.y * self->box.z;
+  self->e_background = -self->lb * M_PI * q_sum * q_sum / (2.0 * vol * self->alpha * self->alpha);
+}
+
+Pppm* newPppm(const PosStore* store,
+              const Boundary* bound,
+              const Parameter* param)
+{
+  if (getBoundaryType(bound) != PERIODIC) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "PPPM electrostatics requires the periodic boundary.\n");
+    exit(1);
+  }
+
+  Pppm* self = (Pppm*)xmalloc(sizeof(Pppm));
+  self->num_ptcl = getNumPtcl(param);
+  self->lb = getBjerrumLen(param);
+  self->mesh = getPppmMesh(param);
+  if (!isPowerOfTwo(self->mesh) || self->mesh < 2 * PPPM_ORDER) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "pppm_mesh should be a power of two not smaller than %d (%d).\n",
+            2 * PPPM_ORDER, self->mesh);
+    exit(1);
+  }
+  self->mesh3 = self->mesh * self->mesh * self->mesh;
+
+  self->box = getBoundaryBoxLength(bound);
+  if (getBoundaryDim(bound) == 2) {
+    self->box.z = (self->box.x > self->box.y) ? self->box.x : self->box.y;
+  }
+  self->inv_h.x = self->mesh / self->box.x;
+  self->inv_h.y = self->mesh / self->box.y;
+  self->inv_h.z = self->mesh / self->box.z;
+
+  double l_min = (self->box.x < self->box.y) ? self->box.x : self->box.y;
+  if (getBoundaryDim(bound) == 3 && self->box.z < l_min) l_min = self->box.z;
+  self->rcut = isnan(getEwaldRcut(param)) ? 0.25 * l_min : getEwaldRcut(param);
+  self->alpha = isnan(getEwaldAlpha(param)) ? 3.2 / self->rcut : getEwaldAlpha(param);
+  if (self->rcut > 0.5 * l_min) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "ewald_rcut (%f) should not exceed half of the box length.\n", self->rcut);
+    exit(1);
+  }
+
+  setupCharges(self, param);
+
+  self->influence = (double*)xmalloc(self->mesh3 * sizeof(double));
+  self->q_mesh    = (double*)xmalloc(self->mesh3 * sizeof(double));
+  self->phi_mesh  = (double*)xmalloc(self->mesh3 * sizeof(double));
+  self->work      = (double complex*)xmalloc(self->mesh3 * sizeof(double complex));
+  self->ref_pos   = (dvec*)xmalloc(self->num_ptcl * sizeof(dvec));
+  setupInfluence(self);
+
+  self->cells = newCellList(bound, self->rcut, self->num_ptcl);
+  buildCellList(self->cells, store);
+  self->trial_id = -1;
+  refreshMesh(self, store);
+  return self;
+}
+
+void deletePppm(Pppm* self)
+{
+  deleteCellList(self->cells);
+  xfree(self->charge);
+  xfree(self->influence);
+  xfree(self->q_mesh);
+  xfree(self->phi_mesh);
+  xfree(self->work);
+  xfree(self->ref_pos);
+  xfree(self);
+}
+
+// NOTE: between two FFTs the reciprocal part of a charge is its energy in
+//       the stored mesh potential, less the potential of its own cloud at
+//       its reference position. Both depend only on the position of the
+//       moved charge, so each move costs one interpolation stencil per
+//       position and is the exact energy difference of that Hamiltonian.
+double calcCoulombMoveEnergy(Pppm* self,
+                             const PosStore* store,
+                             const int32_t id,
+                             const dvec* trial,
+                             const Boundary* bound)
+{
+  const double q = self->charge[id];
+  self->trial_id = id;
+  if (q == 0.0) return 0.0;
+
+  const dvec r_old = getPosOfStore(store, id);
+  dvec dr_new = sub_dvec_new(trial, &self->ref_pos[id]);
+  dvec dr_old = sub_dvec_new(&r_old, &self->ref_pos[id]);
+  applyMinimumImageConv(bound, &dr_new);
+  applyMinimumImageConv(bound, &dr_old);
+  const double de_mesh = interpolatePotential(self, trial) - interpolatePotential(self, &r_old);
+  const double de_own = calcOwnCloudPotential(self, &dr_new) - calcOwnCloudPotential(self, &dr_old);
+  const double de_real = calcRealSpacePotential(self, store, id, trial, bound)
+    - calcRealSpacePotential(self, store, id, &r_old, bound);
+  return self->lb * q * (de_mesh - q * de_own + de_real);
+}
+
+// NOTE: the mesh potential is recomputed once per sweep over the charges,
+//       after num_charged accepted charge moves.
+void acceptCoulombMove(Pppm* self,
+                       const PosStore* store,
+                       const int32_t id)
+{
+  if (id != self->trial_id) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "accepted move (%d) does not match the last trial (%d).\n", id, self->trial_id);
+    exit(1);
+  }
+  const dvec r = getPosOfStore(store, id);
+  moveInCellList(self->cells, id, &r);
+  if (self->charge[id] == 0.0) return;
+
+  if (++self->num_moves >= self->num_charged) refreshMesh(self, store);
+}
+
+// NOTE: the observed totals are those of the current positions, from an
+//       FFT of their own; the mesh potential and the reference positions
+//       of the moves are left as they are, so that observing does not
+//       change the sampled Hamiltonian.
+double calcCoulombEnergyTotal(Pppm* self,
+                              const PosStore* store,
+                              const Boundary* bound)
+{
+  assignCharges(self, store);
+  const double e_recip = calcRecipEnergy(self);
+
+  double e_real = 0.0;
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    if (self->charge[i] == 0.0) continue;
+    const dvec r = getPosOfStore(store, i);
+    e_real += self->charge[i] * calcRealSpacePotential(self, store, i, &r, bound);
+  }
+  e_real *= 0.5;
+
+  return self->lb * (e_recip + e_real) + self->e_self + self->e_background;
+}
+
+// NOTE: the erfc pair forces within rcut, each pair counted from both ends.
+static dtensor3 calcRealSpaceVirial(const Pppm* self,
+                                    const PosStore* store,
+                                    const Boundary* bound)
+{
+  const double rcut2 = self->rcut * self->rcut;
+  const double two_a_sqrtpi = 2.0 * self->alpha / sqrt(M_PI);
+  dtensor3 vir = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+  int32_t neighbors[MAX_NEIGHBOR_CELLS];
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    if (self->charge[i] == 0.0) continue;
+    const dvec ri = getPosOfStore(store, i);
+    const int32_t num_neighbors = getNeighborCells(self->cells, getCellIdOfPos(self->cells, &ri), neighbors);
+    for (int32_t n = 0; n < num_neighbors; n++) {
+      for (int32_t j = getCellHead(self->cells, neighbors[n]); j != CELL_NONE; j = getNextInCell(self->cells, j)) {
+        if (j == i || self->charge[j] == 0.0) continue;
+        const dvec rj = getPosOfStore(store, j);
+        dvec dr = sub_dvec_new(&rj, &ri);
+        applyMinimumImageConv(bound, &dr);
+        const double r2 = norm2(&dr);
+        if (r2 >= rcut2) continue;
+        const double r = sqrt(r2);
+        const double ar = self->alpha * r;
+        const double f_r = 0.5 * self->charge[i] * self->charge[j]
+          * (erfc(ar) / r + two_a_sqrtpi * exp(-ar * ar)) / r2;
+        const dvec df = mul_scalar_new(&dr, f_r);
+        const dtensor3 dvir = dtensor3_dot(&df, &dr);
+        dtensor3_add(&vir, &dvir);
+      }
+    }
+  }
+  return vir;
+}
+
+dtensor3 calcCoulombVirialTotal(Pppm* self,
+                                const PosStore* store,
+                                const Boundary* bound)
+{
+  assignCharges(self, store);
+  dtensor3 vir = calcRecipVirial(self);
+  const dtensor3 vir_real = calcRealSpaceVirial(self, store, bound);
+  dtensor3_add(&vir, &vir_real);
+  dtensor3_mul_scalar(&vir, self->lb);
+  // NOTE: the background energy goes as 1 / V.
+  vir.xx += self->e_background;
+  vir.yy += self->e_background;
+  vir.zz += self->e_background;
+  return vir;
+}
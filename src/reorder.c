@@ -0,0 +1,175 @@
+#include "reorder.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils.h"
+#include "boundary.h"
+
+typedef struct {
+  uint64_t key;
+  int32_t id;
+} CurveKey;
+
+const char* getReorderNameFromType(REORDER_TYPE type)
+{
+  switch (type) {
+  case NO_REORDER:
+    return "none";
+  case HILBERT_CURVE:
+    return "hilbert";
+  case MORTON_CURVE:
+    return "morton";
+  case MESH_MORTON_CURVE:
+    return "mesh_morton";
+  default:
+    fprintf(stderr, "Unknown type\n");
+    return NULL;
+  }
+}
+
+// NOTE: particles are not reordered when reorder_curve is not specified.
+REORDER_TYPE getReorderTypeFromName(const string* curve_name)
+{
+  if (!curve_name) return NO_REORDER;
+  for (int32_t type = NO_REORDER; type <= MESH_MORTON_CURVE; type++) {
+    if (0 == strcmp(string_to_char(curve_name), getReorderNameFromType(type))) return type;
+  }
+  fprintf(stderr, "Error occurs in getReorderTypeFromName at %s:%d\n", __FILE__, (int32_t)__LINE__);
+  fprintf(stderr, "Unknown reorder curve %s\n", string_to_char(curve_name));
+  exit(1);
+}
+
+// NOTE: bit b of every coordinate, from the most significant one down.
+static uint64_t interleaveBits(const uint32_t* x,
+                               const int32_t num_bits,
+                               const int32_t dim)
+{
+  uint64_t key = 0;
+  for (int32_t b = num_bits - 1; b >= 0; b--) {
+    for (int32_t d = 0; d < dim; d++) key = (key << 1) | ((x[d] >> b) & 1u);
+  }
+  return key;
+}
+
+// NOTE: coordinates to the transposed Hilbert index, after J. Skilling,
+//       "Programming the Hilbert curve", AIP Conf. Proc. 707 (2004).
+//       Interleaving the transposed bits gives the index along the curve.
+static void transposeHilbert(uint32_t* x,
+                             const int32_t num_bits,
+                             const int32_t dim)
+{
+  const uint32_t m = 1u << (num_bits - 1);
+  for (uint32_t q = m; q > 1; q >>= 1) {
+    const uint32_t p = q - 1;
+    for (int32_t d = 0; d < dim; d++) {
+      if (x[d] & q) {
+        x[0] ^= p;
+      } else {
+        const uint32_t t = (x[0] ^ x[d]) & p;
+        x[0] ^= t;
+        x[d] ^= t;
+      }
+    }
+  }
+  for (int32_t d = 1; d < dim; d++) x[d] ^= x[d - 1];
+  uint32_t t = 0;
+  for (uint32_t q = m; q > 1; q >>= 1) {
+    if (x[dim - 1] & q) t ^= q - 1;
+  }
+  for (int32_t d = 0; d < dim; d++) x[d] ^= t;
+}
+
+static uint32_t quantize(const double x,
+                         const double lo,
+                         const double inv_width,
+                         const int32_t num_bits)
+{
+  const double cells = (double)(1u << num_bits);
+  const double u = (x - lo) * inv_width * cells;
+  if (!(u > 0.0)) return 0;
+  if (u >= cells) return (1u << num_bits) - 1;
+  return (uint32_t)u;
+}
+
+// NOTE: positions are mapped onto a grid of 2^num_bits cells per axis
+//       spanning the box (periodic) or the bounding box (free).
+static void calcPositionKeys(const REORDER_TYPE type,
+                             const PosStore* store,
+                             const int32_t id_lo,
+                             const int32_t id_hi,
+                             const Boundary* bound,
+                             CurveKey* keys)
+{
+  const int32_t dim = getBoundaryDim(bound);
+  const int32_t num_bits = (dim == 3) ? 21 : 31;
+  dvec lo = {0.0, 0.0, 0.0}, width = getBoundaryBoxLength(bound);
+  if (getBoundaryType(bound) == FREE) {
+    dvec hi = getPosOfStore(store, id_lo);
+    lo = hi;
+    for (int32_t i = id_lo + 1; i <= id_hi; i++) {
+      const dvec r = getPosOfStore(store, i);
+      lo.x = fmin(lo.x, r.x);
+      lo.y = fmin(lo.y, r.y);
+      lo.z = fmin(lo.z, r.z);
+      hi.x = fmax(hi.x, r.x);
+      hi.y = fmax(hi.y, r.y);
+      hi.z = fmax(hi.z, r.z);
+    }
+    width = sub_dvec_new(&hi, &lo);
+  }
+  const double inv_x = (width.x > 0.0) ? 1.0 / width.x : 0.0;
+  const double inv_y = (width.y > 0.0) ? 1.0 / width.y : 0.0;
+  const double inv_z = (width.z > 0.0) ? 1.0 / width.z : 0.0;
+
+  for (int32_t i = id_lo; i <= id_hi; i++) {
+    const dvec r = getPosOfStore(store, i);
+    uint32_t x[3];
+    x[0] = quantize(r.x, lo.x, inv_x, num_bits);
+    x[1] = quantize(r.y, lo.y, inv_y, num_bits);
+    x[2] = (dim == 3) ? quantize(r.z, lo.z, inv_z, num_bits) : 0;
+    if (type == HILBERT_CURVE) transposeHilbert(x, num_bits, dim);
+    keys[i - id_lo].key = interleaveBits(x, num_bits, dim);
+    keys[i - id_lo].id = i;
+  }
+}
+
+static int compareCurveKey(const void* a,
+                           const void* b)
+{
+  const CurveKey* ka = (const CurveKey*)a;
+  const CurveKey* kb = (const CurveKey*)b;
+  if (ka->key != kb->key) return (ka->key < kb->key) ? -1 : 1;
+  return (ka->id > kb->id) - (ka->id < kb->id);
+}
+
+void calcCurveOrder(const REORDER_TYPE type,
+                    const PosStore* store,
+                    const int32_t* orig_of,
+                    const int32_t num_ptcl,
+                    const int32_t id_lo,
+                    const int32_t id_hi,
+                    const int32_t side_dim_x,
+                    const Boundary* bound,
+                    int32_t* new_of_old)
+{
+  for (int32_t i = 0; i < num_ptcl; i++) new_of_old[i] = i;
+  const int32_t num_keys = id_hi - id_lo + 1;
+  if (type == NO_REORDER || num_keys <= 1) return;
+
+  CurveKey* keys = (CurveKey*)xmalloc(num_keys * sizeof(CurveKey));
+  if (type == MESH_MORTON_CURVE) {
+    for (int32_t i = id_lo; i <= id_hi; i++) {
+      const uint32_t x[2] = {(uint32_t)(orig_of[i] % side_dim_x), (uint32_t)(orig_of[i] / side_dim_x)};
+      keys[i - id_lo].key = interleaveBits(x, 31, 2);
+      keys[i - id_lo].id = i;
+    }
+  } else {
+    calcPositionKeys(type, store, id_lo, id_hi, bound, keys);
+  }
+  qsort(keys, num_keys, sizeof(CurveKey), compareCurveKey);
+  for (int32_t k = 0; k < num_keys; k++) new_of_old[keys[k].id] = id_lo + k;
+  xfree(keys);
+}
@@ -0,0 +1,80 @@
+#include "single_pos.h"
+
+// NOTE: the free boundary has no box; the origin is the center of the
+//       bounding box, so that the float32 coordinates stay small.
+static dvec calcOrigin(const PosStore* store,
+                       const int32_t num_ptcl,
+                       const Boundary* bound)
+{
+  dvec origin = {.x = 0.0, .y = 0.0, .z = 0.0};
+  if (getBoundaryType(bound) == PERIODIC) return origin;
+
+  dvec lo = getPosOfStore(store, 0), hi = lo;
+  for (int32_t i = 1; i < num_ptcl; i++) {
+    const dvec r = getPosOfStore(store, i);
+    lo.x = fmin(lo.x, r.x);
+    lo.y = fmin(lo.y, r.y);
+    lo.z = fmin(lo.z, r.z);
+    hi.x = fmax(hi.x, r.x);
+    hi.y = fmax(hi.y, r.y);
+    hi.z = fmax(hi.z, r.z);
+  }
+  origin.x = 0.5 * (lo.x + hi.x);
+  origin.y = 0.5 * (lo.y + hi.y);
+  origin.z = (getBoundaryDim(bound) == 3) ? 0.5 * (lo.z + hi.z) : 0.0;
+  return origin;
+}
+
+SinglePosStore* newSinglePosStore(const PosStore* store,
+                                  const int32_t num_ptcl,
+                                  const Boundary* bound)
+{
+  SinglePosStore* self = (SinglePosStore*)xmalloc(sizeof(SinglePosStore));
+  self->num_ptcl = num_ptcl;
+  self->dim = getBoundaryDim(bound);
+  self->pos = (float*)xmalloc(self->dim * num_ptcl * sizeof(float));
+  self->origin = calcOrigin(store, num_ptcl, bound);
+  self->e_bonded = 0.0;
+
+  const dvec box = getBoundaryBoxLength(bound);
+  self->box_leng.x = (float)box.x;
+  self->box_leng.y = (float)box.y;
+  self->box_leng.z = (float)box.z;
+  self->inv_box_leng.x = (box.x != 0.0) ? 1.0f / self->box_leng.x : 0.0f;
+  self->inv_box_leng.y = (box.y != 0.0) ? 1.0f / self->box_leng.y : 0.0f;
+  self->inv_box_leng.z = (box.z != 0.0) ? 1.0f / self->box_leng.z : 0.0f;
+
+  const BOUNDARY_TYPE bc = getBoundaryType(bound);
+  for (int32_t i = 0; i < num_ptcl; i++) {
+    const dvec ri = getPosOfStore(store, i);
+    fvec r;
+    r.x = (float)(ri.x - self->origin.x);
+    r.y = (float)(ri.y - self->origin.y);
+    r.z = (self->dim == 3) ? (float)(ri.z - self->origin.z) : 0.0f;
+    // NOTE: a coordinate just below L may round up to L.
+    applyBoundaryCondSingle(self, &r, bc, self->dim);
+    setPosOfSingle(self, i, &r, self->dim);
+  }
+  return self;
+}
+
+void deleteSinglePosStore(SinglePosStore* self)
+{
+  xfree(self->pos);
+  xfree(self);
+}
+
+void storeSinglePos(const SinglePosStore* self,
+                    PosStore* store)
+{
+  const int32_t num_ptcl = self->num_ptcl;
+  for (int32_t i = 0; i < num_ptcl; i++) {
+    const fvec ri = getPosOfSingle(self, i, self->dim);
+    const dvec r = {
+      .x = self->origin.x + (double)ri.x,
+      .y = self->origin.y + (double)ri.y,
+      .z = self->origin.z + (double)ri.z,
+    };
+    setPosOfStore(store, i, &r);
+  }
+}
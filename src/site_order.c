@@ -0,0 +1,180 @@
+#include "site_order.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils.h"
+#include "mt_rand.h"
+
+// NOTE: a moved particle reads its position, its ptclid2topol row and the
+//       pairs, triples and positions of its terms, about 128 bytes along a
+//       chain or mesh.
+#define SWEEP_TILE_BYTES (32 << 10)
+#define SWEEP_SITE_BYTES 128
+
+struct SiteOrder_t {
+  SWEEP_ORDER type;
+  int32_t num_sites;
+  int32_t num_tiles;
+  int32_t* sites;      // tile by tile
+  int32_t* tile_begin; // num_tiles + 1 offsets into sites
+  int32_t* tile_perm;
+  int32_t* order;
+};
+
+const char* getSweepOrderNameFromType(SWEEP_ORDER type)
+{
+  switch (type) {
+  case RANDOM_ORDER:
+    return "random";
+  case SEQUENTIAL_ORDER:
+    return "sequential";
+  case SHUFFLED_ORDER:
+    return "shuffled";
+  case BLOCKED_ORDER:
+    return "blocked";
+  default:
+    fprintf(stderr, "Unknown type\n");
+    return NULL;
+  }
+}
+
+// NOTE: the sites are drawn at random when sweep_order is not specified.
+SWEEP_ORDER getSweepOrderTypeFromName(const string* order_name)
+{
+  if (!order_name) return RANDOM_ORDER;
+  for (int32_t type = RANDOM_ORDER; type <= BLOCKED_ORDER; type++) {
+    if (0 == strcmp(string_to_char(order_name), getSweepOrderNameFromType(type))) return type;
+  }
+  fprintf(stderr, "Error occurs in getSweepOrderTypeFromName at %s:%d\n", __FILE__, (int32_t)__LINE__);
+  fprintf(stderr, "Unknown sweep order %s\n", string_to_char(order_name));
+  exit(1);
+}
+
+int32_t calcSweepTileSize(const int32_t sweep_tile)
+{
+  return (sweep_tile > 0) ? sweep_tile : SWEEP_TILE_BYTES / SWEEP_SITE_BYTES;
+}
+
+static int32_t minInt32(const int32_t a,
+                        const int32_t b)
+{
+  return (a < b) ? a : b;
+}
+
+// NOTE: tiles of tile_len consecutive ids.
+static void setRangeTiles(SiteOrder* self,
+                          const int32_t id_lo,
+                          const int32_t tile_len)
+{
+  for (int32_t i = 0; i < self->num_sites; i++) self->sites[i] = id_lo + i;
+  self->num_tiles = (self->num_sites + tile_len - 1) / tile_len;
+  self->tile_begin = (int32_t*)xmalloc((self->num_tiles + 1) * sizeof(int32_t));
+  for (int32_t t = 0; t < self->num_tiles; t++) self->tile_begin[t] = t * tile_len;
+  self->tile_begin[self->num_tiles] = self->num_sites;
+}
+
+// NOTE: square tiles of side tile_side of the mesh, whose sites are listed
+//       row by row; the sites outside id_lo..id_hi are left out.
+static void setMeshTiles(SiteOrder* self,
+                         const int32_t id_lo,
+                         const int32_t id_hi,
+                         const int32_t side_dim_x,
+                         const int32_t side_dim_y,
+                         const int32_t tile_side)
+{
+  const int32_t tiles_x = (side_dim_x + tile_side - 1) / tile_side;
+  const int32_t tiles_y = (side_dim_y + tile_side - 1) / tile_side;
+  self->num_tiles = tiles_x * tiles_y;
+  self->tile_begin = (int32_t*)xmalloc((self->num_tiles + 1) * sizeof(int32_t));
+  int32_t num_sites = 0;
+  for (int32_t ty = 0; ty < tiles_y; ty++) {
+    for (int32_t tx = 0; tx < tiles_x; tx++) {
+      self->tile_begin[ty * tiles_x + tx] = num_sites;
+      for (int32_t y = ty * tile_side; y < minInt32((ty + 1) * tile_side, side_dim_y); y++) {
+        for (int32_t x = tx * tile_side; x < minInt32((tx + 1) * tile_side, side_dim_x); x++) {
+          const int32_t id = y * side_dim_x + x;
+          if (id >= id_lo && id <= id_hi) self->sites[num_sites++] = id;
+        }
+      }
+    }
+  }
+  self->tile_begin[self->num_tiles] = num_sites;
+}
+
+SiteOrder* newSiteOrder(const SWEEP_ORDER type,
+                        const int32_t id_lo,
+                        const int32_t id_hi,
+                        const int32_t side_dim_x,
+                        const int32_t side_dim_y,
+                        const int32_t tile_size)
+{
+  SiteOrder* self = (SiteOrder*)xmalloc(sizeof(SiteOrder));
+  self->type = type;
+  self->num_sites = id_hi - id_lo + 1;
+  self->sites = (int32_t*)xmalloc(self->num_sites * sizeof(int32_t));
+  self->order = (int32_t*)xmalloc(self->num_sites * sizeof(int32_t));
+  if (type == BLOCKED_ORDER && side_dim_x > 0) {
+    const int32_t tile_side = (int32_t)sqrt((double)tile_size);
+    setMeshTiles(self, id_lo, id_hi, side_dim_x, side_dim_y, (tile_side > 0) ? tile_side : 1);
+  } else {
+    setRangeTiles(self, id_lo, (type == BLOCKED_ORDER) ? tile_size : self->num_sites);
+  }
+  self->tile_perm = (int32_t*)xmalloc(self->num_tiles * sizeof(int32_t));
+  for (int32_t t = 0; t < self->num_tiles; t++) self->tile_perm[t] = t;
+  memcpy(self->order, self->sites, self->num_sites * sizeof(int32_t));
+  return self;
+}
+
+void deleteSiteOrder(SiteOrder* self)
+{
+  xfree(self->sites);
+  xfree(self->tile_begin);
+  xfree(self->tile_perm);
+  xfree(self->order);
+  xfree(self);
+}
+
+int32_t getNumSitesOfSiteOrder(const SiteOrder* self)
+{
+  return self->num_sites;
+}
+
+// NOTE: Fisher-Yates; a permutation shuffled again is uniformly random.
+static void shuffleInt32(int32_t* a,
+                         const int32_t n,
+                         MTstate* mtst)
+{
+  for (int32_t k = n - 1; k > 0; k--) {
+    const int32_t j = (int32_t)genrand_int31_range(mtst, 0, k);
+    const int32_t tmp = a[k];
+    a[k] = a[j];
+    a[j] = tmp;
+  }
+}
+
+const int32_t* nextSiteOrder(SiteOrder* self,
+                             MTstate* mtst)
+{
+  if (self->type == SHUFFLED_ORDER) {
+    shuffleInt32(self->order, self->num_sites, mtst);
+    return self->order;
+  }
+
+  const bool reverse = genrand_int31_range(mtst, 0, 1) == 1;
+  shuffleInt32(self->tile_perm, self->num_tiles, mtst);
+  int32_t p = 0;
+  for (int32_t t = 0; t < self->num_tiles; t++) {
+    const int32_t begin = self->tile_begin[self->tile_perm[t]];
+    const int32_t end = self->tile_begin[self->tile_perm[t] + 1];
+    if (reverse) {
+      for (int32_t i = end - 1; i >= begin; i--) self->order[p++] = self->sites[i];
+    } else {
+      for (int32_t i = begin; i < end; i++) self->order[p++] = self->sites[i];
+    }
+  }
+  return self->order;
+}
@@ -0,0 +1,117 @@
+#include "spline_table.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils.h"
+#include "file_utils.h"
+
+static void readTable(const char* fname,
+                      double** xs,
+                      double** fs,
+                      int32_t* num)
+{
+  FILE* fp = xfopen(fname, "r");
+  int32_t capacity = 64, n = 0;
+  double* x = (double*)xmalloc(capacity * sizeof(double));
+  double* f = (double*)xmalloc(capacity * sizeof(double));
+
+  char line[256];
+  while (fgets(line, sizeof(line), fp)) {
+    if (line[0] == '#') continue;
+    double xv, fv;
+    if (sscanf(line, "%lf %lf", &xv, &fv) != 2) continue;
+    if (n == capacity) {
+      double* x_new = (double*)xmalloc(2 * capacity * sizeof(double));
+      double* f_new = (double*)xmalloc(2 * capacity * sizeof(double));
+      memcpy(x_new, x, capacity * sizeof(double));
+      memcpy(f_new, f, capacity * sizeof(double));
+      xfree(x);
+      xfree(f);
+      x = x_new;
+      f = f_new;
+      capacity *= 2;
+    }
+    x[n] = xv;
+    f[n] = fv;
+    n++;
+  }
+  xfclose(fp);
+
+  *xs = x;
+  *fs = f;
+  *num = n;
+}
+
+// NOTE: second derivatives (in units of the grid spacing) of the natural
+//       cubic spline, solved with the Thomas algorithm.
+static void calcSecondDerivs(const double* f,
+                             const int32_t num,
+                             double* m)
+{
+  double* cp = (double*)xmalloc(num * sizeof(double));
+  m[0] = m[num - 1] = 0.0;
+  cp[0] = 0.0;
+  double prev_d = 0.0;
+  for (int32_t i = 1; i < num - 1; i++) {
+    const double denom = 4.0 - cp[i - 1];
+    cp[i] = 1.0 / denom;
+    const double rhs = 6.0 * (f[i + 1] - 2.0 * f[i] + f[i - 1]);
+    prev_d = (rhs - prev_d) / denom;
+    m[i] = prev_d;
+  }
+  for (int32_t i = num - 3; i >= 1; i--) {
+    m[i] -= cp[i] * m[i + 1];
+  }
+  xfree(cp);
+}
+
+SplineTable* newSplineTableFromFile(const char* fname)
+{
+  double *x = NULL, *f = NULL;
+  int32_t num = 0;
+  readTable(fname, &x, &f, &num);
+  if (num < 2) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "%s should contain at least two points.\n", fname);
+    exit(1);
+  }
+
+  const double dx = (x[num - 1] - x[0]) / (num - 1);
+  for (int32_t i = 0; i < num; i++) {
+    if (dx <= 0.0 || fabs(x[i] - (x[0] + i * dx)) > 1.0e-6 * dx) {
+      fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+      fprintf(stderr, "%s should be on an increasing uniform grid (line %d).\n", fname, i + 1);
+      exit(1);
+    }
+  }
+
+  double* m = (double*)xmalloc(num * sizeof(double));
+  calcSecondDerivs(f, num, m);
+
+  SplineTable* self = (SplineTable*)xmalloc(sizeof(SplineTable));
+  self->num_intervals = num - 1;
+  self->x0 = x[0];
+  self->inv_dx = 1.0 / dx;
+  self->coef = (double*)xmalloc(4 * self->num_intervals * sizeof(double));
+  for (int32_t i = 0; i < self->num_intervals; i++) {
+    double* c = &self->coef[4 * i];
+    c[0] = f[i];
+    c[1] = f[i + 1] - f[i] - (2.0 * m[i] + m[i + 1]) / 6.0;
+    c[2] = 0.5 * m[i];
+    c[3] = (m[i + 1] - m[i]) / 6.0;
+  }
+
+  xfree(m);
+  xfree(x);
+  xfree(f);
+  return self;
+}
+
+void deleteSplineTable(SplineTable* self)
+{
+  xfree(self->coef);
+  xfree(self);
+}
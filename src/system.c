@@ -1,6 +1,8 @@
 #include "system.h"
 
 #include <stdlib.h>
+#include <string.h>
+#include <math.h>
 
 #include "topol.h"
 #include "evolver.h"
@@ -8,11 +10,56 @@
 #include "file_utils.h"
 #include "observer.h"
 #include "mt_rand.h"
+#include "lattice.h"
+#include "ensemble.h"
+#include "melt.h"
+#include "domain.h"
+#include "cell_list.h"
+#include "hash_grid.h"
+#include "verlet_list.h"
+#include "pppm.h"
+#include "spline_table.h"
+#include "potential.h"
+#include "math_utils.h"
+#include "parameter.h"
+#include "pos_store.h"
+#include "single_pos.h"
+#include "fixed_pos.h"
+#include "batch_kernels.h"
+#include "reorder.h"
+#include "site_order.h"
+#include "bond_cache.h"
+#include "arena.h"
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// NOTE: store, batch, top, id2top, orig_of and stored_of live in arena,
+//       except that the store of the fixed-point and float32 modes lives
+//       in pos_arena (see loadPosStore).
 struct System_t {
-  dvec* pos;
+  Arena* arena;
+  Arena* pos_arena;
+  PosStore* store;
+  BatchBuffers* batch;
   topol* top;
   ptclid2topol* id2top;
+  ImplicitTopol* implicit;
+  Melt* melt;
+  CellList* cells;
+  HashGrid* hgrid;
+  VerletList* verlet;
+  Pppm* pppm;
+  SinglePosStore* single;
+  FixedPosStore* fixed;
+  BondCache* bcache;
+  SiteOrder* sorder;
+  int32_t* orig_of;   // original id of each stored particle, NULL unless reordered
+  int32_t* stored_of; // stored id of each original particle, NULL unless reordered
+  BondedParam bonded;
+  SplineTable* bond_table;
+  SplineTable* angle_table;
   double accept_ratio;
 };
 
@@ -23,9 +70,20 @@ System* newSystem(void)
 
 void deleteSystem(System* self)
 {
-  xfree(self->pos);
-  deleteTopol(self->top);
-  deleteId2Topol(self->id2top);
+  if (self->implicit) deleteImplicitTopol(self->implicit);
+  if (self->melt) deleteMelt(self->melt);
+  if (self->cells) deleteCellList(self->cells);
+  if (self->hgrid) deleteHashGrid(self->hgrid);
+  if (self->verlet) deleteVerletList(self->verlet);
+  if (self->pppm) deletePppm(self->pppm);
+  if (self->single) deleteSinglePosStore(self->single);
+  if (self->fixed) deleteFixedPosStore(self->fixed);
+  if (self->bcache) deleteBondCache(self->bcache);
+  if (self->sorder) deleteSiteOrder(self->sorder);
+  if (self->bond_table) deleteSplineTable(self->bond_table);
+  if (self->angle_table) deleteSplineTable(self->angle_table);
+  if (self->pos_arena) deleteArena(self->pos_arena);
+  if (self->arena) deleteArena(self->arena);
   xfree(self);
 }
 
@@ -39,9 +97,75 @@ ptclid2topol* getPtclId2Topol(const System* self)
   return self->id2top;
 }
 
-dvec* getPos(const System* self)
+const ImplicitTopol* getImplicitTopol(const System* self)
+{
+  return self->implicit;
+}
+
+Melt* getMelt(const System* self)
+{
+  return self->melt;
+}
+
+CellList* getCellList(const System* self)
+{
+  return self->cells;
+}
+
+HashGrid* getHashGrid(const System* self)
+{
+  return self->hgrid;
+}
+
+VerletList* getVerletList(const System* self)
+{
+  return self->verlet;
+}
+
+Pppm* getPppm(const System* self)
+{
+  return self->pppm;
+}
+
+const BondedParam* getBondedParam(const System* self)
+{
+  return &self->bonded;
+}
+
+PosStore* getPosStore(const System* self)
+{
+  return self->store;
+}
+
+BatchBuffers* getBatchBuffers(const System* self)
+{
+  return self->batch;
+}
+
+SinglePosStore* getSinglePosStore(const System* self)
+{
+  return self->single;
+}
+
+FixedPosStore* getFixedPosStore(const System* self)
+{
+  return self->fixed;
+}
+
+BondCache* getBondCache(const System* self)
+{
+  return self->bcache;
+}
+
+SiteOrder* getSiteOrder(const System* self)
+{
+  return self->sorder;
+}
+
+int32_t getStoredId(const System* self,
+                    const int32_t orig_id)
 {
-  return self->pos;
+  return self->stored_of ? self->stored_of[orig_id] : orig_id;
 }
 
 double getAcceptRatio(const System* self)
@@ -49,33 +173,224 @@ double getAcceptRatio(const System* self)
   return self->accept_ratio;
 }
 
+const char* getModelNameFromType(MODEL_TYPE type)
+{
+  switch (type) {
+  case OFF_LATTICE:
+    return "offlattice";
+  case BOND_FLUCTUATION:
+    return "bfm";
+  default:
+    fprintf(stderr, "Unknown type\n");
+    return NULL;
+  }
+}
+
+// NOTE: off-lattice model is used when model_name is not specified.
+MODEL_TYPE getModelTypeFromName(const string* model_name)
+{
+  if (!model_name) return OFF_LATTICE;
+  for (int32_t type = OFF_LATTICE; type <= BOND_FLUCTUATION; type++) {
+    if (0 == strcmp(string_to_char(model_name), getModelNameFromType(type))) return type;
+  }
+  fprintf(stderr, "Error occurs in getModelTypeFromName at %s:%d\n", __FILE__, (int32_t)__LINE__);
+  fprintf(stderr, "Unknown model name %s\n", string_to_char(model_name));
+  exit(1);
+}
+
+static SplineTable* loadSplineTable(const string* table_name,
+                                    const Parameter* param)
+{
+  if (!table_name) return NULL;
+  if (getModelTypeFromName(getModelName(param)) != OFF_LATTICE) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "bond_table and angle_table are supported only for the off-lattice model.\n");
+    exit(1);
+  }
+  string* fname = new_string_from_string(getRootDir(param));
+  append_char(fname, "/");
+  append_char(fname, string_to_char(table_name));
+  SplineTable* table = newSplineTableFromFile(string_to_char(fname));
+  delete_string(fname);
+  return table;
+}
+
+// NOTE: table files are looked up in the input directory. A table given
+//       without bond_type (angle_type) selects the tabulated potential.
+static void setupBondedParam(System* self,
+                             const Parameter* param)
+{
+  self->bond_table  = loadSplineTable(getBondTable(param), param);
+  self->angle_table = loadSplineTable(getAngleTable(param), param);
+
+  BondedParam* bp = &self->bonded;
+  bp->bond_type = (self->bond_table && !getBondType(param))
+    ? BOND_TABULATED : getBondTypeFromName(getBondType(param));
+  bp->angle_type = (self->angle_table && !getAngleType(param))
+    ? ANGLE_TABULATED : getAngleTypeFromName(getAngleType(param));
+  if ((bp->bond_type == BOND_TABULATED && !self->bond_table)
+      || (bp->angle_type == ANGLE_TABULATED && !self->angle_table)) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "tabulated potentials require bond_table (angle_table).\n");
+    exit(1);
+  }
+
+  bp->cf_bond  = getCfBond(param);
+  bp->cf_angle = getCfAngle(param);
+  bp->l0       = getBondLen(param);
+  const double fene_r0 = isnan(getFeneR0(param)) ? 1.5 * bp->l0 : getFeneR0(param);
+  bp->fene_r02 = fene_r0 * fene_r0;
+  bp->cos_theta0 = cos(getAngleTheta0(param) * M_PI / 180.0);
+  bp->bond_table  = self->bond_table;
+  bp->angle_table = self->angle_table;
+}
+
+const char* getPrecisionNameFromType(PRECISION_TYPE type)
+{
+  switch (type) {
+  case DOUBLE_PRECISION:
+    return "double";
+  case FLOAT32:
+    return "float32";
+  case FIXED_POINT:
+    return "fixed";
+  default:
+    fprintf(stderr, "Unknown type\n");
+    return NULL;
+  }
+}
+
+// NOTE: double precision is used when position_precision is not specified.
+PRECISION_TYPE getPrecisionTypeFromName(const string* precision_name)
+{
+  if (!precision_name) return DOUBLE_PRECISION;
+  for (int32_t type = DOUBLE_PRECISION; type <= FIXED_POINT; type++) {
+    if (0 == strcmp(string_to_char(precision_name), getPrecisionNameFromType(type))) return type;
+  }
+  fprintf(stderr, "Error occurs in getPrecisionTypeFromName at %s:%d\n", __FILE__, (int32_t)__LINE__);
+  fprintf(stderr, "Unknown position precision %s\n", string_to_char(precision_name));
+  exit(1);
+}
+
+// NOTE: the observer passes (bonded sums, Rg and the fluctuation spectrum)
+//       run on observer_threads threads; 0 keeps the OpenMP default. The
+//       reductions do not depend on the number of threads.
+static void setupObserverThreads(const Parameter* param)
+{
+  const int32_t num_threads = getObserverThreads(param);
+#ifdef _OPENMP
+  const int32_t max_threads = INT32_MAX;
+#else
+  const int32_t max_threads = 1;
+#endif
+  if (num_threads < 0 || num_threads > max_threads) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "observer_threads must be >= 0, and > 1 only in a build with OpenMP.\n");
+    exit(1);
+  }
+#ifdef _OPENMP
+  if (num_threads > 0) omp_set_num_threads(num_threads);
+#endif
+}
+
+// NOTE: the implicit topology is derived from the particle index in the
+//       random-site sweep of single chains (2D) and meshes (3D); the rows of
+//       ptclid2topol are then not built, and the features that read them
+//       are not supported.
+static void setupTopologyMode(System* self,
+                              const Parameter* param)
+{
+  self->id2top = NULL;
+  self->implicit = NULL;
+  const TOPOLOGY_MODE mode = getTopologyModeTypeFromName(getTopologyMode(param));
+  if (mode == EXPLICIT_TOPOLOGY) {
+    self->id2top = newId2Topol(self->top, param, self->arena);
+    return;
+  }
+  if (getModelTypeFromName(getModelName(param)) != OFF_LATTICE || getTopologyFile(param)
+      || getNumChains(param) > 1 || getNumReplicas(param) > 1 || getPrefetchDistance(param) > 0
+      || getPrecisionTypeFromName(getPositionPrecision(param)) != DOUBLE_PRECISION) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "topology_mode %s is supported only for a single off-lattice chain or mesh "
+            "without topology_file, num_chains > 1, num_replicas > 1, prefetch_distance and "
+            "position_precision other than double.\n", getTopologyModeNameFromType(mode));
+    exit(1);
+  }
+  self->implicit = newImplicitTopol(param);
+}
+
 void initializeSystem(System* self,
                       const Boundary* bound,
                       const Parameter* param,
                       confMaker conf_make,
                       topolMaker topol_make)
 {
-  // create initial configuration
+  setupObserverThreads(param);
+  self->arena = NULL;
+  self->pos_arena = NULL;
+  self->store = NULL;
+  self->batch = NULL;
+  self->top = NULL;
+  self->id2top = NULL;
+  self->implicit = NULL;
+  self->melt = NULL;
+  self->cells = NULL;
+  self->hgrid = NULL;
+  self->verlet = NULL;
+  self->pppm = NULL;
+  self->single = NULL;
+  self->fixed = NULL;
+  self->bcache = NULL;
+  self->sorder = NULL;
+  self->orig_of = NULL;
+  self->stored_of = NULL;
+  setupBondedParam(self, param);
+  // NOTE: with domain decomposition only the root rank builds the topology
+  //       and the initial configuration, which newDomain scatters to the
+  //       ranks owning the particles.
+  if (!isRootRank()) {
+    self->accept_ratio = 0.0;
+    return;
+  }
+
+  // NOTE: the sweep state in the arena is first touched by this thread,
+  //       which runs the sweep, and the partial sums of the observer passes
+  //       by the observer threads that own them.
+  self->arena = newArena(getHugePages(param) != 0);
+
+  // create topology
+  self->top = topol_make(param, bound, self->arena);
+  setupTopologyMode(self, param);
+
+  // create initial configuration (conf_make may follow the topology)
   const int32_t num_ptcl = getNumPtcl(param);
-  self->pos = (dvec*)xmalloc(num_ptcl * sizeof(dvec));
+  if (getPrecisionTypeFromName(getPositionPrecision(param)) != DOUBLE_PRECISION) {
+    self->pos_arena = newArena(getHugePages(param) != 0);
+  }
+  self->store = newPosStore(num_ptcl, getDimension(param), self->pos_arena ? self->pos_arena : self->arena);
+  self->batch = newBatchBuffers(getNumBonds(self->top), getNumAngles(self->top), self->store->num_padded,
+                                self->arena);
   conf_make(self, param);
 
-  // create topology
-  self->top = topol_make(param, bound);
-  self->id2top = newId2Topol(self->top, param);
+  self->melt = (getNumChains(param) > 1) ? newMelt(param) : NULL;
 
   debugDumpTopolInfo(self->top, param);
-  debugDumpId2TopolInfo(self->id2top, param);
+  if (self->id2top) debugDumpId2TopolInfo(self->id2top, param);
 
   // clear acceptance ratio
   self->accept_ratio = 0.0;
 }
 
+// NOTE: the configuration files hold num_ptcl followed by dim doubles per
+//       particle, i.e. packed (x, y) in 2D. Files with three components per
+//       particle written before the packed format are also accepted in 2D.
 void readRestartConfig(System* self,
                        const Parameter* param)
 {
-  dvec* pos = getPos(self);
+  if (!isRootRank()) return;
+  PosStore* store = getPosStore(self);
   const int32_t num_ptcls = getNumPtcl(param);
+  const int32_t dim = getDimension(param);
   const string* root_dir = getRootDir(param);
   string* fname = new_string_from_string(root_dir);
   append_char(fname, "/init_config.bin");
@@ -96,7 +411,19 @@ void readRestartConfig(System* self,
             n, num_ptcls);
     exit(EXIT_FAILURE);
   }
-  _ = fread(pos, sizeof(dvec), n, fp), (void) _;
+
+  const size_t num_comps = (get_file_size(fp) - sizeof(int32_t)) / ((size_t)n * sizeof(double));
+  if (num_comps != 3 && num_comps != (size_t)dim) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "init_config.bin does not hold %d or 3 components per particle.\n", dim);
+    exit(EXIT_FAILURE);
+  }
+  for (int32_t i = 0; i < n; i++) {
+    double r[3] = {0.0, 0.0, 0.0};
+    _ = fread(r, sizeof(double), num_comps, fp), (void) _;
+    const dvec ri = {.x = r[0], .y = r[1], .z = r[2]};
+    setPosOfStore(store, i, &ri);
+  }
 
   fclose(fp);
   delete_string(fname);
@@ -105,40 +432,509 @@ void readRestartConfig(System* self,
 void writeFinalConfig(System* self,
                       const Parameter* param)
 {
+  if (!isRootRank()) return;
+
   const int32_t num_ptcls = getNumPtcl(param);
-  const dvec* pos = getPos(self);
+  const int32_t dim = getDimension(param);
+  const PosStore* store = getPosStore(self);
 
   const string* root_dir = getRootDir(param);
   string* fname = new_string_from_string(root_dir);
   append_char(fname, "/fin_config.bin");
 
+  // NOTE: in the original order of the particles.
   FILE* fp = xfopen(string_to_char(fname), "w");
   fwrite((void *)&num_ptcls, sizeof(int32_t), 1, fp);
-  fwrite((void *)pos, sizeof(dvec), num_ptcls, fp);
+  for (int32_t i = 0; i < num_ptcls; i++) {
+    const dvec r = getPosOfStore(store, getStoredId(self, i));
+    const double r3[3] = {r.x, r.y, r.z};
+    fwrite((void *)r3, sizeof(double), dim, fp);
+  }
   xfclose(fp);
 
   delete_string(fname);
 }
 
+// NOTE: a cell list is used for the periodic boundary and a hash grid for
+//       the free boundary. It is built after the restart configuration is read.
+//       The moves keep the configuration free of overlaps, so the initial
+//       one must be free of them too.
+static void setupExcludedVolume(System* self,
+                                const Boundary* boundary,
+                                const Parameter* param)
+{
+  const double excl_diam = getExcludedDiameter(param);
+  if (excl_diam <= 0.0) return;
+  if (getModelTypeFromName(getModelName(param)) != OFF_LATTICE) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "excluded_diameter is supported only for the off-lattice model.\n");
+    exit(1);
+  }
+  const int32_t num_ptcl = getNumPtcl(param);
+  if (checkParticleOverlap(self->store, num_ptcl, boundary, excl_diam)) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "Initial configuration contains overlaps closer than excluded_diameter (%f).\n", excl_diam);
+    exit(1);
+  }
+  if (getBoundaryType(boundary) == PERIODIC) {
+    self->cells = newCellList(boundary, excl_diam, num_ptcl);
+    buildCellList(self->cells, self->store);
+  } else {
+    self->hgrid = newHashGrid(excl_diam, num_ptcl, getBoundaryDim(boundary));
+    buildHashGrid(self->hgrid, self->store);
+  }
+}
+
+// NOTE: the partner bond of a double-bridge move is drawn within
+//       double_bridge_cutoff of the chosen particle, which defaults to the
+//       largest FENE bond length fene_r0 (1.5 bond_len unless specified).
+static void setupDoubleBridge(System* self,
+                              const Boundary* boundary,
+                              const Parameter* param)
+{
+  if (!self->melt || getDoubleBridgeProb(param) <= 0.0) return;
+  const double cutoff = isnan(getDoubleBridgeCutoff(param))
+    ? sqrt(self->bonded.fene_r02) : getDoubleBridgeCutoff(param);
+  if (!(cutoff > 0.0)) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "double_bridge_cutoff should be positive (%f).\n", cutoff);
+    exit(1);
+  }
+  setupBridgeGrid(self->melt, self->store, boundary, cutoff);
+}
+
+// NOTE: lj_sigma defaults to bond_len and lj_cutoff to the WCA cutoff
+//       2^(1/6) lj_sigma. verlet_skin defaults to 0.4 lj_sigma, or three
+//       times the maximum trial displacement if that is larger.
+static void setupNonbond(System* self,
+                         const Boundary* boundary,
+                         const Parameter* param)
+{
+  const double eps = getLJEpsilon(param);
+  if (eps == 0.0) return;
+  if (getModelTypeFromName(getModelName(param)) != OFF_LATTICE) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "lj_epsilon is supported only for the off-lattice model.\n");
+    exit(1);
+  }
+  const double sigma = isnan(getLJSigma(param)) ? getBondLen(param) : getLJSigma(param);
+  const double rc = isnan(getLJCutoff(param)) ? pow(2.0, 1.0 / 6.0) * sigma : getLJCutoff(param);
+  const double max_step = sqrt((double)getDimension(param)) * getStepLen(param);
+  const double skin = isnan(getVerletSkin(param)) ? fmax(0.4 * sigma, 3.0 * max_step) : getVerletSkin(param);
+  if (max_step >= 0.5 * skin) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "verlet_skin (%f) should be larger than twice the maximum trial displacement (%f).\n",
+            skin, 2.0 * max_step);
+    exit(1);
+  }
+  self->verlet = newVerletList(boundary, makeLJParam(eps, sigma, rc), skin, getNumPtcl(param));
+  buildVerletList(self->verlet, self->store, boundary);
+}
+
+static void setupElectrostatics(System* self,
+                                const Boundary* boundary,
+                                const Parameter* param)
+{
+  if (!getChargeFile(param)) return;
+  if (getModelTypeFromName(getModelName(param)) != OFF_LATTICE) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "charge_file is supported only for the off-lattice model.\n");
+    exit(1);
+  }
+  self->pppm = newPppm(self->store, boundary, param);
+}
+
+static double recomputeBondedEnergy(const System* self,
+                                    const Boundary* boundary)
+{
+  const topol* top = self->top;
+  double e_bond = 0.0, e_angle = 0.0;
+  sumBondedEnergyOfStore(self->store, getBondTopol(top), getNumBonds(top), getAngleTopol(top), getNumAngles(top),
+                         &self->bonded, boundary, self->batch, &e_bond, &e_angle);
+  return e_bond + e_angle;
+}
+
+// NOTE: the fixed-point or float32 positions are the stored ones. The
+//       float64 positions are converted from them for an observation and
+//       for the output, into pos_arena, and released after an observation,
+//       so that the run keeps dim * 4 bytes per particle of positions
+//       instead of dim * 8.
+static void loadPosStore(System* self,
+                         const Parameter* param)
+{
+  if ((!self->fixed && !self->single) || self->store) return;
+  self->pos_arena = newArena(getHugePages(param) != 0);
+  self->store = newPosStore(getNumPtcl(param), getDimension(param), self->pos_arena);
+  if (self->fixed) {
+    storeFixedPos(self->fixed, self->store);
+  } else {
+    storeSinglePos(self->single, self->store);
+  }
+}
+
+static void releasePosStore(System* self)
+{
+  if ((!self->fixed && !self->single) || !self->store) return;
+  deleteArena(self->pos_arena);
+  self->pos_arena = NULL;
+  self->store = NULL;
+}
+
+// NOTE: the float32 and fixed-point positions are supported only by the
+//       random-site sweep of bonded off-lattice systems. The positions are
+//       rounded once here. The running bonded energy of the float32 mode
+//       starts from a float64 evaluation of the rounded configuration.
+static void setupPositionPrecision(System* self,
+                                   const Boundary* boundary,
+                                   const Parameter* param)
+{
+  const PRECISION_TYPE precision = getPrecisionTypeFromName(getPositionPrecision(param));
+  if (precision == DOUBLE_PRECISION) return;
+  if (getModelTypeFromName(getModelName(param)) != OFF_LATTICE || self->cells || self->hgrid || self->verlet
+      || self->pppm || self->melt || getPrefetchDistance(param) > 0) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "position_precision %s is supported only for bonded off-lattice systems "
+            "without excluded_diameter, lj_epsilon, charge_file, num_chains > 1 and prefetch_distance.\n",
+            getPrecisionNameFromType(precision));
+    exit(1);
+  }
+  if (precision == FIXED_POINT) {
+    self->fixed = newFixedPosStore(self->store, getNumPtcl(param), boundary);
+    releasePosStore(self);
+    return;
+  }
+  self->single = newSinglePosStore(self->store, getNumPtcl(param), boundary);
+  storeSinglePos(self->single, self->store);
+  self->single->e_bonded = recomputeBondedEnergy(self, boundary);
+  releasePosStore(self);
+}
+
+// NOTE: the running bonded energy of the float32 mode, accumulated from
+//       the start of the run without correction, is compared with a float64
+//       evaluation of the same configuration. The run stops once the drift
+//       exceeds drift_tolerance per particle.
+static void checkSinglePrecisionDrift(System* self,
+                                      const Boundary* boundary,
+                                      const Parameter* param,
+                                      const int32_t mc_steps)
+{
+  const double e_ref = recomputeBondedEnergy(self, boundary);
+  const double drift = fabs(self->single->e_bonded - e_ref) / getNumPtcl(param);
+  if (drift > getDriftTolerance(param)) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "bonded energy drift of float32 is %g per particle at step %d, above drift_tolerance %g.\n",
+            drift, mc_steps, getDriftTolerance(param));
+    exit(1);
+  }
+}
+
+// NOTE: particle i of the current order becomes new_of_old[i]. The
+//       topology, chains and neighbor structures are renamed or rebuilt
+//       accordingly; orig_of and stored_of keep the original ids.
+static void permuteSystem(System* self,
+                          const Boundary* boundary,
+                          const Parameter* param,
+                          const int32_t* new_of_old)
+{
+  const int32_t num_ptcl = getNumPtcl(param);
+  dvec* pos = (dvec*)xmalloc(num_ptcl * sizeof(dvec));
+  int32_t* orig_of = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  for (int32_t i = 0; i < num_ptcl; i++) {
+    pos[new_of_old[i]] = getPosOfStore(self->store, i);
+    orig_of[new_of_old[i]] = self->orig_of[i];
+  }
+  for (int32_t i = 0; i < num_ptcl; i++) setPosOfStore(self->store, i, &pos[i]);
+  memcpy(self->orig_of, orig_of, num_ptcl * sizeof(int32_t));
+  xfree(pos);
+  xfree(orig_of);
+  for (int32_t i = 0; i < num_ptcl; i++) self->stored_of[self->orig_of[i]] = i;
+
+  permuteTopol(self->top, new_of_old);
+  if (self->melt) {
+    permuteMelt(self->melt, new_of_old);
+    buildBridgeGrid(self->melt, self->store);
+  }
+  rebuildId2Topol(self->id2top, self->top, param);
+  if (self->cells) buildCellList(self->cells, self->store);
+  if (self->hgrid) buildHashGrid(self->hgrid, self->store);
+  if (self->verlet) buildVerletList(self->verlet, self->store, boundary);
+  if (self->bcache) {
+    deleteBondCache(self->bcache);
+    self->bcache = newBondCache(self->top, self->id2top, self->store, boundary, &self->bonded);
+  }
+}
+
+// NOTE: the chain ends of a single periodic chain or mesh are never moved
+//       (see evolveMc).
+static void getMovedRange(const System* self,
+                          const Boundary* boundary,
+                          const Parameter* param,
+                          int32_t* id_lo,
+                          int32_t* id_hi)
+{
+  const int32_t num_ptcl = getNumPtcl(param);
+  const bool ends_fixed = getBoundaryType(boundary) == PERIODIC && !self->melt && !getTopologyFile(param);
+  *id_lo = ends_fixed ? 1 : 0;
+  *id_hi = ends_fixed ? num_ptcl - 2 : num_ptcl - 1;
+}
+
+// NOTE: the particles outside getMovedRange keep their ids.
+static void reorderSystem(System* self,
+                          const Boundary* boundary,
+                          const Parameter* param)
+{
+  const int32_t num_ptcl = getNumPtcl(param);
+  int32_t id_lo, id_hi;
+  getMovedRange(self, boundary, param, &id_lo, &id_hi);
+  int32_t* new_of_old = (int32_t*)xmalloc(num_ptcl * sizeof(int32_t));
+  calcCurveOrder(getReorderTypeFromName(getReorderCurve(param)), self->store, self->orig_of, num_ptcl,
+                 id_lo, id_hi, getSideDimx(param), boundary, new_of_old);
+  permuteSystem(self, boundary, param, new_of_old);
+  xfree(new_of_old);
+}
+
+// NOTE: the particles are reordered once here, and every reorder_interval
+//       steps if it is positive (not for mesh_morton, whose order does not
+//       depend on the positions). The float32, fixed-point and implicit
+//       topology paths, the Coulomb charges (assigned by id) and the
+//       lattice model are not supported.
+static void setupReorder(System* self,
+                         const Boundary* boundary,
+                         const Parameter* param)
+{
+  const REORDER_TYPE curve = getReorderTypeFromName(getReorderCurve(param));
+  if (curve == NO_REORDER) return;
+  if (getModelTypeFromName(getModelName(param)) != OFF_LATTICE || !self->id2top || self->pppm
+      || self->single || self->fixed || getReorderInterval(param) < 0) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "reorder_curve %s is supported only for off-lattice systems with the explicit topology, "
+            "without charge_file and position_precision other than double, and reorder_interval >= 0.\n",
+            getReorderNameFromType(curve));
+    exit(1);
+  }
+  if (curve == MESH_MORTON_CURVE && (getDimension(param) != 3 || self->melt || getTopologyFile(param))) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "reorder_curve mesh_morton is supported only for the 3D mesh.\n");
+    exit(1);
+  }
+
+  const int32_t num_ptcl = getNumPtcl(param);
+  self->orig_of = (int32_t*)allocArena(self->arena, num_ptcl * sizeof(int32_t));
+  self->stored_of = (int32_t*)allocArena(self->arena, num_ptcl * sizeof(int32_t));
+  for (int32_t i = 0; i < num_ptcl; i++) self->orig_of[i] = self->stored_of[i] = i;
+  reorderSystem(self, boundary, param);
+}
+
+static bool isReorderStep(const Parameter* param,
+                          const int32_t step)
+{
+  const int32_t interval = getReorderInterval(param);
+  return step > 0 && interval > 0 && step % interval == 0
+    && getReorderTypeFromName(getReorderCurve(param)) != NO_REORDER
+    && getReorderTypeFromName(getReorderCurve(param)) != MESH_MORTON_CURVE;
+}
+
+// NOTE: the cache is valid as long as the positions and the topology change
+//       only through the random-site sweep, which excludes double-bridge
+//       moves; it is rebuilt when the particles are reordered. It is not
+//       built if an angle has no bonds between its particles. bond_cache 0
+//       turns it off: it holds a CachedBond (40 bytes) per bond, an energy
+//       per angle and an AngleBondRef (24 bytes) per angle of each row of
+//       ptclid2topol, about 240 bytes per particle of a chain or mesh.
+static void setupBondCache(System* self,
+                           const Boundary* boundary,
+                           const Parameter* param)
+{
+  if (getBondCacheSwitch(param) == 0 || getModelTypeFromName(getModelName(param)) != OFF_LATTICE || !self->id2top || self->single || self->fixed
+      || (self->melt && getDoubleBridgeProb(param) > 0.0)) return;
+  self->bcache = newBondCache(self->top, self->id2top, self->store, boundary, &self->bonded);
+}
+
+// NOTE: the sites moved by evolveMc, id_lo..id_hi, are visited once per
+//       sweep in the given order. The tiles of the blocked order follow the
+//       (x, y) indices of the 3D mesh unless the particles are reordered,
+//       in which case consecutive ids are already close in space.
+static void setupSiteOrder(System* self,
+                           const Boundary* boundary,
+                           const Parameter* param)
+{
+  const SWEEP_ORDER type = getSweepOrderTypeFromName(getSweepOrder(param));
+  if (type == RANDOM_ORDER) return;
+  if (getModelTypeFromName(getModelName(param)) != OFF_LATTICE || getSweepTile(param) < 0) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "sweep_order %s is supported only for off-lattice systems, with sweep_tile >= 0.\n",
+            getSweepOrderNameFromType(type));
+    exit(1);
+  }
+
+  int32_t id_lo, id_hi;
+  getMovedRange(self, boundary, param, &id_lo, &id_hi);
+  const bool is_mesh = getDimension(param) == 3 && !self->melt && !getTopologyFile(param)
+    && getReorderTypeFromName(getReorderCurve(param)) == NO_REORDER;
+  self->sorder = newSiteOrder(type, id_lo, id_hi, is_mesh ? getSideDimx(param) : 0,
+                              is_mesh ? getSideDimy(param) : 0, calcSweepTileSize(getSweepTile(param)));
+}
+
+// NOTE: replicas are advanced in lockstep and observed as an ensemble.
+//       The final configuration of replica 0 is stored back to self.
+static void executeEnsembleSimulation(System* self,
+                                      const Boundary* boundary,
+                                      const Parameter* param)
+{
+  if (getModelTypeFromName(getModelName(param)) != OFF_LATTICE) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "num_replicas > 1 is supported only for the off-lattice model.\n");
+    exit(1);
+  }
+  if (getExcludedDiameter(param) > 0.0 || getLJEpsilon(param) != 0.0 || getChargeFile(param)
+      || self->bonded.bond_type != BOND_HARMONIC || self->bonded.angle_type != ANGLE_KRATKY_POROD
+      || getPrecisionTypeFromName(getPositionPrecision(param)) != DOUBLE_PRECISION
+      || getReorderTypeFromName(getReorderCurve(param)) != NO_REORDER
+      || getSweepOrderTypeFromName(getSweepOrder(param)) != RANDOM_ORDER) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "excluded_diameter, lj_epsilon, charge_file, position_precision other than double, reorder_curve, sweep_order and non-default bond/angle types are not supported with num_replicas > 1.\n");
+    exit(1);
+  }
+
+  Ensemble* ensemble = newEnsemble(self, boundary, param);
+  MTstate* mtst = newMTstate();
+  init_genrand(mtst, getRandSeed(param));
+
+  const int32_t tot_steps = getTotalSteps(param);
+  printf("tot_steps: %d, num_replicas: %d\n", tot_steps, getNumReplicasOfEnsemble(ensemble));
+  const int32_t observe_interval_mac = getObserveIntervalMac(param);
+  for (int32_t i = 0; i < tot_steps; i++) {
+    self->accept_ratio = evolveEnsembleMc(ensemble, self, mtst);
+    if (i % observe_interval_mac == 0) observeEnsemble(ensemble, i, self);
+  }
+
+  copyReplicaToSystem(ensemble, 0, self);
+  writeEnsembleFinalConfig(ensemble, param);
+  deleteEnsemble(ensemble);
+  deleteMTstate(mtst);
+}
+
+#ifdef USE_MPI
+// NOTE: once newDomain has scattered them, the particles and the topology
+//       are held by the ranks of the domain decomposition. The root rank
+//       keeps the melt for the observers.
+static void releaseParticles(System* self)
+{
+  if (self->arena) deleteArena(self->arena);
+  self->arena = NULL;
+  self->store = NULL;
+  self->batch = NULL;
+  self->top = NULL;
+  self->id2top = NULL;
+}
+
+// NOTE: each rank updates the particles in its own slab. The positions
+//       are streamed to the root rank only when they are observed, and at
+//       the end of the run for the final configuration.
+static void executeDomainSimulation(System* self,
+                                    const Boundary* boundary,
+                                    const Parameter* param)
+{
+  if (getModelTypeFromName(getModelName(param)) != OFF_LATTICE || getNumReplicas(param) > 1
+      || getExcludedDiameter(param) > 0.0 || getLJEpsilon(param) != 0.0 || getChargeFile(param)
+      || getPrecisionTypeFromName(getPositionPrecision(param)) != DOUBLE_PRECISION
+      || getTopologyModeTypeFromName(getTopologyMode(param)) != EXPLICIT_TOPOLOGY
+      || getReorderTypeFromName(getReorderCurve(param)) != NO_REORDER
+      || getSweepOrderTypeFromName(getSweepOrder(param)) != RANDOM_ORDER) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "Domain decomposition is supported only for a single off-lattice system in double precision "
+            "with the explicit topology and without reorder_curve and sweep_order.\n");
+    exit(1);
+  }
+
+  Domain* domain = newDomain(self, boundary, param);
+  releaseParticles(self);
+  Observer* observer = isRootRank() ? newObserver(getRootDir(param)) : NULL;
+  MTstate* mtst = newMTstate();
+  init_genrand(mtst, getRandSeed(param) + 1 + getRankOfDomain(domain));
+  // NOTE: this stream must be identical on all ranks.
+  MTstate* mtst_shared = newMTstate();
+  init_genrand(mtst_shared, getRandSeed(param));
+
+  const int32_t tot_steps = getTotalSteps(param);
+  if (observer) printf("tot_steps: %d, num_ranks: %d\n", tot_steps, getNumRanksOfDomain(domain));
+  const int32_t observe_interval_mic = getObserveIntervalMic(param);
+  const int32_t observe_interval_mac = getObserveIntervalMac(param);
+  for (int32_t i = 0; i < tot_steps; i++) {
+    shiftDomain(domain, mtst_shared);
+    self->accept_ratio = evolveMcDomain(domain, self, boundary, mtst);
+    // NOTE: the trajectory and the bond lengths are streamed per particle
+    //       (bond); the other observables are reduced from the partial
+    //       sums of the ranks.
+    if (i % observe_interval_mic == 0) observeMicroVarsOfDomain(domain, observer, i, boundary);
+    if (i % observe_interval_mac == 0) {
+      MacroSums sums;
+      reduceMacroSumsOfDomain(domain, self, boundary, &sums);
+      if (observer) observeMacroSums(observer, i, self, &sums, boundary, param);
+    }
+  }
+  writeFinalConfigOfDomain(domain, param);
+
+  if (observer) deleteObserver(observer);
+  deleteMTstate(mtst);
+  deleteMTstate(mtst_shared);
+  deleteDomain(domain);
+}
+#endif
+
 // NOTE: main simulation loop is described here.
 void executeSimulation(System* self,
                        const Boundary* boundary,
                        const Parameter* param)
 {
+#ifdef USE_MPI
+  executeDomainSimulation(self, boundary, param);
+  return;
+#endif
+
+  if (getNumReplicas(param) > 1) {
+    executeEnsembleSimulation(self, boundary, param);
+    return;
+  }
+  setupExcludedVolume(self, boundary, param);
+  setupDoubleBridge(self, boundary, param);
+  setupNonbond(self, boundary, param);
+  setupElectrostatics(self, boundary, param);
+  setupPositionPrecision(self, boundary, param);
+  setupReorder(self, boundary, param);
+  setupBondCache(self, boundary, param);
+  setupSiteOrder(self, boundary, param);
+
   Observer* observer = newObserver(getRootDir(param));
   MTstate* mtst = newMTstate();
   init_genrand(mtst, getRandSeed(param));
 
+  Lattice* lattice = NULL;
+  if (getModelTypeFromName(getModelName(param)) == BOND_FLUCTUATION) {
+    lattice = newLattice(self, boundary, param);
+  }
+
   const int32_t tot_steps = getTotalSteps(param);
   printf("tot_steps: %d\n", tot_steps);
   const int32_t observe_interval_mic = getObserveIntervalMic(param);
   const int32_t observe_interval_mac = getObserveIntervalMac(param);
   for (int32_t i = 0; i < tot_steps; i++) {
-    self->accept_ratio = evolveMc(self, param, boundary, mtst);
+    if (isReorderStep(param, i)) reorderSystem(self, boundary, param);
+    if (lattice) {
+      self->accept_ratio = evolveBfm(lattice, self, mtst);
+    } else {
+      self->accept_ratio = evolveMc(self, param, boundary, mtst);
+    }
+    if (i % observe_interval_mic == 0 || i % observe_interval_mac == 0) loadPosStore(self, param);
     if (i % observe_interval_mic == 0) observeMicroVars(observer, i, self, boundary, param);
+    if (self->single && i % observe_interval_mac == 0) checkSinglePrecisionDrift(self, boundary, param, i);
     if (i % observe_interval_mac == 0) observeMacroVars(observer, i, self, boundary, param);
+    releasePosStore(self);
   }
+  // NOTE: for writeFinalConfig.
+  loadPosStore(self, param);
 
   deleteObserver(observer);
   deleteMTstate(mtst);
+  if (lattice) deleteLattice(lattice);
 }
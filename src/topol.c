@@ -2,13 +2,18 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
 #include <math.h>
+#include <ctype.h>
+#include <errno.h>
 
 #include "utils.h"
 #include "file_utils.h"
 #include "math_utils.h"
 #include "string_c.h"
 #include "boundary.h"
+#include "arena.h"
 
 struct topol_t {
   int32_t num_bonds;
@@ -17,21 +22,20 @@ struct topol_t {
   triple* angle_top;
 };
 
-static void copyPair(pair* dst, const pair* src);
-static void copyTriple(triple* dst, const triple* src);
-static void registerBondTopol(ptclid2topol* id2tops, const pair* bond_top);
-static void registerAngleTopol(ptclid2topol* id2tops, const triple* angle_top);
+static void registerBondTopol(ptclid2topol* id2top, const int32_t bond);
+static void registerAngleTopol(ptclid2topol* id2top, const int32_t angle);
 
 topol* newTopolChain(const Parameter* param,
-                     const Boundary* bound)
+                     const Boundary* bound,
+                     Arena* arena)
 {
   const int32_t n = getNumPtcl(param);
-  topol* top = (topol*)xmalloc(sizeof(topol));
+  topol* top = (topol*)allocArena(arena, sizeof(topol));
 
   // bond topology
   int32_t num_bonds = n - 1;
   if (getBoundaryType(bound) == PERIODIC) num_bonds += 1;
-  top->bond_top = (pair*)xmalloc(num_bonds * sizeof(pair));
+  top->bond_top = (pair*)allocArena(arena, num_bonds * sizeof(pair));
   for (int32_t i = 0; i < n - 1; i++) {
     top->bond_top[i].i0 = i + 0;
     top->bond_top[i].i1 = i + 1;
@@ -45,7 +49,7 @@ topol* newTopolChain(const Parameter* param,
   // angle topology
   int32_t num_angles = n - 2;
   if (getBoundaryType(bound) == PERIODIC) num_angles += 2;
-  top->angle_top = (triple*)xmalloc(num_angles * sizeof(triple));
+  top->angle_top = (triple*)allocArena(arena, num_angles * sizeof(triple));
   for (int32_t i = 0; i < n - 2; i++) {
     top->angle_top[i].i0 = i + 0;
     top->angle_top[i].i1 = i + 1;
@@ -64,6 +68,62 @@ topol* newTopolChain(const Parameter* param,
   return top;
 }
 
+// NOTE: bonds and angles of chain c are stored in contiguous blocks
+//       starting at c * (chain_len - 1) and c * (chain_len - 2).
+void setTopolChain(topol* top,
+                   const int32_t chain,
+                   const int32_t* seq,
+                   const int32_t chain_len)
+{
+  pair* bond_top = &top->bond_top[chain * (chain_len - 1)];
+  for (int32_t k = 0; k < chain_len - 1; k++) {
+    bond_top[k].i0 = seq[k + 0];
+    bond_top[k].i1 = seq[k + 1];
+  }
+  triple* angle_top = &top->angle_top[chain * (chain_len - 2)];
+  for (int32_t k = 0; k < chain_len - 2; k++) {
+    angle_top[k].i0 = seq[k + 0];
+    angle_top[k].i1 = seq[k + 1];
+    angle_top[k].i2 = seq[k + 2];
+  }
+}
+
+topol* newTopolMelt(const Parameter* param,
+                    const Boundary* bound,
+                    Arena* arena)
+{
+  if (getBoundaryType(bound) == FREE) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "%s cannot be specified for melt simulation.\n", getBoundaryNameFromType(getBoundaryType(bound)));
+    exit(1);
+  }
+
+  const int32_t n = getNumPtcl(param);
+  const int32_t num_chains = getNumChains(param);
+  const int32_t chain_len = n / num_chains;
+  if (chain_len * num_chains != n || chain_len < 3) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "Number of particles should be num_chains * chain length (chain length >= 3).\n");
+    fprintf(stderr, "num_ptcl = %d, num_chains = %d.\n", n, num_chains);
+    exit(1);
+  }
+
+  topol* top = (topol*)allocArena(arena, sizeof(topol));
+  top->num_bonds  = num_chains * (chain_len - 1);
+  top->num_angles = num_chains * (chain_len - 2);
+  top->bond_top   = (pair*)allocArena(arena, top->num_bonds * sizeof(pair));
+  top->angle_top  = (triple*)allocArena(arena, top->num_angles * sizeof(triple));
+
+  int32_t* seq = (int32_t*)xmalloc(chain_len * sizeof(int32_t));
+  for (int32_t c = 0; c < num_chains; c++) {
+    for (int32_t k = 0; k < chain_len; k++) seq[k] = c * chain_len + k;
+    setTopolChain(top, c, seq, chain_len);
+  }
+  xfree(seq);
+
+  return top;
+}
+
 static int32_t getMeshId(int32_t x,
                          int32_t y,
                          const int32_t side_dim_x,
@@ -77,7 +137,8 @@ static int32_t getMeshId(int32_t x,
 }
 
 topol* newTopolMesh(const Parameter* param,
-                    const Boundary* bound)
+                    const Boundary* bound,
+                    Arena* arena)
 {
   if (getBoundaryType(bound) == FREE) {
     fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
@@ -96,11 +157,11 @@ topol* newTopolMesh(const Parameter* param,
     exit(1);
   }
 
-  topol* top = (topol*)xmalloc(sizeof(topol));
+  topol* top = (topol*)allocArena(arena, sizeof(topol));
 
   // bond topology
   const int32_t num_bonds = 2 * n;
-  top->bond_top = (pair*)xmalloc(num_bonds * sizeof(pair));
+  top->bond_top = (pair*)allocArena(arena, num_bonds * sizeof(pair));
   int32_t cnt0 = 0, cnt1 = n;
   for (int32_t y = 0; y < side_dim_y; y++) {
     for (int32_t x = 0; x < side_dim_x; x++) {
@@ -116,7 +177,7 @@ topol* newTopolMesh(const Parameter* param,
 
   // angle topology
   const int32_t num_angles = 2 * n;
-  top->angle_top = (triple*)xmalloc(num_angles * sizeof(triple));
+  top->angle_top = (triple*)allocArena(arena, num_angles * sizeof(triple));
   cnt0 = 0; cnt1 = n;
   for (int32_t y = 0; y < side_dim_y; y++) {
     for (int32_t x = 0; x < side_dim_x; x++) {
@@ -135,11 +196,219 @@ topol* newTopolMesh(const Parameter* param,
   return top;
 }
 
-void deleteTopol(topol* top)
+// NOTE: a bond or an angle read from a topology file, with the line it
+//       was read from. key is its canonical form: (min, max) of a bond and
+//       (vertex, min, max) of an angle, so that reversed entries compare
+//       equal.
+typedef struct {
+  int32_t ids[3];
+  int32_t key[3];
+  int32_t line_no;
+} TopolEntry;
+
+typedef struct {
+  TopolEntry* entries;
+  int32_t num_entries;
+  int32_t capacity;
+} TopolEntryList;
+
+static void exitAtTopolLine(const char* fname,
+                            const int32_t line_no,
+                            const char* msg)
+{
+  fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+  fprintf(stderr, "%s line %d: %s\n", fname, line_no, msg);
+  exit(1);
+}
+
+static void pushTopolEntry(TopolEntryList* list,
+                           const TopolEntry* entry)
 {
-  xfree(top->bond_top);
-  xfree(top->angle_top);
-  xfree(top);
+  if (list->num_entries == list->capacity) {
+    list->capacity = (list->capacity > 0) ? 2 * list->capacity : 64;
+    TopolEntry* entries = (TopolEntry*)xmalloc(list->capacity * sizeof(TopolEntry));
+    if (list->num_entries > 0) memcpy(entries, list->entries, list->num_entries * sizeof(TopolEntry));
+    if (list->entries) xfree(list->entries);
+    list->entries = entries;
+  }
+  list->entries[list->num_entries++] = *entry;
+}
+
+// NOTE: the whitespace-separated integers of a line, or -1 if a token is
+//       not an integer or there are more than max_ids of them.
+static int32_t parseTopolIds(const char* line,
+                             int32_t* ids,
+                             const int32_t max_ids)
+{
+  int32_t num_ids = 0;
+  const char* p = line;
+  while (true) {
+    while (isspace((unsigned char)*p)) p++;
+    if (*p == '\0') return num_ids;
+    if (num_ids == max_ids) return -1;
+    char* end;
+    errno = 0;
+    const long id = strtol(p, &end, 10);
+    if (end == p || errno != 0 || id < INT32_MIN || id > INT32_MAX
+        || (*end != '\0' && !isspace((unsigned char)*end))) return -1;
+    ids[num_ids++] = (int32_t)id;
+    p = end;
+  }
+}
+
+static int compareTopolKey(const void* lhs,
+                           const void* rhs)
+{
+  const TopolEntry* a = (const TopolEntry*)lhs;
+  const TopolEntry* b = (const TopolEntry*)rhs;
+  for (int32_t k = 0; k < 3; k++) {
+    if (a->key[k] != b->key[k]) return (a->key[k] < b->key[k]) ? -1 : 1;
+  }
+  return 0;
+}
+
+// NOTE: sorts the entries by key and rejects the first repeated one.
+static void checkDuplicateEntries(TopolEntry* sorted,
+                                  const int32_t num_entries,
+                                  const char* fname,
+                                  const char* kind)
+{
+  qsort(sorted, num_entries, sizeof(TopolEntry), compareTopolKey);
+  for (int32_t k = 1; k < num_entries; k++) {
+    if (compareTopolKey(&sorted[k - 1], &sorted[k]) == 0) {
+      const TopolEntry* first = (sorted[k - 1].line_no < sorted[k].line_no) ? &sorted[k - 1] : &sorted[k];
+      const TopolEntry* second = (first == &sorted[k]) ? &sorted[k - 1] : &sorted[k];
+      char msg[128];
+      snprintf(msg, sizeof(msg), "duplicate %s, first given at line %d.", kind, first->line_no);
+      exitAtTopolLine(fname, second->line_no, msg);
+    }
+  }
+}
+
+static bool hasBondEntry(const TopolEntry* sorted_bonds,
+                         const int32_t num_bonds,
+                         const int32_t p0,
+                         const int32_t p1)
+{
+  TopolEntry bond;
+  bond.key[0] = (p0 < p1) ? p0 : p1;
+  bond.key[1] = (p0 < p1) ? p1 : p0;
+  bond.key[2] = -1;
+  return bsearch(&bond, sorted_bonds, num_bonds, sizeof(TopolEntry), compareTopolKey) != NULL;
+}
+
+// NOTE: a line of two particle ids is a bond and a line of three is an
+//       angle; ids must lie in [0, num_ptcl) and be distinct within the line.
+static void readTopolLine(const char* line,
+                          const int32_t line_no,
+                          const int32_t num_ptcl,
+                          const char* fname,
+                          TopolEntryList* bonds,
+                          TopolEntryList* angles)
+{
+  TopolEntry entry;
+  const int32_t num_ids = parseTopolIds(line, entry.ids, 3);
+  if (num_ids == 0) return;
+  if (num_ids != 2 && num_ids != 3) {
+    exitAtTopolLine(fname, line_no, "expected two particle ids (bond) or three (angle).");
+  }
+  for (int32_t k = 0; k < num_ids; k++) {
+    if (entry.ids[k] < 0 || entry.ids[k] >= num_ptcl) {
+      char msg[128];
+      snprintf(msg, sizeof(msg), "particle %d is out of range (num_ptcl = %d).", entry.ids[k], num_ptcl);
+      exitAtTopolLine(fname, line_no, msg);
+    }
+  }
+  entry.line_no = line_no;
+  if (num_ids == 2) {
+    if (entry.ids[0] == entry.ids[1]) exitAtTopolLine(fname, line_no, "bond of a particle with itself.");
+    entry.ids[2] = -1;
+    entry.key[0] = (entry.ids[0] < entry.ids[1]) ? entry.ids[0] : entry.ids[1];
+    entry.key[1] = (entry.ids[0] < entry.ids[1]) ? entry.ids[1] : entry.ids[0];
+    entry.key[2] = -1;
+    pushTopolEntry(bonds, &entry);
+  } else {
+    if (entry.ids[0] == entry.ids[1] || entry.ids[1] == entry.ids[2] || entry.ids[0] == entry.ids[2]) {
+      exitAtTopolLine(fname, line_no, "angle with a repeated particle.");
+    }
+    entry.key[0] = entry.ids[1];
+    entry.key[1] = (entry.ids[0] < entry.ids[2]) ? entry.ids[0] : entry.ids[2];
+    entry.key[2] = (entry.ids[0] < entry.ids[2]) ? entry.ids[2] : entry.ids[0];
+    pushTopolEntry(angles, &entry);
+  }
+}
+
+// NOTE: the format is that of topology.dat (see debugDumpTopolInfo). Lines
+//       starting with '#' are comments and blank lines are skipped; a line
+//       of two particle ids is a bond and a line of three is an angle (i1
+//       is the vertex), whose two bonds must be given in the file. Any
+//       other line, a bond of a particle with itself and a repeated bond or
+//       angle (also reversed) are rejected with the line number.
+topol* newTopolFromFile(const Parameter* param,
+                        const Boundary* bound,
+                        Arena* arena)
+{
+  (void)bound;
+  if (getNumChains(param) > 1) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "topology_file cannot be specified for melt simulation.\n");
+    exit(1);
+  }
+
+  string* fname = new_string_from_string(getRootDir(param));
+  append_char(fname, "/");
+  append_char(fname, string_to_char(getTopologyFile(param)));
+  const char* fname_c = string_to_char(fname);
+
+  TopolEntryList bonds = {NULL, 0, 0};
+  TopolEntryList angles = {NULL, 0, 0};
+  FILE* fp = xfopen(fname_c, "r");
+  char line[256];
+  int32_t line_no = 0;
+  while (fgets(line, sizeof(line), fp)) {
+    line_no++;
+    if (!strchr(line, '\n') && !feof(fp)) exitAtTopolLine(fname_c, line_no, "line too long.");
+    if (line[0] == '#') continue;
+    readTopolLine(line, line_no, getNumPtcl(param), fname_c, &bonds, &angles);
+  }
+  xfclose(fp);
+
+  if (bonds.num_entries == 0) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "%s contains no bond.\n", fname_c);
+    exit(1);
+  }
+
+  topol* top = (topol*)allocArena(arena, sizeof(topol));
+  top->num_bonds = bonds.num_entries;
+  top->num_angles = angles.num_entries;
+  top->bond_top = (pair*)allocArena(arena, top->num_bonds * sizeof(pair));
+  for (int32_t b = 0; b < top->num_bonds; b++) {
+    top->bond_top[b].i0 = bonds.entries[b].ids[0];
+    top->bond_top[b].i1 = bonds.entries[b].ids[1];
+  }
+  top->angle_top = (triple*)allocArena(arena, top->num_angles * sizeof(triple));
+  for (int32_t a = 0; a < top->num_angles; a++) {
+    top->angle_top[a].i0 = angles.entries[a].ids[0];
+    top->angle_top[a].i1 = angles.entries[a].ids[1];
+    top->angle_top[a].i2 = angles.entries[a].ids[2];
+  }
+
+  // the lists are sorted by key once the topology holds them in file order
+  checkDuplicateEntries(bonds.entries, bonds.num_entries, fname_c, "bond");
+  checkDuplicateEntries(angles.entries, angles.num_entries, fname_c, "angle");
+  for (int32_t a = 0; a < angles.num_entries; a++) {
+    const int32_t* ids = angles.entries[a].ids;
+    if (!hasBondEntry(bonds.entries, bonds.num_entries, ids[0], ids[1])
+        || !hasBondEntry(bonds.entries, bonds.num_entries, ids[1], ids[2])) {
+      exitAtTopolLine(fname_c, angles.entries[a].line_no, "angle whose bonds are not both given.");
+    }
+  }
+
+  xfree(bonds.entries);
+  if (angles.entries) xfree(angles.entries);
+  delete_string(fname);
+  return top;
 }
 
 int32_t getNumBonds(const topol* top)
@@ -162,80 +431,184 @@ const triple* getAngleTopol(const topol* top)
   return top->angle_top;
 }
 
-static void copyPair(pair* dst, const pair* src)
+static void registerBondTopol(ptclid2topol* id2top,
+                              const int32_t bond)
 {
-  dst->i0 = src->i0;
-  dst->i1 = src->i1;
+  const pair* bond_top = &id2top->bond_top[bond];
+  const int32_t ids[2] = {bond_top->i0, bond_top->i1};
+  for (int32_t k = 0; k < 2; k++) {
+    Id2TopolRow* row = &id2top->rows[ids[k]];
+    id2top->pair_ids[row->pair_begin + row->num_pair++] = bond;
+  }
 }
 
-static void copyTriple(triple* dst, const triple* src)
+static void registerAngleTopol(ptclid2topol* id2top,
+                               const int32_t angle)
 {
-  dst->i0 = src->i0;
-  dst->i1 = src->i1;
-  dst->i2 = src->i2;
+  const triple* angle_top = &id2top->angle_top[angle];
+  const int32_t ids[3] = {angle_top->i0, angle_top->i1, angle_top->i2};
+  for (int32_t k = 0; k < 3; k++) {
+    Id2TopolRow* row = &id2top->rows[ids[k]];
+    id2top->triple_ids[row->triple_begin + row->num_triple++] = angle;
+  }
 }
 
-static void registerBondTopol(ptclid2topol* id2tops,
-                              const pair* bond_top)
+// NOTE: counts the degrees into rows and sets the row begins; returns the
+//       lengths of pair_ids and triple_ids.
+static void setId2TopolRows(Id2TopolRow* rows,
+                            const topol* top,
+                            const Parameter* param,
+                            int32_t* pair_end,
+                            int32_t* triple_end)
 {
-  const int32_t i = bond_top->i0;
-  const int32_t j = bond_top->i1;
+  const int32_t num_ptcl = getNumPtcl(param);
+  for (int32_t i = 0; i <= num_ptcl; i++) {
+    rows[i].num_pair = 0;
+    rows[i].num_triple = 0;
+  }
 
-  int32_t i_id = id2tops[i].num_pair;
-  int32_t j_id = id2tops[j].num_pair;
+  // degrees
+  const int32_t num_bonds = top->num_bonds;
+  for (int32_t bond = 0; bond < num_bonds; bond++) {
+    rows[top->bond_top[bond].i0].num_pair++;
+    rows[top->bond_top[bond].i1].num_pair++;
+  }
+  const int32_t num_angles = top->num_angles;
+  for (int32_t angle = 0; angle < num_angles; angle++) {
+    rows[top->angle_top[angle].i0].num_triple++;
+    rows[top->angle_top[angle].i1].num_triple++;
+    rows[top->angle_top[angle].i2].num_triple++;
+  }
 
-  copyPair(&id2tops[i].pair[i_id++], bond_top);
-  copyPair(&id2tops[j].pair[j_id++], bond_top);
+  // row begins; capacities are the degrees (at least 2 and 3 for melts)
+  const bool is_melt = getNumChains(param) > 1;
+  const int32_t min_pair = is_melt ? 2 : 0;
+  const int32_t min_triple = is_melt ? 3 : 0;
+  *pair_end = *triple_end = 0;
+  for (int32_t i = 0; i <= num_ptcl; i++) {
+    rows[i].pair_begin = *pair_end;
+    rows[i].triple_begin = *triple_end;
+    *pair_end += (rows[i].num_pair > min_pair) ? rows[i].num_pair : min_pair;
+    *triple_end += (rows[i].num_triple > min_triple) ? rows[i].num_triple : min_triple;
+    rows[i].num_pair = 0;
+    rows[i].num_triple = 0;
+  }
+}
 
-  id2tops[i].num_pair = i_id;
-  id2tops[j].num_pair = j_id;
+static void registerAllTopol(ptclid2topol* id2top,
+                             const topol* top)
+{
+  for (int32_t bond = 0; bond < top->num_bonds; bond++) {
+    registerBondTopol(id2top, bond);
+  }
+  for (int32_t angle = 0; angle < top->num_angles; angle++) {
+    registerAngleTopol(id2top, angle);
+  }
 }
 
-static void registerAngleTopol(ptclid2topol* id2tops,
-                               const triple* angle_top)
+ptclid2topol* newId2Topol(const topol* top,
+                          const Parameter* param,
+                          Arena* arena)
 {
-  const int32_t i = angle_top->i0;
-  const int32_t j = angle_top->i1;
-  const int32_t k = angle_top->i2;
+  const int32_t num_ptcl = getNumPtcl(param);
+  ptclid2topol* id2top = (ptclid2topol*)allocArena(arena, sizeof(ptclid2topol));
+  id2top->num_ptcl = num_ptcl;
+  id2top->bond_top = top->bond_top;
+  id2top->angle_top = top->angle_top;
+  id2top->rows = (Id2TopolRow*)allocArena(arena, (num_ptcl + 1) * sizeof(Id2TopolRow));
+  int32_t pair_end, triple_end;
+  setId2TopolRows(id2top->rows, top, param, &pair_end, &triple_end);
+  id2top->pair_ids = (int32_t*)allocArena(arena, pair_end * sizeof(int32_t));
+  id2top->triple_ids = (int32_t*)allocArena(arena, triple_end * sizeof(int32_t));
+  registerAllTopol(id2top, top);
+  return id2top;
+}
 
-  int32_t i_id = id2tops[i].num_triple;
-  int32_t j_id = id2tops[j].num_triple;
-  int32_t k_id = id2tops[k].num_triple;
+void rebuildId2Topol(ptclid2topol* id2top,
+                     const topol* top,
+                     const Parameter* param)
+{
+  int32_t pair_end, triple_end;
+  setId2TopolRows(id2top->rows, top, param, &pair_end, &triple_end);
+  registerAllTopol(id2top, top);
+}
+
+// NOTE: every bond and angle of a particle in a melt belongs to its own chain,
+//       so the rows of one chain can be rebuilt independently.
+void updateId2TopolChain(ptclid2topol* id2top,
+                         const topol* top,
+                         const int32_t chain,
+                         const int32_t* seq,
+                         const int32_t chain_len)
+{
+  (void)top;
+  for (int32_t k = 0; k < chain_len; k++) {
+    id2top->rows[seq[k]].num_pair = 0;
+    id2top->rows[seq[k]].num_triple = 0;
+  }
 
-  copyTriple(&id2tops[i].triple[i_id++], angle_top);
-  copyTriple(&id2tops[j].triple[j_id++], angle_top);
-  copyTriple(&id2tops[k].triple[k_id++], angle_top);
+  const int32_t bond_offset = chain * (chain_len - 1);
+  for (int32_t k = 0; k < chain_len - 1; k++) {
+    registerBondTopol(id2top, bond_offset + k);
+  }
 
-  id2tops[i].num_triple = i_id;
-  id2tops[j].num_triple = j_id;
-  id2tops[k].num_triple = k_id;
+  const int32_t angle_offset = chain * (chain_len - 2);
+  for (int32_t k = 0; k < chain_len - 2; k++) {
+    registerAngleTopol(id2top, angle_offset + k);
+  }
 }
 
-ptclid2topol* newId2Topol(const topol* top,
-                          const Parameter* param)
+void permuteTopol(topol* top,
+                  const int32_t* new_of_old)
 {
-  const int32_t num_ptcls = getNumPtcl(param);
-  ptclid2topol* id2tops = (ptclid2topol*)xmalloc(num_ptcls * sizeof(ptclid2topol));
-  for (int32_t i = 0; i < num_ptcls; i++) {
-    id2tops[i].num_pair = 0;
-    id2tops[i].num_triple = 0;
+  for (int32_t b = 0; b < top->num_bonds; b++) {
+    top->bond_top[b].i0 = new_of_old[top->bond_top[b].i0];
+    top->bond_top[b].i1 = new_of_old[top->bond_top[b].i1];
   }
-
-  const int32_t num_bonds = top->num_bonds;
-  for (int32_t bond = 0; bond < num_bonds; bond++) {
-    registerBondTopol(id2tops, &top->bond_top[bond]);
+  for (int32_t a = 0; a < top->num_angles; a++) {
+    top->angle_top[a].i0 = new_of_old[top->angle_top[a].i0];
+    top->angle_top[a].i1 = new_of_old[top->angle_top[a].i1];
+    top->angle_top[a].i2 = new_of_old[top->angle_top[a].i2];
   }
+}
 
-  const int32_t num_angles = top->num_angles;
-  for (int32_t angle = 0; angle < num_angles; angle++) {
-    registerAngleTopol(id2tops, &top->angle_top[angle]);
+ImplicitTopol* newImplicitTopol(const Parameter* param)
+{
+  ImplicitTopol* implicit = (ImplicitTopol*)xmalloc(sizeof(ImplicitTopol));
+  implicit->num_ptcl = getNumPtcl(param);
+  implicit->side_dim_x = getSideDimx(param);
+  implicit->side_dim_y = getSideDimy(param);
+  return implicit;
+}
+
+void deleteImplicitTopol(ImplicitTopol* implicit)
+{
+  xfree(implicit);
+}
+
+const char* getTopologyModeNameFromType(TOPOLOGY_MODE type)
+{
+  switch (type) {
+  case EXPLICIT_TOPOLOGY:
+    return "explicit";
+  case IMPLICIT_TOPOLOGY:
+    return "implicit";
+  default:
+    fprintf(stderr, "Unknown type\n");
+    return NULL;
   }
-  return id2tops;
 }
 
-void deleteId2Topol(ptclid2topol* id2tops)
+// NOTE: the explicit topology is used when topology_mode is not specified.
+TOPOLOGY_MODE getTopologyModeTypeFromName(const string* mode_name)
 {
-  xfree(id2tops);
+  if (!mode_name) return EXPLICIT_TOPOLOGY;
+  for (int32_t type = EXPLICIT_TOPOLOGY; type <= IMPLICIT_TOPOLOGY; type++) {
+    if (0 == strcmp(string_to_char(mode_name), getTopologyModeNameFromType(type))) return type;
+  }
+  fprintf(stderr, "Error occurs in getTopologyModeTypeFromName at %s:%d\n", __FILE__, (int32_t)__LINE__);
+  fprintf(stderr, "Unknown topology mode %s\n", string_to_char(mode_name));
+  exit(1);
 }
 
 void debugDumpTopolInfo(const topol* top,
@@ -277,13 +650,13 @@ void debugDumpId2TopolInfo(const ptclid2topol* id2top,
   const int32_t num_ptcls = getNumPtcl(param);
   for (int32_t i = 0; i < num_ptcls; i++) {
     fprintf(fp_id2top, "%d ", i);
-    for (int32_t b = 0; b < id2top[i].num_pair; b++) {
-      fprintf(fp_id2top, "(%d, %d) ",
-              id2top[i].pair[b].i0, id2top[i].pair[b].i1);
+    for (int32_t b = 0; b < getNumPairsOfPtcl(id2top, i); b++) {
+      const pair* bond = getPairOfPtcl(id2top, i, b);
+      fprintf(fp_id2top, "(%d, %d) ", bond->i0, bond->i1);
     }
-    for (int32_t a = 0; a < id2top[i].num_triple; a++) {
-      fprintf(fp_id2top, "(%d, %d, %d) ",
-              id2top[i].triple[a].i0, id2top[i].triple[a].i1, id2top[i].triple[a].i2);
+    for (int32_t a = 0; a < getNumTriplesOfPtcl(id2top, i); a++) {
+      const triple* angle = getTripleOfPtcl(id2top, i, a);
+      fprintf(fp_id2top, "(%d, %d, %d) ", angle->i0, angle->i1, angle->i2);
     }
     fprintf(fp_id2top, "\n");
   }
@@ -11,6 +11,15 @@ void* xmalloc(const size_t size) {
   return ptr_ret;
 }
 
+void* xmalloc_aligned(const size_t alignment, const size_t size) {
+  void* ptr_ret = NULL;
+  if (posix_memalign(&ptr_ret, alignment, size) != 0) {
+    perror("xmalloc_aligned");
+    exit(EXIT_FAILURE);
+  }
+  return ptr_ret;
+}
+
 void xfree(void* ptr) {
   free(ptr);
 }
@@ -0,0 +1,207 @@
+#include "verlet_list.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "utils.h"
+#include "boundary.h"
+#include "cell_list.h"
+#include "hash_grid.h"
+
+struct VerletList_t {
+  LJParam lj;
+  double skin;
+  double half_skin2;
+  double list_cut2;
+  int32_t num_ptcl;
+  int32_t num_rebuilds;
+  int32_t dim;
+
+  CellList* cells;
+  HashGrid* hgrid;
+  double* pos_at_build; // dim per particle
+  int32_t* offsets;
+  int32_t* nbrs;
+  int32_t nbrs_cap;
+};
+
+VerletList* newVerletList(const Boundary* bound,
+                          const LJParam lj,
+                          const double skin,
+                          const int32_t num_ptcl)
+{
+  if (!(skin > 0.0)) {
+    fprintf(stderr, "Error occurs at %s %d\n", __FILE__, (int32_t)__LINE__);
+    fprintf(stderr, "verlet_skin should be positive (%f).\n", skin);
+    exit(1);
+  }
+
+  VerletList* self = (VerletList*)xmalloc(sizeof(VerletList));
+  self->lj = lj;
+  self->skin = skin;
+  self->half_skin2 = 0.25 * skin * skin;
+  const double list_cut = sqrt(lj.rc2) + skin;
+  self->list_cut2 = list_cut * list_cut;
+  self->num_ptcl = num_ptcl;
+  self->num_rebuilds = 0;
+
+  self->cells = NULL;
+  self->hgrid = NULL;
+  if (getBoundaryType(bound) == PERIODIC) {
+    self->cells = newCellList(bound, list_cut, num_ptcl);
+  } else {
+    self->hgrid = newHashGrid(list_cut, num_ptcl, getBoundaryDim(bound));
+  }
+  self->dim = getBoundaryDim(bound);
+  self->pos_at_build = (double*)xmalloc(self->dim * num_ptcl * sizeof(double));
+  self->offsets = (int32_t*)xmalloc((num_ptcl + 1) * sizeof(int32_t));
+  self->nbrs_cap = 16 * num_ptcl;
+  self->nbrs = (int32_t*)xmalloc(self->nbrs_cap * sizeof(int32_t));
+  return self;
+}
+
+void deleteVerletList(VerletList* self)
+{
+  if (self->cells) deleteCellList(self->cells);
+  if (self->hgrid) deleteHashGrid(self->hgrid);
+  xfree(self->pos_at_build);
+  xfree(self->offsets);
+  xfree(self->nbrs);
+  xfree(self);
+}
+
+static void pushNeighbor(VerletList* self,
+                         const int32_t num,
+                         const int32_t j)
+{
+  if (num == self->nbrs_cap) {
+    int32_t* nbrs = (int32_t*)xmalloc(2 * self->nbrs_cap * sizeof(int32_t));
+    memcpy(nbrs, self->nbrs, self->nbrs_cap * sizeof(int32_t));
+    xfree(self->nbrs);
+    self->nbrs = nbrs;
+    self->nbrs_cap *= 2;
+  }
+  self->nbrs[num] = j;
+}
+
+static int32_t collectNeighbors(VerletList* self,
+                                const PosStore* store,
+                                const int32_t i,
+                                int32_t num,
+                                const Boundary* bound)
+{
+  const dvec ri = getPosOfStore(store, i);
+  int32_t heads[MAX_NEIGHBOR_CELLS];
+  int32_t num_heads = 0;
+  if (self->cells) {
+    num_heads = getNeighborCells(self->cells, getCellIdOfPos(self->cells, &ri), heads);
+    for (int32_t c = 0; c < num_heads; c++) heads[c] = getCellHead(self->cells, heads[c]);
+  } else {
+    num_heads = getNeighborHeadsInHashGrid(self->hgrid, &ri, heads);
+  }
+
+  for (int32_t c = 0; c < num_heads; c++) {
+    int32_t j = heads[c];
+    while (j != CELL_NONE) {
+      const dvec rj = getPosOfStore(store, j);
+      if (j != i && distance2(&ri, &rj, bound) < self->list_cut2) pushNeighbor(self, num++, j);
+      j = self->cells ? getNextInCell(self->cells, j) : getNextInHashGrid(self->hgrid, j);
+    }
+  }
+  return num;
+}
+
+void buildVerletList(VerletList* self,
+                     const PosStore* store,
+                     const Boundary* bound)
+{
+  if (self->cells) {
+    buildCellList(self->cells, store);
+  } else {
+    buildHashGrid(self->hgrid, store);
+  }
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    double* r = &self->pos_at_build[self->dim * i];
+    r[0] = store->x[i];
+    r[1] = store->y[i];
+    if (self->dim == 3) r[2] = store->z[i];
+  }
+
+  int32_t num = 0;
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    self->offsets[i] = num;
+    num = collectNeighbors(self, store, i, num, bound);
+  }
+  self->offsets[self->num_ptcl] = num;
+  self->num_rebuilds++;
+}
+
+// NOTE: must be called before the energy at the trial position is computed.
+void prepareVerletMove(VerletList* self,
+                       const PosStore* store,
+                       const int32_t id,
+                       const dvec* trial,
+                       const Boundary* bound)
+{
+  const double* r = &self->pos_at_build[self->dim * id];
+  const dvec r_at_build = {.x = r[0], .y = r[1], .z = (self->dim == 3) ? r[2] : 0.0};
+  if (distance2(trial, &r_at_build, bound) >= self->half_skin2) {
+    buildVerletList(self, store, bound);
+  }
+}
+
+double calcNonbondEnergyLocal(const VerletList* self,
+                              const PosStore* store,
+                              const int32_t id,
+                              const Boundary* bound)
+{
+  const dvec r = getPosOfStore(store, id);
+  double esum = 0.0;
+  for (int32_t k = self->offsets[id]; k < self->offsets[id + 1]; k++) {
+    const dvec rk = getPosOfStore(store, self->nbrs[k]);
+    esum += calcLJEnergy(&r, &rk, &self->lj, bound);
+  }
+  return esum;
+}
+
+double calcNonbondEnergyTotal(const VerletList* self,
+                              const PosStore* store,
+                              const Boundary* bound)
+{
+  double esum = 0.0;
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    const dvec ri = getPosOfStore(store, i);
+    for (int32_t k = self->offsets[i]; k < self->offsets[i + 1]; k++) {
+      const int32_t j = self->nbrs[k];
+      if (j <= i) continue;
+      const dvec rj = getPosOfStore(store, j);
+      esum += calcLJEnergy(&ri, &rj, &self->lj, bound);
+    }
+  }
+  return esum;
+}
+
+dtensor3 calcNonbondVirialTotal(const VerletList* self,
+                                const PosStore* store,
+                                const Boundary* bound)
+{
+  dtensor3 vir_tot = { 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0.0 };
+  for (int32_t i = 0; i < self->num_ptcl; i++) {
+    const dvec ri = getPosOfStore(store, i);
+    for (int32_t k = self->offsets[i]; k < self->offsets[i + 1]; k++) {
+      const int32_t j = self->nbrs[k];
+      if (j <= i) continue;
+      const dvec rj = getPosOfStore(store, j);
+      const dtensor3 dvir = calcLJVirial(&ri, &rj, &self->lj, bound);
+      dtensor3_add(&vir_tot, &dvir);
+    }
+  }
+  return vir_tot;
+}
+
+int32_t getNumVerletRebuilds(const VerletList* self)
+{
+  return self->num_rebuilds;
+}